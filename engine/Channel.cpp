@@ -382,14 +382,17 @@ const String& CallEndpoint::audioType()
 
 static const String s_disconnected("chan.disconnected");
 
+// Number of one second slots in the channel timer wheel of a driver
+#define TIMER_SLOTS 1024
+
 // Mutex used to lock disconnect parameters during access
 static Mutex s_paramMutex(true,"ChannelParams");
 
 Channel::Channel(Driver* driver, const char* id, bool outgoing)
     : CallEndpoint(id),
       m_parameters(""), m_driver(driver), m_outgoing(outgoing),
-      m_timeout(0), m_maxcall(0), m_maxPDD(0), m_dtmfTime(0),
-      m_toutAns(0), m_dtmfSeq(0), m_answered(false)
+      m_timeout(0), m_maxcall(0), m_maxPDD(0), m_timerTime(0), m_timer(this),
+      m_dtmfTime(0), m_toutAns(0), m_dtmfSeq(0), m_answered(false)
 {
     init();
 }
@@ -397,8 +400,8 @@ Channel::Channel(Driver* driver, const char* id, bool outgoing)
 Channel::Channel(Driver& driver, const char* id, bool outgoing)
     : CallEndpoint(id),
       m_parameters(""), m_driver(&driver), m_outgoing(outgoing),
-      m_timeout(0), m_maxcall(0), m_maxPDD(0), m_dtmfTime(0),
-      m_toutAns(0), m_dtmfSeq(0), m_answered(false)
+      m_timeout(0), m_maxcall(0), m_maxPDD(0), m_timerTime(0), m_timer(this),
+      m_dtmfTime(0), m_toutAns(0), m_dtmfSeq(0), m_answered(false)
 {
     init();
 }
@@ -483,7 +486,9 @@ void Channel::initChan()
     m_driver->m_total++;
     m_driver->m_chanCount++;
     m_driver->channels().append(this);
+    m_driver->m_chanIndex.append(this)->setDelete(false);
     m_driver->changed();
+    updateTimers();
 }
 
 void Channel::dropChan()
@@ -493,6 +498,8 @@ void Channel::dropChan()
     m_driver->lock();
     if (!m_driver)
 	Debug(DebugFail,"Driver lost in dropChan! [%p]",this);
+    m_driver->m_chanIndex.remove(this,false,true);
+    m_driver->timerCancel(this);
     if (m_driver->channels().remove(this,false)) {
 	if (m_driver->m_chanCount > 0)
 	    m_driver->m_chanCount--;
@@ -560,7 +567,16 @@ void Channel::dispatched(const Message& msg, bool handled)
 void Channel::setId(const char* newId)
 {
     debugName(0);
-    CallEndpoint::setId(newId);
+    if (m_driver) {
+	// keep the driver's channel index in sync
+	Lock lock(m_driver);
+	bool indexed = (0 != m_driver->m_chanIndex.remove(this,false,true));
+	CallEndpoint::setId(newId);
+	if (indexed)
+	    m_driver->m_chanIndex.append(this)->setDelete(false);
+    }
+    else
+	CallEndpoint::setId(newId);
     debugName(id());
 }
 
@@ -859,6 +875,26 @@ void Channel::statusParams(String& str)
     }
 }
 
+void Channel::scheduleTimers(u_int64_t when)
+{
+    if (!(when && m_driver))
+	return;
+    Lock lock(m_driver);
+    if (m_driver && !(m_timerTime && (m_timerTime <= when)))
+	m_driver->timerSchedule(this,when);
+}
+
+// Schedule a check for the earliest of the channel's timeouts
+void Channel::updateTimers()
+{
+    u_int64_t when = m_timeout;
+    if (m_maxcall && (!when || (m_maxcall < when)))
+	when = m_maxcall;
+    if (m_maxPDD && (!when || (m_maxPDD < when)))
+	when = m_maxPDD;
+    scheduleTimers(when);
+}
+
 void Channel::checkTimers(Message& msg, const Time& tmr)
 {
     if (timeout() && (timeout() < tmr))
@@ -1348,6 +1384,7 @@ bool Module::filterDebug(const String& item) const
 Driver::Driver(const char* name, const char* type)
     : Module(name,type),
       m_init(false), m_varchan(true),
+      m_chanIndex(1021), m_timerWheel(0),
       m_routing(0), m_routed(0), m_total(0),
       m_nextid(0), m_timeout(0),
       m_maxroute(0), m_maxchans(0), m_chanCount(0), m_dtmfDups(false)
@@ -1355,6 +1392,11 @@ Driver::Driver(const char* name, const char* type)
     m_prefix << name << "/";
 }
 
+Driver::~Driver()
+{
+    delete m_timerWheel;
+}
+
 void* Driver::getObject(const String& name) const
 {
     if (name == YATOM("Driver"))
@@ -1397,9 +1439,32 @@ bool Driver::isBusy() const
     return (m_routing || m_chanCount);
 }
 
+// Place a channel in the timer wheel, driver must be locked
+void Driver::timerSchedule(Channel* chan, u_int64_t when)
+{
+    // only channels in our list are checked for timeouts
+    if (!m_chanIndex.find(chan,chan->id().hash()))
+	return;
+    if (!m_timerWheel)
+	m_timerWheel = new TimerWheel(TIMER_SLOTS,1000000,Time::now());
+    // a channel already in the wheel is only moved to an earlier time
+    chan->m_timerTime = when;
+    m_timerWheel->schedule(chan->m_timer,when);
+}
+
+// Remove a channel from the timer wheel, driver must be locked
+void Driver::timerCancel(Channel* chan)
+{
+    if (!chan->m_timerTime)
+	return;
+    chan->m_timerTime = 0;
+    if (m_timerWheel)
+	m_timerWheel->cancel(chan->m_timer);
+}
+
 Channel* Driver::find(const String& id) const
 {
-    const ObjList* pos = m_chans.find(id);
+    const ObjList* pos = m_chanIndex.find(id);
     return pos ? static_cast<Channel*>(pos->get()) : 0;
 }
 
@@ -1412,18 +1477,25 @@ bool Driver::received(Message &msg, int id)
     switch (id) {
 	case Timer:
 	    {
-		// check each channel for timeouts
-		lock();
-		ListIterator iter(m_chans);
+		// collect the channels whose scheduled check time has passed
+		ObjList due;
+		ObjList* last = &due;
 		Time t;
-		for (;;) {
-		    RefPointer<Channel> c = static_cast<Channel*>(iter.get());
-		    unlock();
-		    if (!c)
-			break;
+		lock();
+		if (m_timerWheel) {
+		    m_timerWheel->advance(t);
+		    // channels returned early from the end of the wheel reschedule themselves
+		    while (Channel* c = static_cast<Channel*>(m_timerWheel->get())) {
+			c->m_timerTime = 0;
+			if (c->ref())
+			    last = last->append(c);
+		    }
+		}
+		unlock();
+		while (Channel* c = static_cast<Channel*>(due.remove(false))) {
 		    c->checkTimers(msg,t);
-		    c = 0;
-		    lock();
+		    c->updateTimers();
+		    c->deref();
 		}
 	    }
 	    return Module::received(msg,id);
@@ -50,6 +50,11 @@ unsigned int Cipher::initVectorSize() const
     return 0;
 }
 
+unsigned int Cipher::tagSize() const
+{
+    return 0;
+}
+
 unsigned int Cipher::bufferSize(unsigned int len) const
 {
     unsigned int bSize = blockSize();
@@ -71,4 +76,14 @@ bool Cipher::initVector(const void* vect, unsigned int len, Direction dir)
     return false;
 }
 
+bool Cipher::encryptAuth(void* data, unsigned int len, const void* aad, unsigned int aadLen, void* tag)
+{
+    return false;
+}
+
+bool Cipher::decryptAuth(void* data, unsigned int len, const void* aad, unsigned int aadLen, const void* tag)
+{
+    return false;
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
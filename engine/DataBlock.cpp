@@ -22,6 +22,11 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifndef _WINDOWS
+#define FRAME_POOL
+#include <pthread.h>
+#endif
+
 using namespace TelEngine;
 
 namespace { // anonymous
@@ -75,6 +80,179 @@ static InitG711 s_initG711;
 
 }; // anonymous namespace
 
+#ifdef FRAME_POOL
+
+// Number of pooled buffer classes and their data size, 10 to 40ms slin frames fit
+#define POOL_CLASSES 4
+static const unsigned int s_poolSize[POOL_CLASSES] = { 256, 512, 1024, 2048 };
+// Buffers a thread caches per class before moving half of them to the depot
+#define POOL_CACHE_MAX 32
+// Buffers kept per class in the depot shared by all threads, extra ones are freed
+#define POOL_DEPOT_MAX 1024
+// Trailer of a pooled buffer, placed after the data
+// The data starts the allocated memory so a block that takes it over with
+//  assign(data,len,false) can release it with free() like any other
+struct PoolBuffer
+{
+    PoolBuffer* next;
+    unsigned int cls;
+};
+
+static inline void* poolData(PoolBuffer* b)
+{
+    return ((char*)b) - s_poolSize[b->cls];
+}
+
+// Free buffers and allocation counter of a thread
+struct PoolCache
+{
+    PoolBuffer* free[POOL_CLASSES];
+    unsigned int count[POOL_CLASSES];
+    unsigned int allocs;
+};
+
+static volatile bool s_poolEnabled = true;
+static Mutex s_poolMutex(false,"DataPool");
+static PoolBuffer* s_depot[POOL_CLASSES];
+static unsigned int s_depotCount[POOL_CLASSES];
+static pthread_key_t s_poolKey;
+static bool s_poolKeyOk = false;
+
+// Move a number of buffers from a thread's cache to the depot
+static void poolPut(PoolCache* cache, unsigned int cls, unsigned int count)
+{
+    PoolBuffer* list = 0;
+    s_poolMutex.lock();
+    for (; count && cache->free[cls]; count--) {
+	PoolBuffer* b = cache->free[cls];
+	cache->free[cls] = b->next;
+	cache->count[cls]--;
+	if (s_depotCount[cls] < POOL_DEPOT_MAX) {
+	    b->next = s_depot[cls];
+	    s_depot[cls] = b;
+	    s_depotCount[cls]++;
+	}
+	else {
+	    b->next = list;
+	    list = b;
+	}
+    }
+    s_poolMutex.unlock();
+    while (list) {
+	PoolBuffer* b = list;
+	list = b->next;
+	::free(poolData(b));
+    }
+}
+
+// Take a number of buffers from the depot into a thread's cache
+static void poolGet(PoolCache* cache, unsigned int cls, unsigned int count)
+{
+    s_poolMutex.lock();
+    for (; count && s_depot[cls]; count--) {
+	PoolBuffer* b = s_depot[cls];
+	s_depot[cls] = b->next;
+	s_depotCount[cls]--;
+	b->next = cache->free[cls];
+	cache->free[cls] = b;
+	cache->count[cls]++;
+    }
+    s_poolMutex.unlock();
+}
+
+// Thread exit: give cached buffers back to the depot
+static void pool_release(void* data)
+{
+    PoolCache* cache = static_cast<PoolCache*>(data);
+    for (unsigned int i = 0; i < POOL_CLASSES; i++)
+	poolPut(cache,i,cache->count[i]);
+    ::free(cache);
+}
+
+class InitPool
+{
+public:
+    InitPool()
+	{ s_poolKeyOk = (0 == ::pthread_key_create(&s_poolKey,pool_release)); }
+};
+
+static InitPool s_initPool;
+
+static inline PoolCache* poolCache()
+{
+    if (!s_poolKeyOk)
+	return 0;
+    PoolCache* cache = static_cast<PoolCache*>(::pthread_getspecific(s_poolKey));
+    if (!cache) {
+	cache = static_cast<PoolCache*>(::calloc(1,sizeof(PoolCache)));
+	if (cache && ::pthread_setspecific(s_poolKey,cache)) {
+	    ::free(cache);
+	    cache = 0;
+	}
+    }
+    return cache;
+}
+
+#endif // FRAME_POOL
+
+// Allocate memory for data, update allocated length if taken from a pooled buffer
+static void* blockAlloc(unsigned int& allocated, void*& buffer)
+{
+    buffer = 0;
+#ifdef FRAME_POOL
+    PoolCache* cache = poolCache();
+    if (cache) {
+	cache->allocs++;
+	if (s_poolEnabled && (allocated <= s_poolSize[POOL_CLASSES - 1])) {
+	    unsigned int cls = 0;
+	    while (allocated > s_poolSize[cls])
+		cls++;
+	    if (!cache->free[cls])
+		poolGet(cache,cls,POOL_CACHE_MAX / 2);
+	    PoolBuffer* b = cache->free[cls];
+	    if (b) {
+		cache->free[cls] = b->next;
+		cache->count[cls]--;
+	    }
+	    else {
+		char* data = static_cast<char*>(::malloc(s_poolSize[cls] + sizeof(PoolBuffer)));
+		if (!data)
+		    return 0;
+		b = reinterpret_cast<PoolBuffer*>(data + s_poolSize[cls]);
+		b->cls = cls;
+	    }
+	    b->next = 0;
+	    allocated = s_poolSize[cls];
+	    buffer = b;
+	    return poolData(b);
+	}
+    }
+#endif
+    return ::malloc(allocated);
+}
+
+// Release data memory, pooled buffers go back to the cache of the thread
+static void blockFree(void* data, void* buffer)
+{
+#ifdef FRAME_POOL
+    if (buffer) {
+	PoolBuffer* b = static_cast<PoolBuffer*>(buffer);
+	PoolCache* cache = poolCache();
+	if (!cache) {
+	    ::free(poolData(b));
+	    return;
+	}
+	unsigned int cls = b->cls;
+	b->next = cache->free[cls];
+	cache->free[cls] = b;
+	if (++cache->count[cls] > POOL_CACHE_MAX)
+	    poolPut(cache,cls,POOL_CACHE_MAX / 2);
+	return;
+    }
+#endif
+    ::free(data);
+}
+
 static const DataBlock s_empty;
 
 const DataBlock& DataBlock::empty()
@@ -83,26 +261,26 @@ const DataBlock& DataBlock::empty()
 }
 
 DataBlock::DataBlock(unsigned int overAlloc)
-    : m_data(0), m_length(0), m_allocated(0), m_overAlloc(overAlloc)
+    : m_data(0), m_length(0), m_allocated(0), m_overAlloc(overAlloc), m_buffer(0)
 {
 }
 
 DataBlock::DataBlock(const DataBlock& value)
     : GenObject(),
-      m_data(0), m_length(0), m_allocated(0), m_overAlloc(value.overAlloc())
+      m_data(0), m_length(0), m_allocated(0), m_overAlloc(value.overAlloc()), m_buffer(0)
 {
     assign(value.data(),value.length());
 }
 
 DataBlock::DataBlock(const DataBlock& value, unsigned int overAlloc)
     : GenObject(),
-      m_data(0), m_length(0), m_allocated(0), m_overAlloc(overAlloc)
+      m_data(0), m_length(0), m_allocated(0), m_overAlloc(overAlloc), m_buffer(0)
 {
     assign(value.data(),value.length());
 }
 
 DataBlock::DataBlock(void* value, unsigned int len, bool copyData, unsigned int overAlloc)
-    : m_data(0), m_length(0), m_allocated(0), m_overAlloc(overAlloc)
+    : m_data(0), m_length(0), m_allocated(0), m_overAlloc(overAlloc), m_buffer(0)
 {
     assign(value,len,copyData);
 }
@@ -124,9 +302,12 @@ void DataBlock::clear(bool deleteData)
     m_length = 0;
     if (m_data) {
 	void *data = m_data;
+	void* buffer = m_buffer;
 	m_data = 0;
+	m_buffer = 0;
+	// whoever took over the data releases it with free(), pooled or not
 	if (deleteData)
-	    ::free(data);
+	    blockFree(data,buffer);
     }
 }
 
@@ -134,19 +315,23 @@ DataBlock& DataBlock::assign(void* value, unsigned int len, bool copyData, unsig
 {
     if ((value != m_data) || (len != m_length)) {
 	void *odata = m_data;
+	void* obuffer = m_buffer;
 	m_length = 0;
 	m_allocated = 0;
 	m_data = 0;
+	m_buffer = 0;
 	if (len) {
 	    if (copyData) {
 		allocated = allocLen(len);
-		void *data = ::malloc(allocated);
+		void* buffer = 0;
+		void *data = blockAlloc(allocated,buffer);
 		if (data) {
 		    if (value)
 			::memcpy(data,value,len);
 		    else
 			::memset(data,0,len);
 		    m_data = data;
+		    m_buffer = buffer;
 		}
 		else
 		    Debug("DataBlock",DebugFail,"malloc(%d) returned NULL!",allocated);
@@ -155,6 +340,9 @@ DataBlock& DataBlock::assign(void* value, unsigned int len, bool copyData, unsig
 		if (allocated < len)
 		    allocated = len;
 		m_data = value;
+		// same data inserted back, keep its buffer
+		if (value == odata)
+		    m_buffer = obuffer;
 	    }
 	    if (m_data) {
 		m_length = len;
@@ -162,11 +350,22 @@ DataBlock& DataBlock::assign(void* value, unsigned int len, bool copyData, unsig
 	    }
 	}
 	if (odata && (odata != m_data))
-	    ::free(odata);
+	    blockFree(odata,obuffer);
     }
     return *this;
 }
 
+// Replace data with a newly allocated one
+void DataBlock::replace(void* data, unsigned int len, unsigned int allocated, void* buffer)
+{
+    if (m_data)
+	blockFree(m_data,m_buffer);
+    m_data = data;
+    m_length = len;
+    m_allocated = allocated;
+    m_buffer = buffer;
+}
+
 void DataBlock::truncate(unsigned int len)
 {
     if (!len)
@@ -209,11 +408,12 @@ void DataBlock::append(const DataBlock& value)
 		return;
 	    }
 	    unsigned int aLen = allocLen(len);
-	    void *data = ::malloc(aLen);
+	    void* buffer = 0;
+	    void *data = blockAlloc(aLen,buffer);
 	    if (data) {
 		::memcpy(data,m_data,m_length);
 		::memcpy(m_length+(char*)data,value.data(),value.length());
-		assign(data,len,false,aLen);
+		replace(data,len,aLen,buffer);
 	    }
 	    else
 		Debug("DataBlock",DebugFail,"malloc(%d) returned NULL!",aLen);
@@ -234,11 +434,12 @@ void DataBlock::append(const String& value)
 		return;
 	    }
 	    unsigned int aLen = allocLen(len);
-	    void *data = ::malloc(aLen);
+	    void* buffer = 0;
+	    void *data = blockAlloc(aLen,buffer);
 	    if (data) {
 		::memcpy(data,m_data,m_length);
 		::memcpy(m_length+(char*)data,value.safe(),value.length());
-		assign(data,len,false,aLen);
+		replace(data,len,aLen,buffer);
 	    }
 	    else
 		Debug("DataBlock",DebugFail,"malloc(%d) returned NULL!",aLen);
@@ -254,20 +455,42 @@ void DataBlock::insert(const DataBlock& value)
     if (m_length) {
 	if (vl) {
 	    unsigned int len = m_length+vl;
-	    void *data = ::malloc(len);
+	    unsigned int aLen = allocLen(len);
+	    void* buffer = 0;
+	    void *data = blockAlloc(aLen,buffer);
 	    if (data) {
 		::memcpy(data,value.data(),vl);
 		::memcpy(vl+(char*)data,m_data,m_length);
-		assign(data,len,false);
+		replace(data,len,aLen,buffer);
 	    }
 	    else
-		Debug("DataBlock",DebugFail,"malloc(%d) returned NULL!",len);
+		Debug("DataBlock",DebugFail,"malloc(%d) returned NULL!",aLen);
 	}
     }
     else
 	assign(value.data(),vl);
 }
 
+void DataBlock::setFramePool(bool enable)
+{
+#ifdef FRAME_POOL
+    s_poolEnabled = enable;
+#endif
+}
+
+unsigned int DataBlock::allocCounter(unsigned int value)
+{
+#ifdef FRAME_POOL
+    PoolCache* cache = poolCache();
+    if (cache) {
+	unsigned int old = cache->allocs;
+	cache->allocs = value;
+	return old;
+    }
+#endif
+    return 0;
+}
+
 unsigned int DataBlock::allocLen(unsigned int len) const
 {
     // allocate a multiple of 8 bytes
@@ -478,7 +478,15 @@ unsigned long DataConsumer::Consume(const DataBlock& data, unsigned long tStamp,
     else
 	tStamp += m_regularTsDelta;
     u_int64_t tsTime = Time::now();
-    unsigned long len = Consume(data,tStamp,flags);
+    unsigned long len = 0;
+    if (getTransSource()) {
+	// count only the allocations made by this translator
+	unsigned int outer = DataBlock::allocCounter(0);
+	len = Consume(data,tStamp,flags);
+	static_cast<DataTranslator*>(this)->m_allocs += DataBlock::allocCounter(outer);
+    }
+    else
+	len = Consume(data,tStamp,flags);
     m_timestamp = tStamp;
     m_lastTsTime = tsTime;
     return len;
@@ -1123,7 +1131,7 @@ bool ThreadedSource::looping(bool runConsumers) const
 
 
 DataTranslator::DataTranslator(const char* sFormat, const char* dFormat)
-    : DataConsumer(sFormat)
+    : DataConsumer(sFormat), m_allocs(0)
 {
     DDebug(DebugAll,"DataTranslator::DataTranslator('%s','%s') [%p]",sFormat,dFormat,this);
     m_tsource = new DataSource(dFormat);
@@ -1131,7 +1139,7 @@ DataTranslator::DataTranslator(const char* sFormat, const char* dFormat)
 }
 
 DataTranslator::DataTranslator(const char* sFormat, DataSource* source)
-    : DataConsumer(sFormat), m_tsource(source)
+    : DataConsumer(sFormat), m_tsource(source), m_allocs(0)
 {
     DDebug(DebugAll,"DataTranslator::DataTranslator('%s',%p) [%p]",sFormat,source,this);
     m_tsource->setTranslator(this);
@@ -1139,7 +1147,7 @@ DataTranslator::DataTranslator(const char* sFormat, DataSource* source)
 
 DataTranslator::~DataTranslator()
 {
-    DDebug(DebugAll,"DataTranslator::~DataTranslator() [%p]",this);
+    DDebug(DebugAll,"DataTranslator::~DataTranslator() allocations=%u [%p]",m_allocs,this);
     DataSource *temp = m_tsource;
     m_tsource = 0;
     if (temp) {
@@ -107,6 +107,19 @@ public:
     static void doCompletion(Message &msg, const String& partLine, const String& partWord);
 };
 
+// The global variables space is static, it drops its own reference only at exit
+class EngineSharedVars : public SharedVars
+{
+public:
+    inline EngineSharedVars()
+	{ }
+    virtual ~EngineSharedVars()
+	{ deref(); }
+protected:
+    virtual void zeroRefs()
+	{ }
+};
+
 };
 
 using namespace TelEngine;
@@ -232,6 +245,13 @@ static Engine::PluginMode s_loadMode = Engine::LoadFail;
 static int s_minworkers = 1;
 static int s_maxworkers = 10;
 static int s_exit = -1;
+static int s_initThreads = 0;
+static Mutex s_timesMutex(false,"StartupTimes");
+static NamedList s_loadTimes("");
+static NamedList s_initTimes("");
+static u_int64_t s_loadTotal = 0;
+static u_int64_t s_initTotal = 0;
+static unsigned int s_initUsed = 0;
 unsigned int Engine::s_congestion = 0;
 static Mutex s_congMutex(false,"Congestion");
 static bool s_debug = true;
@@ -240,7 +260,9 @@ static int s_maxevents = 25;
 static Mutex s_eventsMutex(false,"EventsList");
 static ObjList s_events;
 static String s_startMsg;
-static SharedVars s_vars;
+static EngineSharedVars s_vars;
+static Mutex s_varsMutex(false,"SharedVarsList");
+static ObjList s_varSpaces;
 static Mutex s_hooksMutex(true,"HooksList");
 static ObjList s_hooks;
 static NamedCounter* s_counter = 0;
@@ -298,6 +320,58 @@ private:
     unsigned int m_count;
 };
 
+// Plugin waiting to be initialized after the plugins it depends on
+class InitJob : public GenObject
+{
+public:
+    enum State {
+	Pending,
+	Running,
+	Done
+    };
+    inline InitJob(Plugin* plugin, const String& after)
+	: m_plugin(plugin), m_after(after.split(',',false)), m_state(Pending)
+	{ }
+    virtual ~InitJob()
+	{ TelEngine::destruct(m_after); }
+    virtual const String& toString() const
+	{ return m_plugin->toString(); }
+    Plugin* m_plugin;
+    ObjList* m_after;
+    State m_state;
+};
+
+// Initializes plugins from several threads, honoring their ordering constraints
+class PluginInitializer : public RefObject, public Mutex
+{
+public:
+    PluginInitializer(unsigned int threads);
+    void add(Plugin* plugin);
+    unsigned int run();
+    void work();
+private:
+    InitJob* next();
+    bool ready(const InitJob* job) const;
+    ObjList m_jobs;
+    Semaphore m_done;
+    unsigned int m_threads;
+    unsigned int m_running;
+};
+
+class InitWorker : public Thread
+{
+public:
+    inline InitWorker(PluginInitializer* init)
+	: Thread("Engine Init"),
+	  m_init(init)
+	{ m_init->ref(); }
+    virtual ~InitWorker()
+	{ TelEngine::destruct(m_init); }
+    virtual void run();
+private:
+    PluginInitializer* m_init;
+};
+
 class EngineSuperHandler : public MessageHandler
 {
 public:
@@ -319,6 +393,8 @@ public:
     virtual bool received(Message &msg);
     static void objects(String& retVal, bool details);
     static int objects(String& str);
+    static void sharedVars(String& retVal, const String& space, bool details);
+    static void startup(String& retVal, bool load, bool details);
 };
 
 class EngineHelp : public MessageHandler
@@ -451,6 +527,53 @@ void EngineStatusHandler::objects(String& retVal, bool details)
     retVal << "\r\n";
 }
 
+// Report how long loading and initializing plugins took
+void EngineStatusHandler::startup(String& retVal, bool load, bool details)
+{
+    Lock mylock(s_timesMutex);
+    const NamedList& times = load ? s_loadTimes : s_initTimes;
+    retVal << "name=startup,type=system";
+    retVal << ";load=" << s_loadTotal << ",libs=" << s_loadTimes.length();
+    retVal << ",init=" << s_initTotal << ",plugins=" << s_initTimes.length();
+    retVal << ",threads=" << s_initUsed;
+    if (details) {
+	String str;
+	for (const ObjList* l = times.paramList()->skipNull(); l; l = l->skipNext()) {
+	    const NamedString* ns = static_cast<const NamedString*>(l->get());
+	    str.append(ns->name(),",") << "=" << *ns;
+	}
+	retVal.append(str,";");
+    }
+    retVal << "\r\n";
+}
+
+// Report the global or a named variables space, list its variables if details are requested
+void EngineStatusHandler::sharedVars(String& retVal, const String& space, bool details)
+{
+    Lock mylock(s_varsMutex);
+    SharedVars* vars = space ? static_cast<SharedVars*>(s_varSpaces[space]) : &s_vars;
+    retVal << "name=sharedvars,type=system";
+    retVal << ";space=" << space;
+    retVal << ",spaces=" << s_varSpaces.count();
+    if (!vars) {
+	retVal << ",count=0\r\n";
+	return;
+    }
+    if (details) {
+	NamedList snap("");
+	String str;
+	retVal << ",count=" << vars->copy(snap);
+	for (const ObjList* l = snap.paramList()->skipNull(); l; l = l->skipNext()) {
+	    const NamedString* ns = static_cast<const NamedString*>(l->get());
+	    str.append(ns->name(),",") << "=" << String::uriEscape(*ns,',');
+	}
+	retVal.append(str,";");
+    }
+    else
+	retVal << ",count=" << vars->count();
+    retVal << "\r\n";
+}
+
 bool EngineStatusHandler::received(Message &msg)
 {
     bool details = msg.getBoolValue("details",true);
@@ -472,6 +595,14 @@ bool EngineStatusHandler::received(Message &msg)
 		objects(msg.retValue(),details);
 	    return true;
 	}
+	if (sel.startSkip("sharedvars")) {
+	    sharedVars(msg.retValue(),sel,details);
+	    return true;
+	}
+	if (sel.startSkip("startup")) {
+	    startup(msg.retValue(),(sel == YSTRING("load")),details);
+	    return true;
+	}
 	return false;
     }
     msg.retValue() << "name=engine,type=system";
@@ -483,6 +614,7 @@ bool EngineStatusHandler::received(Message &msg)
     msg.retValue() << ",handlers=" << Engine::self()->handlerCount();
     msg.retValue() << ",hooks=" << Engine::self()->postHookCount();
     msg.retValue() << ",messages=" << Engine::self()->messageCount();
+    msg.retValue() << ",suspended=" << Engine::self()->suspendedCount();
     msg.retValue() << ",supervised=" << (s_super_handle >= 0);
     msg.retValue() << ",runattempt=" << s_run_attempt;
 #ifndef _WINDOWS
@@ -675,7 +807,11 @@ void EngineCommand::doCompletion(Message &msg, const String& partLine, const Str
     else if (partLine == YSTRING("status")) {
 	completeOne(msg.retValue(),"engine",partWord);
 	completeOne(msg.retValue(),"objects",partWord);
+	completeOne(msg.retValue(),"sharedvars",partWord);
+	completeOne(msg.retValue(),"startup",partWord);
     }
+    else if (partLine == YSTRING("status startup"))
+	completeOne(msg.retValue(),"load",partWord);
     else if (partLine == YSTRING("status objects")) {
 	for (ObjList* l = getObjCounters().skipNull();l;l = l->skipNext())
 	    completeOne(msg.retValue(),l->get()->toString(),partWord);
@@ -1289,65 +1425,549 @@ bool SLib::unload(bool unloadNow)
 }
 
 
-void SharedVars::get(const String& name, String& rval)
+// Remember how long a library took to load or a plugin to initialize
+static void startupTime(NamedList& list, const String& name, u_int64_t usec)
+{
+    Lock mylock(s_timesMutex);
+    list.setParam(name,String(usec));
+}
+
+// Initialize one plugin and record the time spent
+static void initPlugin(Plugin* plugin)
+{
+    u_int64_t t = Time::now();
+    TempObjectCounter cnt(plugin->objectsCounter(),true);
+    plugin->initialize();
+    startupTime(s_initTimes,plugin->toString(),Time::now() - t);
+}
+
+PluginInitializer::PluginInitializer(unsigned int threads)
+    : Mutex(false,"PluginInitializer"),
+      m_done(threads,"PluginInitDone",0),
+      m_threads(threads), m_running(0)
+{
+}
+
+void PluginInitializer::add(Plugin* plugin)
+{
+    String after = plugin->initAfter();
+    after.append(Engine::config().getValue(YSTRING("initafter"),plugin->toString()),",");
+    m_jobs.append(new InitJob(plugin,after));
+}
+
+// Check if all the plugins a job depends on were initialized, unknown ones are ignored
+bool PluginInitializer::ready(const InitJob* job) const
+{
+    for (ObjList* l = job->m_after->skipNull(); l; l = l->skipNext()) {
+	String name = l->get()->toString();
+	const InitJob* dep = static_cast<const InitJob*>(m_jobs[name.trimBlanks()]);
+	if (dep && (dep != job) && (dep->m_state != InitJob::Done))
+	    return false;
+    }
+    return true;
+}
+
+// Pick the next job that can run, wait for running ones if none is ready
+InitJob* PluginInitializer::next()
+{
+    Lock mylock(this);
+    for (;;) {
+	if (Engine::exiting())
+	    return 0;
+	InitJob* first = 0;
+	for (ObjList* l = m_jobs.skipNull(); l; l = l->skipNext()) {
+	    InitJob* job = static_cast<InitJob*>(l->get());
+	    if (job->m_state != InitJob::Pending)
+		continue;
+	    if (ready(job)) {
+		job->m_state = InitJob::Running;
+		m_running++;
+		return job;
+	    }
+	    if (!first)
+		first = job;
+	}
+	if (!first)
+	    return 0;
+	if (!m_running) {
+	    // nothing running can ever satisfy the remaining dependencies
+	    Debug(DebugWarn,"Plugin '%s' has circular initialization dependencies",
+		first->toString().c_str());
+	    first->m_state = InitJob::Running;
+	    m_running++;
+	    return first;
+	}
+	mylock.drop();
+	m_done.lock(10000);
+	mylock.acquire(this);
+    }
+}
+
+void PluginInitializer::work()
 {
+    while (InitJob* job = next()) {
+	initPlugin(job->m_plugin);
+	lock();
+	job->m_state = InitJob::Done;
+	m_running--;
+	unlock();
+	m_done.unlock();
+    }
+}
+
+// Initialize all jobs, the calling thread works too, return number of threads used
+unsigned int PluginInitializer::run()
+{
+    unsigned int threads = m_jobs.count();
+    if (threads > m_threads)
+	threads = m_threads;
+    unsigned int used = 1;
+    for (unsigned int i = 1; i < threads; i++) {
+	InitWorker* w = new InitWorker(this);
+	if (w->startup())
+	    used++;
+	else
+	    delete w;
+    }
+    work();
+    // other threads may still be initializing their last plugins
     lock();
-    rval = m_vars.getValue(name,rval);
+    while (m_running) {
+	unlock();
+	m_done.lock(10000);
+	lock();
+    }
     unlock();
+    return used;
+}
+
+void InitWorker::run()
+{
+    m_init->work();
+    TelEngine::destruct(m_init);
+}
+
+
+// Variables are spread over independently locked shards, each holding hashed chains
+#define SHARED_SHARDS 16
+#define SHARED_BUCKETS 64
+
+#if defined(ATOMIC_OPS) && !defined(_WINDOWS)
+// Entries are only ever prepended to chains and cleared ones are freed only
+//  after all lock free readers left the shard so chains can be walked
+//  without holding the shard lock
+#define SHARED_ATOMIC
+#endif
+
+namespace TelEngine {
+
+class SharedVarsEntry
+{
+public:
+    enum State {
+	Unset = 0,
+	Text,
+	Number
+    };
+    inline SharedVarsEntry(const String& name, SharedVarsEntry* next)
+	: m_next(next), m_retired(0), m_name(name), m_state(Unset), m_num(0)
+	{ m_name.hash(); }
+    inline void value(String& rval) const
+	{
+	    if (m_state == Number)
+		rval = m_num;
+	    else if (m_state == Text)
+		rval = m_text;
+	}
+    unsigned int inc(unsigned int wrap);
+    unsigned int dec(unsigned int wrap);
+    SharedVarsEntry* m_next;
+    SharedVarsEntry* m_retired;
+    String m_name;
+    String m_text;
+    volatile int m_state;
+    volatile unsigned int m_num;
+};
+
+class SharedVarsShard : public Mutex
+{
+public:
+    SharedVarsShard();
+    ~SharedVarsShard();
+    SharedVarsEntry* find(const String& name) const;
+    SharedVarsEntry* make(const String& name);
+    SharedVarsEntry* number(const String& name);
+    void remove(const String& name);
+    void removeAll();
+    void reclaim();
+    inline SharedVarsEntry* first(unsigned int bucket) const
+	{ return m_buckets[bucket]; }
+    inline unsigned int entries() const
+	{ return m_entries; }
+    volatile int m_readers;
+private:
+    inline static unsigned int index(const String& name)
+	{ return (name.hash() / SHARED_SHARDS) % SHARED_BUCKETS; }
+    void retire(SharedVarsEntry* e);
+    SharedVarsEntry* volatile m_buckets[SHARED_BUCKETS];
+    SharedVarsEntry* m_retired;
+    unsigned int m_entries;
+};
+
+// Keeps unlinked entries of a shard from being freed while walking its chains unlocked
+class SharedVarsReader
+{
+public:
+#ifdef SHARED_ATOMIC
+    inline SharedVarsReader(SharedVarsShard* shard)
+	: m_shard(shard)
+	{ __sync_add_and_fetch(&m_shard->m_readers,1); }
+    inline ~SharedVarsReader()
+	{ __sync_sub_and_fetch(&m_shard->m_readers,1); }
+private:
+    SharedVarsShard* m_shard;
+#else
+    inline SharedVarsReader(SharedVarsShard* shard)
+	{ }
+#endif
+};
+
+};
+
+unsigned int SharedVarsEntry::inc(unsigned int wrap)
+{
+    for (;;) {
+	unsigned int old = m_num;
+	unsigned int val = old;
+	if (wrap)
+	    val = val % (wrap + 1);
+	unsigned int nval = val + 1;
+	if (wrap)
+	    nval = nval % (wrap + 1);
+#ifdef SHARED_ATOMIC
+	if (__sync_bool_compare_and_swap(&m_num,old,nval))
+	    return val;
+#else
+	m_num = nval;
+	return val;
+#endif
+    }
+}
+
+unsigned int SharedVarsEntry::dec(unsigned int wrap)
+{
+    for (;;) {
+	unsigned int old = m_num;
+	unsigned int val = old;
+	if (wrap)
+	    val = val ? ((val - 1) % (wrap + 1)) : wrap;
+	else
+	    val = val ? (val - 1) : 0;
+#ifdef SHARED_ATOMIC
+	if (__sync_bool_compare_and_swap(&m_num,old,val))
+	    return val;
+#else
+	m_num = val;
+	return val;
+#endif
+    }
+}
+
+SharedVarsShard::SharedVarsShard()
+    : Mutex(false,"SharedVarsShard"),
+      m_readers(0), m_retired(0), m_entries(0)
+{
+    for (unsigned int i = 0; i < SHARED_BUCKETS; i++)
+	m_buckets[i] = 0;
+}
+
+SharedVarsShard::~SharedVarsShard()
+{
+    for (unsigned int i = 0; i < SHARED_BUCKETS; i++) {
+	while (SharedVarsEntry* e = m_buckets[i]) {
+	    m_buckets[i] = e->m_next;
+	    delete e;
+	}
+    }
+    while (SharedVarsEntry* e = m_retired) {
+	m_retired = e->m_retired;
+	delete e;
+    }
+}
+
+// Find an entry by name, must be called with the shard locked if not atomic
+SharedVarsEntry* SharedVarsShard::find(const String& name) const
+{
+    for (SharedVarsEntry* e = m_buckets[index(name)]; e; e = e->m_next) {
+	if (e->m_name == name)
+	    return e;
+    }
+    return 0;
+}
+
+// Find or create an entry, must be called with the shard locked
+SharedVarsEntry* SharedVarsShard::make(const String& name)
+{
+    SharedVarsEntry* e = find(name);
+    if (e)
+	return e;
+    unsigned int idx = index(name);
+    e = new SharedVarsEntry(name,m_buckets[idx]);
+#ifdef SHARED_ATOMIC
+    // entry must be complete before lock free readers can reach it
+    __sync_synchronize();
+#endif
+    m_buckets[idx] = e;
+    m_entries++;
+    return e;
+}
+
+// Unlink an entry, must be called with the shard locked
+void SharedVarsShard::remove(const String& name)
+{
+    for (SharedVarsEntry* volatile* p = m_buckets + index(name); *p; p = &(*p)->m_next) {
+	SharedVarsEntry* e = *p;
+	if (e->m_name != name)
+	    continue;
+	// readers still holding the entry must see it cleared
+	e->m_state = SharedVarsEntry::Unset;
+	*p = e->m_next;
+	m_entries--;
+	retire(e);
+	reclaim();
+	return;
+    }
+}
+
+// Unlink all entries, must be called with the shard locked
+void SharedVarsShard::removeAll()
+{
+    for (unsigned int i = 0; i < SHARED_BUCKETS; i++) {
+	SharedVarsEntry* e = m_buckets[i];
+	m_buckets[i] = 0;
+	while (e) {
+	    SharedVarsEntry* next = e->m_next;
+	    e->m_state = SharedVarsEntry::Unset;
+	    retire(e);
+	    e = next;
+	}
+    }
+    m_entries = 0;
+    reclaim();
+}
+
+// Queue an unlinked entry for freeing, keep its chain link for current readers
+void SharedVarsShard::retire(SharedVarsEntry* e)
+{
+#ifdef SHARED_ATOMIC
+    e->m_retired = m_retired;
+    m_retired = e;
+#else
+    delete e;
+#endif
+}
+
+// Free unlinked entries if no lock free reader is walking the chains
+// Readers arriving later can't reach them anymore, must be called with the shard locked
+void SharedVarsShard::reclaim()
+{
+    if (!m_retired)
+	return;
+#ifdef SHARED_ATOMIC
+    __sync_synchronize();
+    if (m_readers)
+	return;
+#endif
+    while (SharedVarsEntry* e = m_retired) {
+	m_retired = e->m_retired;
+	delete e;
+    }
+}
+
+// Find or create an entry holding a number, must be called with the shard locked
+SharedVarsEntry* SharedVarsShard::number(const String& name)
+{
+    SharedVarsEntry* e = make(name);
+    if (e->m_state != SharedVarsEntry::Number) {
+	e->m_num = (e->m_state == SharedVarsEntry::Text) ? e->m_text.toInteger() : 0;
+	e->m_text.clear();
+#ifdef SHARED_ATOMIC
+	__sync_synchronize();
+#endif
+	e->m_state = SharedVarsEntry::Number;
+    }
+    return e;
+}
+
+
+SharedVars::SharedVars(const char* name)
+    : Mutex(false,"SharedVars"),
+      m_shards(new SharedVarsShard[SHARED_SHARDS]), m_name(name)
+{
+}
+
+SharedVars::~SharedVars()
+{
+    delete[] m_shards;
+}
+
+const String& SharedVars::toString() const
+{
+    return m_name;
+}
+
+SharedVarsShard* SharedVars::shard(const String& name) const
+{
+    return m_shards + (name.hash() % SHARED_SHARDS);
+}
+
+void SharedVars::get(const String& name, String& rval)
+{
+    SharedVarsShard* s = shard(name);
+#ifdef SHARED_ATOMIC
+    // counters are read directly, text values need the lock to be copied
+    SharedVarsReader reader(s);
+    const SharedVarsEntry* e = s->find(name);
+    if (!e || (e->m_state == SharedVarsEntry::Unset))
+	return;
+    if (e->m_state == SharedVarsEntry::Number) {
+	rval = e->m_num;
+	return;
+    }
+    Lock mylock(s);
+#else
+    Lock mylock(s);
+    const SharedVarsEntry* e = s->find(name);
+    if (!e)
+	return;
+#endif
+    e->value(rval);
 }
 
 void SharedVars::set(const String& name, const char* val)
 {
-    lock();
-    m_vars.setParam(name,val);
-    unlock();
+    SharedVarsShard* s = shard(name);
+    Lock mylock(s);
+    SharedVarsEntry* e = s->make(name);
+    e->m_text = val;
+    e->m_state = SharedVarsEntry::Text;
+    s->reclaim();
 }
 
 bool SharedVars::create(const String& name, const char* val)
 {
-    Lock mylock(this);
-    if (m_vars.getParam(name))
+    SharedVarsShard* s = shard(name);
+    Lock mylock(s);
+    SharedVarsEntry* e = s->make(name);
+    if (e->m_state != SharedVarsEntry::Unset)
 	return false;
-    m_vars.addParam(name,val);
+    e->m_text = val;
+    e->m_state = SharedVarsEntry::Text;
     return true;
 }
 
 void SharedVars::clear(const String& name)
 {
-    lock();
-    m_vars.clearParam(name);
-    unlock();
+    SharedVarsShard* s = shard(name);
+    Lock mylock(s);
+    s->remove(name);
+}
+
+void SharedVars::clearAll()
+{
+    for (unsigned int i = 0; i < SHARED_SHARDS; i++) {
+	Lock mylock(m_shards[i]);
+	m_shards[i].removeAll();
+    }
 }
 
 bool SharedVars::exists(const String& name)
 {
-    Lock mylock(this);
-    return m_vars.getParam(name) != 0;
+    SharedVarsShard* s = shard(name);
+#ifdef SHARED_ATOMIC
+    SharedVarsReader reader(s);
+#else
+    Lock mylock(s);
+#endif
+    SharedVarsEntry* e = s->find(name);
+    return e && (e->m_state != SharedVarsEntry::Unset);
 }
 
 unsigned int SharedVars::inc(const String& name, unsigned int wrap)
 {
-    Lock mylock(this);
-    unsigned int val = m_vars.getIntValue(name);
-    if (wrap)
-	val = val % (wrap + 1);
-    unsigned int nval = val + 1;
-    if (wrap)
-	nval = nval % (wrap + 1);
-    m_vars.setParam(name,String(nval));
-    return val;
+    SharedVarsShard* s = shard(name);
+#ifdef SHARED_ATOMIC
+    {
+	SharedVarsReader reader(s);
+	SharedVarsEntry* e = s->find(name);
+	if (e && (e->m_state == SharedVarsEntry::Number))
+	    return e->inc(wrap);
+    }
+#endif
+    Lock mylock(s);
+    return s->number(name)->inc(wrap);
 }
 
 unsigned int SharedVars::dec(const String& name, unsigned int wrap)
 {
-    Lock mylock(this);
-    unsigned int val = m_vars.getIntValue(name);
-    if (wrap)
-	val = val ? ((val - 1) % (wrap + 1)) : wrap;
-    else
-	val = val ? (val - 1) : 0;
-    m_vars.setParam(name,String(val));
-    return val;
+    SharedVarsShard* s = shard(name);
+#ifdef SHARED_ATOMIC
+    {
+	SharedVarsReader reader(s);
+	SharedVarsEntry* e = s->find(name);
+	if (e && (e->m_state == SharedVarsEntry::Number))
+	    return e->dec(wrap);
+    }
+#endif
+    Lock mylock(s);
+    return s->number(name)->dec(wrap);
+}
+
+unsigned int SharedVars::count()
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < SHARED_SHARDS; i++) {
+	Lock mylock(m_shards[i]);
+	m_shards[i].reclaim();
+	n += m_shards[i].entries();
+    }
+    return n;
+}
+
+unsigned int SharedVars::copy(NamedList& dest, const String& prefix, bool skipPrefix)
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < SHARED_SHARDS; i++) {
+	Lock mylock(m_shards[i]);
+	for (unsigned int b = 0; b < SHARED_BUCKETS; b++) {
+	    for (SharedVarsEntry* e = m_shards[i].first(b); e; e = e->m_next) {
+		if ((e->m_state == SharedVarsEntry::Unset) || (prefix && !e->m_name.startsWith(prefix)))
+		    continue;
+		NamedString* ns = new NamedString(skipPrefix ? e->m_name.substr(prefix.length()) : e->m_name);
+		e->value(*ns);
+		dest.addParam(ns);
+		n++;
+	    }
+	}
+    }
+    return n;
+}
+
+// Free cleared variables and release named spaces that are empty and unused
+static void sweepSharedVars()
+{
+    s_vars.count();
+    Lock mylock(s_varsMutex);
+    for (ObjList* l = s_varSpaces.skipNull(); l; ) {
+	SharedVars* vars = static_cast<SharedVars*>(l->get());
+	// with the list holding the only reference nobody can set variables
+	if ((vars->refcount() == 1) && !vars->count()) {
+	    l->remove();
+	    l = l->skipNull();
+	}
+	else
+	    l = l->skipNext();
+    }
 }
 
 
@@ -1439,7 +2059,13 @@ int Engine::engineInit()
 	s_modpath = modPath;
     s_minworkers = s_cfg.getIntValue("general","minworkers",s_minworkers,1,25);
     s_maxworkers = s_cfg.getIntValue("general","maxworkers",s_maxworkers,s_minworkers);
+    s_initThreads = s_cfg.getIntValue("general","initthreads",s_initThreads,0,32);
     s_maxevents = s_cfg.getIntValue("general","maxevents",s_maxevents);
+    NamedList::indexThreshold(s_cfg.getIntValue("general","paramindex",
+	NamedList::indexThreshold(),0));
+    Debugger::setAsyncOutput(s_cfg.getIntValue("general","asynclog",0,0));
+    DataBlock::setFramePool(s_cfg.getBoolValue("general","framepool",true));
+    Hasher::setAccelerated(s_cfg.getBoolValue("general","hashaccel",true));
     s_restarts = s_cfg.getIntValue("general","restarts");
     m_dispatcher.warnTime(1000*(u_int64_t)s_cfg.getIntValue("general","warntime"));
     extraPath(clientMode() ? "client" : "server");
@@ -1624,6 +2250,7 @@ int Engine::run()
 	    t += 1000000;
 	XDebug(DebugAll,"Sleeping for %ld",t);
 	Thread::usleep(t);
+	sweepSharedVars();
 	Message* m = new Message("engine.timer",0,true);
 	m->addParam("time",String(m->msgTime().sec()));
 	if (nodeName())
@@ -1663,6 +2290,7 @@ int Engine::engineCleanup()
     checkPoint();
     // We are occasionally doing things that can cause crashes so don't abort
     abortOnBug(s_sigabrt && s_lateabrt);
+    Debugger::setAsyncOutput(0);
     Thread::killall();
     checkPoint();
     m_dispatcher.dequeue();
@@ -1781,9 +2409,13 @@ bool Engine::loadPlugin(const char* file, bool local, bool nounload)
 {
     s_dynplugin = false;
     s_loadMode = Engine::LoadLate;
+    u_int64_t t = Time::now();
     SLib *lib = SLib::load(file,local,nounload);
+    t = Time::now() - t;
     s_dynplugin = true;
     if (lib) {
+	int sep = lib->rfind(PATH_SEP[0]);
+	startupTime(s_loadTimes,lib->substr(sep + 1),t);
 	switch (s_loadMode) {
 	    case LoadFail:
 		delete lib;
@@ -1879,6 +2511,7 @@ bool Engine::loadPluginDir(const String& relPath)
 
 void Engine::loadPlugins()
 {
+    u_int64_t start = Time::now();
     NamedList *l = s_cfg.getSection("preload");
     if (l) {
         unsigned int len = l->length();
@@ -1912,6 +2545,8 @@ void Engine::loadPlugins()
 	    }
 	}
     }
+    Lock mylock(s_timesMutex);
+    s_loadTotal = Time::now() - start;
 }
 
 void Engine::initPlugins()
@@ -1920,16 +2555,38 @@ void Engine::initPlugins()
 	return;
     Output("Initializing plugins");
     dispatch("engine.init",true);
+    u_int64_t start = Time::now();
+    unsigned int threads = 1;
+    PluginInitializer* init = 0;
     ObjList *l = plugins.skipNull();
     for (; l; l = l->skipNext()) {
 	Plugin *p = static_cast<Plugin *>(l->get());
-	TempObjectCounter cnt(p->objectsCounter(),true);
-	p->initialize();
-	if (exiting()) {
-	    Output("Initialization aborted, exiting...");
-	    return;
+	// early plugins go first, the rest may run in parallel at startup
+	if (!(s_started || p->earlyInit()) && (s_initThreads > 1)) {
+	    if (!init)
+		init = new PluginInitializer(s_initThreads);
+	    init->add(p);
+	    continue;
 	}
+	initPlugin(p);
+	if (exiting())
+	    break;
     }
+    if (init) {
+	if (!exiting())
+	    threads = init->run();
+	TelEngine::destruct(init);
+    }
+    if (exiting()) {
+	Output("Initialization aborted, exiting...");
+	return;
+    }
+    s_timesMutex.lock();
+    s_initTotal = Time::now() - start;
+    s_initUsed = threads;
+    s_timesMutex.unlock();
+    Debug(DebugInfo,"Initialized %u plugins in " FMT64U " usec using %u threads",
+	plugins.count(),s_initTotal,threads);
     Output("Initialization complete");
 }
 
@@ -2102,6 +2759,22 @@ SharedVars& Engine::sharedVars()
     return s_vars;
 }
 
+bool Engine::sharedVars(RefPointer<SharedVars>& vars, const String& name)
+{
+    if (name.null()) {
+	vars = &s_vars;
+	return true;
+    }
+    Lock mylock(s_varsMutex);
+    SharedVars* v = static_cast<SharedVars*>(s_varSpaces[name]);
+    if (!v) {
+	v = new SharedVars(name);
+	s_varSpaces.append(v);
+    }
+    vars = v;
+    return vars != 0;
+}
+
 // Append command line arguments form current config.
 void Engine::buildCmdLine(String& line)
 {
@@ -22,8 +22,44 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define HASH_CPUID
+#endif
+
 using namespace TelEngine;
 
+// Find out which of the accelerations known to the hashers this CPU has
+static unsigned int detectAccel()
+{
+    unsigned int accel = 0;
+#ifdef HASH_CPUID
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1,&eax,&ebx,&ecx,&edx))
+	return 0;
+    // SHA extensions need SSE4.1 (ECX bit 19) for the state shuffles
+    bool sse41 = (ecx & (1 << 19)) != 0;
+    // AVX2 also requires the OS to save the YMM registers (OSXSAVE + XCR0)
+    bool ymm = false;
+    if (ecx & (1 << 27)) {
+	unsigned int xlo = 0, xhi = 0;
+	__asm__ __volatile__ ("xgetbv" : "=a" (xlo), "=d" (xhi) : "c" (0));
+	ymm = (xlo & 0x06) == 0x06;
+    }
+    if (__get_cpuid_max(0,0) < 7)
+	return 0;
+    __cpuid_count(7,0,eax,ebx,ecx,edx);
+    if (sse41 && (ebx & (1 << 29)))
+	accel |= Hasher::AccelShaExt;
+    if (ymm && (ebx & (1 << 5)))
+	accel |= Hasher::AccelAvx2;
+#endif
+    return accel;
+}
+
+static unsigned int s_cpuAccel = detectAccel();
+static unsigned int s_accel = s_cpuAccel;
+
 Hasher::~Hasher()
 {
 }
@@ -35,6 +71,16 @@ Hasher& Hasher::operator<<(const char* value)
     return *this;
 }
 
+unsigned int Hasher::accelerated()
+{
+    return s_accel;
+}
+
+void Hasher::setAccelerated(bool enable)
+{
+    s_accel = enable ? s_cpuAccel : 0;
+}
+
 // For details see RFC 2104: HMAC: Keyed-Hashing for Message Authentication
 
 unsigned int Hasher::hmacBlockSize() const
@@ -37,7 +37,8 @@ private:
 
 Message::Message(const char* name, const char* retval, bool broadcast)
     : NamedList(name),
-      m_return(retval), m_data(0), m_notify(false), m_broadcast(broadcast)
+      m_return(retval), m_data(0), m_dispatcher(0), m_suspender(0), m_priority(0),
+      m_state(Sync), m_handled(false), m_notify(false), m_broadcast(broadcast)
 {
     XDebug(DebugAll,"Message::Message(\"%s\",\"%s\",%s) [%p]",
 	name,retval,String::boolText(broadcast),this);
@@ -46,7 +47,8 @@ Message::Message(const char* name, const char* retval, bool broadcast)
 Message::Message(const Message& original)
     : NamedList(original),
       m_return(original.retValue()), m_time(original.msgTime()),
-      m_data(0), m_notify(false), m_broadcast(original.broadcast())
+      m_data(0), m_dispatcher(0), m_suspender(0), m_priority(0),
+      m_state(Sync), m_handled(false), m_notify(false), m_broadcast(original.broadcast())
 {
     XDebug(DebugAll,"Message::Message(&%p) [%p]",&original,this);
 }
@@ -54,7 +56,8 @@ Message::Message(const Message& original)
 Message::Message(const Message& original, bool broadcast)
     : NamedList(original),
       m_return(original.retValue()), m_time(original.msgTime()),
-      m_data(0), m_notify(false), m_broadcast(broadcast)
+      m_data(0), m_dispatcher(0), m_suspender(0), m_priority(0),
+      m_state(Sync), m_handled(false), m_notify(false), m_broadcast(broadcast)
 {
     XDebug(DebugAll,"Message::Message(&%p,%s) [%p]",
 	&original,String::boolText(broadcast),this);
@@ -95,6 +98,41 @@ void Message::dispatched(bool accepted)
 	hook->dispatched(*this,accepted);
 }
 
+bool Message::suspend()
+{
+    if (!m_dispatcher)
+	return false;
+    Lock lck(m_dispatcher);
+    if (m_state != Async)
+	return false;
+    m_state = Suspending;
+    return true;
+}
+
+bool Message::resume(bool handled)
+{
+    MessageDispatcher* disp = m_dispatcher;
+    if (!disp)
+	return false;
+    Lock lck(disp);
+    switch (m_state) {
+	case Suspending:
+	    // handler did not return yet, dispatcher will just continue
+	    m_handled = handled;
+	    m_state = Resumed;
+	    return true;
+	case Suspended:
+	    m_handled = m_handled || handled;
+	    m_state = Resuming;
+	    disp->m_suspended--;
+	    break;
+	default:
+	    return false;
+    }
+    lck.drop();
+    return disp->enqueue(this);
+}
+
 String Message::encode(const char* id) const
 {
     String s("%%>message:");
@@ -300,7 +338,7 @@ MessageDispatcher::MessageDispatcher(const char* trackParam)
       m_hookMutex(false,"PostHooks"),
       m_msgAppend(&m_messages), m_hookAppend(&m_hooks),
       m_trackParam(trackParam), m_changes(0), m_warnTime(0),
-      m_hookCount(0), m_hookHole(false)
+      m_hookCount(0), m_suspended(0), m_hookHole(false)
 {
     XDebug(DebugInfo,"MessageDispatcher::MessageDispatcher('%s') [%p]",trackParam,this);
 }
@@ -377,6 +415,28 @@ bool MessageDispatcher::uninstall(MessageHandler* handler)
 }
 
 bool MessageDispatcher::dispatch(Message& msg)
+{
+    bool suspended = false;
+    return dispatchInternal(msg,suspended);
+}
+
+// Find where to continue with the handlers after the one that suspended a message
+ObjList* MessageDispatcher::resumePoint(const MessageHandler* handler, unsigned int priority)
+{
+    for (ObjList* l = &m_handlers; l; l = l->next()) {
+	MessageHandler* mh = static_cast<MessageHandler*>(l->get());
+	if (!mh)
+	    continue;
+	if (mh == handler)
+	    return l->next();
+	// handler was removed meanwhile, continue with the ones that followed it
+	if ((mh->priority() > priority) || ((mh->priority() == priority) && (mh > handler)))
+	    return l;
+    }
+    return 0;
+}
+
+bool MessageDispatcher::dispatchInternal(Message& msg, bool& suspended)
 {
 #ifdef XDEBUG
     Debugger debug("MessageDispatcher::dispatch","(%p) (\"%s\")",&msg,msg.c_str());
@@ -389,6 +449,11 @@ bool MessageDispatcher::dispatch(Message& msg)
     NamedCounter* saved = Thread::getCurrentObjCounter(counting);
     ObjList *l = &m_handlers;
     Lock mylock(this);
+    if (msg.m_state == Message::Resuming) {
+	msg.m_state = Message::Async;
+	retv = msg.m_handled;
+	l = (retv && !msg.broadcast()) ? 0 : resumePoint(msg.m_suspender,msg.m_priority);
+    }
     for (; l; l=l->next()) {
 	MessageHandler *h = static_cast<MessageHandler*>(l->get());
 	if (h && (h->null() || *h == msg)) {
@@ -425,6 +490,23 @@ bool MessageDispatcher::dispatch(Message& msg)
 		}
 	    }
 
+	    if ((msg.m_state != Message::Sync) && (msg.m_state != Message::Async)) {
+		mylock.acquire(this);
+		if (msg.m_state == Message::Suspending) {
+		    // handler took over the message, it will be resumed later
+		    msg.m_state = Message::Suspended;
+		    msg.m_suspender = h;
+		    msg.m_priority = p;
+		    msg.m_handled = retv;
+		    m_suspended++;
+		    suspended = true;
+		    break;
+		}
+		// resumed before the handler even returned
+		msg.m_state = Message::Async;
+		retv = msg.m_handled || retv;
+	    }
+
 	    if (retv && !msg.broadcast())
 		break;
 	    mylock.acquire(this);
@@ -456,6 +538,12 @@ bool MessageDispatcher::dispatch(Message& msg)
 		break;
 	}
     }
+    if (suspended) {
+	// another thread may resume and destroy the message once we unlock
+	if (counting)
+	    Thread::setCurrentObjCounter(saved);
+	return false;
+    }
     mylock.drop();
     if (counting)
 	Thread::setCurrentObjCounter(msg.getObjCounter());
@@ -528,11 +616,19 @@ bool MessageDispatcher::dequeueOne()
     if (m_messages.next() == m_msgAppend)
 	m_msgAppend = &m_messages;
     Message* msg = static_cast<Message *>(m_messages.remove(false));
+    if (msg && (msg->m_state != Message::Resuming)) {
+	// messages dispatched from the queue may be suspended by handlers
+	msg->m_dispatcher = this;
+	msg->m_state = Message::Async;
+	msg->m_handled = false;
+    }
     unlock();
     if (!msg)
 	return false;
-    dispatch(*msg);
-    msg->destruct();
+    bool suspended = false;
+    dispatchInternal(*msg,suspended);
+    if (!suspended)
+	msg->destruct();
     return true;
 }
 
@@ -19,6 +19,9 @@
 
 #include "yateclass.h"
 
+#include <string.h>
+#include <stdio.h>
+
 #ifdef _WINDOWS
 
 typedef HANDLE HMUTEX;
@@ -53,8 +56,24 @@ typedef sem_t HSEMAPHORE;
 #define MUTEX_STATIC_UNSAFE false
 #endif
 
+#if defined(ATOMIC_OPS) && !defined(_WINDOWS)
+#define MUTEX_PROFILE
+#endif
+
+// Size of the mutex profiling table, must be a power of 2
+#ifndef MUTEX_PROFILE_SIZE
+#define MUTEX_PROFILE_SIZE 1024
+#endif
+
+// Maximum number of table slots probed for a name before using the overflow entry
+#ifndef MUTEX_PROFILE_PROBE
+#define MUTEX_PROFILE_PROBE 16
+#endif
+
 namespace TelEngine {
 
+class MutexProfile;
+
 class MutexPrivate {
 public:
     MutexPrivate(bool recursive, const char* name);
@@ -76,13 +95,16 @@ public:
     static volatile int s_count;
     static volatile int s_locks;
 private:
+    MutexProfile* profile();
     HMUTEX m_mutex;
     int m_refcount;
     volatile unsigned int m_locked;
-    volatile unsigned int m_waiting;
+    volatile int m_waiting;
     bool m_recursive;
     const char* m_name;
     const char* m_owner;
+    MutexProfile* m_profile;
+    u_int64_t m_holdStart;
 };
 
 class SemaphorePrivate {
@@ -120,6 +142,32 @@ private:
     static HMUTEX s_mutex;
 };
 
+#ifdef MUTEX_PROFILE
+// Lock statistics of all mutexes sharing a name
+class MutexProfile {
+public:
+    void waited(u_int64_t usec);
+    void held(u_int64_t usec);
+    void reset();
+    volatile int m_state;
+    unsigned int m_hash;
+    char m_name[48];
+    volatile u_int64_t m_locks;
+    volatile u_int64_t m_waitTotal;
+    volatile u_int64_t m_waitMax;
+    volatile u_int64_t m_holdTotal;
+    volatile u_int64_t m_holdMax;
+};
+#else
+class MutexProfile {
+public:
+    inline void waited(u_int64_t usec)
+	{ }
+    inline void held(u_int64_t usec)
+	{ }
+};
+#endif
+
 };
 
 using namespace TelEngine;
@@ -129,6 +177,11 @@ static GlobalMutex s_global;
 static unsigned long s_maxwait = 0;
 static bool s_unsafe = MUTEX_STATIC_UNSAFE;
 static bool s_safety = false;
+static volatile bool s_profiling = false;
+#ifdef MUTEX_PROFILE
+// The last entry collects the mutexes whose names did not fit in the table
+static MutexProfile s_profiles[MUTEX_PROFILE_SIZE + 1];
+#endif
 
 volatile int MutexPrivate::s_count = 0;
 volatile int MutexPrivate::s_locks = 0;
@@ -185,12 +238,120 @@ void GlobalMutex::unlock()
 }
 
 
+// Adjust shared counters without taking the global mutex if possible
+static inline int counterInc(volatile int& counter)
+{
+#ifdef ATOMIC_OPS
+#ifdef _WINDOWS
+    return InterlockedIncrement((LONG*)&counter);
+#else
+    return __sync_add_and_fetch(&counter,1);
+#endif
+#else
+    GlobalMutex::lock();
+    int val = ++counter;
+    GlobalMutex::unlock();
+    return val;
+#endif
+}
+
+static inline int counterDec(volatile int& counter)
+{
+#ifdef ATOMIC_OPS
+#ifdef _WINDOWS
+    return InterlockedDecrement((LONG*)&counter);
+#else
+    return __sync_sub_and_fetch(&counter,1);
+#endif
+#else
+    GlobalMutex::lock();
+    int val = --counter;
+    GlobalMutex::unlock();
+    return val;
+#endif
+}
+
+
+#ifdef MUTEX_PROFILE
+static inline void profileMax(volatile u_int64_t& max, u_int64_t val)
+{
+    u_int64_t old = max;
+    while ((val > old) && !__sync_bool_compare_and_swap(&max,old,val))
+	old = max;
+}
+
+void MutexProfile::waited(u_int64_t usec)
+{
+    __sync_add_and_fetch(&m_locks,1);
+    if (!usec)
+	return;
+    __sync_add_and_fetch(&m_waitTotal,usec);
+    profileMax(m_waitMax,usec);
+}
+
+void MutexProfile::held(u_int64_t usec)
+{
+    if (!usec)
+	return;
+    __sync_add_and_fetch(&m_holdTotal,usec);
+    profileMax(m_holdMax,usec);
+}
+
+void MutexProfile::reset()
+{
+    m_locks = 0;
+    m_waitTotal = 0;
+    m_waitMax = 0;
+    m_holdTotal = 0;
+    m_holdMax = 0;
+}
+
+// Claim an unused entry for a name, return false if it is already used
+static bool claimProfile(MutexProfile* p, const char* name, unsigned int len, unsigned int hash)
+{
+    if (p->m_state || !__sync_bool_compare_and_swap(&p->m_state,0,1))
+	return false;
+    p->m_hash = hash;
+    ::memcpy(p->m_name,name,len);
+    p->m_name[len] = '\0';
+    __sync_synchronize();
+    p->m_state = 2;
+    return true;
+}
+
+// Find or create the statistics entry of a mutex name, entries are never removed
+// Only a few slots are probed, names that don't fit share the overflow entry
+static MutexProfile* findProfile(const char* name)
+{
+    unsigned int hash = String::hash(name);
+    unsigned int len = ::strlen(name);
+    if (len >= sizeof(s_profiles[0].m_name))
+	len = sizeof(s_profiles[0].m_name) - 1;
+    for (unsigned int i = 0; i < MUTEX_PROFILE_PROBE; i++) {
+	MutexProfile* p = s_profiles + ((hash + i) & (MUTEX_PROFILE_SIZE - 1));
+	if (claimProfile(p,name,len,hash))
+	    return p;
+	// another thread is just filling in this entry
+	while (p->m_state == 1)
+	    Thread::yield();
+	if ((p->m_hash == hash) && !::strncmp(p->m_name,name,len) && !p->m_name[len])
+	    return p;
+    }
+    MutexProfile* p = s_profiles + MUTEX_PROFILE_SIZE;
+    if (!claimProfile(p,"(overflow)",10,0)) {
+	while (p->m_state == 1)
+	    Thread::yield();
+    }
+    return p;
+}
+#endif
+
+
 MutexPrivate::MutexPrivate(bool recursive, const char* name)
     : m_refcount(1), m_locked(0), m_waiting(0), m_recursive(recursive),
-      m_name(name), m_owner(0)
+      m_name(name), m_owner(0), m_profile(0), m_holdStart(0)
 {
-    GlobalMutex::lock();
-    s_count++;
+    counterInc(s_count);
 #ifdef _WINDOWS
     // All mutexes are recursive in Windows
     m_mutex = ::CreateMutex(NULL,FALSE,NULL);
@@ -205,40 +366,46 @@ MutexPrivate::MutexPrivate(bool recursive, const char* name)
     else
 	::pthread_mutex_init(&m_mutex,0);
 #endif
-    GlobalMutex::unlock();
 }
 
 MutexPrivate::~MutexPrivate()
 {
     bool warn = false;
-    GlobalMutex::lock();
     if (m_locked) {
 	warn = true;
 	m_locked--;
 	if (s_safety)
-	    s_locks--;
+	    counterDec(s_locks);
 #ifdef _WINDOWS
 	::ReleaseMutex(m_mutex);
 #else
 	::pthread_mutex_unlock(&m_mutex);
 #endif
     }
-    s_count--;
+    counterDec(s_count);
 #ifdef _WINDOWS
     ::CloseHandle(m_mutex);
     m_mutex = 0;
 #else
     ::pthread_mutex_destroy(&m_mutex);
 #endif
-    GlobalMutex::unlock();
     if (m_locked || m_waiting)
-	Debug(DebugFail,"MutexPrivate '%s' owned by '%s' destroyed with %u locks, %u waiting [%p]",
+	Debug(DebugFail,"MutexPrivate '%s' owned by '%s' destroyed with %u locks, %d waiting [%p]",
 	    m_name,m_owner,m_locked,m_waiting,this);
     else if (warn)
 	Debug(DebugGoOn,"MutexPrivate '%s' owned by '%s' unlocked in destructor [%p]",
 	    m_name,m_owner,this);
 }
 
+MutexProfile* MutexPrivate::profile()
+{
+#ifdef MUTEX_PROFILE
+    if (!m_profile)
+	m_profile = findProfile(m_name);
+#endif
+    return m_profile;
+}
+
 bool MutexPrivate::lock(long maxwait)
 {
     bool rval = false;
@@ -247,16 +414,14 @@ bool MutexPrivate::lock(long maxwait)
 	maxwait = (long)s_maxwait;
 	warn = true;
     }
+    MutexProfile* prof = s_profiling ? profile() : 0;
+    u_int64_t start = prof ? Time::now() : 0;
     bool safety = s_safety;
-    if (safety)
-	GlobalMutex::lock();
     Thread* thr = Thread::current();
     if (thr)
 	thr->m_locking = true;
-    if (safety) {
-	m_waiting++;
-	GlobalMutex::unlock();
-    }
+    if (safety)
+	counterInc(m_waiting);
 #ifdef _WINDOWS
     DWORD ms = 0;
     if (maxwait < 0)
@@ -297,15 +462,13 @@ bool MutexPrivate::lock(long maxwait)
 #endif // HAVE_TIMEDLOCK
     }
 #endif // _WINDOWS
-    if (safety) {
-	GlobalMutex::lock();
-	m_waiting--;
-    }
+    if (safety)
+	counterDec(m_waiting);
     if (thr)
 	thr->m_locking = false;
     if (rval) {
 	if (safety)
-	    s_locks++;
+	    counterInc(s_locks);
 	m_locked++;
 	if (thr) {
 	    thr->m_locks++;
@@ -313,11 +476,15 @@ bool MutexPrivate::lock(long maxwait)
 	}
 	else
 	    m_owner = 0;
+	if (prof) {
+	    u_int64_t now = Time::now();
+	    prof->waited(now - start);
+	    if (m_locked == 1)
+		m_holdStart = now;
+	}
     }
-    if (safety)
-	GlobalMutex::unlock();
     if (warn && !rval)
-	Debug(DebugFail,"Thread '%s' could not lock mutex '%s' owned by '%s' waited by %u others for %lu usec!",
+	Debug(DebugFail,"Thread '%s' could not lock mutex '%s' owned by '%s' waited by %d others for %lu usec!",
 	    Thread::currentName(),m_name,m_owner,m_waiting,maxwait);
     return rval;
 }
@@ -327,8 +494,6 @@ bool MutexPrivate::unlock()
     bool ok = false;
     // Hope we don't hit a bug related to the debug mutex!
     bool safety = s_safety;
-    if (safety)
-	GlobalMutex::lock();
     if (m_locked) {
 	Thread* thr = Thread::current();
 	if (thr)
@@ -339,9 +504,14 @@ bool MutexPrivate::unlock()
 		Debug(DebugFail,"MutexPrivate '%s' unlocked by '%s' but owned by '%s' [%p]",
 		    m_name,tname,m_owner,this);
 	    m_owner = 0;
+	    if (m_holdStart) {
+		if (s_profiling && m_profile)
+		    m_profile->held(Time::now() - m_holdStart);
+		m_holdStart = 0;
+	    }
 	}
 	if (safety) {
-	    int locks = --s_locks;
+	    int locks = counterDec(s_locks);
 	    if (locks < 0) {
 		// this is very very bad - abort right now
 		abortOnBug(true);
@@ -359,8 +529,6 @@ bool MutexPrivate::unlock()
     }
     else
 	Debug(DebugFail,"MutexPrivate::unlock called on unlocked '%s' [%p]",m_name,this);
-    if (safety)
-	GlobalMutex::unlock();
     return ok;
 }
 
@@ -372,27 +540,23 @@ SemaphorePrivate::SemaphorePrivate(unsigned int maxcount, const char* name,
 {
     if (initialCount > m_maxcount)
 	initialCount = m_maxcount;
-    GlobalMutex::lock();
-    s_count++;
+    counterInc(s_count);
 #ifdef _WINDOWS
     m_semaphore = ::CreateSemaphore(NULL,initialCount,maxcount,NULL);
 #else
     ::sem_init(&m_semaphore,0,initialCount);
 #endif
-    GlobalMutex::unlock();
 }
 
 SemaphorePrivate::~SemaphorePrivate()
 {
-    GlobalMutex::lock();
-    s_count--;
+    counterDec(s_count);
 #ifdef _WINDOWS
     ::CloseHandle(m_semaphore);
     m_semaphore = 0;
 #else
     ::sem_destroy(&m_semaphore);
 #endif
-    GlobalMutex::unlock();
     if (m_waiting)
 	Debug(DebugFail,"SemaphorePrivate '%s' destroyed with %u locks [%p]",
 	    m_name,m_waiting,this);
@@ -628,6 +792,60 @@ bool Mutex::efficientTimedLock()
 #endif
 }
 
+bool Mutex::profiling(bool enable)
+{
+#ifdef MUTEX_PROFILE
+    s_profiling = enable;
+#endif
+    return s_profiling;
+}
+
+bool Mutex::profiling()
+{
+    return s_profiling;
+}
+
+void Mutex::profileReset()
+{
+#ifdef MUTEX_PROFILE
+    for (unsigned int i = 0; i <= MUTEX_PROFILE_SIZE; i++)
+	s_profiles[i].reset();
+#endif
+}
+
+unsigned int Mutex::profileReport(String& dest, unsigned int max)
+{
+    unsigned int n = 0;
+#ifdef MUTEX_PROFILE
+    const MutexProfile* list[MUTEX_PROFILE_SIZE + 1];
+    for (unsigned int i = 0; i <= MUTEX_PROFILE_SIZE; i++) {
+	const MutexProfile* p = s_profiles + i;
+	if (p->m_state != 2 || !p->m_locks)
+	    continue;
+	// insertion sort by total wait time, the table is small
+	unsigned int j = n++;
+	for (; j && (list[j - 1]->m_waitTotal < p->m_waitTotal); j--)
+	    list[j] = list[j - 1];
+	list[j] = p;
+    }
+    if (max && (max > n))
+	max = n;
+    else if (!max)
+	max = n;
+    char buf[256];
+    for (unsigned int i = 0; i < max; i++) {
+	const MutexProfile* p = list[i];
+	u_int64_t locks = p->m_locks;
+	::snprintf(buf,sizeof(buf),"%-32s locks=" FMT64U " wait=" FMT64U " avgwait=" FMT64U
+	    " maxwait=" FMT64U " hold=" FMT64U " maxhold=" FMT64U "\r\n",
+	    p->m_name,locks,p->m_waitTotal,p->m_waitTotal / locks,p->m_waitMax,
+	    p->m_holdTotal,p->m_holdMax);
+	dest << buf;
+    }
+#endif
+    return n;
+}
+
 
 MutexPool::MutexPool(unsigned int len, bool recursive, const char* name)
     : m_name(0), m_data(0), m_length(len ? len : 1)
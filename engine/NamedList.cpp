@@ -19,36 +19,213 @@
 
 #include "yateclass.h"
 
+#include <string.h>
+
 using namespace TelEngine;
 
+namespace TelEngine {
+
+// Open addressing hash of the list items holding the first parameter of each name
+class NamedListIndex
+{
+public:
+    NamedListIndex(unsigned int count);
+    ~NamedListIndex();
+    static NamedListIndex* build(ObjList& params);
+    unsigned int slot(const String& name) const;
+    inline ObjList* item(unsigned int slot) const
+	{ return m_entries[slot].item; }
+    inline ObjList* find(const String& name) const
+	{ return item(slot(name)); }
+    void add(ObjList* item);
+    void replace(unsigned int slot, ObjList* item);
+    inline void remove(const String& name)
+	{ replace(slot(name),0); }
+    void moved(ObjList* from, ObjList* to);
+    // Last item in list, 0 if unknown
+    ObjList* m_last;
+private:
+    struct Entry {
+	unsigned int hash;
+	ObjList* item;
+    };
+    void resize(unsigned int size);
+    Entry* m_entries;
+    unsigned int m_mask;
+    unsigned int m_used;
+};
+
+}; // namespace TelEngine
+
 static const NamedList s_empty("");
+static unsigned int s_indexThreshold = 16;
+
+static inline const NamedString* itemParam(const ObjList* item)
+{
+    return static_cast<const NamedString*>(item->get());
+}
+
+NamedListIndex::NamedListIndex(unsigned int count)
+    : m_last(0), m_entries(0), m_mask(0), m_used(0)
+{
+    unsigned int size = 32;
+    while (size < 2 * count)
+	size <<= 1;
+    resize(size);
+}
+
+NamedListIndex::~NamedListIndex()
+{
+    delete[] m_entries;
+}
+
+// Build the index of a parameter list
+NamedListIndex* NamedListIndex::build(ObjList& params)
+{
+    NamedListIndex* idx = new NamedListIndex(params.length());
+    for (ObjList* l = &params; l; l = l->next()) {
+	if (l->get())
+	    idx->add(l);
+	if (!l->next())
+	    idx->m_last = l;
+    }
+    return idx;
+}
+
+// Find the slot holding a name or the empty slot where it should be inserted
+unsigned int NamedListIndex::slot(const String& name) const
+{
+    unsigned int hash = name.hash();
+    unsigned int i = hash & m_mask;
+    for (; m_entries[i].item; i = (i + 1) & m_mask) {
+	if (m_entries[i].hash != hash)
+	    continue;
+	const NamedString* s = itemParam(m_entries[i].item);
+	if (s && (s->name() == name))
+	    break;
+    }
+    return i;
+}
+
+void NamedListIndex::resize(unsigned int size)
+{
+    Entry* old = m_entries;
+    unsigned int oldSize = old ? m_mask + 1 : 0;
+    m_entries = new Entry[size];
+    ::memset(m_entries,0,size * sizeof(Entry));
+    m_mask = size - 1;
+    for (unsigned int i = 0; i < oldSize; i++) {
+	if (!old[i].item)
+	    continue;
+	unsigned int j = old[i].hash & m_mask;
+	while (m_entries[j].item)
+	    j = (j + 1) & m_mask;
+	m_entries[j] = old[i];
+    }
+    delete[] old;
+}
+
+// Index a list item unless a previous one with the same name exists
+void NamedListIndex::add(ObjList* item)
+{
+    const String& name = itemParam(item)->name();
+    unsigned int i = slot(name);
+    if (m_entries[i].item)
+	return;
+    m_entries[i].hash = name.hash();
+    m_entries[i].item = item;
+    if (2 * ++m_used > m_mask)
+	resize(2 * (m_mask + 1));
+}
+
+// Change the item held in an used slot, empty the slot if no item is given
+void NamedListIndex::replace(unsigned int slot, ObjList* item)
+{
+    if (!m_entries[slot].item)
+	return;
+    if (item) {
+	m_entries[slot].item = item;
+	return;
+    }
+    m_used--;
+    // backward shift deletion, no tombstones are needed
+    unsigned int i = slot;
+    for (unsigned int j = (i + 1) & m_mask; m_entries[j].item; j = (j + 1) & m_mask) {
+	unsigned int k = m_entries[j].hash & m_mask;
+	if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)))
+	    continue;
+	m_entries[i] = m_entries[j];
+	i = j;
+    }
+    m_entries[i].item = 0;
+}
+
+// Account for ObjList::remove() moving an object from the next item to the current one
+void NamedListIndex::moved(ObjList* from, ObjList* to)
+{
+    if (m_last == from)
+	m_last = to;
+    const NamedString* s = itemParam(to);
+    if (!s)
+	return;
+    // the old item was already destroyed, match it only by address
+    unsigned int i = s->name().hash() & m_mask;
+    for (; m_entries[i].item; i = (i + 1) & m_mask) {
+	if (m_entries[i].item == from) {
+	    m_entries[i].item = to;
+	    break;
+	}
+    }
+}
+
 
 const NamedList& NamedList::empty()
 {
     return s_empty;
 }
 
+unsigned int NamedList::indexThreshold()
+{
+    return s_indexThreshold;
+}
+
+void NamedList::indexThreshold(unsigned int count)
+{
+    s_indexThreshold = count;
+}
+
 NamedList::NamedList(const char* name)
-    : String(name)
+    : String(name),
+      m_index(0)
 {
 }
 
 NamedList::NamedList(const NamedList& original)
-    : String(original)
+    : String(original),
+      m_index(0)
 {
+    unsigned int n = 0;
     ObjList* dest = &m_params;
-    for (const ObjList* l = original.m_params.skipNull(); l; l = l->skipNext()) {
+    for (const ObjList* l = original.m_params.skipNull(); l; l = l->skipNext(), n++) {
 	const NamedString* p = static_cast<const NamedString*>(l->get());
 	dest = dest->append(new NamedString(p->name(),*p));
     }
+    if (s_indexThreshold && (n >= s_indexThreshold))
+	m_index = NamedListIndex::build(m_params);
 }
 
 NamedList::NamedList(const char* name, const NamedList& original, const String& prefix)
-    : String(name)
+    : String(name),
+      m_index(0)
 {
     copySubParams(original,prefix);
 }
 
+NamedList::~NamedList()
+{
+    dropIndex();
+}
+
 NamedList& NamedList::operator=(const NamedList& value)
 {
     String::operator=(value);
@@ -56,6 +233,67 @@ NamedList& NamedList::operator=(const NamedList& value)
     return copyParams(value);
 }
 
+void NamedList::dropIndex()
+{
+    if (!m_index)
+	return;
+    delete m_index;
+    m_index = 0;
+}
+
+// Append a parameter at the end of the list, build the index if it grew enough
+void NamedList::appendParam(NamedString* param)
+{
+    if (m_index) {
+	ObjList* last = m_index->m_last;
+	if (!last)
+	    last = m_params.last();
+	last = last->append(param);
+	m_index->m_last = last;
+	m_index->add(last);
+	return;
+    }
+    unsigned int n = 1;
+    ObjList* last = &m_params;
+    for (; last->next(); last = last->next())
+	n++;
+    last->append(param);
+    if (s_indexThreshold && (n >= s_indexThreshold))
+	m_index = NamedListIndex::build(m_params);
+}
+
+// Remove the parameter held in a list item, keep the index up to date
+void NamedList::removeParam(ObjList* item, bool delParam)
+{
+    if (!m_index) {
+	item->remove(delParam);
+	return;
+    }
+    NamedString* param = static_cast<NamedString*>(item->get());
+    if (!param) {
+	item->remove(delParam);
+	return;
+    }
+    unsigned int slot = m_index->slot(param->name());
+    bool first = (m_index->item(slot) == item);
+    ObjList* next = item->next();
+    item->remove(false);
+    if (first) {
+	// removed parameter was indexed, look for another with the same name
+	ObjList* l = item;
+	for (; l; l = l->next()) {
+	    const NamedString* s = itemParam(l);
+	    if (s && (s->name() == param->name()))
+		break;
+	}
+	m_index->replace(slot,l);
+    }
+    if (next)
+	m_index->moved(next,item);
+    if (delParam)
+	param->destruct();
+}
+
 void* NamedList::getObject(const String& name) const
 {
     if (name == YATOM("NamedList"))
@@ -68,7 +306,7 @@ NamedList& NamedList::addParam(NamedString* param)
     XDebug(DebugInfo,"NamedList::addParam(%p) [\"%s\",\"%s\"]",
         param,(param ? param->name().c_str() : ""),TelEngine::c_safe(param));
     if (param)
-	m_params.append(param);
+	appendParam(param);
     return *this;
 }
 
@@ -76,13 +314,22 @@ NamedList& NamedList::addParam(const char* name, const char* value, bool emptyOK
 {
     XDebug(DebugInfo,"NamedList::addParam(\"%s\",\"%s\",%s)",name,value,String::boolText(emptyOK));
     if (emptyOK || !TelEngine::null(value))
-	m_params.append(new NamedString(name, value));
+	appendParam(new NamedString(name, value));
     return *this;
 }
 
 NamedList& NamedList::setParam(const String& name, const char* value)
 {
     XDebug(DebugInfo,"NamedList::setParam(\"%s\",\"%s\")",name.c_str(),value);
+    if (m_index) {
+	ObjList* o = m_index->find(name);
+	if (o)
+	    *static_cast<NamedString*>(o->get()) = value;
+	else
+	    appendParam(new NamedString(name,value));
+	return *this;
+    }
+    unsigned int n = 0;
     ObjList *p = m_params.skipNull();
     while (p) {
         NamedString *s = static_cast<NamedString*>(p->get());
@@ -90,6 +337,7 @@ NamedList& NamedList::setParam(const String& name, const char* value)
             *s = value;
 	    return *this;
 	}
+	n++;
 	ObjList* next = p->skipNext();
 	if (next)
 	    p = next;
@@ -100,6 +348,26 @@ NamedList& NamedList::setParam(const String& name, const char* value)
 	p->append(new NamedString(name,value));
     else
 	m_params.append(new NamedString(name,value));
+    if (s_indexThreshold && (n >= s_indexThreshold))
+	m_index = NamedListIndex::build(m_params);
+    return *this;
+}
+
+NamedList& NamedList::setParam(NamedString* param)
+{
+    XDebug(DebugInfo,"NamedList::setParam(%p) [\"%s\",\"%s\"]",
+        param,(param ? param->name().c_str() : ""),TelEngine::c_safe(param));
+    if (!param)
+	return *this;
+    if (m_index) {
+	ObjList* o = m_index->find(param->name());
+	if (o)
+	    o->set(param);
+	else
+	    appendParam(param);
+    }
+    else
+	m_params.setUnique(param);
     return *this;
 }
 
@@ -107,14 +375,20 @@ NamedList& NamedList::clearParam(const String& name, char childSep)
 {
     XDebug(DebugInfo,"NamedList::clearParam(\"%s\",'%.1s')",
 	name.c_str(),&childSep);
+    ObjList *p = &m_params;
     String tmp;
     if (childSep)
 	tmp << name << childSep;
-    ObjList *p = &m_params;
+    else if (m_index) {
+	// all parameters before the indexed one have other names
+	p = m_index->find(name);
+	if (!p)
+	    return *this;
+    }
     while (p) {
         NamedString *s = static_cast<NamedString *>(p->get());
         if (s && ((s->name() == name) || s->name().startsWith(tmp)))
-            p->remove();
+            removeParam(p,true);
 	else
 	    p = p->next();
     }
@@ -126,9 +400,11 @@ NamedList& NamedList::clearParam(NamedString* param, bool delParam)
 {
     if (!param)
 	return *this;
-    ObjList* o = m_params.find(param);
+    ObjList* o = m_index ? m_index->find(param->name()) : 0;
+    if (!(o && (o->get() == param)))
+	o = m_params.find(param);
     if (o)
-	o->remove(delParam);
+	removeParam(o,delParam);
     XDebug(DebugInfo,"NamedList::clearParam(%p) found=%p",param,o);
     return *this;
 }
@@ -145,11 +421,10 @@ NamedList& NamedList::copyParam(const NamedList& original, const String& name, c
     clearParam(name,childSep);
     String tmp;
     tmp << name << childSep;
-    ObjList* dest = &m_params;
     for (const ObjList* l = original.m_params.skipNull(); l; l = l->skipNext()) {
 	const NamedString* s = static_cast<const NamedString*>(l->get());
         if ((s->name() == name) || s->name().startsWith(tmp))
-	    dest = dest->append(new NamedString(s->name(),*s));
+	    appendParam(new NamedString(s->name(),*s));
     }
     return *this;
 }
@@ -200,7 +475,6 @@ NamedList& NamedList::copySubParams(const NamedList& original, const String& pre
 	String::boolText(replace),this);
     if (prefix) {
 	unsigned int offs = skipPrefix ? prefix.length() : 0;
-	ObjList* dest = &m_params;
 	for (const ObjList* l = original.m_params.skipNull(); l; l = l->skipNext()) {
 	    const NamedString* s = static_cast<const NamedString*>(l->get());
 	    if (s->name().startsWith(prefix)) {
@@ -208,7 +482,7 @@ NamedList& NamedList::copySubParams(const NamedList& original, const String& pre
 		if (!*name)
 		    continue;
 		if (!replace)
-		    dest = dest->append(new NamedString(name,*s));
+		    appendParam(new NamedString(name,*s));
 		else if (offs)
 		    setParam(name,*s);
 		else
@@ -290,6 +564,10 @@ int NamedList::getIndex(const String& name) const
 NamedString* NamedList::getParam(const String& name) const
 {
     XDebug(DebugInfo,"NamedList::getParam(\"%s\")",name.c_str());
+    if (m_index) {
+	const ObjList* o = m_index->find(name);
+	return o ? static_cast<NamedString*>(o->get()) : 0;
+    }
     const ObjList *p = m_params.skipNull();
     for (; p; p=p->skipNext()) {
         NamedString *s = static_cast<NamedString *>(p->get());
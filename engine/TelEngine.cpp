@@ -25,6 +25,12 @@
 #include <stdio.h>
 #include <time.h>
 
+#if defined(ATOMIC_OPS) && !defined(_WINDOWS)
+#define ASYNC_OUTPUT
+#include <pthread.h>
+#include <errno.h>
+#include <sys/uio.h>
+#endif
 
 #ifdef _WINDOWS
 
@@ -181,6 +187,8 @@ static Thread* s_thr = 0;
 bool CapturedEvent::s_capturing = false;
 ObjList CapturedEvent::s_events;
 
+static unsigned int dbg_format_time(char* buf, Debugger::Formatting format, u_int64_t t);
+
 static bool reentered()
 {
     if (!s_thr)
@@ -188,7 +196,327 @@ static bool reentered()
     return (Thread::current() == s_thr);
 }
 
-static void common_output(int level,char* buf)
+#ifdef ASYNC_OUTPUT
+
+// Minimum and maximum size of a thread's output ring
+#define RING_MIN_SIZE 65536
+#define RING_MAX_SIZE 16777216
+// Maximum number of lines written by the output thread in one batch
+#define RING_BATCH 64
+// Delay in usec before writing a line so lines of other threads can be sorted
+#define RING_HOLD 10000
+#define RING_ALIGN(n) (((n) + 7) & ~7)
+#define RING_WRAP ((unsigned int)-1)
+
+// Header of a line stored in an output ring, the text follows it
+struct RingLine
+{
+    u_int64_t time;
+    int level;
+    unsigned int len;
+};
+
+// Lines are pushed lock free by the owner thread and popped by the output thread
+class OutputRing
+{
+public:
+    inline OutputRing(unsigned int size)
+	: m_next(0), m_orphan(false), m_dropped(0), m_reported(0),
+	  m_buf(new char[size]), m_mask(size - 1), m_head(0), m_tail(0), m_read(0)
+	{ }
+    inline ~OutputRing()
+	{ delete[] m_buf; }
+    bool push(u_int64_t time, int level, const char* text, unsigned int len);
+    const RingLine* peek();
+    inline void pop(const RingLine* line)
+	{ m_read += RING_ALIGN(sizeof(RingLine) + line->len); }
+    inline void commit()
+	{ __sync_synchronize(); m_tail = m_read; }
+    inline bool empty() const
+	{ return m_tail == m_head; }
+    OutputRing* m_next;
+    volatile bool m_orphan;
+    volatile unsigned int m_dropped;
+    unsigned int m_reported;
+private:
+    char* m_buf;
+    unsigned int m_mask;
+    volatile unsigned int m_head;
+    volatile unsigned int m_tail;
+    unsigned int m_read;
+};
+
+class OutputThread : public Thread
+{
+public:
+    inline OutputThread()
+	: Thread("Debug Output")
+	{ }
+    virtual void run();
+    virtual void cleanup();
+};
+
+static Mutex s_ringsMux(false,"DebugRings");
+static OutputRing* s_rings = 0;
+static pthread_key_t s_ringKey;
+static bool s_ringKeyOk = false;
+static unsigned int s_ringSize = 0;
+static volatile bool s_async = false;
+static volatile bool s_asyncStop = false;
+static volatile int s_asyncBusy = 0;
+static OutputThread* volatile s_asyncThread = 0;
+
+bool OutputRing::push(u_int64_t time, int level, const char* text, unsigned int len)
+{
+    unsigned int size = m_mask + 1;
+    unsigned int need = RING_ALIGN(sizeof(RingLine) + len);
+    unsigned int head = m_head;
+    unsigned int off = head & m_mask;
+    // a line never spans the end of the buffer
+    unsigned int skip = (size - off < need) ? size - off : 0;
+    __sync_synchronize();
+    if (size - (head - m_tail) < skip + need) {
+	m_dropped++;
+	return false;
+    }
+    if (skip) {
+	if (skip >= sizeof(RingLine))
+	    reinterpret_cast<RingLine*>(m_buf + off)->len = RING_WRAP;
+	head += skip;
+	off = 0;
+    }
+    RingLine* line = reinterpret_cast<RingLine*>(m_buf + off);
+    line->time = time;
+    line->level = level;
+    line->len = len;
+    ::memcpy(line + 1,text,len);
+    __sync_synchronize();
+    m_head = head + need;
+    return true;
+}
+
+const RingLine* OutputRing::peek()
+{
+    if (m_read == m_head)
+	return 0;
+    __sync_synchronize();
+    unsigned int off = m_read & m_mask;
+    unsigned int rest = m_mask + 1 - off;
+    if (rest < sizeof(RingLine) || reinterpret_cast<RingLine*>(m_buf + off)->len == RING_WRAP) {
+	m_read += rest;
+	off = 0;
+    }
+    return reinterpret_cast<RingLine*>(m_buf + off);
+}
+
+// Called by the key destructor when a thread exits
+static void ring_release(void* data)
+{
+    OutputRing* ring = static_cast<OutputRing*>(data);
+    Lock lck(s_ringsMux);
+    if (s_asyncThread) {
+	// output thread will collect it once it's empty
+	ring->m_orphan = true;
+	return;
+    }
+    for (OutputRing** p = &s_rings; *p; p = &((*p)->m_next)) {
+	if (*p == ring) {
+	    *p = ring->m_next;
+	    break;
+	}
+    }
+    delete ring;
+}
+
+// Write all vectors, retrying after partial writes
+static void ring_writev(struct iovec* iov, int cnt)
+{
+    while (cnt > 0) {
+	int w = ::writev(2,iov,cnt);
+	if (w < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return;
+	}
+	while (cnt > 0 && (size_t)w >= iov->iov_len) {
+	    w -= iov->iov_len;
+	    iov++;
+	    cnt--;
+	}
+	if (cnt > 0) {
+	    iov->iov_base = static_cast<char*>(iov->iov_base) + w;
+	    iov->iov_len -= w;
+	}
+    }
+}
+
+// Write out one batch of lines in timestamp order, return number of lines
+static unsigned int ring_flush(bool all)
+{
+    // give other threads a chance to queue their older lines
+    u_int64_t limit = all ? (u_int64_t)-1 : Time::now() - RING_HOLD;
+    const RingLine* lines[RING_BATCH];
+    OutputRing* rings[RING_BATCH];
+    unsigned int cnt = 0;
+    unsigned int dropped = 0;
+    s_ringsMux.lock();
+    for (OutputRing** p = &s_rings; *p; ) {
+	OutputRing* r = *p;
+	if (r->m_orphan && r->empty()) {
+	    *p = r->m_next;
+	    dropped += r->m_dropped - r->m_reported;
+	    delete r;
+	    continue;
+	}
+	unsigned int d = r->m_dropped;
+	dropped += d - r->m_reported;
+	r->m_reported = d;
+	p = &(r->m_next);
+    }
+    while (cnt < RING_BATCH) {
+	OutputRing* best = 0;
+	const RingLine* line = 0;
+	for (OutputRing* r = s_rings; r; r = r->m_next) {
+	    const RingLine* l = r->peek();
+	    if (l && (!line || (l->time < line->time))) {
+		best = r;
+		line = l;
+	    }
+	}
+	if (!best || (line->time > limit))
+	    break;
+	best->pop(line);
+	lines[cnt] = line;
+	rings[cnt++] = best;
+    }
+    s_ringsMux.unlock();
+    if (!(cnt || dropped))
+	return 0;
+    char warn[128];
+    if (dropped) {
+	unsigned int n = dbg_format_time(warn,s_fmtstamp,Time::now());
+	::snprintf(warn + n,sizeof(warn) - n,
+	    "<WARN> Debug output overrun, dropped %u lines\n",dropped);
+    }
+    out_mux.lock();
+    s_thr = Thread::current();
+    void (*output)(const char*,int) = s_output;
+    if (output == dbg_stderr_func || output == dbg_colorize_func) {
+	bool color = (output == dbg_colorize_func);
+	struct iovec iov[3 * (RING_BATCH + 1)];
+	int n = 0;
+	for (unsigned int i = 0; i <= cnt; i++) {
+	    const char* text = 0;
+	    int level = DebugWarn;
+	    if (i < cnt) {
+		text = reinterpret_cast<const char*>(lines[i] + 1);
+		level = lines[i]->level;
+	    }
+	    else if (dropped)
+		text = warn;
+	    if (!text)
+		break;
+	    if (color) {
+		iov[n].iov_base = const_cast<char*>(debugColor(level));
+		iov[n++].iov_len = ::strlen(debugColor(level));
+	    }
+	    iov[n].iov_base = const_cast<char*>(text);
+	    iov[n++].iov_len = ::strlen(text);
+	    if (color) {
+		iov[n].iov_base = const_cast<char*>(debugColor(-2));
+		iov[n++].iov_len = ::strlen(debugColor(-2));
+	    }
+	}
+	ring_writev(iov,n);
+	output = 0;
+    }
+    for (unsigned int i = 0; i < cnt; i++) {
+	const char* text = reinterpret_cast<const char*>(lines[i] + 1);
+	if (output)
+	    output(text,lines[i]->level);
+	if (s_intout)
+	    s_intout(text,lines[i]->level);
+    }
+    if (dropped) {
+	if (output)
+	    output(warn,DebugWarn);
+	if (s_intout)
+	    s_intout(warn,DebugWarn);
+    }
+    s_thr = 0;
+    out_mux.unlock();
+    // release the buffer space only after the lines were written
+    for (unsigned int i = 0; i < cnt; i++)
+	rings[i]->commit();
+    return cnt ? cnt : 1;
+}
+
+void OutputThread::run()
+{
+    for (;;) {
+	bool stop = s_asyncStop;
+	if (ring_flush(stop))
+	    continue;
+	if (stop)
+	    break;
+	Thread::idle();
+    }
+}
+
+void OutputThread::cleanup()
+{
+    s_ringsMux.lock();
+    s_asyncThread = 0;
+    // rings of threads that exited meanwhile are not needed any more
+    for (OutputRing** p = &s_rings; *p; ) {
+	OutputRing* r = *p;
+	if (r->m_orphan) {
+	    *p = r->m_next;
+	    delete r;
+	}
+	else
+	    p = &(r->m_next);
+    }
+    s_ringsMux.unlock();
+}
+
+// Queue a line in the current thread's ring, return false if not in async mode
+static bool async_output(int level, char* buf, int n, u_int64_t when)
+{
+    __sync_add_and_fetch(&s_asyncBusy,1);
+    if (!s_async) {
+	__sync_sub_and_fetch(&s_asyncBusy,1);
+	return false;
+    }
+    OutputRing* ring = static_cast<OutputRing*>(::pthread_getspecific(s_ringKey));
+    if (!ring) {
+	ring = new OutputRing(s_ringSize);
+	::pthread_setspecific(s_ringKey,ring);
+	s_ringsMux.lock();
+	ring->m_next = s_rings;
+	s_rings = ring;
+	s_ringsMux.unlock();
+    }
+    if (CapturedEvent::capturing()) {
+	out_mux.lock();
+	buf[n] = '\0';
+	bool save = s_debugging;
+	s_debugging = false;
+	CapturedEvent::append(level,buf);
+	s_debugging = save;
+	out_mux.unlock();
+    }
+    buf[n] = '\n';
+    buf[n+1] = '\0';
+    ring->push(when ? when : Time::now(),level,buf,n + 2);
+    buf[n] = '\0';
+    __sync_sub_and_fetch(&s_asyncBusy,1);
+    return true;
+}
+
+#endif // ASYNC_OUTPUT
+
+static void common_output(int level,char* buf,u_int64_t when = 0)
 {
     if (level < -1)
 	level = -1;
@@ -197,6 +525,11 @@ static void common_output(int level,char* buf)
     int n = ::strlen(buf);
     if (n && (buf[n-1] == '\n'))
 	n--;
+#ifdef ASYNC_OUTPUT
+    // a fatal bug must reach the output before aborting
+    if (!(s_abort && (level == DebugFail)) && async_output(level,buf,n,when))
+	return;
+#endif
     // serialize the output strings
     out_mux.lock();
     // TODO: detect reentrant calls from foreign threads and main thread
@@ -229,7 +562,8 @@ static void dbg_output(int level,const char* prefix, const char* format, va_list
     if (!(out || alarm))
 	return;
     char buf[OUT_BUFFER_SIZE];
-    unsigned int n = Debugger::formatTime(buf,s_fmtstamp);
+    u_int64_t when = Time::now();
+    unsigned int n = dbg_format_time(buf,s_fmtstamp,when);
     unsigned int l = s_indent*2;
     if (l >= sizeof(buf)-n)
 	l = sizeof(buf)-n-1;
@@ -251,11 +585,26 @@ static void dbg_output(int level,const char* prefix, const char* format, va_list
 	return;
     }
     if (out)
-	common_output(level,buf);
+	common_output(level,buf,when);
     if (alarm)
 	alarms(msg,level,alarmComp,alarmInfo);
 }
 
+// Format a debug line, the indentation lock is not needed in async mode
+static inline void dbg_indent_output(int level,const char* prefix, const char* format, va_list ap,
+    const char* alarmComp = 0, const char* alarmInfo = 0)
+{
+#ifdef ASYNC_OUTPUT
+    if (s_async) {
+	dbg_output(level,prefix,format,ap,alarmComp,alarmInfo);
+	return;
+    }
+#endif
+    ind_mux.lock();
+    dbg_output(level,prefix,format,ap,alarmComp,alarmInfo);
+    ind_mux.unlock();
+}
+
 void Output(const char* format, ...)
 {
     char buf[OUT_BUFFER_SIZE];
@@ -288,9 +637,7 @@ void Debug(int level, const char* format, ...)
     ::sprintf(buf,"<%s> ",dbg_level(level));
     va_list va;
     va_start(va,format);
-    ind_mux.lock();
-    dbg_output(level,buf,format,va);
-    ind_mux.unlock();
+    dbg_indent_output(level,buf,format,va);
     va_end(va);
     if (s_abort && (level == DebugFail))
 	abort();
@@ -310,9 +657,7 @@ void Debug(const char* facility, int level, const char* format, ...)
     ::snprintf(buf,sizeof(buf),"<%s:%s> ",facility,dbg_level(level));
     va_list va;
     va_start(va,format);
-    ind_mux.lock();
-    dbg_output(level,buf,format,va);
-    ind_mux.unlock();
+    dbg_indent_output(level,buf,format,va);
     va_end(va);
     if (s_abort && (level == DebugFail))
 	abort();
@@ -343,9 +688,7 @@ void Debug(const DebugEnabler* local, int level, const char* format, ...)
 	::sprintf(buf,"<%s> ",dbg_level(level));
     va_list va;
     va_start(va,format);
-    ind_mux.lock();
-    dbg_output(level,buf,format,va);
-    ind_mux.unlock();
+    dbg_indent_output(level,buf,format,va);
     va_end(va);
     if (s_abort && (level == DebugFail))
 	abort();
@@ -361,9 +704,7 @@ void Alarm(const char* component, int level, const char* format, ...)
     ::snprintf(buf,sizeof(buf),"<%s:%s> ",component,dbg_level(level));
     va_list va;
     va_start(va,format);
-    ind_mux.lock();
-    dbg_output(level,buf,format,va,component);
-    ind_mux.unlock();
+    dbg_indent_output(level,buf,format,va,component);
     va_end(va);
     if (s_abort && (level == DebugFail))
 	abort();
@@ -379,9 +720,7 @@ void Alarm(const DebugEnabler* component, int level, const char* format, ...)
     ::snprintf(buf,sizeof(buf),"<%s:%s> ",name,dbg_level(level));
     va_list va;
     va_start(va,format);
-    ind_mux.lock();
-    dbg_output(level,buf,format,va,name);
-    ind_mux.unlock();
+    dbg_indent_output(level,buf,format,va,name);
     va_end(va);
     if (s_abort && (level == DebugFail))
 	abort();
@@ -397,9 +736,7 @@ void Alarm(const char* component, const char* info, int level, const char* forma
     ::snprintf(buf,sizeof(buf),"<%s:%s> ",component,dbg_level(level));
     va_list va;
     va_start(va,format);
-    ind_mux.lock();
-    dbg_output(level,buf,format,va,component,info);
-    ind_mux.unlock();
+    dbg_indent_output(level,buf,format,va,component,info);
     va_end(va);
     if (s_abort && (level == DebugFail))
 	abort();
@@ -415,9 +752,7 @@ void Alarm(const DebugEnabler* component, const char* info, int level, const cha
     ::snprintf(buf,sizeof(buf),"<%s:%s> ",name,dbg_level(level));
     va_list va;
     va_start(va,format);
-    ind_mux.lock();
-    dbg_output(level,buf,format,va,name,info);
-    ind_mux.unlock();
+    dbg_indent_output(level,buf,format,va,name,info);
     va_end(va);
     if (s_abort && (level == DebugFail))
 	abort();
@@ -601,6 +936,56 @@ void Debugger::enableOutput(bool enable, bool colorize)
 	setOutput(dbg_colorize_func);
 }
 
+bool Debugger::setAsyncOutput(unsigned int bufSize)
+{
+#ifdef ASYNC_OUTPUT
+    static Mutex s_asyncMux(false,"DebugAsync");
+    Lock lck(s_asyncMux);
+    if (bufSize) {
+	if (bufSize < RING_MIN_SIZE)
+	    bufSize = RING_MIN_SIZE;
+	else if (bufSize > RING_MAX_SIZE)
+	    bufSize = RING_MAX_SIZE;
+	// round up to a power of 2 so ring positions can wrap around freely
+	unsigned int size = RING_MIN_SIZE;
+	while (size < bufSize)
+	    size <<= 1;
+	// only rings created from now on use the new size
+	s_ringSize = size;
+	if (s_async)
+	    return true;
+	if (!s_ringKeyOk) {
+	    if (::pthread_key_create(&s_ringKey,ring_release))
+		return false;
+	    s_ringKeyOk = true;
+	}
+	while (s_asyncThread)
+	    Thread::idle();
+	s_asyncStop = false;
+	OutputThread* thr = new OutputThread;
+	s_asyncThread = thr;
+	if (!thr->startup()) {
+	    delete thr;
+	    s_asyncThread = 0;
+	    return false;
+	}
+	s_async = true;
+	return true;
+    }
+    if (!s_async)
+	return false;
+    s_async = false;
+    // wait for threads that are just queueing a line
+    while (s_asyncBusy)
+	Thread::yield();
+    s_asyncStop = true;
+    // the output thread writes everything left before exiting
+    while (s_asyncThread)
+	Thread::idle();
+#endif
+    return false;
+}
+
 uint32_t Debugger::getStartTimeSec()
 {
     return (uint32_t)(s_timestamp / 1000000);
@@ -623,25 +1008,24 @@ void Debugger::setFormatting(Formatting format, uint32_t startTimeSec)
     s_fmtstamp = format;
 }
 
-unsigned int Debugger::formatTime(char* buf, Formatting format)
+static unsigned int dbg_format_time(char* buf, Debugger::Formatting format, u_int64_t t)
 {
     if (!buf)
 	return 0;
-    if (None != format) {
-	u_int64_t t = Time::now();
-	if (Relative == format)
+    if (Debugger::None != format) {
+	if (Debugger::Relative == format)
 	    t -= s_timestamp;
 	unsigned int s = (unsigned int)(t / 1000000);
 	unsigned int u = (unsigned int)(t % 1000000);
 	switch (format) {
-	    case Textual:
-	    case TextLocal:
-	    case TextSep:
-	    case TextLSep:
+	    case Debugger::Textual:
+	    case Debugger::TextLocal:
+	    case Debugger::TextSep:
+	    case Debugger::TextLSep:
 		{
 		    time_t sec = (time_t)s;
 		    struct tm tmp;
-		    if (TextLocal == format || TextLSep == format)
+		    if (Debugger::TextLocal == format || Debugger::TextLSep == format)
 #ifdef _WINDOWS
 			_localtime_s(&tmp,&sec);
 #else
@@ -653,7 +1037,7 @@ unsigned int Debugger::formatTime(char* buf, Formatting format)
 #else
 			gmtime_r(&sec,&tmp);
 #endif
-		    if (Textual == format || TextLocal == format)
+		    if (Debugger::Textual == format || Debugger::TextLocal == format)
 			::sprintf(buf,"%04d%02d%02d%02d%02d%02d.%06u ",
 			    tmp.tm_year+1900,tmp.tm_mon+1,tmp.tm_mday,
 			    tmp.tm_hour,tmp.tm_min,tmp.tm_sec,u);
@@ -672,6 +1056,11 @@ unsigned int Debugger::formatTime(char* buf, Formatting format)
     return 0;
 }
 
+unsigned int Debugger::formatTime(char* buf, Formatting format)
+{
+    return dbg_format_time(buf,format,Time::now());
+}
+
 void Debugger::relayOutput(int level, char* buffer, const char* component, const char* info)
 {
     if (TelEngine::null(buffer))
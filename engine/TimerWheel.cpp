@@ -0,0 +1,122 @@
+/**
+ * TimerWheel.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "yateclass.h"
+
+using namespace TelEngine;
+
+TimerWheel::TimerWheel(unsigned int slots, u_int64_t tick, u_int64_t now)
+    : m_slots(slots), m_tick(tick), m_current(0), m_wheel(0), m_readyLast(&m_ready)
+{
+    XDebug(DebugAll,"TimerWheel::TimerWheel(%u," FMT64U ") [%p]",slots,tick,this);
+    if (m_slots < 1)
+	m_slots = 1;
+    if (m_tick < 1)
+	m_tick = 1;
+    m_current = now / m_tick;
+    m_wheel = new ObjList[m_slots];
+}
+
+TimerWheel::~TimerWheel()
+{
+    XDebug(DebugAll,"TimerWheel::~TimerWheel() [%p]",this);
+    // entries are owned by their objects, lists only hold them with no delete flag
+    delete[] m_wheel;
+}
+
+bool TimerWheel::schedule(TimerWheelEntry& entry, u_int64_t when)
+{
+    if (entry.m_done)
+	return false;
+    if (entry.m_ready)
+	return true;
+    // Round up: an entry must not be returned before the requested time
+    u_int64_t tick = (when + m_tick - 1) / m_tick;
+    if (entry.m_slot >= 0) {
+	if (when && entry.m_tick <= tick)
+	    return true;
+	m_wheel[entry.m_slot].remove(&entry,false);
+	entry.m_slot = -1;
+    }
+    if (!when || tick < m_current) {
+	m_readyLast = m_readyLast->append(&entry);
+	m_readyLast->setDelete(false);
+	entry.m_ready = true;
+	return true;
+    }
+    // Far away times are re-evaluated when reaching the end of the wheel
+    if (tick >= m_current + m_slots)
+	tick = m_current + m_slots - 1;
+    entry.m_tick = tick;
+    entry.m_slot = (int)(tick % m_slots);
+    m_wheel[entry.m_slot].append(&entry)->setDelete(false);
+    return true;
+}
+
+void TimerWheel::cancel(TimerWheelEntry& entry, bool done)
+{
+    if (done)
+	entry.m_done = true;
+    if (entry.m_ready) {
+	// Leave an empty entry, the list tail must remain valid
+	ObjList* o = m_ready.find(&entry);
+	if (o)
+	    o->set(0,false);
+	entry.m_ready = false;
+    }
+    if (entry.m_slot >= 0) {
+	m_wheel[entry.m_slot].remove(&entry,false);
+	entry.m_slot = -1;
+    }
+}
+
+void TimerWheel::advance(u_int64_t now)
+{
+    u_int64_t tick = now / m_tick;
+    for (unsigned int n = 0; m_current <= tick && n < m_slots; n++, m_current++) {
+	ObjList& slot = m_wheel[m_current % m_slots];
+	for (ObjList* o = slot.skipNull(); o; o = o->skipNext()) {
+	    TimerWheelEntry* e = static_cast<TimerWheelEntry*>(o->get());
+	    e->m_slot = -1;
+	    e->m_ready = true;
+	    m_readyLast = m_readyLast->append(e);
+	    m_readyLast->setDelete(false);
+	}
+	slot.clear();
+    }
+    // All slots were visited if we fell behind more than a full turn
+    if (m_current <= tick)
+	m_current = tick + 1;
+}
+
+GenObject* TimerWheel::get()
+{
+    while (m_ready.get() || m_ready.next()) {
+	TimerWheelEntry* e = static_cast<TimerWheelEntry*>(m_ready.remove(false));
+	if (!m_ready.next())
+	    m_readyLast = &m_ready;
+	if (!e)
+	    continue;
+	e->m_ready = false;
+	return e->object();
+    }
+    return 0;
+}
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
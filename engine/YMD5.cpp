@@ -27,6 +27,11 @@
 
 #define MD5_HASHBYTES 16
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MD5_MULTI_AVX2
+#define MD5_LANES 8
+#endif
+
 typedef struct MD5Context {
     u_int32_t buf[4];
     u_int32_t bits[2];
@@ -65,6 +70,79 @@ static void byteReverse(unsigned char *buf, unsigned longs)
 #define MD5STEP(f, w, x, y, z, data, s) \
 	( w += f(x, y, z) + data,  w = w<<s | w>>(32-s),  w += x )
 
+/*
+ * All 64 steps of the MD5 transform.  The working variables and input words
+ * can be plain 32 bit integers or vectors processing several blocks at once.
+ */
+#define MD5ROUNDS(a, b, c, d, in) \
+    MD5STEP(F1, a, b, c, d,  in[0] + 0xd76aa478,  7); \
+    MD5STEP(F1, d, a, b, c,  in[1] + 0xe8c7b756, 12); \
+    MD5STEP(F1, c, d, a, b,  in[2] + 0x242070db, 17); \
+    MD5STEP(F1, b, c, d, a,  in[3] + 0xc1bdceee, 22); \
+    MD5STEP(F1, a, b, c, d,  in[4] + 0xf57c0faf,  7); \
+    MD5STEP(F1, d, a, b, c,  in[5] + 0x4787c62a, 12); \
+    MD5STEP(F1, c, d, a, b,  in[6] + 0xa8304613, 17); \
+    MD5STEP(F1, b, c, d, a,  in[7] + 0xfd469501, 22); \
+    MD5STEP(F1, a, b, c, d,  in[8] + 0x698098d8,  7); \
+    MD5STEP(F1, d, a, b, c,  in[9] + 0x8b44f7af, 12); \
+    MD5STEP(F1, c, d, a, b, in[10] + 0xffff5bb1, 17); \
+    MD5STEP(F1, b, c, d, a, in[11] + 0x895cd7be, 22); \
+    MD5STEP(F1, a, b, c, d, in[12] + 0x6b901122,  7); \
+    MD5STEP(F1, d, a, b, c, in[13] + 0xfd987193, 12); \
+    MD5STEP(F1, c, d, a, b, in[14] + 0xa679438e, 17); \
+    MD5STEP(F1, b, c, d, a, in[15] + 0x49b40821, 22); \
+\
+    MD5STEP(F2, a, b, c, d,  in[1] + 0xf61e2562,  5); \
+    MD5STEP(F2, d, a, b, c,  in[6] + 0xc040b340,  9); \
+    MD5STEP(F2, c, d, a, b, in[11] + 0x265e5a51, 14); \
+    MD5STEP(F2, b, c, d, a,  in[0] + 0xe9b6c7aa, 20); \
+    MD5STEP(F2, a, b, c, d,  in[5] + 0xd62f105d,  5); \
+    MD5STEP(F2, d, a, b, c, in[10] + 0x02441453,  9); \
+    MD5STEP(F2, c, d, a, b, in[15] + 0xd8a1e681, 14); \
+    MD5STEP(F2, b, c, d, a,  in[4] + 0xe7d3fbc8, 20); \
+    MD5STEP(F2, a, b, c, d,  in[9] + 0x21e1cde6,  5); \
+    MD5STEP(F2, d, a, b, c, in[14] + 0xc33707d6,  9); \
+    MD5STEP(F2, c, d, a, b,  in[3] + 0xf4d50d87, 14); \
+    MD5STEP(F2, b, c, d, a,  in[8] + 0x455a14ed, 20); \
+    MD5STEP(F2, a, b, c, d, in[13] + 0xa9e3e905,  5); \
+    MD5STEP(F2, d, a, b, c,  in[2] + 0xfcefa3f8,  9); \
+    MD5STEP(F2, c, d, a, b,  in[7] + 0x676f02d9, 14); \
+    MD5STEP(F2, b, c, d, a, in[12] + 0x8d2a4c8a, 20); \
+\
+    MD5STEP(F3, a, b, c, d,  in[5] + 0xfffa3942,  4); \
+    MD5STEP(F3, d, a, b, c,  in[8] + 0x8771f681, 11); \
+    MD5STEP(F3, c, d, a, b, in[11] + 0x6d9d6122, 16); \
+    MD5STEP(F3, b, c, d, a, in[14] + 0xfde5380c, 23); \
+    MD5STEP(F3, a, b, c, d,  in[1] + 0xa4beea44,  4); \
+    MD5STEP(F3, d, a, b, c,  in[4] + 0x4bdecfa9, 11); \
+    MD5STEP(F3, c, d, a, b,  in[7] + 0xf6bb4b60, 16); \
+    MD5STEP(F3, b, c, d, a, in[10] + 0xbebfbc70, 23); \
+    MD5STEP(F3, a, b, c, d, in[13] + 0x289b7ec6,  4); \
+    MD5STEP(F3, d, a, b, c,  in[0] + 0xeaa127fa, 11); \
+    MD5STEP(F3, c, d, a, b,  in[3] + 0xd4ef3085, 16); \
+    MD5STEP(F3, b, c, d, a,  in[6] + 0x04881d05, 23); \
+    MD5STEP(F3, a, b, c, d,  in[9] + 0xd9d4d039,  4); \
+    MD5STEP(F3, d, a, b, c, in[12] + 0xe6db99e5, 11); \
+    MD5STEP(F3, c, d, a, b, in[15] + 0x1fa27cf8, 16); \
+    MD5STEP(F3, b, c, d, a,  in[2] + 0xc4ac5665, 23); \
+\
+    MD5STEP(F4, a, b, c, d,  in[0] + 0xf4292244,  6); \
+    MD5STEP(F4, d, a, b, c,  in[7] + 0x432aff97, 10); \
+    MD5STEP(F4, c, d, a, b, in[14] + 0xab9423a7, 15); \
+    MD5STEP(F4, b, c, d, a,  in[5] + 0xfc93a039, 21); \
+    MD5STEP(F4, a, b, c, d, in[12] + 0x655b59c3,  6); \
+    MD5STEP(F4, d, a, b, c,  in[3] + 0x8f0ccc92, 10); \
+    MD5STEP(F4, c, d, a, b, in[10] + 0xffeff47d, 15); \
+    MD5STEP(F4, b, c, d, a,  in[1] + 0x85845dd1, 21); \
+    MD5STEP(F4, a, b, c, d,  in[8] + 0x6fa87e4f,  6); \
+    MD5STEP(F4, d, a, b, c, in[15] + 0xfe2ce6e0, 10); \
+    MD5STEP(F4, c, d, a, b,  in[6] + 0xa3014314, 15); \
+    MD5STEP(F4, b, c, d, a, in[13] + 0x4e0811a1, 21); \
+    MD5STEP(F4, a, b, c, d,  in[4] + 0xf7537e82,  6); \
+    MD5STEP(F4, d, a, b, c, in[11] + 0xbd3af235, 10); \
+    MD5STEP(F4, c, d, a, b,  in[2] + 0x2ad7d2bb, 15); \
+    MD5STEP(F4, b, c, d, a,  in[9] + 0xeb86d391, 21)
+
 /*
  * The core of the MD5 algorithm, this alters an existing MD5 hash to
  * reflect the addition of 16 longwords of new data.  MD5Update blocks
@@ -79,73 +157,7 @@ static void MD5Transform(u_int32_t buf[4], u_int32_t const in[16])
     c = buf[2];
     d = buf[3];
 
-    MD5STEP(F1, a, b, c, d,  in[0] + 0xd76aa478,  7);
-    MD5STEP(F1, d, a, b, c,  in[1] + 0xe8c7b756, 12);
-    MD5STEP(F1, c, d, a, b,  in[2] + 0x242070db, 17);
-    MD5STEP(F1, b, c, d, a,  in[3] + 0xc1bdceee, 22);
-    MD5STEP(F1, a, b, c, d,  in[4] + 0xf57c0faf,  7);
-    MD5STEP(F1, d, a, b, c,  in[5] + 0x4787c62a, 12);
-    MD5STEP(F1, c, d, a, b,  in[6] + 0xa8304613, 17);
-    MD5STEP(F1, b, c, d, a,  in[7] + 0xfd469501, 22);
-    MD5STEP(F1, a, b, c, d,  in[8] + 0x698098d8,  7);
-    MD5STEP(F1, d, a, b, c,  in[9] + 0x8b44f7af, 12);
-    MD5STEP(F1, c, d, a, b, in[10] + 0xffff5bb1, 17);
-    MD5STEP(F1, b, c, d, a, in[11] + 0x895cd7be, 22);
-    MD5STEP(F1, a, b, c, d, in[12] + 0x6b901122,  7);
-    MD5STEP(F1, d, a, b, c, in[13] + 0xfd987193, 12);
-    MD5STEP(F1, c, d, a, b, in[14] + 0xa679438e, 17);
-    MD5STEP(F1, b, c, d, a, in[15] + 0x49b40821, 22);
-
-    MD5STEP(F2, a, b, c, d,  in[1] + 0xf61e2562,  5);
-    MD5STEP(F2, d, a, b, c,  in[6] + 0xc040b340,  9);
-    MD5STEP(F2, c, d, a, b, in[11] + 0x265e5a51, 14);
-    MD5STEP(F2, b, c, d, a,  in[0] + 0xe9b6c7aa, 20);
-    MD5STEP(F2, a, b, c, d,  in[5] + 0xd62f105d,  5);
-    MD5STEP(F2, d, a, b, c, in[10] + 0x02441453,  9);
-    MD5STEP(F2, c, d, a, b, in[15] + 0xd8a1e681, 14);
-    MD5STEP(F2, b, c, d, a,  in[4] + 0xe7d3fbc8, 20);
-    MD5STEP(F2, a, b, c, d,  in[9] + 0x21e1cde6,  5);
-    MD5STEP(F2, d, a, b, c, in[14] + 0xc33707d6,  9);
-    MD5STEP(F2, c, d, a, b,  in[3] + 0xf4d50d87, 14);
-    MD5STEP(F2, b, c, d, a,  in[8] + 0x455a14ed, 20);
-    MD5STEP(F2, a, b, c, d, in[13] + 0xa9e3e905,  5);
-    MD5STEP(F2, d, a, b, c,  in[2] + 0xfcefa3f8,  9);
-    MD5STEP(F2, c, d, a, b,  in[7] + 0x676f02d9, 14);
-    MD5STEP(F2, b, c, d, a, in[12] + 0x8d2a4c8a, 20);
-
-    MD5STEP(F3, a, b, c, d,  in[5] + 0xfffa3942,  4);
-    MD5STEP(F3, d, a, b, c,  in[8] + 0x8771f681, 11);
-    MD5STEP(F3, c, d, a, b, in[11] + 0x6d9d6122, 16);
-    MD5STEP(F3, b, c, d, a, in[14] + 0xfde5380c, 23);
-    MD5STEP(F3, a, b, c, d,  in[1] + 0xa4beea44,  4);
-    MD5STEP(F3, d, a, b, c,  in[4] + 0x4bdecfa9, 11);
-    MD5STEP(F3, c, d, a, b,  in[7] + 0xf6bb4b60, 16);
-    MD5STEP(F3, b, c, d, a, in[10] + 0xbebfbc70, 23);
-    MD5STEP(F3, a, b, c, d, in[13] + 0x289b7ec6,  4);
-    MD5STEP(F3, d, a, b, c,  in[0] + 0xeaa127fa, 11);
-    MD5STEP(F3, c, d, a, b,  in[3] + 0xd4ef3085, 16);
-    MD5STEP(F3, b, c, d, a,  in[6] + 0x04881d05, 23);
-    MD5STEP(F3, a, b, c, d,  in[9] + 0xd9d4d039,  4);
-    MD5STEP(F3, d, a, b, c, in[12] + 0xe6db99e5, 11);
-    MD5STEP(F3, c, d, a, b, in[15] + 0x1fa27cf8, 16);
-    MD5STEP(F3, b, c, d, a,  in[2] + 0xc4ac5665, 23);
-
-    MD5STEP(F4, a, b, c, d,  in[0] + 0xf4292244,  6);
-    MD5STEP(F4, d, a, b, c,  in[7] + 0x432aff97, 10);
-    MD5STEP(F4, c, d, a, b, in[14] + 0xab9423a7, 15);
-    MD5STEP(F4, b, c, d, a,  in[5] + 0xfc93a039, 21);
-    MD5STEP(F4, a, b, c, d, in[12] + 0x655b59c3,  6);
-    MD5STEP(F4, d, a, b, c,  in[3] + 0x8f0ccc92, 10);
-    MD5STEP(F4, c, d, a, b, in[10] + 0xffeff47d, 15);
-    MD5STEP(F4, b, c, d, a,  in[1] + 0x85845dd1, 21);
-    MD5STEP(F4, a, b, c, d,  in[8] + 0x6fa87e4f,  6);
-    MD5STEP(F4, d, a, b, c, in[15] + 0xfe2ce6e0, 10);
-    MD5STEP(F4, c, d, a, b,  in[6] + 0xa3014314, 15);
-    MD5STEP(F4, b, c, d, a, in[13] + 0x4e0811a1, 21);
-    MD5STEP(F4, a, b, c, d,  in[4] + 0xf7537e82,  6);
-    MD5STEP(F4, d, a, b, c, in[11] + 0xbd3af235, 10);
-    MD5STEP(F4, c, d, a, b,  in[2] + 0x2ad7d2bb, 15);
-    MD5STEP(F4, b, c, d, a,  in[9] + 0xeb86d391, 21);
+    MD5ROUNDS(a, b, c, d, in);
 
     buf[0] += a;
     buf[1] += b;
@@ -261,6 +273,134 @@ static void MD5_Final(unsigned char digest[16], MD5_CTX *ctx)
     memset((char *) ctx, 0, sizeof(ctx));	/* In case it's sensitive */
 }
 
+#ifdef MD5_MULTI_AVX2
+
+/* 8 independent MD5 states, one in each 32 bit lane */
+typedef u_int32_t md5_vec __attribute__((vector_size(32)));
+
+/* A message hashed in one lane of the vectors */
+typedef struct MD5Lane {
+    const unsigned char *data;	/* next full block of the message */
+    const unsigned char *tail;	/* next block of the padded tail */
+    unsigned full;		/* full blocks left in message */
+    unsigned left;		/* padded tail blocks left */
+    unsigned char *out;		/* digest destination, NULL if lane is idle */
+    unsigned char pad[128];	/* last partial block, padding and bit count */
+} MD5_LANE;
+
+static void MD5LaneStart(MD5_LANE *lane, const unsigned char *buf, unsigned len,
+    unsigned char *out)
+{
+    unsigned rem = len & 63;
+    u_int64_t bits = (u_int64_t)len << 3;
+    unsigned char *p;
+    int i;
+
+    lane->data = buf;
+    lane->full = len >> 6;
+    lane->tail = lane->pad;
+    lane->left = (rem < 56) ? 1 : 2;
+    lane->out = out;
+    memset(lane->pad, 0, sizeof(lane->pad));
+    if (rem)
+	memcpy(lane->pad, buf + len - rem, rem);
+    lane->pad[rem] = 0x80;
+    p = lane->pad + 64 * lane->left - 8;
+    for (i = 0; i < 8; i++, bits >>= 8)
+	p[i] = (unsigned char)bits;
+}
+
+/* Return the block to hash next in a lane and step past it */
+static inline const unsigned char *MD5LaneBlock(MD5_LANE *lane)
+{
+    const unsigned char *blk;
+    if (lane->full) {
+	blk = lane->data;
+	lane->data += 64;
+	lane->full--;
+    }
+    else {
+	blk = lane->tail;
+	lane->tail += 64;
+	lane->left--;
+    }
+    return blk;
+}
+
+/*
+ * Hash many messages in parallel, each vector lane works on a different one.
+ * A lane that finishes its message is refilled with the next one so lanes
+ * stay busy even when message lengths differ.
+ */
+__attribute__((target("avx2")))
+static void MD5ManyAvx2(unsigned char *out, const void *const *bufs,
+    const unsigned *lens, unsigned count)
+{
+    static const unsigned char idle[64] = { 0 };
+    static const u_int32_t iv[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    MD5_LANE lanes[MD5_LANES];
+    u_int32_t words[16][MD5_LANES] __attribute__((aligned(32)));
+    md5_vec in[16];
+    md5_vec sa, sb, sc, sd, a, b, c, d;
+    unsigned next = 0, active = 0, l, j;
+
+    for (l = 0; l < MD5_LANES; l++) {
+	if (next < count) {
+	    MD5LaneStart(&lanes[l], (const unsigned char *) bufs[next], lens[next],
+		out + MD5_HASHBYTES * next);
+	    next++;
+	    active++;
+	}
+	else
+	    lanes[l].out = 0;
+	sa[l] = iv[0];
+	sb[l] = iv[1];
+	sc[l] = iv[2];
+	sd[l] = iv[3];
+    }
+    while (active) {
+	/* Transpose one block of each lane into vectors of message words */
+	for (l = 0; l < MD5_LANES; l++) {
+	    const unsigned char *blk = lanes[l].out ? MD5LaneBlock(&lanes[l]) : idle;
+	    for (j = 0; j < 16; j++)
+		memcpy(&words[j][l], blk + 4 * j, 4);
+	}
+	for (j = 0; j < 16; j++)
+	    memcpy(&in[j], words[j], sizeof(md5_vec));
+	a = sa;
+	b = sb;
+	c = sc;
+	d = sd;
+	MD5ROUNDS(a, b, c, d, in);
+	sa += a;
+	sb += b;
+	sc += c;
+	sd += d;
+	/* Collect finished digests and start the waiting messages */
+	for (l = 0; l < MD5_LANES; l++) {
+	    MD5_LANE *lane = &lanes[l];
+	    if (!lane->out || lane->full || lane->left)
+		continue;
+	    u_int32_t res[4] = { sa[l], sb[l], sc[l], sd[l] };
+	    memcpy(lane->out, res, MD5_HASHBYTES);
+	    if (next < count) {
+		MD5LaneStart(lane, (const unsigned char *) bufs[next], lens[next],
+		    out + MD5_HASHBYTES * next);
+		next++;
+	    }
+	    else {
+		lane->out = 0;
+		active--;
+	    }
+	    sa[l] = iv[0];
+	    sb[l] = iv[1];
+	    sc[l] = iv[2];
+	    sd[l] = iv[3];
+	}
+    }
+}
+#endif
+
 // Yate's C++ wrapper routines start here
 
 using namespace TelEngine;
@@ -367,4 +507,30 @@ const unsigned char* MD5::rawDigest()
     return m_bin;
 }
 
+bool MD5::digestMany(unsigned char* out, const void* const* bufs,
+    const unsigned int* lens, unsigned int count)
+{
+    if (!count)
+	return true;
+    if (!(out && bufs && lens))
+	return false;
+    for (unsigned int i = 0; i < count; i++)
+	if (lens[i] && !bufs[i])
+	    return false;
+#ifdef MD5_MULTI_AVX2
+    if ((count > 1) && (Hasher::accelerated() & Hasher::AccelAvx2)) {
+	MD5ManyAvx2(out,bufs,lens,count);
+	return true;
+    }
+#endif
+    MD5_CTX ctx;
+    for (unsigned int i = 0; i < count; i++, out += MD5_HASHBYTES) {
+	MD5_Init(&ctx);
+	if (lens[i])
+	    MD5_Update(&ctx,(unsigned char const*)bufs[i],lens[i]);
+	MD5_Final(out,&ctx);
+    }
+    return true;
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
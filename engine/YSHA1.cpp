@@ -28,6 +28,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SHA1_SHA_NI
+#endif
+
 #if (defined(WORDS_BIGENDIAN) || defined(BIGENDIAN))
 #define be32_to_cpu(x) (x) /* Nothing */
 #define cpu_to_be32(x) (x)
@@ -121,6 +126,79 @@ static void sha1_transform(u_int32_t *state, const u_int8_t *in)
     memset (block32, 0x00, sizeof block32);
 }
 
+#ifdef SHA1_SHA_NI
+
+/* Four rounds using the SHA extensions, alternates between e0 and e1 */
+#define NI_RND4(ein,eout,m,f) \
+    ein = _mm_sha1nexte_epu32(ein,m); eout = abcd; abcd = _mm_sha1rnds4_epu32(abcd,ein,f)
+/* Rounds that also expand the message schedule */
+#define NI_RND4X(ein,eout,m,f,next,prev,prev2) \
+    NI_RND4(ein,eout,m,f); next = _mm_sha1msg2_epu32(next,m); \
+    prev = _mm_sha1msg1_epu32(prev,m); prev2 = _mm_xor_si128(prev2,m)
+
+/* Hash consecutive 512-bit blocks with the x86 SHA instructions */
+__attribute__((target("sha,sse4.1")))
+static void sha1_transform_ni(u_int32_t *state, const u_int8_t *in, unsigned int blocks)
+{
+    const __m128i swap = _mm_set_epi64x(0x0001020304050607LL,0x08090a0b0c0d0e0fLL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state),0x1B);
+    __m128i e0 = _mm_set_epi32(state[4],0,0,0);
+    __m128i e1, m0, m1, m2, m3;
+    for (; blocks; blocks--, in += 64) {
+	__m128i abcdSave = abcd;
+	__m128i eSave = e0;
+	m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in),swap);
+	m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 16)),swap);
+	m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 32)),swap);
+	m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 48)),swap);
+
+	e0 = _mm_add_epi32(e0,m0);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd,e0,0);
+	NI_RND4(e1,e0,m1,0); m0 = _mm_sha1msg1_epu32(m0,m1);
+	NI_RND4(e0,e1,m2,0); m1 = _mm_sha1msg1_epu32(m1,m2); m0 = _mm_xor_si128(m0,m2);
+	NI_RND4X(e1,e0,m3,0,m0,m2,m1);
+	NI_RND4X(e0,e1,m0,0,m1,m3,m2);
+	NI_RND4X(e1,e0,m1,1,m2,m0,m3);
+	NI_RND4X(e0,e1,m2,1,m3,m1,m0);
+	NI_RND4X(e1,e0,m3,1,m0,m2,m1);
+	NI_RND4X(e0,e1,m0,1,m1,m3,m2);
+	NI_RND4X(e1,e0,m1,1,m2,m0,m3);
+	NI_RND4X(e0,e1,m2,2,m3,m1,m0);
+	NI_RND4X(e1,e0,m3,2,m0,m2,m1);
+	NI_RND4X(e0,e1,m0,2,m1,m3,m2);
+	NI_RND4X(e1,e0,m1,2,m2,m0,m3);
+	NI_RND4X(e0,e1,m2,2,m3,m1,m0);
+	NI_RND4X(e1,e0,m3,3,m0,m2,m1);
+	NI_RND4X(e0,e1,m0,3,m1,m3,m2);
+	NI_RND4(e1,e0,m1,3); m2 = _mm_sha1msg2_epu32(m2,m1); m3 = _mm_xor_si128(m3,m1);
+	NI_RND4(e0,e1,m2,3); m3 = _mm_sha1msg2_epu32(m3,m2);
+	NI_RND4(e1,e0,m3,3);
+
+	e0 = _mm_sha1nexte_epu32(e0,eSave);
+	abcd = _mm_add_epi32(abcd,abcdSave);
+    }
+    _mm_storeu_si128((__m128i*)state,_mm_shuffle_epi32(abcd,0x1B));
+    state[4] = _mm_extract_epi32(e0,3);
+}
+
+#undef NI_RND4X
+#undef NI_RND4
+#endif
+
+/* Hash consecutive blocks with the fastest code available */
+static void sha1_blocks(u_int32_t *state, const u_int8_t *in, unsigned int blocks)
+{
+#ifdef SHA1_SHA_NI
+    if (TelEngine::Hasher::accelerated() & TelEngine::Hasher::AccelShaExt) {
+	sha1_transform_ni(state, in, blocks);
+	return;
+    }
+#endif
+    for (; blocks; blocks--, in += 64)
+	sha1_transform(state, in);
+}
+
 static void sha1_init(sha1_ctx *sctx)
 {
     static const sha1_ctx initstate = {
@@ -141,9 +219,11 @@ static void sha1_update(sha1_ctx *sctx, const u_int8_t *data, unsigned int len)
 
     if ((j + len) > 63) {
 	memcpy(&sctx->buffer[j], data, (i = 64-j));
-	sha1_transform(sctx->state, sctx->buffer);
-	for ( ; i + 63 < len; i += 64) {
-	    sha1_transform(sctx->state, &data[i]);
+	sha1_blocks(sctx->state, sctx->buffer, 1);
+	if (i + 63 < len) {
+	    unsigned int n = (len - i) >> 6;
+	    sha1_blocks(sctx->state, &data[i], n);
+	    i += n << 6;
 	}
 	j = 0;
     }
@@ -289,6 +369,26 @@ const unsigned char* SHA1::rawDigest()
     return m_bin;
 }
 
+bool SHA1::digestMany(unsigned char* out, const void* const* bufs,
+    const unsigned int* lens, unsigned int count)
+{
+    if (!count)
+	return true;
+    if (!(out && bufs && lens))
+	return false;
+    for (unsigned int i = 0; i < count; i++)
+	if (lens[i] && !bufs[i])
+	    return false;
+    sha1_ctx ctx;
+    for (unsigned int i = 0; i < count; i++, out += 20) {
+	sha1_init(&ctx);
+	if (lens[i])
+	    sha1_update(&ctx,(const u_int8_t*)bufs[i],lens[i]);
+	sha1_final(&ctx,out);
+    }
+    return true;
+}
+
 // NIST FIPS 186-2 change notice 1 PRF with 160 bit SHA1 function G(t,c)
 bool SHA1::fips186prf(DataBlock& out, const DataBlock& seed, unsigned int len)
 {
@@ -26,6 +26,11 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SHA256_SHA_NI
+#endif
+
 #define GET_UINT32(n,b,i)                       \
 {                                               \
     (n) = ( (uint32_t) (b)[(i)    ] << 24 )       \
@@ -196,6 +201,101 @@ static void sha256_process( context_sha256_t *ctx, const uint8_t data[64] )
   ctx->state[7] += H;
 }
 
+#ifdef SHA256_SHA_NI
+
+static const uint32_t sha256_k[64] =
+  {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+  };
+
+/* First and second pair of rounds for one group of 4 message words */
+#define NI_RND(m,i) \
+  msg = _mm_add_epi32(m, _mm_loadu_si128((const __m128i*)(sha256_k + 4 * i))); \
+  st1 = _mm_sha256rnds2_epu32(st1, st0, msg)
+#define NI_RND2 \
+  msg = _mm_shuffle_epi32(msg, 0x0E); \
+  st0 = _mm_sha256rnds2_epu32(st0, st1, msg)
+/* Rounds that also expand the message schedule */
+#define NI_RNDX(m,i,next,prev) \
+  NI_RND(m,i); \
+  next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(m, prev, 4)), m); \
+  NI_RND2
+
+/* Hash consecutive 512-bit blocks with the x86 SHA instructions */
+__attribute__((target("sha,sse4.1")))
+static void sha256_process_ni( uint32_t state[8], const uint8_t *data, uint32_t blocks )
+{
+  const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+  __m128i msg, m0, m1, m2, m3;
+  /* Reorder the state words as the instructions expect: ABEF and CDGH */
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0xB1);
+  __m128i st1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(state + 4)), 0x1B);
+  __m128i st0 = _mm_alignr_epi8(tmp, st1, 8);
+  st1 = _mm_blend_epi16(st1, tmp, 0xF0);
+
+  for( ; blocks; blocks--, data += 64 )
+    {
+      __m128i save0 = st0;
+      __m128i save1 = st1;
+      m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), swap);
+      m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), swap);
+      m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), swap);
+      m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), swap);
+
+      NI_RND(m0, 0); NI_RND2;
+      NI_RND(m1, 1); NI_RND2; m0 = _mm_sha256msg1_epu32(m0, m1);
+      NI_RND(m2, 2); NI_RND2; m1 = _mm_sha256msg1_epu32(m1, m2);
+      NI_RNDX(m3, 3, m0, m2); m2 = _mm_sha256msg1_epu32(m2, m3);
+      NI_RNDX(m0, 4, m1, m3); m3 = _mm_sha256msg1_epu32(m3, m0);
+      NI_RNDX(m1, 5, m2, m0); m0 = _mm_sha256msg1_epu32(m0, m1);
+      NI_RNDX(m2, 6, m3, m1); m1 = _mm_sha256msg1_epu32(m1, m2);
+      NI_RNDX(m3, 7, m0, m2); m2 = _mm_sha256msg1_epu32(m2, m3);
+      NI_RNDX(m0, 8, m1, m3); m3 = _mm_sha256msg1_epu32(m3, m0);
+      NI_RNDX(m1, 9, m2, m0); m0 = _mm_sha256msg1_epu32(m0, m1);
+      NI_RNDX(m2, 10, m3, m1); m1 = _mm_sha256msg1_epu32(m1, m2);
+      NI_RNDX(m3, 11, m0, m2); m2 = _mm_sha256msg1_epu32(m2, m3);
+      NI_RNDX(m0, 12, m1, m3); m3 = _mm_sha256msg1_epu32(m3, m0);
+      NI_RNDX(m1, 13, m2, m0);
+      NI_RNDX(m2, 14, m3, m1);
+      NI_RND(m3, 15); NI_RND2;
+
+      st0 = _mm_add_epi32(st0, save0);
+      st1 = _mm_add_epi32(st1, save1);
+    }
+
+  /* Back to ABCD and EFGH */
+  tmp = _mm_shuffle_epi32(st0, 0x1B);
+  st1 = _mm_shuffle_epi32(st1, 0xB1);
+  _mm_storeu_si128((__m128i*)state, _mm_blend_epi16(tmp, st1, 0xF0));
+  _mm_storeu_si128((__m128i*)(state + 4), _mm_alignr_epi8(st1, tmp, 8));
+}
+
+#undef NI_RNDX
+#undef NI_RND2
+#undef NI_RND
+#endif
+
+/* Hash consecutive blocks with the fastest code available */
+static void sha256_blocks( context_sha256_t *ctx, const uint8_t *data, uint32_t blocks )
+{
+#ifdef SHA256_SHA_NI
+  if( TelEngine::Hasher::accelerated() & TelEngine::Hasher::AccelShaExt )
+    {
+      sha256_process_ni( ctx->state, data, blocks );
+      return;
+    }
+#endif
+  for( ; blocks; blocks--, data += 64 )
+    sha256_process( ctx, data );
+}
+
 static void sha256_update( context_sha256_t *ctx, const uint8_t *input, uint32_t length )
 {
   uint32_t left, fill;
@@ -215,17 +315,18 @@ static void sha256_update( context_sha256_t *ctx, const uint8_t *input, uint32_t
     {
       memcpy( (void *) (ctx->buffer + left),
 	      (void *) input, fill );
-      sha256_process( ctx, ctx->buffer );
+      sha256_blocks( ctx, ctx->buffer, 1 );
       length -= fill;
       input  += fill;
       left = 0;
     }
 
-  while( length >= 64 )
+  if( length >= 64 )
     {
-      sha256_process( ctx, input );
-      length -= 64;
-      input  += 64;
+      uint32_t blocks = length >> 6;
+      sha256_blocks( ctx, input, blocks );
+      length -= blocks << 6;
+      input  += blocks << 6;
     }
 
   if( length )
@@ -370,4 +471,24 @@ const unsigned char* SHA256::rawDigest()
     return m_bin;
 }
 
+bool SHA256::digestMany(unsigned char* out, const void* const* bufs,
+    const unsigned int* lens, unsigned int count)
+{
+    if (!count)
+	return true;
+    if (!(out && bufs && lens))
+	return false;
+    for (unsigned int i = 0; i < count; i++)
+	if (lens[i] && !bufs[i])
+	    return false;
+    context_sha256_t ctx;
+    for (unsigned int i = 0; i < count; i++, out += 32) {
+	sha256_starts(&ctx);
+	if (lens[i])
+	    sha256_update(&ctx,(const uint8_t*)bufs[i],lens[i]);
+	sha256_finish(&ctx,(uint8_t*)out);
+    }
+    return true;
+}
+
 /* vi: set ts=8 sw=4 sts=4 noet: */
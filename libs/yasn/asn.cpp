@@ -21,6 +21,9 @@
 
 #include "yateasn.h"
 
+#include <string.h>
+#include <stdlib.h>
+
 using namespace TelEngine;
 
 static String s_libName = "ASNLib";
@@ -31,7 +34,7 @@ ASNLib::ASNLib()
 ASNLib::~ASNLib()
 {}
 
-int ASNLib::decodeLength(DataBlock& data) {
+int ASNLib::decodeLength(AsnCursor& data) {
 
     XDebug(s_libName.c_str(),DebugAll,"::decodeLength() - from data='%p'",&data);
     int length = 0;
@@ -87,7 +90,7 @@ DataBlock ASNLib::buildLength(DataBlock& data)
    return lenDb;
 }
 
-int ASNLib::matchEOC(DataBlock& data)
+int ASNLib::matchEOC(AsnCursor& data)
 {
     /**
      * EoC = 00 00
@@ -103,11 +106,10 @@ int ASNLib::matchEOC(DataBlock& data)
 }
 
 
-int ASNLib::parseUntilEoC(DataBlock& data, int length)
+int ASNLib::parseUntilEoC(AsnCursor& data, int length)
 {
-    if (length >= (int)data.length() || ASNLib::matchEOC(data) > 0)
-	return length;
-    while (data.length() && ASNLib::matchEOC(data) < 0) {
+    // only peek at the end of contents, the caller consumes it
+    while (data.length() && !(data.length() >= 2 && !data[0] && !data[1])) {
 	// compute tag portion length
 	AsnTag tag;
 	AsnTag::decode(tag,data);
@@ -135,7 +137,7 @@ int ASNLib::parseUntilEoC(DataBlock& data, int length)
     return length;
 }
 
-int ASNLib::decodeBoolean(DataBlock& data, bool* val, bool tagCheck)
+int ASNLib::decodeBoolean(AsnCursor& data, bool* val, bool tagCheck)
 {
     /**
      * boolean = 0x01 length byte (byte == 0 => false, byte != 0 => true)
@@ -180,7 +182,7 @@ int ASNLib::decodeBoolean(DataBlock& data, bool* val, bool tagCheck)
     return length;
 }
 
-int ASNLib::decodeInteger(DataBlock& data, u_int64_t& intVal, unsigned int bytes, bool tagCheck)
+int ASNLib::decodeInteger(AsnCursor& data, u_int64_t& intVal, unsigned int bytes, bool tagCheck)
 {
     /**
      * integer = 0x02 length byte {byte}*
@@ -233,7 +235,7 @@ int ASNLib::decodeInteger(DataBlock& data, u_int64_t& intVal, unsigned int bytes
     return length;
 }
 
-int ASNLib::decodeUINT8(DataBlock& data, u_int8_t* intVal, bool tagCheck)
+int ASNLib::decodeUINT8(AsnCursor& data, u_int8_t* intVal, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeUINT8()");
     u_int64_t val;
@@ -246,7 +248,7 @@ int ASNLib::decodeUINT8(DataBlock& data, u_int8_t* intVal, bool tagCheck)
     return l;
 }
 
-int ASNLib::decodeUINT16(DataBlock& data, u_int16_t* intVal, bool tagCheck)
+int ASNLib::decodeUINT16(AsnCursor& data, u_int16_t* intVal, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeUINT16() from data='%p'",&data);
     u_int64_t val;
@@ -259,7 +261,7 @@ int ASNLib::decodeUINT16(DataBlock& data, u_int16_t* intVal, bool tagCheck)
     return l;
 }
 
-int ASNLib::decodeUINT32(DataBlock& data, u_int32_t* intVal, bool tagCheck)
+int ASNLib::decodeUINT32(AsnCursor& data, u_int32_t* intVal, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeUINT32() from data='%p'",&data);
     u_int64_t val;
@@ -272,7 +274,7 @@ int ASNLib::decodeUINT32(DataBlock& data, u_int32_t* intVal, bool tagCheck)
     return l;
 }
 
-int ASNLib::decodeUINT64(DataBlock& data, u_int64_t* intVal, bool tagCheck)
+int ASNLib::decodeUINT64(AsnCursor& data, u_int64_t* intVal, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeUINT64() from data='%p'",&data);
     u_int64_t val;
@@ -285,7 +287,7 @@ int ASNLib::decodeUINT64(DataBlock& data, u_int64_t* intVal, bool tagCheck)
     return l;
 }
 
-int ASNLib::decodeINT8(DataBlock& data, int8_t* intVal, bool tagCheck)
+int ASNLib::decodeINT8(AsnCursor& data, int8_t* intVal, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeINT8() from data='%p'",&data);
     u_int64_t val;
@@ -298,7 +300,7 @@ int ASNLib::decodeINT8(DataBlock& data, int8_t* intVal, bool tagCheck)
     return l;
 }
 
-int ASNLib::decodeINT16(DataBlock& data, int16_t* intVal, bool tagCheck)
+int ASNLib::decodeINT16(AsnCursor& data, int16_t* intVal, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeINT16() from data='%p'",&data);
     u_int64_t val;
@@ -311,7 +313,7 @@ int ASNLib::decodeINT16(DataBlock& data, int16_t* intVal, bool tagCheck)
     return l;
 }
 
-int ASNLib::decodeINT32(DataBlock& data, int32_t* intVal, bool tagCheck)
+int ASNLib::decodeINT32(AsnCursor& data, int32_t* intVal, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeINT32() from data='%p'",&data);
     u_int64_t val;
@@ -324,7 +326,7 @@ int ASNLib::decodeINT32(DataBlock& data, int32_t* intVal, bool tagCheck)
     return l;
 }
 
-int ASNLib::decodeINT64(DataBlock& data, int64_t* intVal, bool tagCheck)
+int ASNLib::decodeINT64(AsnCursor& data, int64_t* intVal, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeINT64() from data='%p'",&data);
     u_int64_t val;
@@ -337,7 +339,7 @@ int ASNLib::decodeINT64(DataBlock& data, int64_t* intVal, bool tagCheck)
     return l;
 }
 
-int ASNLib::decodeBitString(DataBlock& data, String* val, bool tagCheck)
+int ASNLib::decodeBitString(AsnCursor& data, String* val, bool tagCheck)
 {
     /**
      * bitstring ::= 0x03 asnlength unusedBytes {byte}*
@@ -398,7 +400,7 @@ int ASNLib::decodeBitString(DataBlock& data, String* val, bool tagCheck)
     return length;
 }
 
-int ASNLib::decodeOctetString(DataBlock& db, OctetString* strVal, bool tagCheck)
+int ASNLib::decodeOctetString(AsnCursor& db, OctetString* strVal, bool tagCheck)
 {
     /**
      *  octet string ::= 0x04 asnlength {byte}*
@@ -439,7 +441,7 @@ int ASNLib::decodeOctetString(DataBlock& db, OctetString* strVal, bool tagCheck)
     return length;
 }
 
-int ASNLib::decodeNull(DataBlock& data, bool tagCheck)
+int ASNLib::decodeNull(AsnCursor& data, bool tagCheck)
 {
     /**
      * ASN.1 null := 0x05 00
@@ -465,7 +467,7 @@ int ASNLib::decodeNull(DataBlock& data, bool tagCheck)
     return length;
 }
 
-int ASNLib::decodeOID(DataBlock& data, ASNObjId* obj, bool tagCheck)
+int ASNLib::decodeOID(AsnCursor& data, ASNObjId* obj, bool tagCheck)
 {
    /**
     * ASN.1 objid ::= 0x06 asnlength subidentifier {subidentifier}*
@@ -546,7 +548,7 @@ int ASNLib::decodeOID(DataBlock& data, ASNObjId* obj, bool tagCheck)
     return length;
 }
 
-int ASNLib::decodeReal(DataBlock& db, float* realVal, bool tagCheck)
+int ASNLib::decodeReal(AsnCursor& db, float* realVal, bool tagCheck)
 {
     if (db.length() < 2)
 	return InvalidLengthOrTag;
@@ -573,7 +575,7 @@ int ASNLib::decodeReal(DataBlock& db, float* realVal, bool tagCheck)
     return 0;
 }
 
-int ASNLib::decodeString(DataBlock& data, String* str, int* type, bool tagCheck)
+int ASNLib::decodeString(AsnCursor& data, String* str, int* type, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeString() from data='%p'",&data);
     if (data.length() < 2)
@@ -622,7 +624,7 @@ int ASNLib::decodeString(DataBlock& data, String* str, int* type, bool tagCheck)
 }
 
 
-int ASNLib::decodeUtf8(DataBlock& data, String* str, bool tagCheck)
+int ASNLib::decodeUtf8(AsnCursor& data, String* str, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeUtf8() from data='%p'",&data);
     if (data.length() < 2)
@@ -665,7 +667,7 @@ int ASNLib::decodeUtf8(DataBlock& data, String* str, bool tagCheck)
     return length;
 }
 
-int ASNLib::decodeGenTime(DataBlock& data, unsigned int* time, unsigned int* fractions, bool* utc, bool tagCheck)
+int ASNLib::decodeGenTime(AsnCursor& data, unsigned int* time, unsigned int* fractions, bool* utc, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeGenTime() from data='%p'",&data);
     if (data.length() < 2)
@@ -761,7 +763,7 @@ int ASNLib::decodeGenTime(DataBlock& data, unsigned int* time, unsigned int* fra
     return length;
 }
 
-int ASNLib::decodeUTCTime(DataBlock& data, unsigned int* time, bool tagCheck)
+int ASNLib::decodeUTCTime(AsnCursor& data, unsigned int* time, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeUTCTime() from data='%p'",&data);
     if (data.length() < 2)
@@ -855,7 +857,7 @@ int ASNLib::decodeAny(DataBlock data, DataBlock* val, bool tagCheck)
     return data.length();
 }
 
-int ASNLib::decodeSequence(DataBlock& data, bool tagCheck)
+int ASNLib::decodeSequence(AsnCursor& data, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeSequence() from data='%p'",&data);
     if (data.length() < 2)
@@ -879,7 +881,7 @@ int ASNLib::decodeSequence(DataBlock& data, bool tagCheck)
     return length;
 }
 
-int ASNLib::decodeSet(DataBlock& data, bool tagCheck)
+int ASNLib::decodeSet(AsnCursor& data, bool tagCheck)
 {
     XDebug(s_libName.c_str(),DebugAll,"::decodeSet() from data='%p",&data);
     if (data.length() < 2)
@@ -904,6 +906,199 @@ int ASNLib::decodeSet(DataBlock& data, bool tagCheck)
     return length;
 }
 
+// Decoders working on a DataBlock walk it with a cursor and cut the consumed data once
+int ASNLib::decodeLength(DataBlock& data)
+{
+    AsnCursor cursor(data);
+    int ret = decodeLength(cursor);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::matchEOC(DataBlock& data)
+{
+    AsnCursor cursor(data);
+    int ret = matchEOC(cursor);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::parseUntilEoC(DataBlock& data, int length)
+{
+    AsnCursor cursor(data);
+    int ret = parseUntilEoC(cursor,length);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeBoolean(DataBlock& data, bool* val, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeBoolean(cursor,val,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeInteger(DataBlock& data, u_int64_t& intVal, unsigned int bytes, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeInteger(cursor,intVal,bytes,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeUINT8(DataBlock& data, u_int8_t* intVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeUINT8(cursor,intVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeUINT16(DataBlock& data, u_int16_t* intVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeUINT16(cursor,intVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeUINT32(DataBlock& data, u_int32_t* intVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeUINT32(cursor,intVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeUINT64(DataBlock& data, u_int64_t* intVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeUINT64(cursor,intVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeINT8(DataBlock& data, int8_t* intVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeINT8(cursor,intVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeINT16(DataBlock& data, int16_t* intVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeINT16(cursor,intVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeINT32(DataBlock& data, int32_t* intVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeINT32(cursor,intVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeINT64(DataBlock& data, int64_t* intVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeINT64(cursor,intVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeBitString(DataBlock& data, String* val, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeBitString(cursor,val,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeOctetString(DataBlock& data, OctetString* strVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeOctetString(cursor,strVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeNull(DataBlock& data, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeNull(cursor,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeOID(DataBlock& data, ASNObjId* obj, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeOID(cursor,obj,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeReal(DataBlock& data, float* realVal, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeReal(cursor,realVal,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeString(DataBlock& data, String* str, int* type, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeString(cursor,str,type,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeUtf8(DataBlock& data, String* str, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeUtf8(cursor,str,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeGenTime(DataBlock& data, unsigned int* time, unsigned int* fractions, bool* utc, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeGenTime(cursor,time,fractions,utc,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeUTCTime(DataBlock& data, unsigned int* time, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeUTCTime(cursor,time,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeSequence(DataBlock& data, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeSequence(cursor,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
+int ASNLib::decodeSet(DataBlock& data, bool tagCheck)
+{
+    AsnCursor cursor(data);
+    int ret = decodeSet(cursor,tagCheck);
+    data.cut(-(int)cursor.consumed());
+    return ret;
+}
+
 DataBlock ASNLib::encodeBoolean(bool val, bool tagCheck)
 {
     /**
@@ -1236,7 +1431,7 @@ int ASNLib::encodeSet(DataBlock& data, bool tagCheck)
 /**
   * AsnTag
   */
-void AsnTag::decode(AsnTag& tag, DataBlock& data)
+void AsnTag::decode(AsnTag& tag, const AsnCursor& data)
 {
     XDebug(s_libName.c_str(),DebugAll,"AsnTag::decode()");
     tag.classType((Class)(data[0] & 0xc0));
@@ -1258,6 +1453,11 @@ void AsnTag::decode(AsnTag& tag, DataBlock& data)
     tag.encode();
 }
 
+void AsnTag::decode(AsnTag& tag, DataBlock& data)
+{
+    decode(tag,AsnCursor(data));
+}
+
 void AsnTag::encode(Class clas, Type type, unsigned int code, DataBlock& data)
 {
     XDebug(s_libName.c_str(),DebugAll,"AsnTag::encode(clas=0x%x, type=0x%x, code=%u)",clas,type,code);
@@ -1301,6 +1501,149 @@ void AsnTag::encode(Class clas, Type type, unsigned int code, DataBlock& data)
 #endif
 }
 
+/**
+  * AsnWriter
+  */
+AsnWriter::AsnWriter(unsigned int size)
+    : m_buffer(0), m_size(size ? size : 16), m_pos(0)
+{
+    m_buffer = static_cast<unsigned char*>(::malloc(m_size));
+    m_pos = m_size;
+}
+
+AsnWriter::~AsnWriter()
+{
+    ::free(m_buffer);
+}
+
+// Reallocate so at least len more bytes fit in front of the current data
+void AsnWriter::grow(unsigned int len)
+{
+    unsigned int used = length();
+    unsigned int size = m_size * 2;
+    if (size < used + len)
+	size = used + len + m_size;
+    unsigned char* buf = static_cast<unsigned char*>(::malloc(size));
+    if (!buf) {
+	Debug(s_libName.c_str(),DebugFail,"AsnWriter failed to allocate %u bytes",size);
+	return;
+    }
+    ::memcpy(buf + size - used,m_buffer + m_pos,used);
+    ::free(m_buffer);
+    m_buffer = buf;
+    m_size = size;
+    m_pos = size - used;
+}
+
+void AsnWriter::prepend(const void* data, unsigned int len)
+{
+    if (!(data && len))
+	return;
+    if (m_pos < len)
+	grow(len);
+    if (m_pos < len)
+	return;
+    m_pos -= len;
+    ::memcpy(m_buffer + m_pos,data,len);
+}
+
+void AsnWriter::prependByte(u_int8_t value)
+{
+    if (!m_pos)
+	grow(1);
+    if (m_pos)
+	m_buffer[--m_pos] = value;
+}
+
+unsigned int AsnWriter::prependLength(unsigned int len)
+{
+    if (len < ASN_LONG_LENGTH) {
+	prependByte(len);
+	return 1;
+    }
+    unsigned int n = 0;
+    while (len > 0) {
+	prependByte(len & 0xff);
+	len >>= 8;
+	n++;
+    }
+    prependByte(ASN_LONG_LENGTH | n);
+    return n + 1;
+}
+
+unsigned int AsnWriter::close(unsigned int mark, const AsnTag& tag)
+{
+    unsigned int n = prependLength(length() - mark);
+    prepend(tag.coding());
+    return n + tag.coding().length();
+}
+
+unsigned int AsnWriter::close(unsigned int mark, u_int8_t tag)
+{
+    unsigned int n = prependLength(length() - mark);
+    prependByte(tag);
+    return n + 1;
+}
+
+unsigned int AsnWriter::writeBoolean(bool val, bool tagCheck)
+{
+    prependByte(val ? 1 : 0);
+    if (!tagCheck)
+	return 1;
+    prependByte(1);
+    prependByte(ASNLib::BOOLEAN);
+    return 3;
+}
+
+unsigned int AsnWriter::writeInteger(u_int64_t intVal, bool tagCheck)
+{
+    // same minimal two's complement form as ASNLib::encodeInteger()
+    int size = sizeof(u_int64_t);
+    uint16_t msb = (uint16_t)(intVal >> ((size - 1) * 8 - 1));
+    while (((msb & 0x1FF) == 0 || (msb & 0x1FF) == 0x1FF) && (size - 1 >= 1)) {
+	size--;
+	msb = (uint16_t)(intVal >> ((size - 1) * 8 - 1));
+    }
+    unsigned int mark = length();
+    for (int i = 0; i < size; i++)
+	prependByte((u_int8_t)(intVal >> (i * 8)));
+    if (tagCheck)
+	close(mark,(u_int8_t)ASNLib::INTEGER);
+    return length() - mark;
+}
+
+unsigned int AsnWriter::writeOctetString(const void* data, unsigned int len, bool tagCheck)
+{
+    unsigned int mark = length();
+    prepend(data,len);
+    if (tagCheck)
+	close(mark,(u_int8_t)ASNLib::OCTET_STRING);
+    return length() - mark;
+}
+
+unsigned int AsnWriter::writeNull(bool tagCheck)
+{
+    if (!tagCheck)
+	return 0;
+    prependByte(0);
+    prependByte(ASNLib::NULL_ID);
+    return 2;
+}
+
+void AsnWriter::appendTo(DataBlock& dest) const
+{
+    dest.append((void*)data(),length());
+}
+
+void AsnWriter::insertTo(DataBlock& dest) const
+{
+    if (!length())
+	return;
+    DataBlock tmp((void*)data(),length(),false);
+    dest.insert(tmp);
+    tmp.clear(false);
+}
+
 /**
   * ASNObjId
   */
@@ -492,6 +492,129 @@ private:
     DataBlock m_ids;
 };
 
+/**
+ * Read-only view over a block of ASN.1 encoded data. It only keeps a pointer
+ *  and the number of bytes left so elements are consumed by advancing over the
+ *  input instead of reallocating it. The cursor does not own the data, the
+ *  buffer must stay unchanged while the cursor is used.
+ * The read methods mirror the ones of DataBlock.
+ * @short Zero-copy read cursor for BER/DER decoding
+ */
+class YASN_API AsnCursor
+{
+public:
+    /**
+     * Constructor of an empty cursor
+     */
+    inline AsnCursor()
+	: m_data(0), m_length(0), m_consumed(0)
+	{ }
+
+    /**
+     * Constructor
+     * @param data Pointer to the encoded data
+     * @param len Number of bytes available at data
+     */
+    inline AsnCursor(const void* data, unsigned int len)
+	: m_data(static_cast<const unsigned char*>(data)), m_length(data ? len : 0), m_consumed(0)
+	{ }
+
+    /**
+     * Constructor of a cursor walking the whole content of a data block
+     * @param data Data block holding the encoded data
+     */
+    explicit inline AsnCursor(const DataBlock& data)
+	: m_data(static_cast<const unsigned char*>(data.data())), m_length(data.length()), m_consumed(0)
+	{ }
+
+    /**
+     * Get a pointer to the data not yet consumed
+     * @return A pointer to the data or NULL if nothing is left
+     */
+    inline void* data() const
+	{ return m_length ? (void*)m_data : 0; }
+
+    /**
+     * Get a pointer to a byte range inside the data not yet consumed
+     * @param offs Byte offset from the current position
+     * @param len Number of bytes that must be valid starting at offset
+     * @return A pointer to the data or NULL if the range is not available
+     */
+    inline unsigned char* data(unsigned int offs, unsigned int len = 1) const
+	{ return (offs + len <= m_length) ? const_cast<unsigned char*>(m_data + offs) : 0; }
+
+    /**
+     * Get the value of a single byte
+     * @param offs Byte offset from the current position
+     * @param defvalue Default value to return if offset is outside data
+     * @return Byte value at offset (0-255) or defvalue if offset outside data
+     */
+    inline int at(unsigned int offs, int defvalue = -1) const
+	{ return (offs < m_length) ? m_data[offs] : defvalue; }
+
+    /**
+     * Byte indexing operator with signed parameter
+     * @param index Index of the byte to retrieve
+     * @return Byte value at index (0-255) or -1 if index outside data
+     */
+    inline int operator[](signed int index) const
+	{ return at(index); }
+
+    /**
+     * Byte indexing operator with unsigned parameter
+     * @param index Index of the byte to retrieve
+     * @return Byte value at index (0-255) or -1 if index outside data
+     */
+    inline int operator[](unsigned int index) const
+	{ return at(index); }
+
+    /**
+     * Get the number of bytes not yet consumed
+     * @return Length of the remaining data
+     */
+    inline unsigned int length() const
+	{ return m_length; }
+
+    /**
+     * Get the number of bytes consumed from the front since the cursor was built
+     * @return Count of bytes skipped
+     */
+    inline unsigned int consumed() const
+	{ return m_consumed; }
+
+    /**
+     * Consume data from the front or drop it from the end, no data is moved
+     * @param len Number of bytes to skip from the front if negative,
+     *  number of bytes to drop from the end if positive
+     */
+    inline void cut(int len)
+    {
+	if (len < 0) {
+	    unsigned int n = -len;
+	    if (n > m_length)
+		n = m_length;
+	    m_data += n;
+	    m_length -= n;
+	    m_consumed += n;
+	}
+	else
+	    m_length = ((unsigned int)len < m_length) ? m_length - len : 0;
+    }
+
+    /**
+     * Build a cursor over the first bytes of the remaining data
+     * @param len Maximum number of bytes the new cursor will cover
+     * @return A cursor over at most len bytes starting at the current position
+     */
+    inline AsnCursor head(unsigned int len) const
+	{ return AsnCursor(m_data,(len < m_length) ? len : m_length); }
+
+private:
+    const unsigned char* m_data;
+    unsigned int m_length;
+    unsigned int m_consumed;
+};
+
 /**
  * Class AsnTag
  * @short Class for ASN.1 tags
@@ -548,6 +671,13 @@ public:
      */
     static void decode(AsnTag& tag, DataBlock& data);
 
+    /**
+     * Decode an ASN.1 tag from the current position of a cursor
+     * @param tag Tag to fill
+     * @param data Cursor from which the tag should be filled, it is not advanced
+     */
+    static void decode(AsnTag& tag, const AsnCursor& data);
+
     /**
      * Encode an ASN.1 tag and put the encoded form into the given data
      * @param clas Class of the tag
@@ -919,6 +1049,203 @@ public:
      */
     static int decodeSet(DataBlock& data, bool tagCheck);
 
+    /**
+     * Decode the length of an ASN.1 element and advance the cursor past it
+     * @param data Cursor from which to extract the length
+     * @return The length of the element contents, negative error code if it couldn't be decoded
+     */
+    static int decodeLength(AsnCursor& data);
+
+    /**
+     * Decode a boolean value and advance the cursor past it
+     * @param data Cursor from which the boolean value should be extracted
+     * @param val Pointer to a boolean to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for boolean (0x01)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeBoolean(AsnCursor& data, bool* val, bool tagCheck);
+
+    /**
+     * Decode an integer value and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param bytes Width of the decoded integer field
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeInteger(AsnCursor& data, u_int64_t& intVal, unsigned int bytes, bool tagCheck);
+
+    /**
+     * Decode an unsigned 8 bit integer and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeUINT8(AsnCursor& data, u_int8_t* intVal, bool tagCheck);
+
+    /**
+     * Decode an unsigned 16 bit integer and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeUINT16(AsnCursor& data, u_int16_t* intVal, bool tagCheck);
+
+    /**
+     * Decode an unsigned 32 bit integer and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeUINT32(AsnCursor& data, u_int32_t* intVal, bool tagCheck);
+
+    /**
+     * Decode an unsigned 64 bit integer and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeUINT64(AsnCursor& data, u_int64_t* intVal, bool tagCheck);
+
+    /**
+     * Decode a signed 8 bit integer and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeINT8(AsnCursor& data, int8_t* intVal, bool tagCheck);
+
+    /**
+     * Decode a signed 16 bit integer and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeINT16(AsnCursor& data, int16_t* intVal, bool tagCheck);
+
+    /**
+     * Decode a signed 32 bit integer and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeINT32(AsnCursor& data, int32_t* intVal, bool tagCheck);
+
+    /**
+     * Decode a signed 64 bit integer and advance the cursor past it
+     * @param data Cursor from which the integer value should be extracted
+     * @param intVal Integer to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for integer (0x02)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeINT64(AsnCursor& data, int64_t* intVal, bool tagCheck);
+
+    /**
+     * Decode a bitstring value and advance the cursor past it
+     * @param data Cursor from which the bitstring value should be extracted
+     * @param val String to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for bitstring (0x03)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeBitString(AsnCursor& data, String* val, bool tagCheck);
+
+    /**
+     * Decode an octet string value and advance the cursor past it
+     * @param data Cursor from which the octet string should be extracted
+     * @param strVal OctetString to be filled with a copy of the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for octet string (0x04)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeOctetString(AsnCursor& data, OctetString* strVal, bool tagCheck);
+
+    /**
+     * Decode a null value and advance the cursor past it
+     * @param data Cursor from which the null value should be extracted
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for null (0x05)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeNull(AsnCursor& data, bool tagCheck);
+
+    /**
+     * Decode an object id value and advance the cursor past it
+     * @param data Cursor from which the OID value should be extracted
+     * @param obj ASNObjId to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for OID (0x06)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeOID(AsnCursor& data, ASNObjId* obj, bool tagCheck);
+
+    /**
+     * Skip over a real value - decoding not implemented
+     * @param data Cursor from which the real value should be extracted
+     * @param realVal Float to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag for real (0x09)
+     * @return 0 if the value was skipped, negative error code on failure
+     */
+    static int decodeReal(AsnCursor& data, float* realVal, bool tagCheck);
+
+    /**
+     * Decode a NumericString, PrintableString, VisibleString or IA5String and advance the cursor past it
+     * @param data Cursor from which the string value should be extracted
+     * @param str String to be filled with the decoded value
+     * @param type Integer to be filled with the value indicating which type of string has been decoded
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeString(AsnCursor& data, String* str, int* type, bool tagCheck);
+
+    /**
+     * Decode an UTF8 string and advance the cursor past it
+     * @param data Cursor from which the string value should be extracted
+     * @param str String to be filled with the decoded value
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag (0x0c)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeUtf8(AsnCursor& data, String* str, bool tagCheck);
+
+    /**
+     * Decode a GeneralizedTime value and advance the cursor past it
+     * @param data Cursor from which the value should be extracted
+     * @param time Integer to be filled with time in seconds since epoch
+     * @param fractions Integer to be filled with fractions of a second
+     * @param utc Flag indicating if the decode time value represent local time or UTC time
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag (0x18)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeGenTime(AsnCursor& data, unsigned int* time, unsigned int* fractions, bool* utc, bool tagCheck);
+
+    /**
+     * Decode a UTC time value and advance the cursor past it
+     * @param data Cursor from which the value should be extracted
+     * @param time Integer to be filled with time in seconds since epoch
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag (0x17)
+     * @return Length of the decoded contents, negative error code on failure
+     */
+    static int decodeUTCTime(AsnCursor& data, unsigned int* time, bool tagCheck);
+
+    /**
+     * Decode the header (tag and length) of a sequence and advance the cursor past it
+     * @param data Cursor from which the header should be extracted
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag (0x30)
+     * @return Length of the sequence contents, negative error code on failure
+     */
+    static int decodeSequence(AsnCursor& data, bool tagCheck);
+
+    /**
+     * Decode the header (tag and length) of a set and advance the cursor past it
+     * @param data Cursor from which the header should be extracted
+     * @param tagCheck Flag for verifying the presence of the ASN.1 tag (0x31)
+     * @return Length of the set contents, negative error code on failure
+     */
+    static int decodeSet(AsnCursor& data, bool tagCheck);
+
     /**
      * Encode the length of the given data
      * @param data The data for which the length should be encoded
@@ -1053,6 +1380,173 @@ public:
      * @return Length until End Of Contents
      */
     static int parseUntilEoC(DataBlock& data, int length = 0);
+
+    /**
+     * Verify a cursor for End Of Contents presence and advance past it if found
+     * @param data Cursor to verify
+     * @return 2 if End Of Contents was matched, -1 otherwise
+     */
+    static int matchEOC(AsnCursor& data);
+
+    /**
+     * Advance a cursor until an End Of Contents is found
+     * @param data Cursor for which to determine the length to End Of Contents
+     * @param length Length to which to add determined length
+     * @return Length until End Of Contents
+     */
+    static int parseUntilEoC(AsnCursor& data, int length = 0);
+};
+
+/**
+ * Encoder that fills a preallocated buffer from the end towards the start.
+ * Contents are written first and their length and tag are prepended after,
+ *  so closing a constructed element never moves the data already encoded.
+ * Elements must therefore be written in reverse order.
+ * @short Back-to-front BER/DER encoder
+ */
+class YASN_API AsnWriter
+{
+    YNOCOPY(AsnWriter); // no automatic copies please
+public:
+    /**
+     * Constructor
+     * @param size Initial buffer size, the buffer grows if more room is needed
+     */
+    explicit AsnWriter(unsigned int size = 256);
+
+    /**
+     * Destructor, releases the buffer
+     */
+    ~AsnWriter();
+
+    /**
+     * Get the encoded data
+     * @return Pointer to the first byte of the encoding
+     */
+    inline const unsigned char* data() const
+	{ return m_buffer + m_pos; }
+
+    /**
+     * Get the length of the encoded data
+     * @return Number of bytes written so far
+     */
+    inline unsigned int length() const
+	{ return m_size - m_pos; }
+
+    /**
+     * Remember the current position before writing the contents of a constructed element
+     * @return Position to be given later to close()
+     */
+    inline unsigned int mark() const
+	{ return length(); }
+
+    /**
+     * Drop everything written after a mark
+     * @param mark Value returned by mark()
+     */
+    inline void reset(unsigned int mark)
+	{ if (mark <= length()) m_pos = m_size - mark; }
+
+    /**
+     * Discard all encoded data, the buffer is kept for reuse
+     */
+    inline void clear()
+	{ m_pos = m_size; }
+
+    /**
+     * Prepend raw bytes
+     * @param data Pointer to the bytes to write
+     * @param len Number of bytes to write
+     */
+    void prepend(const void* data, unsigned int len);
+
+    /**
+     * Prepend the content of a data block
+     * @param data Data block to write
+     */
+    inline void prepend(const DataBlock& data)
+	{ prepend(data.data(),data.length()); }
+
+    /**
+     * Prepend a single byte
+     * @param value Byte to write
+     */
+    void prependByte(u_int8_t value);
+
+    /**
+     * Prepend the definite form encoding of a length
+     * @param len Length value to encode
+     * @return Number of bytes used by the length encoding
+     */
+    unsigned int prependLength(unsigned int len);
+
+    /**
+     * Prepend the length and the tag of a constructed or primitive element whose
+     *  contents were written since the given mark
+     * @param mark Value returned by mark() before writing the contents
+     * @param tag Tag of the element
+     * @return Number of bytes used by the length and tag
+     */
+    unsigned int close(unsigned int mark, const AsnTag& tag);
+
+    /**
+     * Prepend the length and a single byte tag of an element whose contents
+     *  were written since the given mark
+     * @param mark Value returned by mark() before writing the contents
+     * @param tag Encoded single byte tag
+     * @return Number of bytes used by the length and tag
+     */
+    unsigned int close(unsigned int mark, u_int8_t tag);
+
+    /**
+     * Prepend a boolean value, same encoding as ASNLib::encodeBoolean()
+     * @param val The boolean value to encode
+     * @param tagCheck True to write the tag and length too
+     * @return Number of bytes written
+     */
+    unsigned int writeBoolean(bool val, bool tagCheck);
+
+    /**
+     * Prepend an integer value, same encoding as ASNLib::encodeInteger()
+     * @param intVal The integer value to encode
+     * @param tagCheck True to write the tag and length too
+     * @return Number of bytes written
+     */
+    unsigned int writeInteger(u_int64_t intVal, bool tagCheck);
+
+    /**
+     * Prepend an octet string value
+     * @param data Pointer to the octets
+     * @param len Number of octets
+     * @param tagCheck True to write the tag and length too
+     * @return Number of bytes written
+     */
+    unsigned int writeOctetString(const void* data, unsigned int len, bool tagCheck);
+
+    /**
+     * Prepend a null value
+     * @param tagCheck True to write the tag and length, nothing is written otherwise
+     * @return Number of bytes written
+     */
+    unsigned int writeNull(bool tagCheck);
+
+    /**
+     * Append the encoded data to a data block
+     * @param dest Destination data block
+     */
+    void appendTo(DataBlock& dest) const;
+
+    /**
+     * Insert the encoded data at the start of a data block
+     * @param dest Destination data block
+     */
+    void insertTo(DataBlock& dest) const;
+
+private:
+    void grow(unsigned int len);
+    unsigned char* m_buffer;
+    unsigned int m_size;
+    unsigned int m_pos;
 };
 
 }
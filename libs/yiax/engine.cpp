@@ -33,6 +33,12 @@ using namespace TelEngine;
 #define IAX2_CALLTOKEN_CALLNO 1
 // Minimum value for local call numbers
 #define IAX2_MIN_CALLNO 2
+// Number of available local call numbers
+#define IAX2_CALLNO_COUNT (IAX2_MAX_CALLNO - IAX2_MIN_CALLNO + 1)
+
+// Transaction timer wheel: number of slots and slot duration in microseconds
+#define IAX2_SCHED_SLOTS 1024
+#define IAX2_SCHED_TICK 10000
 
 // Outgoing data adjust timestamp defaults
 #define IAX2_ADJUSTTSOUT_THRES 120
@@ -57,10 +63,12 @@ IAXEngine::IAXEngine(const char* iface, int port, u_int32_t format, u_int32_t ca
     : Mutex(true,"IAXEngine"),
     m_trunking(0),
     m_name(name),
-    m_lastGetEvIndex(0),
+    m_freeCallNoHead(0),
+    m_freeCallNoCount(0),
+    m_schedMutex(false,"IAXEngine::Sched"),
+    m_sched(IAX2_SCHED_SLOTS,IAX2_SCHED_TICK,Time::now()),
     m_exiting(false),
     m_maxFullFrameDataLen(1400),
-    m_startLocalCallNo(0),
     m_transListCount(64),
     m_challengeTout(IAX2_CHALLENGETOUT_DEF),
     m_callToken(false),
@@ -91,15 +99,18 @@ IAXEngine::IAXEngine(const char* iface, int port, u_int32_t format, u_int32_t ca
     m_transList = new ObjList*[m_transListCount];
     for (unsigned int i = 0; i < m_transListCount; i++)
 	m_transList[i] = new ObjList;
-    for(unsigned int i = 0; i <= IAX2_MAX_CALLNO; i++)
-	m_lUsedCallNo[i] = false;
+    ::memset(m_usedCallNo,0,sizeof(m_usedCallNo));
     if (!m_callTokenSecret)
 	for (unsigned int i = 0; i < 3; i++)
 	    m_callTokenSecret << (int)(Random::random() ^ Time::now());
     bind(iface,port,forceBind);
-    m_startLocalCallNo = 1 + (u_int16_t)(Random::random() % IAX2_MAX_CALLNO);
-    if (m_startLocalCallNo < IAX2_MIN_CALLNO)
-	m_startLocalCallNo = IAX2_MIN_CALLNO;
+    // Fill the free call numbers list starting from a random value
+    unsigned int callNo = IAX2_MIN_CALLNO + (Random::random() % IAX2_CALLNO_COUNT);
+    for (; m_freeCallNoCount < IAX2_CALLNO_COUNT; m_freeCallNoCount++) {
+	m_freeCallNo[m_freeCallNoCount] = callNo++;
+	if (callNo > IAX2_MAX_CALLNO)
+	    callNo = IAX2_MIN_CALLNO;
+    }
     initialize(params ? *params : NamedList::empty());
 }
 
@@ -108,6 +119,7 @@ IAXEngine::~IAXEngine()
     for (int i = 0; i < m_transListCount; i++)
 	TelEngine::destruct(m_transList[i]);
     delete[] m_transList;
+    m_incompleteTransList.clear();
 }
 
 IAXTransaction* IAXEngine::addFrame(const SocketAddr& addr, IAXFrame* frame)
@@ -221,8 +233,10 @@ IAXTransaction* IAXEngine::addFrame(const SocketAddr& addr, IAXFrame* frame)
     if (lcn) {
 	// Create and add transaction
 	tr = IAXTransaction::factoryIn(this,full,lcn,addr);
-	if (tr)
+	if (tr) {
 	    m_transList[frame->sourceCallNo() % m_transListCount]->append(tr);
+	    scheduleTransaction(tr);
+	}
 	else
 	    releaseCallNo(lcn);
     }
@@ -470,6 +484,7 @@ void IAXEngine::removeTransaction(IAXTransaction* transaction)
 {
     if (!transaction)
 	return;
+    unscheduleTransaction(transaction);
     Lock lock(this);
     releaseCallNo(transaction->localCallNo());
     if (!m_incompleteTransList.remove(transaction,false)) {
@@ -581,78 +596,78 @@ void IAXEngine::processEvent(IAXEvent* event)
     delete event;
 }
 
-IAXEvent* IAXEngine::getEvent(const Time& now)
+// Schedule a transaction to be checked at given time or as soon as possible
+void IAXEngine::scheduleTransaction(IAXTransaction* trans, u_int64_t when)
 {
-    IAXTransaction* tr;
-    IAXEvent* ev;
-    ObjList* l;
+    if (!trans)
+	return;
+    Lock lck(m_schedMutex);
+    m_sched.schedule(trans->m_schedEntry,when);
+}
 
-    lock();
-    // Find for incomplete transactions
-    l = m_incompleteTransList.skipNull();
-    for (; l; l = l->next()) {
-	if (Thread::check(false))
-	    break;
-	tr = static_cast<IAXTransaction*>(l->get());
-	if (tr && 0 != (ev = tr->getEvent(now))) {
-	    unlock();
-	    return ev;
-	}
-    }
-    // Find for complete transactions, start with current index
-    while (m_lastGetEvIndex < m_transListCount) {
-	if (Thread::check(false))
+// Remove a transaction from ready list and timer wheel
+void IAXEngine::unscheduleTransaction(IAXTransaction* trans)
+{
+    if (!trans)
+	return;
+    Lock lck(m_schedMutex);
+    m_sched.cancel(trans->m_schedEntry);
+}
+
+IAXEvent* IAXEngine::getEvent(const Time& now)
+{
+    Lock lck(m_schedMutex);
+    // Move transactions from elapsed timer wheel slots to ready list
+    m_sched.advance(now);
+    while (!Thread::check(false)) {
+	IAXTransaction* tr = static_cast<IAXTransaction*>(m_sched.get());
+	if (!tr)
 	    break;
-	l = m_transList[m_lastGetEvIndex++]->skipNull();
-	if (!l)
+	RefPointer<IAXTransaction> t = tr;
+	// dead pointer?
+	if (!t)
 	    continue;
-	ListIterator iter(*l);
-	for (;;) {
-	    tr = static_cast<IAXTransaction*>(iter.get());
-	    // end of iteration?
-	    if (!tr)
-		break;
-	    RefPointer<IAXTransaction> t = tr;
-	    // dead pointer?
-	    if (!t)
-		continue;
-	    unlock();
-	    if (0 != (ev = t->getEvent(now)))
-		return ev;
-	    lock();
-	}
+	lck.drop();
+	// Transaction stays out of schedule while generating an event:
+	//  it will be scheduled again when the event is terminated
+	IAXEvent* ev = t->getEvent(now);
+	if (ev)
+	    return ev;
+	u_int64_t next = t->nextEventTime(now);
+	if (next)
+	    scheduleTransaction(t,next);
+	t = 0;
+	lck.acquire(m_schedMutex);
     }
-    m_lastGetEvIndex = 0;
-    unlock();
     return 0;
 }
 
-//TODO: Optimize generateCallNo & releaseCallNo
+// Take the oldest released call number from free list
 u_int16_t IAXEngine::generateCallNo()
 {
-    u_int16_t i;
-
-    m_startLocalCallNo++;
-    if (m_startLocalCallNo > IAX2_MAX_CALLNO)
-	m_startLocalCallNo = IAX2_MIN_CALLNO;
-    for (i = m_startLocalCallNo; i <= IAX2_MAX_CALLNO; i++)
-	if (!m_lUsedCallNo[i]) {
-	    m_lUsedCallNo[i] = true;
-	    return i;
-	}
-    for (i = IAX2_MIN_CALLNO; i < m_startLocalCallNo; i++)
-	if (!m_lUsedCallNo[i]) {
-	    m_lUsedCallNo[i] = true;
-	    return i;
-	}
-    Debug(this,DebugWarn,"Unable to generate call number. Transaction count: %u [%p]",
-	transactionCount(),this);
-    return 0;
+    if (!m_freeCallNoCount) {
+	Debug(this,DebugWarn,"Unable to generate call number. Transaction count: %u [%p]",
+	    transactionCount(),this);
+	return 0;
+    }
+    u_int16_t callNo = m_freeCallNo[m_freeCallNoHead];
+    m_freeCallNoHead = (m_freeCallNoHead + 1) % IAX2_MAX_CALLNO;
+    m_freeCallNoCount--;
+    m_usedCallNo[callNo >> 5] |= (1 << (callNo & 31));
+    return callNo;
 }
 
 void IAXEngine::releaseCallNo(u_int16_t lcallno)
 {
-    m_lUsedCallNo[lcallno] = false;
+    if (lcallno < IAX2_MIN_CALLNO || lcallno > IAX2_MAX_CALLNO)
+	return;
+    u_int32_t mask = 1 << (lcallno & 31);
+    // Already released ?
+    if (!(m_usedCallNo[lcallno >> 5] & mask))
+	return;
+    m_usedCallNo[lcallno >> 5] &= ~mask;
+    m_freeCallNo[(m_freeCallNoHead + m_freeCallNoCount) % IAX2_MAX_CALLNO] = lcallno;
+    m_freeCallNoCount++;
 }
 
 IAXTransaction* IAXEngine::startLocalTransaction(IAXTransaction::Type type,
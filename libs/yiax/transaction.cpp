@@ -121,7 +121,8 @@ IAXTransaction::IAXTransaction(IAXEngine* engine, IAXFullFrame* frame, u_int16_t
     m_trunkInTsDelta(0),
     m_trunkInTsDiffRestart(5000),
     m_trunkInFirstTs(0),
-    m_startIEs(0)
+    m_startIEs(0),
+    m_schedEntry(this)
 {
     switch (frame->subclass()) {
 	case IAXControl::New:
@@ -196,7 +197,8 @@ IAXTransaction::IAXTransaction(IAXEngine* engine, Type type, u_int16_t lcallno,
     m_trunkInTsDelta(0),
     m_trunkInTsDiffRestart(5000),
     m_trunkInFirstTs(0),
-    m_startIEs(0)
+    m_startIEs(0),
+    m_schedEntry(this)
 {
     // Init data members
     if (!m_addr.port()) {
@@ -281,6 +283,14 @@ IAXTransaction* IAXTransaction::factoryOut(IAXEngine* engine, Type type, u_int16
     return 0;
 }
 
+// Set the destroy flag
+void IAXTransaction::setDestroy()
+{
+    Lock lck(this);
+    m_destroy = true;
+    m_engine->scheduleTransaction(this);
+}
+
 // Start an outgoing transaction
 void IAXTransaction::start()
 {
@@ -395,6 +405,7 @@ IAXTransaction* IAXTransaction::processFrame(IAXFrame* frame)
 	"Transaction(%u,%u) enqueued Frame(%u,%u) iseq=%u oseq=%u stamp=%u [%p]",
 	localCallNo(),remoteCallNo(),frame->type(),full->subclass(),
 	full->iSeqNo(),full->oSeqNo(),frame->timeStamp(),this);
+    m_engine->scheduleTransaction(this);
     return this;
 }
 
@@ -1086,6 +1097,7 @@ void IAXTransaction::processCallToken(const DataBlock& callToken)
 	ies->appendBinary(IAXInfoElement::CALLTOKEN,(unsigned char*)callToken.data(),callToken.length());
     frame->updateBuffer(m_engine->maxFullFrameDataLen());
     sendFrame(frame);
+    m_engine->scheduleTransaction(this);
 }
 
 // Process incoming audio miniframes from trunk without timestamps
@@ -1203,6 +1215,7 @@ void IAXTransaction::destroyed()
     resetTrunk();
     if (state() != Terminating && state() != Terminated)
 	sendReject("Server shutdown");
+    m_engine->unscheduleTransaction(this);
     RefObject::destroyed();
 }
 
@@ -2117,6 +2130,8 @@ void IAXTransaction::eventTerminated(IAXEvent* event)
 	XDebug(m_engine,DebugAll,"Transaction(%u,%u). Event (%p) terminated. [%p]",
 	    localCallNo(),remoteCallNo(),event,this);
 	m_currentEvent = 0;
+	if (state() != Terminated)
+	    m_engine->scheduleTransaction(this);
     }
 }
 
@@ -2149,6 +2164,7 @@ void IAXTransaction::postFrame(IAXFrameOut* frame)
     incrementSeqNo(frame,false);
     m_outFrames.append(frame);
     sendFrame(frame);
+    m_engine->scheduleTransaction(this);
 }
 
 void IAXTransaction::receivedVoiceMiniBeforeFull()
@@ -2180,6 +2196,45 @@ void IAXTransaction::setPendingEvent(IAXEvent* ev)
     if (m_pendingEvent)
 	delete m_pendingEvent;
     m_pendingEvent = ev;
+    if (ev)
+	m_engine->scheduleTransaction(this);
+}
+
+// Retrieve the time getEvent() must be called again, 0 if only a new frame or
+//  a terminated event can generate something
+u_int64_t IAXTransaction::nextEventTime(const Time& now)
+{
+    Lock lock(this);
+    if (state() == Terminated || m_destroy || m_currentEvent ||
+	(outgoing() && state() == Unknown))
+	return 0;
+    if (m_pendingEvent)
+	return now;
+    u_int64_t next = 0;
+    if (state() == Terminating) {
+	next = m_timeout;
+	// Nothing else to be checked if remote requested termination
+	if (!m_localReqEnd)
+	    return next;
+    }
+    else if (m_timeToNextPing)
+	next = m_timeToNextPing + 1;
+    for (ObjList* o = m_outFrames.skipNull(); o; o = o->skipNext()) {
+	u_int64_t t = static_cast<IAXFrameOut*>(o->get())->nextTransTime();
+	if (!next || t < next)
+	    next = t;
+    }
+    // Incoming requests waiting for a state change: check them again later
+    for (ObjList* o = m_inFrames.skipNull(); o; o = o->skipNext()) {
+	IAXFullFrame* frame = static_cast<IAXFullFrame*>(o->get());
+	if (frame->type() == IAXFrame::IAX && frame->subclass() == IAXControl::Ack)
+	    continue;
+	u_int64_t t = now + m_retransInterval * 1000;
+	if (!next || t < next)
+	    next = t;
+	break;
+    }
+    return next ? next : now + m_pingInterval * 1000;
 }
 
 void IAXTransaction::init()
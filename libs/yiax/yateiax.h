@@ -1401,6 +1401,13 @@ public:
     inline bool timeForRetrans(u_int64_t time) const
         { return time >= m_nextTransTime; }
 
+    /**
+     * Retrieve the time of the next retransmission (or timeout)
+     * @return Time of the next retransmission in microseconds
+     */
+    inline u_int64_t nextTransTime() const
+        { return m_nextTransTime; }
+
     /**
      * Set the retransmission flag of this frame
      */
@@ -2014,9 +2021,9 @@ public:
 
     /**
      * Set the destroy flag
+     * This method is thread safe
      */
-    inline void setDestroy()
-	{ m_destroy = true; }
+    void setDestroy();
 
     /**
      * Start an outgoing transaction.
@@ -2607,6 +2614,7 @@ private:
     void resetTrunk();
     void init();
     void setPendingEvent(IAXEvent* ev = 0);
+    u_int64_t nextEventTime(const Time& now);
     inline void restartTrunkIn(u_int64_t now, u_int32_t ts) {
 	    m_trunkInStartTime = now;
 	    u_int64_t dt = (now - m_lastVoiceFrameIn) / 1000;
@@ -2690,6 +2698,8 @@ private:
     u_int32_t m_trunkInFirstTs;                 // Incoming trunk without timestamp: first trunk timestamp
     // Postponed start
     IAXIEList* m_startIEs;                      // Postponed start
+    // Engine scheduling, protected by the engine's schedule mutex
+    TimerWheelEntry m_schedEntry;               // Engine timer wheel scheduling state
 };
 
 /**
@@ -3023,6 +3033,22 @@ public:
      */
     void removeTransaction(IAXTransaction* transaction);
 
+    /**
+     * Schedule a transaction to be checked for events by getEvent()
+     * This method is thread safe
+     * @param trans The transaction to schedule
+     * @param when Time when the transaction must be checked, 0 to check it as soon as possible.
+     *  An earlier pending check is kept
+     */
+    void scheduleTransaction(IAXTransaction* trans, u_int64_t when = 0);
+
+    /**
+     * Remove a transaction from the ready list and timer wheel
+     * This method is thread safe
+     * @param trans The transaction to unschedule
+     */
+    void unscheduleTransaction(IAXTransaction* trans);
+
     /**
      * Check if there are any transactions in the engine
      * This method is thread safe
@@ -3281,7 +3307,7 @@ protected:
     IAXEvent* getEvent(const Time& now = Time());
 
     /**
-     * Generate call number. Update used call numbers list
+     * Generate call number. Take the oldest released one from the free list
      * @return Call number or 0 if none available
      */
     u_int16_t generateCallNo();
@@ -3322,12 +3348,15 @@ private:
     SocketAddr m_addr;                          // Address we are bound on
     ObjList** m_transList;			// Full transactions
     ObjList m_incompleteTransList;		// Incomplete transactions (no remote call number)
-    bool m_lUsedCallNo[IAX2_MAX_CALLNO + 1];	// Used local call numnmbers flags
-    int m_lastGetEvIndex;			// getEvent: keep last array entry
+    u_int16_t m_freeCallNo[IAX2_MAX_CALLNO];	// Free local call numbers (FIFO ring)
+    unsigned int m_freeCallNoHead;		// Free call numbers ring head
+    unsigned int m_freeCallNoCount;		// Free call numbers ring count
+    u_int32_t m_usedCallNo[(IAX2_MAX_CALLNO >> 5) + 1]; // Used local call numbers bitmap
+    Mutex m_schedMutex;				// Protects the timer wheel
+    TimerWheel m_sched;				// Transactions waiting to be checked for events
     bool m_exiting;                             // Exiting flag
     // Parameters
     int m_maxFullFrameDataLen;			// Max full frame data (IE list) length
-    u_int16_t m_startLocalCallNo;		// Start index of local call number allocation
     u_int16_t m_transListCount;			// m_transList count
     unsigned int m_challengeTout;		// Sent challenge timeout interval
     bool m_callToken;                           // Call token required on incoming calls
@@ -56,6 +56,9 @@ using namespace TelEngine;
 #define TR_RETRANS_COUNT_MIN 1
 #define TR_EXTRA_TIME 30000
 #define TR_EXTRA_TIME_MIN 10000
+#define TR_HASH_SIZE 1021                // Default transaction hash size
+#define TR_SCHED_SLOTS 1024              // Transaction timer wheel slots
+#define TR_SCHED_TICK 10000              // Transaction timer wheel resolution (microseconds)
 
 
 /**
@@ -101,7 +104,8 @@ void MGCPPrivateThread::run()
  */
 MGCPEngine::MGCPEngine(bool gateway, const char* name, const NamedList* params)
     : Mutex(true,"MGCPEngine"),
-    m_iterator(m_transactions),
+    m_trIncoming(params ? params->getIntValue(YSTRING("transactions_hash"),TR_HASH_SIZE,17,131071) : TR_HASH_SIZE),
+    m_trOutgoing(m_trIncoming.length()),
     m_gateway(gateway),
     m_initialized(false),
     m_nextId(1),
@@ -114,7 +118,15 @@ MGCPEngine::MGCPEngine(bool gateway, const char* name, const NamedList* params)
     m_extraTime(TR_EXTRA_TIME * 1000),
     m_parseParamToLower(true),
     m_provisional(true),
-    m_ackRequest(true)
+    m_ackRequest(true),
+    m_trInCount(0),
+    m_trOutCount(0),
+    m_trInTotal(0),
+    m_trOutTotal(0),
+    m_trTimeouts(0),
+    m_retransmissions(0),
+    m_schedMutex(false,"MGCPEngine::Sched"),
+    m_sched(TR_SCHED_SLOTS,TR_SCHED_TICK,Time::now())
 {
     debugName((name && *name) ? name : (gateway ? "mgcp_gw" : "mgcp_ca"));
 
@@ -267,11 +279,13 @@ void MGCPEngine::detach(MGCPEndpoint* ep, bool del, bool delTrans)
     Lock lock(this);
     // Remove transactions
     if (delTrans) {
-	ListIterator iter(m_transactions);
-	for (GenObject* o; 0 != (o = iter.get());) {
-	    MGCPTransaction* tr = static_cast<MGCPTransaction*>(o);
-	    if (ep->id() == tr->ep())
-		m_transactions.remove(tr,true);
+	for (int i = 0; i < 2; i++) {
+	    ListIterator iter(i ? m_trOutgoing : m_trIncoming);
+	    for (GenObject* o; 0 != (o = iter.get());) {
+		MGCPTransaction* tr = static_cast<MGCPTransaction*>(o);
+		if (ep->id() == tr->ep())
+		    removeTrans(tr,true);
+	    }
 	}
     }
     m_endpoints.remove(ep,del);
@@ -294,13 +308,42 @@ MGCPEndpoint* MGCPEngine::findEp(const String& epId)
 // find a transaction
 MGCPTransaction* MGCPEngine::findTrans(unsigned int id, bool outgoing)
 {
+    String tmp(id);
     Lock lock(this);
-    for (ObjList* o = m_transactions.skipNull(); o; o = o->skipNext()) {
-	MGCPTransaction* tr = static_cast<MGCPTransaction*>(o->get());
-	if (outgoing == tr->outgoing() && id == tr->id())
-	    return tr;
-    }
-    return 0;
+    return static_cast<MGCPTransaction*>((outgoing ? m_trOutgoing : m_trIncoming)[tmp]);
+}
+
+// Schedule a transaction to be checked at given time or as soon as possible
+void MGCPEngine::scheduleTransaction(MGCPTransaction* trans, u_int64_t when)
+{
+    if (!trans)
+	return;
+    Lock lck(m_schedMutex);
+    m_sched.schedule(trans->m_schedEntry,when);
+}
+
+// Remove a transaction from ready list and timer wheel
+void MGCPEngine::unscheduleTransaction(MGCPTransaction* trans)
+{
+    if (!trans)
+	return;
+    Lock lck(m_schedMutex);
+    m_sched.cancel(trans->m_schedEntry,true);
+}
+
+// Fill a list with transaction statistics
+void MGCPEngine::status(NamedList& params)
+{
+    Lock lock(this);
+    params.setParam("transactions",String(m_trInCount + m_trOutCount));
+    params.setParam("incoming",String(m_trInCount));
+    params.setParam("outgoing",String(m_trOutCount));
+    params.setParam("totalIncoming",String(m_trInTotal));
+    params.setParam("totalOutgoing",String(m_trOutTotal));
+    params.setParam("timeouts",String(m_trTimeouts));
+    lock.drop();
+    Lock lck(m_schedMutex);
+    params.setParam("retransmissions",String(m_retransmissions));
 }
 
 // Generate a new id for an outgoing transaction
@@ -395,8 +438,10 @@ bool MGCPEngine::receive(unsigned char* buffer, SocketAddr& addr)
 		if (trList) {
 		    for (unsigned int i = 0; i < len; i++) {
 			MGCPTransaction* tr = findTrans(trList[i],false);
-			if (tr)
+			if (tr) {
 			    tr->processMessage(new MGCPMessage(tr,0));
+			    scheduleTransaction(tr);
+			}
 			else
 			    DDebug(this,DebugNote,
 				"Message %s carry ACK for unknown transaction %u",
@@ -424,6 +469,7 @@ bool MGCPEngine::receive(unsigned char* buffer, SocketAddr& addr)
 	MGCPTransaction* tr = findTrans(msg->transactionId(),outgoing);
 	if (tr) {
 	    tr->processMessage(msg);
+	    scheduleTransaction(tr);
 	    continue;
 	}
 	// No transaction
@@ -499,32 +545,37 @@ void MGCPEngine::runProcess()
 }
 
 // Try to get an event from a transaction
+// Only transactions that received something or whose timer expired are checked
 MGCPEvent* MGCPEngine::getEvent(u_int64_t time)
 {
-    lock();
-    while (true) {
-	if (Thread::check(false))
+    Lock lck(m_schedMutex);
+    // Move transactions from elapsed timer wheel slots to ready list
+    m_sched.advance(time);
+    while (!Thread::check(false)) {
+	MGCPTransaction* tr = static_cast<MGCPTransaction*>(m_sched.get());
+	if (!tr)
 	    break;
-	MGCPTransaction* tr = static_cast<MGCPTransaction*>(m_iterator.get());
-        // End of iteration? NO: get a reference to the transaction
-	if (!tr) {
-	    m_iterator.assign(m_transactions);
-	    break;
-	}
+	// Transactions processed by their owner are scheduled again by setEngineProcess()
 	if (!tr->m_engineProcess)
 	    continue;
 	RefPointer<MGCPTransaction> sref = tr;
 	if (!sref)
 	    continue;
-	// Get an event from the transaction
-	unlock();
+	lck.drop();
+	// Transaction stays out of schedule while generating an event:
+	//  it will be scheduled again when the event is terminated
 	MGCPEvent* event = sref->getEvent(time);
-	// Remove the transaction if destroying
 	if (event)
 	    return event;
-	lock();
+	sref->lock();
+	u_int64_t next = sref->m_nextRetrans;
+	sref->unlock();
+	// An expired timer not handled yet (pending event) is checked on next tick
+	if (next)
+	    scheduleTransaction(sref,next > time ? next : time + TR_SCHED_TICK);
+	sref = 0;
+	lck.acquire(m_schedMutex);
     }
-    unlock();
     return 0;
 }
 
@@ -576,13 +627,21 @@ void MGCPEngine::cleanup(bool gracefully, const char* text)
 
     // Terminate transactions
     Lock mylock(this);
-    if (gracefully)
-	for (ObjList* o = m_transactions.skipNull(); o; o = o->skipNext()) {
-	    MGCPTransaction* tr = static_cast<MGCPTransaction*>(o->get());
-	    if (!tr->outgoing())
-		tr->setResponse(400,text);
+    for (int i = 0; i < 2; i++) {
+	HashList& list = i ? m_trOutgoing : m_trIncoming;
+	for (unsigned int n = 0; n < list.length(); n++) {
+	    ObjList* l = list.getList(n);
+	    // Take the transaction out of the list before releasing it
+	    for (ObjList* o = l ? l->skipNull() : 0; o; o = l->skipNull()) {
+		MGCPTransaction* tr = static_cast<MGCPTransaction*>(o->remove(false));
+		if (gracefully && !tr->outgoing())
+		    tr->setResponse(400,text);
+		unscheduleTransaction(tr);
+		TelEngine::destruct(tr);
+	    }
 	}
-    m_transactions.clear();
+    }
+    m_trInCount = m_trOutCount = 0;
 
     // Check if we have any private threads to wait
     if (!m_threads.skipNull())
@@ -638,7 +697,16 @@ void MGCPEngine::appendTrans(MGCPTransaction* trans)
 	return;
     Lock lock(this);
     DDebug(this,DebugAll,"Added transaction (%p)",trans);
-    m_transactions.append(trans);
+    if (trans->outgoing()) {
+	m_trOutgoing.append(trans);
+	m_trOutCount++;
+	m_trOutTotal++;
+    }
+    else {
+	m_trIncoming.append(trans);
+	m_trInCount++;
+	m_trInTotal++;
+    }
 }
 
 // Remove a transaction from the list
@@ -647,8 +715,19 @@ void MGCPEngine::removeTrans(MGCPTransaction* trans, bool del)
     if (!trans)
 	return;
     Lock lock(this);
+    HashList& list = trans->outgoing() ? m_trOutgoing : m_trIncoming;
+    if (!list.remove(trans,false,true))
+	return;
     DDebug(this,DebugAll,"Removed transaction (%p) del=%u",trans,del);
-    m_transactions.remove(trans,del);
+    if (trans->outgoing())
+	m_trOutCount--;
+    else
+	m_trInCount--;
+    if (trans->timeout())
+	m_trTimeouts++;
+    unscheduleTransaction(trans);
+    if (del)
+	TelEngine::destruct(trans);
 }
 
 // Append a private thread to the list
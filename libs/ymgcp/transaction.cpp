@@ -27,6 +27,8 @@ MGCPTransaction::MGCPTransaction(MGCPEngine* engine, MGCPMessage* msg, bool outg
 	const SocketAddr& address, bool engineProcess)
     : Mutex(true,"MGCPTransaction"),
     m_state(Invalid),
+    m_id(msg ? msg->transactionId() : 0),
+    m_idString(m_id),
     m_outgoing(outgoing),
     m_address(address),
     m_engine(engine),
@@ -41,7 +43,8 @@ MGCPTransaction::MGCPTransaction(MGCPEngine* engine, MGCPMessage* msg, bool outg
     m_timeout(false),
     m_ackRequest(true),
     m_private(0),
-    m_engineProcess(engineProcess)
+    m_engineProcess(engineProcess),
+    m_schedEntry(this)
 {
     if (m_engine) {
 	ackRequest(m_engine->ackRequest());
@@ -53,10 +56,11 @@ MGCPTransaction::MGCPTransaction(MGCPEngine* engine, MGCPMessage* msg, bool outg
     }
     if (!(msg && msg->isCommand())) {
 	Debug(engine,DebugNote,"Can't create MGCP transaction from response");
+	// Let getEvent() terminate it
+	m_engine->scheduleTransaction(this);
 	return;
     }
 
-    m_id = msg->transactionId();
     m_endpoint = m_cmd->endpointId();
     m_debug << "Transaction(" << (int)outgoing << "," << m_id << ")";
 
@@ -71,6 +75,7 @@ MGCPTransaction::MGCPTransaction(MGCPEngine* engine, MGCPMessage* msg, bool outg
     }
     else
 	changeState(Initiated);
+    m_engine->scheduleTransaction(this);
 }
 
 MGCPTransaction::~MGCPTransaction()
@@ -154,6 +159,14 @@ MGCPEvent* MGCPTransaction::getEvent(u_int64_t time)
     return m_lastEvent;
 }
 
+// Allow the engine to process this transaction
+void MGCPTransaction::setEngineProcess()
+{
+    m_engineProcess = true;
+    if (m_engine)
+	m_engine->scheduleTransaction(this);
+}
+
 // Explicitely transmit a provisional code
 bool MGCPTransaction::sendProvisional(int code, const char* comment)
 {
@@ -189,6 +202,8 @@ bool MGCPTransaction::setResponse(MGCPMessage* msg)
     if (!m_ackRequest)
 	changeState(Ack);
     initTimeout(Time(),false);
+    if (m_engine)
+	m_engine->scheduleTransaction(this,m_nextRetrans);
     return true;
 }
 
@@ -381,6 +396,7 @@ MGCPEvent* MGCPTransaction::checkTimeout(u_int64_t time)
 
 	if (m) {
 	    send(m);
+	    m_engine->retransmitted();
 	    Debug(m_engine,DebugInfo,"%s. Retransmitted %s remaining=%u [%p]",
 		m_debug.c_str(),m->name().c_str(),m_retransCount,this);
 	}
@@ -404,6 +420,9 @@ void MGCPTransaction::eventTerminated(MGCPEvent* event)
 	return;
     DDebug(m_engine,DebugAll,"%s. Event (%p) terminated [%p]",m_debug.c_str(),event,this);
     m_lastEvent = 0;
+    // The transaction may have more to do, let the engine check it
+    if (m_engine)
+	m_engine->scheduleTransaction(this);
 }
 
 // Change transaction's state if the new state is a valid one
@@ -260,6 +260,13 @@ public:
      */
     virtual ~MGCPTransaction();
 
+    /**
+     * Get the string representation of the transaction id, used to hash transactions
+     * @return The id of this transaction as string
+     */
+    virtual const String& toString() const
+	{ return m_idString; }
+
     /**
      * Get the current transaction's state
      * @return The transaction state as enumeration
@@ -362,8 +369,7 @@ public:
      * Set the engine process flag. Allow the engine to process this transaction
      * (call getEvent() from engine process thread)
      */
-    inline void setEngineProcess()
-	{ m_engineProcess = true; }
+    void setEngineProcess();
 
     /**
      * Get an event from this transaction. Check timeouts
@@ -455,7 +461,7 @@ protected:
     void send(MGCPMessage* msg);
 
 private:
-    MGCPTransaction() {}                 // Avoid using default constructor
+    MGCPTransaction() : m_schedEntry(this) {} // Avoid using default constructor
     // Check if received any final response. Create an event. Init timeout.
     // Send a response ACK if requested by the response
     MGCPEvent* checkResponse(u_int64_t time);
@@ -466,6 +472,7 @@ private:
 
     State m_state;                       // Current state
     unsigned int m_id;                   // Transaction id
+    String m_idString;                   // Transaction id as string
     bool m_outgoing;                     // Transaction direction
     SocketAddr m_address;                // Remote andpoint's address
     MGCPEngine* m_engine;                // The engine owning this transaction
@@ -483,6 +490,7 @@ private:
     void* m_private;                     // Data used by this transaction's user
     String m_debug;                      // String used to identify the transaction in debug messages
     bool m_engineProcess;                // Process transaction (getEvent) from engine processor
+    TimerWheelEntry m_schedEntry;        // Engine timer wheel scheduling state
 };
 
 /**
@@ -947,6 +955,38 @@ public:
      */
     MGCPTransaction* findTrans(unsigned int id, bool outgoing);
 
+    /**
+     * Schedule a transaction to be checked for events by getEvent()
+     * This method is thread safe
+     * @param trans The transaction to schedule
+     * @param when Time when the transaction must be checked, 0 to check it as soon as possible.
+     *  An earlier pending check is kept
+     */
+    void scheduleTransaction(MGCPTransaction* trans, u_int64_t when = 0);
+
+    /**
+     * Remove a transaction from the ready list and timer wheel.
+     * The transaction will not be scheduled again
+     * This method is thread safe
+     * @param trans The transaction to unschedule
+     */
+    void unscheduleTransaction(MGCPTransaction* trans);
+
+    /**
+     * Get the number of outstanding transactions
+     * @param outgoing The transaction direction. True for outgoing, false for incoming
+     * @return The number of transactions in the given direction
+     */
+    inline unsigned int transactionCount(bool outgoing) const
+	{ return outgoing ? m_trOutCount : m_trInCount; }
+
+    /**
+     * Fill a list with transaction statistics
+     * @param params List to fill: outstanding transactions in each direction,
+     *  total transactions, timeouts and retransmissions
+     */
+    void status(NamedList& params);
+
     /**
      * Generate a new id for an outgoing transaction
      * @return An id for an outgoing transaction
@@ -1120,14 +1160,14 @@ protected:
     ObjList m_endpoints;
 
     /**
-     * The transaction list
+     * The incoming transactions, hashed by transaction id
      */
-    ObjList m_transactions;
+    HashList m_trIncoming;
 
     /**
-     * The transaction list iterator used to get events
+     * The outgoing transactions, hashed by transaction id
      */
-    ListIterator m_iterator;
+    HashList m_trOutgoing;
 
 private:
     // Append a private thread to the list
@@ -1137,6 +1177,9 @@ private:
     // Process ACK received with a message or response
     // Return a list of ack'd transactions or 0 if the parameter is incorrect
     unsigned int* decodeAck(const String& param, unsigned int & count);
+    // Count a retransmitted message
+    inline void retransmitted()
+	{ Lock lock(m_schedMutex); m_retransmissions++; }
 
     bool m_gateway;                      // True if this engine is an MGCP gateway, false if call agent
     bool m_initialized;                  // True if the engine was already initialized
@@ -1154,6 +1197,14 @@ private:
     bool m_ackRequest;                   // Remote is requested to send ACK
     ObjList m_knownCommands;             // The list of known commands
     ObjList m_threads;
+    unsigned int m_trInCount;            // Outstanding incoming transactions
+    unsigned int m_trOutCount;           // Outstanding outgoing transactions
+    u_int64_t m_trInTotal;               // Total incoming transactions
+    u_int64_t m_trOutTotal;              // Total outgoing transactions
+    u_int64_t m_trTimeouts;              // Transactions terminated by timeout
+    u_int64_t m_retransmissions;         // Retransmitted messages
+    Mutex m_schedMutex;                  // Protects the timer wheel and retransmissions
+    TimerWheel m_sched;                  // Transactions waiting to be checked for events
 };
 
 }
@@ -19,40 +19,26 @@
  */
 
 #include <yatertp.h>
+#include <string.h>
 
-using namespace TelEngine;
-
-namespace { // anonymous
+// Smallest and largest number of slots in the packet ring
+#define JB_MIN_SLOTS 16
+#define JB_MAX_SLOTS 256
+// Shortest packet interval the ring is sized for, in microseconds
+#define JB_MIN_FRAME 5000
+// Maximum consecutive packets to conceal by repeating the previous one
+#define JB_CONCEAL_MAX 3
 
-class RTPDelayedData : public DataBlock
-{
-public:
-    inline RTPDelayedData(u_int64_t when, bool mark, int payload,
-	unsigned int tstamp, const void* data, int len)
-	: DataBlock(const_cast<void*>(data),len), m_scheduled(when),
-	  m_marker(mark), m_payload(payload), m_timestamp(tstamp)
-	{ }
-    inline u_int64_t scheduled() const
-	{ return m_scheduled; }
-    inline bool marker() const
-	{ return m_marker; }
-    int payload() const
-	{ return m_payload; }
-    inline unsigned int timestamp() const
-	{ return m_timestamp; }
-private:
-    u_int64_t m_scheduled;
-    bool m_marker;
-    int m_payload;
-    unsigned int m_timestamp;
-};
-
-}; // anonymous namespace
+using namespace TelEngine;
 
 
 RTPDejitter::RTPDejitter(RTPReceiver* receiver, unsigned int mindelay, unsigned int maxdelay)
-    : m_receiver(receiver), m_minDelay(mindelay), m_maxDelay(maxdelay),
-      m_headStamp(0), m_tailStamp(0), m_headTime(0), m_sampRate(125000), m_fastRate(10)
+    : m_slots(0), m_mask(0), m_depth(0),
+      m_receiver(receiver), m_minDelay(mindelay), m_maxDelay(maxdelay),
+      m_target(0), m_jitter(0), m_playing(false), m_playSeq(0), m_inSeq(0),
+      m_baseStamp(0), m_baseTime(0), m_lastStamp(0), m_lastSlot(-1), m_conceal(0),
+      m_arrStamp(0), m_arrTime(0), m_refStamp(0), m_refTime(0), m_sampRate(125000),
+      m_late(0), m_lost(0)
 {
     if (m_maxDelay > 1000000)
 	m_maxDelay = 1000000;
@@ -62,122 +48,251 @@ RTPDejitter::RTPDejitter(RTPReceiver* receiver, unsigned int mindelay, unsigned
 	m_minDelay = 5000;
     if (m_minDelay > m_maxDelay - 30000)
 	m_minDelay = m_maxDelay - 30000;
+    m_target = m_minDelay;
+    // the ring must hold the longest buffer at the shortest usual packet interval
+    unsigned int need = m_maxDelay / JB_MIN_FRAME + 2;
+    unsigned int size = JB_MIN_SLOTS;
+    while (size < need && size < JB_MAX_SLOTS)
+	size <<= 1;
+    m_mask = size - 1;
+    m_slots = new Slot[size];
+    for (unsigned int i = 0; i < size; i++) {
+	Slot& slot = m_slots[i];
+	slot.seq = 0;
+	slot.used = false;
+	slot.marker = false;
+	slot.payload = -1;
+	slot.stamp = 0;
+	slot.data = 0;
+	slot.size = 0;
+	slot.len = 0;
+    }
 }
 
 RTPDejitter::~RTPDejitter()
 {
-    DDebug(DebugInfo,"Dejitter destroyed with %u packets [%p]",m_packets.count(),this);
+    DDebug(DebugInfo,"Dejitter destroyed with %u packets, %u late, %u lost [%p]",
+	m_depth,m_late,m_lost,this);
+    for (unsigned int i = 0; i <= m_mask; i++)
+	delete[] m_slots[i].data;
+    delete[] m_slots;
 }
 
 void RTPDejitter::clear()
 {
-    m_packets.clear();
-    m_headStamp = m_tailStamp = 0;
+    for (unsigned int i = 0; i <= m_mask; i++)
+	m_slots[i].used = false;
+    m_depth = 0;
+    m_playing = false;
+    m_lastSlot = -1;
+    m_conceal = 0;
+    m_arrTime = 0;
+    m_refTime = 0;
 }
 
-bool RTPDejitter::rtpRecv(bool marker, int payload, unsigned int timestamp, const void* data, int len)
+void RTPDejitter::stats(NamedList& stat) const
+{
+    stat.setParam("jitterlate",String(m_late));
+    stat.setParam("jitterlost",String(m_lost));
+    stat.setParam("jitterdepth",String(m_depth));
+    stat.setParam("jitterdelay",String(m_target / 1000));
+    stat.setParam("jitter",String(m_jitter / 1000));
+}
+
+// Playout time of a sampling instant relative to the start of the talkspurt
+u_int64_t RTPDejitter::dueTime(unsigned int timestamp) const
 {
-    u_int64_t when = 0;
-    bool insert = false;
+    int64_t offs = (int64_t)(int)(timestamp - m_baseStamp) * (int64_t)m_sampRate / 1000;
+    return (u_int64_t)((int64_t)m_baseTime + offs);
+}
 
-    if (m_headStamp) {
-	// at least one packet got out of the queue
-	int dTs = timestamp - m_headStamp;
-	if (dTs == 0)
-	    return true;
-	else if (dTs < 0) {
-	    DDebug(DebugNote,"Dejitter dropping TS %u, last delivered was %u [%p]",
-		timestamp,m_headStamp,this);
-	    return false;
-	}
-	u_int64_t now = Time::now();
-	int64_t rate = 1000 * (now - m_headTime) / dTs;
-	if (rate > 0) {
-	    if (m_sampRate) {
-		if (m_fastRate) {
-		    m_fastRate--;
-		    rate = (7 * m_sampRate + rate) >> 3;
-		}
-		else
-		    rate = (31 * m_sampRate + rate) >> 5;
+// Start a new talkspurt, this is the only place where the delay changes
+void RTPDejitter::restart(u_int16_t seq, unsigned int timestamp, u_int64_t now)
+{
+    XDebug(DebugAll,"Dejitter restarting at SEQ %u TS %u with delay %u [%p]",
+	seq,timestamp,m_target,this);
+    m_playing = true;
+    m_playSeq = seq;
+    m_baseStamp = timestamp;
+    m_baseTime = now + m_target;
+    m_lastStamp = timestamp;
+    m_conceal = 0;
+}
+
+// Update the sampling rate, interarrival jitter and target delay estimates
+void RTPDejitter::arrival(unsigned int timestamp, u_int64_t now)
+{
+    if (m_refTime) {
+	int dTs = timestamp - m_refStamp;
+	u_int64_t dt = now - m_refTime;
+	if (dTs > 0 && dt >= 100000) {
+	    int64_t rate = 1000 * dt / dTs;
+	    // 6.67 kHz to 50 kHz, anything else means the timestamps jumped
+	    if (rate <= 150000 && rate >= 20000)
+		m_sampRate = rate;
+	    else {
+		m_refTime = now;
+		m_refStamp = timestamp;
 	    }
-	    if (rate > 150000)
-		rate = 150000; // 6.67 kHz
-	    else if (rate < 20000)
-		rate = 20000; // 50 kHz
-	    m_sampRate = rate;
-	    XDebug(DebugAll,"Time per sample " FMT64, rate);
 	}
-	else
-	    rate = m_sampRate;
-	if (rate > 0)
-	    when = m_headTime + (dTs * rate / 1000) + m_minDelay;
-	else
-	    when = now + m_minDelay;
-	if (m_tailStamp) {
-	    if (timestamp == m_tailStamp)
-		return true;
-	    if (((int)(timestamp - m_tailStamp)) < 0)
-		insert = true;
-	    else if (when > now + m_maxDelay) {
-		DDebug(DebugNote,"Packet with TS %u falls after max buffer [%p]",timestamp,this);
-		return false;
-	    }
+	else if (dTs < 0) {
+	    m_refTime = now;
+	    m_refStamp = timestamp;
 	}
     }
     else {
-	if (m_tailStamp && ((int)(timestamp - m_tailStamp)) < 0) {
-	    // until we get some statistics don't attempt to reorder packets
-	    DDebug(DebugNote,"Dejitter got TS %u while last queued was %u [%p]",timestamp,m_tailStamp,this);
-	    return false;
+	m_refTime = now;
+	m_refStamp = timestamp;
+    }
+
+    if (m_arrTime) {
+	int dTs = timestamp - m_arrStamp;
+	if (dTs) {
+	    // RFC 3550 A.8 interarrival jitter, kept in microseconds
+	    int64_t d = (int64_t)(now - m_arrTime) - (int64_t)dTs * (int64_t)m_sampRate / 1000;
+	    if (d < 0)
+		d = -d;
+	    if (d > 2 * (int64_t)m_maxDelay)
+		d = 2 * (int64_t)m_maxDelay;
+	    m_jitter = (unsigned int)((int64_t)m_jitter + (d - (int64_t)m_jitter) / 16);
 	}
-	// we got no packets out yet so use a fixed interval
-	when = Time::now() + m_minDelay;
     }
+    m_arrTime = now;
+    m_arrStamp = timestamp;
 
-    if (insert) {
-	for (ObjList* l = m_packets.skipNull(); l; l = l->skipNext()) {
-	    RTPDelayedData* pkt = static_cast<RTPDelayedData*>(l->get());
-	    if (pkt->timestamp() == timestamp)
-		return true;
-	    if (pkt->timestamp() > timestamp && pkt->scheduled() > when) {
-		l->insert(new RTPDelayedData(when,marker,payload,timestamp,data,len));
-		return true;
-	    }
+    unsigned int target = 4 * m_jitter;
+    if (target < m_minDelay)
+	target = m_minDelay;
+    else if (target > m_maxDelay)
+	target = m_maxDelay;
+    m_target = target;
+}
+
+bool RTPDejitter::rtpRecv(bool marker, int payload, unsigned int timestamp, const void* data, int len)
+{
+    return rtpRecv(marker,payload,timestamp,++m_inSeq,data,len);
+}
+
+bool RTPDejitter::rtpRecv(bool marker, int payload, unsigned int timestamp,
+    u_int16_t seq, const void* data, int len)
+{
+    if (len < 0)
+	return false;
+    u_int64_t now = Time::now();
+    arrival(timestamp,now);
+    if (m_playing) {
+	int d = (int16_t)(seq - m_playSeq);
+	if (d < 0) {
+	    DDebug(DebugNote,"Dejitter dropping SEQ %u, next to play is %u [%p]",
+		seq,m_playSeq,this);
+	    m_late++;
+	    return false;
+	}
+	// keep the slot of the last played packet out of the window
+	bool far = (unsigned int)d >= m_mask;
+	if (!m_depth && (far || marker || (dueTime(timestamp) <= now))) {
+	    // buffer ran empty, resync the playout on this packet
+	    if (d && !far)
+		m_lost += d;
+	    restart(seq,timestamp,now);
 	}
+	else if (far || (dueTime(timestamp) > now + m_maxDelay)) {
+	    DDebug(DebugNote,"Packet with SEQ %u TS %u falls after max buffer [%p]",
+		seq,timestamp,this);
+	    return false;
+	}
+    }
+    else
+	restart(seq,timestamp,now);
+
+    int idx = seq & m_mask;
+    Slot& slot = m_slots[idx];
+    if (slot.used) {
+	if (slot.seq == seq)
+	    return true;
+	m_depth--;
+    }
+    if ((unsigned int)len > slot.size) {
+	delete[] slot.data;
+	slot.size = (len + 63) & ~63;
+	slot.data = new unsigned char[slot.size];
     }
-    m_tailStamp = timestamp;
-    m_packets.append(new RTPDelayedData(when,marker,payload,timestamp,data,len));
+    if (len)
+	::memcpy(slot.data,data,len);
+    slot.seq = seq;
+    slot.used = true;
+    slot.marker = marker;
+    slot.payload = payload;
+    slot.stamp = timestamp;
+    slot.len = len;
+    m_depth++;
+    if (idx == m_lastSlot)
+	m_lastSlot = -1;
     return true;
 }
 
+void RTPDejitter::deliver(Slot& slot)
+{
+    slot.used = false;
+    m_depth--;
+    m_playSeq++;
+    m_lastStamp = slot.stamp;
+    m_lastSlot = &slot - m_slots;
+    m_conceal = 0;
+    if (m_receiver)
+	m_receiver->rtpRecv(slot.marker,slot.payload,slot.stamp,slot.data,slot.len);
+}
+
 void RTPDejitter::timerTick(const Time& when)
 {
-    RTPDelayedData* packet = static_cast<RTPDelayedData*>(m_packets.get());
-    if (!packet) {
-	m_tailStamp = 0;
-	if (m_headStamp && (m_headTime + m_maxDelay < when))
-	    m_headStamp = 0;
+    if (!m_playing)
 	return;
-    }
-    if (packet->scheduled() > when)
-	return;
-    m_packets.remove(packet,false);
-    // remember the last delivered
-    m_headStamp = packet->timestamp();
-    m_headTime = packet->scheduled();
-    if (m_receiver)
-	m_receiver->rtpRecv(packet->marker(),packet->payload(),
-	    packet->timestamp(),packet->data(),packet->length());
-    TelEngine::destruct(packet);
+    u_int64_t now = when;
     unsigned int count = 0;
-    while ((packet = static_cast<RTPDelayedData*>(m_packets.get()))) {
-	long int delayed = (long int)(when - packet->scheduled());
-	if (delayed <= 0 || delayed <= (long)m_minDelay)
+    for (;;) {
+	Slot& slot = m_slots[m_playSeq & m_mask];
+	if (slot.used && (slot.seq == m_playSeq)) {
+	    u_int64_t due = dueTime(slot.stamp);
+	    if (due > now)
+		break;
+	    if (now - due <= m_maxDelay) {
+		deliver(slot);
+		continue;
+	    }
+	    // we are too delayed - probably rtpRecv() took too long to complete...
+	    slot.used = false;
+	    m_depth--;
+	    m_playSeq++;
+	    m_lastStamp = slot.stamp;
+	    m_late++;
+	    count++;
+	    continue;
+	}
+	if (!m_depth)
+	    break;
+	// a packet is missing, find the next one to interpolate its timestamp
+	const Slot* next = 0;
+	unsigned int n = 1;
+	for (; n < m_mask; n++) {
+	    const Slot& s = m_slots[(m_playSeq + n) & m_mask];
+	    if (s.used && (s.seq == (u_int16_t)(m_playSeq + n))) {
+		next = &s;
+		break;
+	    }
+	}
+	if (!next)
+	    break;
+	unsigned int stamp = m_lastStamp + (int)(next->stamp - m_lastStamp) / (int)(n + 1);
+	if (dueTime(stamp) > now)
 	    break;
-	// we are too delayed - probably rtpRecv() took too long to complete...
-	m_packets.remove(packet,true);
-	count++;
+	m_lost++;
+	m_playSeq++;
+	m_lastStamp = stamp;
+	if (m_receiver && (m_lastSlot >= 0) && (++m_conceal <= JB_CONCEAL_MAX)) {
+	    const Slot& last = m_slots[m_lastSlot];
+	    if (last.payload == m_receiver->dataPayload())
+		m_receiver->rtpConcealData(stamp,last.data,last.len,m_conceal);
+	}
     }
     if (count)
 	Debug((count > 1) ? DebugMild : DebugNote,
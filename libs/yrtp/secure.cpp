@@ -27,33 +27,105 @@ using namespace TelEngine;
 
 static const DataBlock s_16bit(0,2);
 
+struct SrtpSuite {
+    const char* name;
+    unsigned int keyLen;
+    unsigned int saltLen;
+    unsigned int authLen;
+    bool aead;
+};
+
+static const SrtpSuite s_suites[] = {
+    { "AES_CM_128_HMAC_SHA1_32", 16, 14, 4, false },
+    { "AES_CM_128_HMAC_SHA1_80", 16, 14, 10, false },
+    // RFC 7714 AEAD suites, the authentication tag is the GCM tag
+    { "AEAD_AES_128_GCM", 16, 12, 16, true },
+    { "AEAD_AES_256_GCM", 32, 12, 16, true },
+    { 0, 0, 0, 0, false }
+};
+
+static const SrtpSuite* findSuite(const String& name)
+{
+    for (const SrtpSuite* s = s_suites; s->name; s++)
+	if (name == s->name)
+	    return s;
+    return 0;
+}
+
+// Length of RTP header including CSRC and extension, -1 if invalid
+static int headerLength(const unsigned char* data, int len)
+{
+    if (len < 12)
+	return -1;
+    int hLen = 12 + 4 * (data[0] & 0x0f);
+    if (data[0] & 0x10) {
+	if (len < hLen + 4)
+	    return -1;
+	hLen += 4 + 4 * (((int)data[hLen + 2] << 8) | data[hLen + 3]);
+    }
+    return (hLen <= len) ? hLen : -1;
+}
+
+// RFC 7714 8: encrypt or decrypt the payload, authenticate header and payload
+static bool rtpAead(Cipher* cipher, const DataBlock& salt, unsigned char* data, int len,
+    void* tag, u_int32_t ssrc, u_int64_t seq, bool encrypt)
+{
+    int hLen = headerLength(data,len);
+    if (!cipher || (hLen < 0) || (salt.length() != 12))
+	return false;
+    // IV = 00 00 || SSRC || ROC || SEQ, XORed with the session salt
+    const unsigned char* s = (const unsigned char*)salt.data();
+    unsigned char iv[12];
+    iv[0] = s[0];
+    iv[1] = s[1];
+    for (int i = 5; i >= 2; i--) {
+	iv[i] = s[i] ^ (ssrc & 0xff);
+	ssrc >>= 8;
+    }
+    for (int i = 11; i >= 6; i--) {
+	iv[i] = s[i] ^ (seq & 0xff);
+	seq >>= 8;
+    }
+    cipher->initVector(iv,sizeof(iv));
+    if (encrypt)
+	return cipher->encryptAuth(data + hLen,len - hLen,data,hLen,tag);
+    return cipher->decryptAuth(data + hLen,len - hLen,data,hLen,tag);
+}
+
 
 RTPSecure::RTPSecure()
     : m_owner(0), m_rtpCipher(0),
-      m_rtpAuthLen(0), m_rtpEncrypted(false)
+      m_rtpAuthLen(0), m_rtpEncrypted(false), m_rtpAead(false),
+      m_keyLen(16), m_saltLen(14)
 {
     DDebug(DebugAll,"RTPSecure::RTPSecure() [%p]",this);
 }
 
 RTPSecure::RTPSecure(const String& suite)
     : m_owner(0), m_rtpCipher(0),
-      m_rtpAuthLen(4), m_rtpEncrypted(true)
+      m_rtpAuthLen(4), m_rtpEncrypted(true), m_rtpAead(false),
+      m_keyLen(16), m_saltLen(14)
 {
     DDebug(DebugAll,"RTPSecure::RTPSecure('%s') [%p]",suite.c_str(),this);
     if (suite == YSTRING("NULL")) {
 	m_rtpAuthLen = 0;
 	m_rtpEncrypted = false;
+	return;
+    }
+    const SrtpSuite* s = findSuite(suite);
+    if (s) {
+	m_rtpAuthLen = s->authLen;
+	m_rtpAead = s->aead;
+	m_keyLen = s->keyLen;
+	m_saltLen = s->saltLen;
     }
-    else if (suite == YSTRING("AES_CM_128_HMAC_SHA1_32"))
-	m_rtpAuthLen = 4;
-    else if (suite == YSTRING("AES_CM_128_HMAC_SHA1_80"))
-	m_rtpAuthLen = 10;
 }
 
 RTPSecure::RTPSecure(const RTPSecure& other)
     : GenObject(),
       m_owner(0), m_rtpCipher(0),
-      m_rtpAuthLen(other.m_rtpAuthLen), m_rtpEncrypted(other.m_rtpEncrypted)
+      m_rtpAuthLen(other.m_rtpAuthLen), m_rtpEncrypted(other.m_rtpEncrypted),
+      m_rtpAead(other.m_rtpAead), m_keyLen(other.m_keyLen), m_saltLen(other.m_saltLen)
 {
     DDebug(DebugAll,"RTPSecure::~RTPSecure(%p) [%p]",&other,this);
 }
@@ -74,7 +146,8 @@ bool RTPSecure::supported(RTPSession* session) const
 {
     if (m_owner && !session)
 	session = m_owner->session();
-    return session && session->checkCipher("aes_ctr");
+    return session && session->checkCipher("aes_ctr") &&
+	!(m_rtpAead && !session->checkCipher("aes_gcm"));
 }
 
 void RTPSecure::init()
@@ -83,14 +156,27 @@ void RTPSecure::init()
 	return;
     Debug(DebugInfo,"RTPSecure::init() encrypt=%s authlen=%d [%p]",
 	String::boolText(m_rtpEncrypted),m_rtpAuthLen,this);
-    m_owner->secLength(m_rtpAuthLen);
+    m_owner->secLength(m_rtpAuthLen,0,m_rtpAead);
     if ((m_rtpEncrypted || m_rtpAuthLen) && !m_rtpCipher && m_owner->session()) {
 	Cipher* cipher = m_owner->session()->createCipher("aes_ctr",Cipher::Bidir);
 	if (!cipher)
 	    return;
 	cipher->setKey(m_masterKey);
-	deriveKey(*cipher,m_cipherKey,16,0);
-	deriveKey(*cipher,m_cipherSalt,14,2);
+	if (m_rtpAead) {
+	    // AEAD suites derive only the session key and salt with the AES-CM PRF
+	    Cipher* aead = m_owner->session()->createCipher("aes_gcm",Cipher::Bidir);
+	    if (aead) {
+		deriveKey(*cipher,m_cipherKey,m_keyLen,0);
+		deriveKey(*cipher,m_cipherSalt,m_saltLen,2);
+		aead->setKey(m_cipherKey);
+		m_rtpCipher = aead;
+	    }
+	    TelEngine::destruct(cipher);
+	    DDebug(DebugInfo,"RTPSecure::init() got AEAD cipher=%p [%p]",aead,this);
+	    return;
+	}
+	deriveKey(*cipher,m_cipherKey,m_keyLen,0);
+	deriveKey(*cipher,m_cipherSalt,m_saltLen,2);
 	// add now the extra 16 bits since we need them for each packet
 	m_cipherSalt.append(s_16bit);
 	// prepare components of auth HMAC-SHA1
@@ -125,15 +211,21 @@ bool RTPSecure::setup(const String& cryptoSuite, const String& keyParams, const
 	m_rtpAuthLen = 0;
 	m_rtpEncrypted = false;
     }
-    else if (cryptoSuite == YSTRING("AES_CM_128_HMAC_SHA1_32"))
-	m_rtpAuthLen = 4;
-    else if (cryptoSuite == YSTRING("AES_CM_128_HMAC_SHA1_80"))
-	m_rtpAuthLen = 10;
     else {
-	Debug(DebugMild,"Unknown SRTP crypto suite '%s'",cryptoSuite.c_str());
-	return false;
+	const SrtpSuite* s = findSuite(cryptoSuite);
+	if (!s) {
+	    Debug(DebugMild,"Unknown SRTP crypto suite '%s'",cryptoSuite.c_str());
+	    return false;
+	}
+	m_rtpAuthLen = s->authLen;
+	m_rtpAead = s->aead;
+	m_keyLen = s->keyLen;
+	m_saltLen = s->saltLen;
     }
-    if (paramList && (0 != paramList->find("UNAUTHENTICATED_SRTP")))
+    // AEAD suites always encrypt and authenticate
+    if (m_rtpAead)
+	m_rtpEncrypted = true;
+    else if (paramList && (0 != paramList->find("UNAUTHENTICATED_SRTP")))
 	m_rtpAuthLen = 0;
     if (m_rtpEncrypted || m_rtpAuthLen) {
 	if (keyParams.null())
@@ -150,11 +242,11 @@ bool RTPSecure::setup(const String& cryptoSuite, const String& keyParams, const
 	    b64 << *key;
 	    if (!b64.decode(saltedKey,false))
 		break;
-	    if (saltedKey.length() != 30)
+	    if (saltedKey.length() != m_keyLen + m_saltLen)
 		break;
 	    char* sk = (char*)saltedKey.data();
-	    m_masterKey.assign(sk,16);
-	    m_masterSalt.assign(sk+16,14);
+	    m_masterKey.assign(sk,m_keyLen);
+	    m_masterSalt.assign(sk+m_keyLen,m_saltLen);
 	}
 	TelEngine::destruct(l);
 	if (err)
@@ -169,38 +261,38 @@ bool RTPSecure::create(String& suite, String& keyParams, bool buildMaster)
     if ((m_masterKey.null() || m_masterSalt.null()) && m_rtpAuthLen && !buildMaster)
 	return false;
     m_rtpEncrypted = true;
-    switch (m_rtpAuthLen) {
-	case 0:
-	    suite = "NULL";
-	    m_rtpEncrypted = false;
-	    break;
-	case 4:
-	    suite = "AES_CM_128_HMAC_SHA1_32";
-	    break;
-	case 10:
-	    suite = "AES_CM_128_HMAC_SHA1_80";
-	    break;
-	default:
+    if (m_rtpAuthLen) {
+	const SrtpSuite* s = s_suites;
+	for (; s->name; s++)
+	    if ((s->authLen == m_rtpAuthLen) && (s->aead == m_rtpAead) && (s->keyLen == m_keyLen))
+		break;
+	if (!s->name)
 	    return false;
+	suite = s->name;
+    }
+    else {
+	suite = "NULL";
+	m_rtpEncrypted = false;
     }
     bool needInit = m_masterKey.null() || m_masterSalt.null();
     if (needInit) {
+	// large enough for the key and salt of any suite
 #if 0
-	// Key Derivation Test Vectors from RFC 3711 B.3.
-	unsigned char sk[30] = {
+	// Key Derivation Test Vectors from RFC 3711 B.3, valid for 128 bit keys only
+	unsigned char sk[48] = {
 	    0xE1, 0xF9, 0x7A, 0x0D, 0x3E, 0x01, 0x8B, 0xE0, 0xD6, 0x4F, 0xA3, 0x2C, 0x06, 0xDE, 0x41, 0x39,
 	    0x0E, 0xC6, 0x75, 0xAD, 0x49, 0x8A, 0xFE, 0xEB, 0xB6, 0x96, 0x0B, 0x3A, 0xAB, 0xE6
 	    };
 #else
-	unsigned char sk[30];
+	unsigned char sk[48];
 	for (unsigned int i = 0; i < sizeof(sk);) {
 	    u_int16_t r = (u_int16_t)Random::random();
 	    sk[i++] = r & 0xff;
 	    sk[i++] = (r >> 8) & 0xff;
 	}
 #endif
-	m_masterKey.assign(sk,16);
-	m_masterSalt.assign(sk+16,14);
+	m_masterKey.assign(sk,m_keyLen);
+	m_masterSalt.assign(sk+m_keyLen,m_saltLen);
     }
     Base64 b64;
     b64 << m_masterKey << m_masterSalt;
@@ -241,25 +333,27 @@ bool RTPSecure::deriveKey(Cipher& cipher, DataBlock& key, unsigned int len, unsi
 
 bool RTPSecure::rtpDecipher(unsigned char* data, int len, const void* secData, u_int32_t ssrc, u_int64_t seq)
 {
-    if (!(m_rtpEncrypted && data))
+    // AEAD payloads were already deciphered while checking their integrity
+    if (!(m_rtpEncrypted && data) || m_rtpAead)
 	return true;
-    if (!(len && m_rtpCipher))
+    if (!(len && m_rtpCipher) || (m_cipherSalt.length() != 16))
 	return false;
-    DataBlock iv(m_cipherSalt);
+    unsigned char iv[16];
+    ::memcpy(iv,m_cipherSalt.data(),sizeof(iv));
     int i;
     // SSRC << 64
-    unsigned char* p = (iv.length() - 8) + (unsigned char*)iv.data();
+    unsigned char* p = iv + 8;
     for (i = 0; i < 4; i++) {
 	*--p ^= (ssrc & 0xff);
 	ssrc >>= 8;
     }
     // index << 16
-    p = (iv.length() - 2) + (unsigned char*)iv.data();
+    p = iv + 14;
     for (i = 0; i < 6; i++) {
 	*--p ^= (seq & 0xff);
 	seq >>= 8;
     }
-    m_rtpCipher->initVector(iv);
+    m_rtpCipher->initVector(iv,sizeof(iv));
     m_rtpCipher->decrypt(data,len);
     return true;
 }
@@ -270,6 +364,9 @@ bool RTPSecure::rtpCheckIntegrity(const unsigned char* data, int len, const void
 	return true;
     if (!(len && data && authData))
 	return false;
+    if (m_rtpAead)
+	return rtpAead(m_rtpCipher,m_cipherSalt,const_cast<unsigned char*>(data),len,
+	    const_cast<void*>(authData),ssrc,seq,false);
 
     // RFC 3711 4.2
     u_int32_t roc = htonl((u_int32_t)(seq >> 16));
@@ -297,7 +394,8 @@ bool RTPSecure::rtpCheckIntegrity(const unsigned char* data, int len, const void
 
 void RTPSecure::rtpEncipher(unsigned char* data, int len)
 {
-    if (!(len && data && m_rtpEncrypted && m_rtpCipher && m_owner))
+    // AEAD encryption is done together with adding the tag
+    if (!(len && data && m_rtpEncrypted && m_rtpCipher && m_owner) || m_rtpAead)
 	return;
     // SRTP is symmetrical as it just XORs the data with a keystream
     rtpDecipher(data,len,0,m_owner->ssrc(),m_owner->fullSeq());
@@ -307,6 +405,11 @@ void RTPSecure::rtpAddIntegrity(const unsigned char* data, int len, unsigned cha
 {
     if (!(m_rtpAuthLen && len && data && authData && m_owner))
 	return;
+    if (m_rtpAead) {
+	rtpAead(m_rtpCipher,m_cipherSalt,const_cast<unsigned char*>(data),len,
+	    authData,m_owner->ssrc(),m_owner->fullSeq(),true);
+	return;
+    }
 
     // RFC 3711 4.2
     u_int32_t roc = htonl(m_owner->rollover());
@@ -130,13 +130,8 @@ void RTPReceiver::rtpData(const void* data, int len)
 	len -= m_secLen;
 	secPtr = pc + len;
     }
-    // check if padding is present and remove it (but remember length)
-    unsigned char padding = 0;
-    if (pc[0] & 0x20) {
-	len -= (padding = pc[len-1]);
-	if (len < 12)
-	    return;
-    }
+    // padding is encrypted in SRTP so it is removed only after deciphering
+    bool padded = (pc[0] & 0x20) != 0;
 
     bool ext = (pc[0] & 0x10) != 0;
     int cc = pc[0] & 0x0f;
@@ -151,18 +146,17 @@ void RTPReceiver::rtpData(const void* data, int len)
     // skip over header and any CSRC
     pc += 12+(4*cc);
     len -= 12+(4*cc);
-    // check if extension is present and skip it
+    // check if extension is present and skip it, length is in 32 bit words
     if (ext) {
 	if (len < 4)
 	    return;
-	int xl = ((int)pc[2] << 8) | pc[3];
+	int xl = 4 * (((int)pc[2] << 8) | pc[3]);
 	pc += xl+4;
 	len -= xl+4;
     }
     if (len < 0)
 	return;
-    if (!len)
-	pc = 0;
+    int hlen = pc - (const unsigned char*)data;
 
     // grab some data at the first packet received or resync
     if (m_ssrcInit) {
@@ -206,7 +200,7 @@ void RTPReceiver::rtpData(const void* data, int len)
     seq48 = (seq48 << 16) | seq;
 
     // if some security data is present authenticate the packet now
-    if (secPtr && !rtpCheckIntegrity((const unsigned char*)data,len + padding + 12,secPtr + m_mkiLen,ss,seq48))
+    if (secPtr && !rtpCheckIntegrity((const unsigned char*)data,hlen + len,secPtr + m_authOffs,ss,seq48))
 	return;
 
     // substraction with overflow to compute sequence difference
@@ -261,8 +255,15 @@ void RTPReceiver::rtpData(const void* data, int len)
 	return;
     }
 
-    if (!rtpDecipher(const_cast<unsigned char*>(pc),len + padding,secPtr,ss,seq48))
+    if (!rtpDecipher(const_cast<unsigned char*>(len ? pc : 0),len,secPtr,ss,seq48))
 	return;
+    if (padded) {
+	if (!len || (pc[len-1] > len))
+	    return;
+	len -= pc[len-1];
+    }
+    if (!len)
+	pc = 0;
 
     m_tsLast = ts - m_ts;
     m_seqCount = 0;
@@ -273,7 +274,7 @@ void RTPReceiver::rtpData(const void* data, int len)
     m_rollover = rollover;
 
     if (m_dejitter) {
-	if (!m_dejitter->rtpRecv(marker,typ,m_tsLast,pc,len))
+	if (!m_dejitter->rtpRecv(marker,typ,m_tsLast,seq,pc,len))
 	    m_ioLostPkt++;
 	return;
     }
@@ -311,6 +312,11 @@ bool RTPReceiver::rtpRecvEvent(int event, char key, int duration, int volume, un
     return m_session && m_session->rtpRecvEvent(event,key,duration,volume,timestamp);
 }
 
+bool RTPReceiver::rtpConcealData(unsigned int timestamp, const void* data, int len, unsigned int count)
+{
+    return m_session && m_session->rtpConcealData(timestamp,data,len,count);
+}
+
 void RTPReceiver::rtpNewPayload(int payload, unsigned int timestamp)
 {
     if (m_session)
@@ -404,6 +410,8 @@ void RTPReceiver::stats(NamedList& stat) const
     stat.setParam("synclost",String(m_syncLost));
     stat.setParam("wrongssrc",String(m_wrongSSRC));
     stat.setParam("seqslost",String(m_seqLost));
+    if (m_dejitter)
+	m_dejitter->stats(stat);
 }
 
 
@@ -467,7 +475,7 @@ bool RTPSender::rtpSend(bool marker, int payload, unsigned int timestamp, const
 	rtpEncipher(pc,len + padding);
     }
     if (m_secLen)
-	rtpAddIntegrity((const unsigned char*)m_buffer.data(),len + padding + 12,pc + (len + padding + m_mkiLen));
+	rtpAddIntegrity((const unsigned char*)m_buffer.data(),len + padding + 12,pc + (len + padding + m_authOffs));
     static_cast<RTPProcessor*>(m_session->UDPSession::transport())->rtpData(m_buffer.data(),m_buffer.length());
     return true;
 }
@@ -742,6 +750,13 @@ bool RTPSession::rtpRecvEvent(int event, char key, int duration, int volume, uns
     return false;
 }
 
+bool RTPSession::rtpConcealData(unsigned int timestamp, const void* data, int len, unsigned int count)
+{
+    XDebug(DebugAll,"RTPSession::rtpConcealData(%u,%p,%d,%u) [%p]",
+	timestamp,data,len,count,this);
+    return false;
+}
+
 void RTPSession::rtpNewPayload(int payload, unsigned int timestamp)
 {
     XDebug(DebugAll,"RTPSession::rtpNewPayload(%d,%u) [%p]",
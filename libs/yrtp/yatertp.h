@@ -349,8 +349,9 @@ private:
 /**
  * A dejitter buffer that can be inserted in the receive data path to
  *  absorb variations in packet arrival time. Incoming packets are stored
- *  and forwarded at fixed intervals.
- * @short Dejitter buffer for incoming data packets
+ *  in a preallocated ring indexed by sequence number and played out with
+ *  a delay that follows the measured interarrival jitter.
+ * @short Adaptive dejitter buffer for incoming data packets
  */
 class YRTP_API RTPDejitter : public RTPProcessor
 {
@@ -369,7 +370,7 @@ public:
     virtual ~RTPDejitter();
 
     /**
-     * Process and store one RTP data packet
+     * Process and store one RTP data packet, packets are assumed to be in sequence
      * @param marker True if the marker bit is set in data packet
      * @param payload Payload number
      * @param timestamp Sampling instant of the packet data
@@ -380,11 +381,65 @@ public:
     virtual bool rtpRecv(bool marker, int payload, unsigned int timestamp,
 	const void* data, int len);
 
+    /**
+     * Process and store one RTP data packet in the slot of its sequence number
+     * @param marker True if the marker bit is set in data packet
+     * @param payload Payload number
+     * @param timestamp Sampling instant of the packet data
+     * @param seq Sequence number of the packet
+     * @param data Pointer to data block to process
+     * @param len Length of the data block in bytes
+     * @return True if the data packet was queued
+     */
+    bool rtpRecv(bool marker, int payload, unsigned int timestamp,
+	u_int16_t seq, const void* data, int len);
+
     /**
      * Clear the delayed packets queue and all variables
      */
     void clear();
 
+    /**
+     * Retrieve the number of packets that arrived after their playout time
+     * @return Number of packets dropped for being late
+     */
+    inline u_int32_t packetsLate() const
+	{ return m_late; }
+
+    /**
+     * Retrieve the number of packets missing at their playout time
+     * @return Number of packets lost or concealed
+     */
+    inline u_int32_t packetsLost() const
+	{ return m_lost; }
+
+    /**
+     * Retrieve the number of packets currently held in the buffer
+     * @return Current buffer depth in packets
+     */
+    inline unsigned int depth() const
+	{ return m_depth; }
+
+    /**
+     * Retrieve the playout delay the buffer currently aims for
+     * @return Target delay in microseconds
+     */
+    inline unsigned int delay() const
+	{ return m_target; }
+
+    /**
+     * Retrieve the estimated interarrival jitter
+     * @return Smoothed jitter in microseconds
+     */
+    inline unsigned int jitter() const
+	{ return m_jitter; }
+
+    /**
+     * Retrieve the statistical data of the buffer in a NamedList
+     * @param stat NamedList to populate with the values for different counters
+     */
+    void stats(NamedList& stat) const;
+
 protected:
     /**
      * Method called periodically to keep the data flowing
@@ -393,15 +448,43 @@ protected:
     virtual void timerTick(const Time& when);
 
 private:
-    ObjList m_packets;
+    struct Slot {
+	u_int16_t seq;
+	bool used;
+	bool marker;
+	int payload;
+	unsigned int stamp;
+	unsigned char* data;
+	unsigned int size;
+	int len;
+    };
+    u_int64_t dueTime(unsigned int timestamp) const;
+    void restart(u_int16_t seq, unsigned int timestamp, u_int64_t now);
+    void arrival(unsigned int timestamp, u_int64_t now);
+    void deliver(Slot& slot);
+    Slot* m_slots;
+    unsigned int m_mask;
+    unsigned int m_depth;
     RTPReceiver* m_receiver;
     unsigned int m_minDelay;
     unsigned int m_maxDelay;
-    unsigned int m_headStamp;
-    unsigned int m_tailStamp;
-    u_int64_t m_headTime;
+    unsigned int m_target;
+    unsigned int m_jitter;
+    bool m_playing;
+    u_int16_t m_playSeq;
+    u_int16_t m_inSeq;
+    unsigned int m_baseStamp;
+    u_int64_t m_baseTime;
+    unsigned int m_lastStamp;
+    int m_lastSlot;
+    unsigned int m_conceal;
+    unsigned int m_arrStamp;
+    u_int64_t m_arrTime;
+    unsigned int m_refStamp;
+    u_int64_t m_refTime;
     u_int64_t m_sampRate;
-    unsigned char m_fastRate;
+    u_int32_t m_late;
+    u_int32_t m_lost;
 };
 
 /**
@@ -419,7 +502,7 @@ public:
     inline RTPBaseIO(RTPSession* session = 0)
 	: m_session(session), m_secure(0),
 	  m_ssrcInit(true), m_ssrc(0), m_ts(0),
-	  m_seq(0), m_rollover(0), m_secLen(0), m_mkiLen(0),
+	  m_seq(0), m_rollover(0), m_secLen(0), m_mkiLen(0), m_authOffs(0),
 	  m_evTs(0), m_evNum(-1), m_evVol(-1),
 	  m_ioPackets(), m_ioOctets(0), m_tsLast(0),
 	  m_dataType(-1), m_eventType(-1), m_silenceType(-1)
@@ -571,9 +654,11 @@ protected:
      * Set the length of the added / expected security info block
      * @param len Length of security information portion
      * @param key Length of master key identifier
+     * @param tagFirst True if the authentication tag precedes the master key
+     *  identifier (AEAD suites, RFC 7714), false if it follows it (RFC 3711)
      */
-    inline void secLength(u_int32_t len, u_int32_t key = 0)
-	{ m_secLen = len; m_mkiLen = key; }
+    inline void secLength(u_int32_t len, u_int32_t key = 0, bool tagFirst = false)
+	{ m_secLen = len; m_mkiLen = key; m_authOffs = tagFirst ? 0 : key; }
 
     RTPSession* m_session;
     RTPSecure* m_secure;
@@ -584,6 +669,7 @@ protected:
     u_int32_t m_rollover;
     u_int16_t m_secLen;
     u_int16_t m_mkiLen;
+    u_int16_t m_authOffs;
     u_int32_t m_evTs;
     int m_evNum;
     int m_evVol;
@@ -679,6 +765,19 @@ public:
     virtual bool rtpRecvEvent(int event, char key, int duration,
 	int volume, unsigned int timestamp);
 
+    /**
+     * Method called by the dejitter buffer when a data packet is missing
+     *  at its playout time. This is a good opportunity to synthesize a
+     *  replacement from the previous data packet.
+     * @param timestamp Sampling instant of the missing packet data
+     * @param data Pointer to the data of the last packet played out
+     * @param len Length of the last packet data in bytes
+     * @param count Number of consecutive packets concealed so far, including this one
+     * @return True if data was generated
+     */
+    virtual bool rtpConcealData(unsigned int timestamp, const void* data, int len,
+	unsigned int count);
+
     /**
      * Method called for unknown payload types just before attempting
      *  to call rtpRecvData(). This is a good opportunity to change the
@@ -1048,6 +1147,19 @@ public:
     virtual bool rtpRecvEvent(int event, char key, int duration,
 	int volume, unsigned int timestamp);
 
+    /**
+     * Method called by the dejitter buffer when a data packet is missing
+     *  at its playout time. This is a good opportunity to synthesize a
+     *  replacement from the previous data packet.
+     * @param timestamp Sampling instant of the missing packet data
+     * @param data Pointer to the data of the last packet played out
+     * @param len Length of the last packet data in bytes
+     * @param count Number of consecutive packets concealed so far, including this one
+     * @return True if data was generated
+     */
+    virtual bool rtpConcealData(unsigned int timestamp, const void* data, int len,
+	unsigned int count);
+
     /**
      * Method called for unknown payload types just before attempting
      *  to call rtpRecvData(). This is a good opportunity to change the
@@ -1566,6 +1678,9 @@ private:
     SHA1 m_authOpad;
     u_int32_t m_rtpAuthLen;
     bool m_rtpEncrypted;
+    bool m_rtpAead;
+    unsigned int m_keyLen;
+    unsigned int m_saltLen;
 };
 
 }
@@ -36,7 +36,7 @@ class JsContext : public JsObject, public Mutex
     YCLASS(JsContext,JsObject)
 public:
     inline JsContext()
-	: JsObject("Context",this), Mutex(true,"JsContext")
+	: JsObject("Context",this), Mutex(true,"JsContext"), m_forkData(127)
 	{
 	    params().addParam(new ExpFunction("isNaN"));
 	    params().addParam(new ExpFunction("parseInt"));
@@ -45,9 +45,11 @@ public:
     virtual bool runFunction(ObjList& stack, const ExpOperation& oper, GenObject* context);
     virtual bool runField(ObjList& stack, const ExpOperation& oper, GenObject* context);
     virtual bool runAssign(ObjList& stack, const ExpOperation& oper, GenObject* context);
-    GenObject* resolve(ObjList& stack, String& name, GenObject* context);
+    GenObject* resolve(ObjList& stack, String& name, GenObject* context, bool write = false);
     bool runStringFunction(GenObject* obj, const String& name, ObjList& stack, const ExpOperation& oper, GenObject* context);
     bool runStringField(GenObject* obj, const String& name, ObjList& stack, const ExpOperation& oper, GenObject* context);
+    // Script data objects each fork of this context gets a private copy of
+    HashList m_forkData;
 private:
     GenObject* resolveTop(ObjList& stack, const String& name, GenObject* context);
 };
@@ -101,6 +103,91 @@ struct JsEntry
     unsigned int index;
 };
 
+// Dotted field name split once when code is linked
+// The parts keep their computed hash so each step is a hashed property lookup
+// No per call site object cache is kept here: linked code is shared by all
+//  contexts of a script, often running in several threads at once
+class JsFieldPath : public String
+{
+public:
+    inline explicit JsFieldPath(const String& name)
+	: String(name), m_parts(name.split('.',true))
+	{ }
+    virtual ~JsFieldPath()
+	{ TelEngine::destruct(m_parts); }
+    inline const ObjList* parts() const
+	{ return m_parts; }
+private:
+    ObjList* m_parts;
+};
+
+// Size of the unboxed value stack of compiled code
+#define JS_VALUES 16
+
+// Instruction of code lowered to bytecode
+struct JsInstr
+{
+    enum Type {
+	Oper = 0,  // run the original operation
+	Nop,       // no effect, label or empty operation
+	Push,      // push an unboxed number or boolean
+	Value,     // read a field that is used right away as operand
+	Binary,    // arithmetic, bitwise or comparison operator
+	Unary,     // negation, bitwise or logical not
+	Drop,      // drop top of stack
+	End,       // end of block keeping the top value
+	Flush,     // end of block dropping all values
+	Trim,      // drop all values of the block, keep it open
+	Jump,      // unconditional relative jump
+	JumpTrue,  // relative jump if true
+	JumpFalse, // relative jump if false
+    };
+    unsigned char type;
+    bool boolean;
+    int opcode;
+    int64_t value;
+    const ExpOperation* oper;
+};
+
+// Value kept unboxed on the compiled code stack
+struct JsValue
+{
+    int64_t number;
+    bool boolean;
+};
+
+// Operand of compiled code, either unboxed or popped from the generic stack
+class JsOperand
+{
+public:
+    inline JsOperand()
+	: m_oper(0), m_number(0), m_bool(false)
+	{ }
+    inline ~JsOperand()
+	{ TelEngine::destruct(m_oper); }
+    inline void set(const JsValue& val)
+	{ m_number = val.number; m_bool = val.boolean; }
+    inline void set(ExpOperation* oper)
+	{ m_oper = oper; }
+    inline ExpOperation* oper() const
+	{ return m_oper; }
+    inline bool isNumber() const
+	{ return !m_oper || m_oper->isNumber(); }
+    inline int64_t valInteger() const
+	{ return m_oper ? m_oper->valInteger() : (m_number != ExpOperation::nonInteger() ? m_number : 0); }
+    inline int64_t toNumber() const
+	{ return m_oper ? m_oper->toNumber() : m_number; }
+    // NaN is true like its non empty "NaN" text in the interpreter
+    inline bool valBoolean() const
+	{ return m_oper ? m_oper->valBoolean() : (m_number != 0); }
+    void append(String& buf) const;
+    bool equals(const JsOperand& other) const;
+private:
+    ExpOperation* m_oper;
+    int64_t m_number;
+    bool m_bool;
+};
+
 class JsCode : public ScriptCode, public ExpEvaluator
 {
     friend class TelEngine::JsFunction;
@@ -112,6 +199,7 @@ public:
 	OpcBegin = OpcPrivate + 1,
 	OpcEnd,
 	OpcFlush,
+	OpcTrim,
 	OpcIndex,
 	OpcEqIdentity,
 	OpcNeIdentity,
@@ -155,7 +243,7 @@ public:
     };
     inline JsCode()
 	: ExpEvaluator(C),
-	  m_pragmas(""), m_label(0), m_depth(0), m_entries(0), m_traceable(false)
+	  m_pragmas(""), m_label(0), m_depth(0), m_entries(0), m_program(0), m_traceable(false)
 	{ debugName("JsCode"); }
     ~JsCode();
     virtual void* getObject(const String& name) const
@@ -171,9 +259,11 @@ public:
     virtual ScriptRun* createRunner(ScriptContext* context, const char* title);
     virtual bool null() const;
     virtual void dump(String& res, bool loneNo = false) const;
-    bool link();
+    bool link(bool bytecode = false);
     inline bool traceable() const
 	{ return m_traceable; }
+    inline const ObjList* fieldPath(const String& name) const
+	{ const JsFieldPath* p = static_cast<const JsFieldPath*>(m_paths[name]); return p ? p->parts() : 0; }
     JsObject* parseArray(ParsePoint& expr, bool constOnly, Mutex* mtx);
     JsObject* parseObject(ParsePoint& expr, bool constOnly, Mutex* mtx);
     inline const NamedList& pragmas() const
@@ -230,6 +320,10 @@ private:
     bool parseSimple(ParsePoint& expr, bool constOnly, Mutex* mtx = 0);
     bool evalList(ObjList& stack, GenObject* context) const;
     bool evalVector(ObjList& stack, GenObject* context) const;
+    bool evalProgram(ObjList& stack, GenObject* context) const;
+    bool runBinary(ObjList& stack, const JsInstr& instr, JsValue* vals, unsigned int& sp, GenObject* context) const;
+    bool popOperand(JsOperand& oper, ObjList& stack, JsValue* vals, unsigned int& sp, GenObject* context) const;
+    void lower();
     bool jumpToLabel(long int label, GenObject* context) const;
     bool jumpRelative(long int offset, GenObject* context) const;
     bool jumpAbsolute(long int index, GenObject* context) const;
@@ -246,6 +340,8 @@ private:
     long int m_label;
     int m_depth;
     JsEntry* m_entries;
+    JsInstr* m_program;
+    HashList m_paths;
     bool m_traceable;
 };
 
@@ -533,6 +629,7 @@ static const TokenDict s_internals[] =
     MAKEOP(Begin),
     MAKEOP(End),
     MAKEOP(Flush),
+    MAKEOP(Trim),
     MAKEOP(Jump),
     MAKEOP(JumpTrue),
     MAKEOP(JumpFalse),
@@ -558,17 +655,23 @@ GenObject* JsContext::resolveTop(ObjList& stack, const String& name, GenObject*
     return this;
 }
 
-GenObject* JsContext::resolve(ObjList& stack, String& name, GenObject* context)
+GenObject* JsContext::resolve(ObjList& stack, String& name, GenObject* context, bool write)
 {
     GenObject* obj = 0;
     if (name.find('.') < 0)
 	obj = resolveTop(stack,name,context);
     else {
-	ObjList* list = name.split('.',true);
+	ObjList* list = 0;
+	const ObjList* parts = 0;
+	const JsRunner* runner = YOBJECT(JsRunner,context);
+	if (runner && runner->code())
+	    parts = static_cast<const JsCode*>(runner->code())->fieldPath(name);
+	if (!parts)
+	    parts = list = name.split('.',true);
 	name.clear();
-	for (ObjList* l = list->skipNull(); l; ) {
+	for (const ObjList* l = parts->skipNull(); l; ) {
 	    const String* s = static_cast<const String*>(l->get());
-	    ObjList* l2 = l->skipNext();
+	    const ObjList* l2 = l->skipNext();
 	    if (TelEngine::null(s)) {
 		// consecutive dots - not good
 		obj = 0;
@@ -584,6 +687,17 @@ GenObject* JsContext::resolve(ObjList& stack, String& name, GenObject* context)
 		GenObject* adv = ext->getField(stack,name,context);
 		XDebug(DebugAll,"JsContext::resolve advanced to '%s' of %p for '%s'",
 		    (adv ? adv->toString().c_str() : 0),ext,s->c_str());
+		if (write && adv && (obj == this) && !params().getParam(name)) {
+		    // function inherited from a forked context, modify a private copy
+		    const JsFunction* jf = YOBJECT(JsFunction,adv);
+		    if (jf) {
+			JsObject* nf = jf->copy(mutex(),jf->getFunc()->name());
+			const ExpOperation* op = YOBJECT(ExpOperation,adv);
+			ExpWrapper* w = new ExpWrapper(nf,name,op && op->barrier());
+			params().setParam(w);
+			adv = w;
+		    }
+		}
 		if (adv) {
 		    if (YOBJECT(ExpExtender,adv)) {
 			obj = adv;
@@ -607,6 +721,80 @@ GenObject* JsContext::resolve(ObjList& stack, String& name, GenObject* context)
     return obj;
 }
 
+// Drop all values from stack up to and including the block begin marker
+static bool flushBlock(ObjList& stack)
+{
+    ExpOperation* o;
+    while ((o = static_cast<ExpOperation*>(stack.remove(false)))) {
+	bool done = (o->opcode() == (ExpEvaluator::Opcode)JsCode::OpcBegin);
+	TelEngine::destruct(o);
+	if (done)
+	    return true;
+    }
+    return false;
+}
+
+// Drop the values left on stack by statements of a loop, keep the block marker
+static bool trimBlock(ObjList& stack)
+{
+    for (;;) {
+	ObjList* l = stack.skipNull();
+	if (!l)
+	    return false;
+	if (static_cast<ExpOperation*>(l->get())->opcode() == (ExpEvaluator::Opcode)JsCode::OpcBegin)
+	    return true;
+	l->remove();
+    }
+}
+
+// Move unboxed values to the generic stack
+static void spillValues(ObjList& stack, JsValue* vals, unsigned int& sp)
+{
+    for (unsigned int i = 0; i < sp; i++) {
+	if (vals[i].boolean)
+	    ExpEvaluator::pushOne(stack,new ExpOperation(vals[i].number != 0));
+	else
+	    ExpEvaluator::pushOne(stack,new ExpOperation(vals[i].number));
+    }
+    sp = 0;
+}
+
+
+void JsOperand::append(String& buf) const
+{
+    if (m_oper)
+	buf << *m_oper;
+    else if (m_bool)
+	buf << String::boolText(m_number != 0);
+    else if (m_number != ExpOperation::nonInteger())
+	buf << m_number;
+    else
+	buf << "NaN";
+}
+
+// Same rules as the == operator of the expression evaluator
+// Unboxed values compare by the text they would have when boxed
+bool JsOperand::equals(const JsOperand& other) const
+{
+    if (m_oper && other.m_oper) {
+	ExpWrapper* w1 = YOBJECT(ExpWrapper,m_oper);
+	ExpWrapper* w2 = YOBJECT(ExpWrapper,other.m_oper);
+	if (m_oper->opcode() == other.m_oper->opcode() && w1 && w2)
+	    return w1->object() == w2->object();
+	return *m_oper == *other.m_oper;
+    }
+    if (!(m_oper || other.m_oper))
+	return (m_bool == other.m_bool) && (m_number == other.m_number);
+    String tmp;
+    if (m_oper) {
+	other.append(tmp);
+	return *m_oper == tmp;
+    }
+    append(tmp);
+    return *other.m_oper == tmp;
+}
+
+
 bool JsContext::runFunction(ObjList& stack, const ExpOperation& oper, GenObject* context)
 {
     XDebug(DebugAll,"JsContext::runFunction '%s' [%p]",oper.name().c_str(),this);
@@ -912,7 +1100,7 @@ bool JsContext::runAssign(ObjList& stack, const ExpOperation& oper, GenObject* c
     XDebug(DebugAll,"JsContext::runAssign '%s'='%s' (%s) [%p]",
 	oper.name().c_str(),oper.c_str(),oper.typeOf(),this);
     String name = oper.name();
-    GenObject* o = resolve(stack,name,context);
+    GenObject* o = resolve(stack,name,context,true);
     if (o && o != this) {
 	ExpExtender* ext = YOBJECT(ExpExtender,o);
 	if (ext) {
@@ -929,6 +1117,7 @@ bool JsContext::runAssign(ObjList& stack, const ExpOperation& oper, GenObject* c
 JsCode::~JsCode()
 {
     delete[] m_entries;
+    delete[] m_program;
 }
 
 // Initialize standard globals in the execution context
@@ -956,7 +1145,13 @@ bool JsCode::evaluate(ScriptRun& runner, ObjList& results) const
 {
     if (null())
 	return false;
-    bool ok = m_linked.length() ? evalVector(results,&runner) : evalList(results,&runner);
+    bool ok = false;
+    if (!m_linked.length())
+	ok = evalList(results,&runner);
+    else if (m_program && !static_cast<JsRunner&>(runner).tracing())
+	ok = evalProgram(results,&runner);
+    else
+	ok = evalVector(results,&runner);
     if (!ok)
 	return false;
     if (static_cast<JsRunner&>(runner).m_paused)
@@ -967,21 +1162,36 @@ bool JsCode::evaluate(ScriptRun& runner, ObjList& results) const
 }
 
 // Convert list to vector and fix label relocations
-bool JsCode::link()
+bool JsCode::link(bool bytecode)
 {
     if (!m_opcodes.skipNull())
 	return false;
     m_linked.assign(m_opcodes);
     delete[] m_entries;
     m_entries = 0;
+    delete[] m_program;
+    m_program = 0;
+    m_paths.clear();
     unsigned int n = m_linked.count();
     if (!n)
 	return false;
     unsigned int entries = 0;
     for (unsigned int i = 0; i < n; i++) {
 	const ExpOperation* l = static_cast<const ExpOperation*>(m_linked[i]);
-	if (!l || l->opcode() != OpcLabel)
+	if (!l)
 	    continue;
+	switch (l->opcode()) {
+	    case OpcField:
+	    case OpcFunc:
+		// split dotted names now instead of at each access
+		if (l->name().find('.') > 0 && !m_paths[l->name()])
+		    m_paths.append(new JsFieldPath(l->name()));
+		continue;
+	    case OpcLabel:
+		break;
+	    default:
+		continue;
+	}
 	long int lbl = (long int)l->number();
 	if (lbl >= 0 && l->barrier())
 	    entries++;
@@ -1022,9 +1232,121 @@ bool JsCode::link()
 	m_entries[entries].number = -1;
 	m_entries[entries].index = 0;
     }
+    if (bytecode)
+	lower();
     return true;
 }
 
+// Translate linked operations to bytecode, one instruction for each
+void JsCode::lower()
+{
+    unsigned int n = m_linked.length();
+    m_program = new JsInstr[n];
+    unsigned int fast = 0;
+    for (unsigned int i = 0; i < n; i++) {
+	const ExpOperation* o = static_cast<const ExpOperation*>(m_linked[i]);
+	JsInstr& instr = m_program[i];
+	instr.type = JsInstr::Oper;
+	instr.boolean = false;
+	instr.opcode = o ? o->opcode() : OpcNone;
+	instr.value = 0;
+	instr.oper = o;
+	if (!o) {
+	    instr.type = JsInstr::Nop;
+	    continue;
+	}
+	switch (instr.opcode) {
+	    case OpcNone:
+	    case OpcLabel:
+		instr.type = JsInstr::Nop;
+		break;
+	    case OpcPush:
+		// only plain constants whose text matches the number can be unboxed
+		if (o->name().null() && o->isNumber() && o->isInteger()
+			&& !YOBJECT(ExpWrapper,o) && !YOBJECT(ExpFunction,o)) {
+		    if (o->isBoolean() ? (*o == String::boolText(o->number() != 0))
+			    : (*o == String(o->number()))) {
+			instr.type = JsInstr::Push;
+			instr.boolean = o->isBoolean();
+			instr.value = o->number();
+		    }
+		}
+		break;
+	    case OpcAdd:
+	    case OpcSub:
+	    case OpcMul:
+	    case OpcDiv:
+	    case OpcMod:
+	    case OpcAnd:
+	    case OpcOr:
+	    case OpcXor:
+	    case OpcShl:
+	    case OpcShr:
+	    case OpcLAnd:
+	    case OpcLOr:
+	    case OpcEq:
+	    case OpcNe:
+	    case OpcLt:
+	    case OpcGt:
+	    case OpcLe:
+	    case OpcGe:
+		instr.type = JsInstr::Binary;
+		break;
+	    case OpcNeg:
+	    case OpcNot:
+	    case OpcLNot:
+		instr.type = JsInstr::Unary;
+		break;
+	    case OpcDrop:
+		instr.type = JsInstr::Drop;
+		break;
+	    case OpcEnd:
+		instr.type = JsInstr::End;
+		break;
+	    case OpcFlush:
+		instr.type = JsInstr::Flush;
+		break;
+	    case OpcTrim:
+		instr.type = JsInstr::Trim;
+		break;
+	    case OpcJRel:
+		instr.type = JsInstr::Jump;
+		instr.value = o->number();
+		break;
+	    case OpcJRelTrue:
+		instr.type = JsInstr::JumpTrue;
+		instr.value = o->number();
+		break;
+	    case OpcJRelFalse:
+		instr.type = JsInstr::JumpFalse;
+		instr.value = o->number();
+		break;
+	}
+	if (instr.type != JsInstr::Oper)
+	    fast++;
+    }
+    // fields consumed by the next operator are read at once
+    for (unsigned int i = 0; i + 1 < n; i++) {
+	JsInstr& instr = m_program[i];
+	if (instr.type != JsInstr::Oper || instr.opcode != OpcField)
+	    continue;
+	switch (m_program[i + 1].type) {
+	    case JsInstr::Binary:
+	    case JsInstr::Unary:
+		break;
+	    case JsInstr::Push:
+		if (i + 2 < n && m_program[i + 2].type == JsInstr::Binary)
+		    break;
+		continue;
+	    default:
+		continue;
+	}
+	instr.type = JsInstr::Value;
+	fast++;
+    }
+    DDebug(this,DebugAll,"Lowered %u operations, %u run as bytecode",n,fast);
+}
+
 const String& JsCode::getFileAt(unsigned int index) const
 {
     if (!index)
@@ -1674,6 +1996,7 @@ bool JsCode::parseFor(ParsePoint& expr, GenObject* nested)
 	if (skipComments(++expr) != ';') {
 	    check = ++m_label;
 	    addOpcode(OpcLabel,check);
+	    addOpcode((Opcode)OpcTrim);
 	    addOpcode((Opcode)OpcBegin);
 	    // parse condition
 	    if (!runCompile(expr))
@@ -1689,6 +2012,7 @@ bool JsCode::parseFor(ParsePoint& expr, GenObject* nested)
 	else {
 	    cont = ++m_label;
 	    addOpcode(OpcLabel,cont);
+	    addOpcode((Opcode)OpcTrim);
 	    addOpcode((Opcode)OpcBegin);
 	    // parse increment
 	    if (!runCompile(expr,')'))
@@ -1707,6 +2031,8 @@ bool JsCode::parseFor(ParsePoint& expr, GenObject* nested)
 	return gotError("Expecting ')'",expr);
     ParseLoop parseStack(this,nested,OpcFor,cont,jump);
     addOpcode(OpcLabel,body);
+    if (cont == body)
+	addOpcode((Opcode)OpcTrim);
     if (!getOneInstruction(++expr,parseStack))
 	return false;
     addOpcode((Opcode)OpcJump,cont);
@@ -1722,6 +2048,7 @@ bool JsCode::parseWhile(ParsePoint& expr, GenObject* nested)
     addOpcode((Opcode)OpcBegin);
     int64_t cont = ++m_label;
     addOpcode(OpcLabel,cont);
+    addOpcode((Opcode)OpcTrim);
     if (!runCompile(++expr,')'))
 	return false;
     if (skipComments(expr) != ')')
@@ -2141,20 +2468,16 @@ bool JsCode::runOperation(ObjList& stack, const ExpOperation& oper, GenObject* c
 			break;
 		    }
 		}
-		bool done = false;
-		ExpOperation* o;
-		while ((o = static_cast<ExpOperation*>(stack.remove(false)))) {
-		    done = (o->opcode() == (Opcode)OpcBegin);
-		    TelEngine::destruct(o);
-		    if (done)
-			break;
-		}
-		if (!done)
+		if (!flushBlock(stack))
 		    return gotError("ExpEvaluator stack underflow",oper.lineNumber());
 		if (op)
 		    pushOne(stack,op);
 	    }
 	    break;
+	case OpcTrim:
+	    if (!trimBlock(stack))
+		return gotError("ExpEvaluator stack underflow",oper.lineNumber());
+	    break;
 	case OpcIndex:
 	    {
 		ExpOperation* op2 = popValue(stack,context);
@@ -2597,12 +2920,12 @@ void JsCode::resolveObjectParams(JsObject* object, ObjList& stack, GenObject* co
     if (!ctx)
 	return;
     JsObject* objProto = 0;
-    JsFunction* objCtr = YOBJECT(JsFunction,ctx->params().getParam(YSTRING("Object")));
+    JsFunction* objCtr = YOBJECT(JsFunction,ctx->getField(stack,YSTRING("Object"),context));
     if (objCtr)
 	objProto = YOBJECT(JsObject,objCtr->params().getParam(YSTRING("prototype")));
 
     JsArray* arrayProto = 0;
-    objCtr = YOBJECT(JsFunction,ctx->params().getParam(YSTRING("Array")));
+    objCtr = YOBJECT(JsFunction,ctx->getField(stack,YSTRING("Array"),context));
     if (objCtr)
 	arrayProto = YOBJECT(JsArray,objCtr->params().getParam(YSTRING("prototype")));
 
@@ -2676,6 +2999,242 @@ bool JsCode::evalVector(ObjList& stack, GenObject* context) const
     return true;
 }
 
+// Run bytecode, operations that can't use unboxed values run on the generic stack
+bool JsCode::evalProgram(ObjList& stack, GenObject* context) const
+{
+    XDebug(this,DebugInfo,"JsCode::evalProgram(%p,%p)",&stack,context);
+    JsRunner* runner = static_cast<JsRunner*>(context);
+    unsigned int& index = runner->m_index;
+    unsigned int n = m_linked.length();
+    JsValue vals[JS_VALUES];
+    unsigned int sp = 0;
+    while (index < n) {
+	if (runner->m_tracing) {
+	    spillValues(stack,vals,sp);
+	    return evalVector(stack,context);
+	}
+	const JsInstr& instr = m_program[index++];
+	switch (instr.type) {
+	    case JsInstr::Nop:
+		continue;
+	    case JsInstr::Push:
+		if (sp >= JS_VALUES)
+		    spillValues(stack,vals,sp);
+		vals[sp].number = instr.value;
+		vals[sp++].boolean = instr.boolean;
+		continue;
+	    case JsInstr::Value:
+		spillValues(stack,vals,sp);
+		if (!runField(stack,*instr.oper,context))
+		    return gotError("ExpEvaluator stack underflow",instr.oper->lineNumber());
+		continue;
+	    case JsInstr::Binary:
+		if (!runBinary(stack,instr,vals,sp,context))
+		    return false;
+		continue;
+	    case JsInstr::Unary:
+		{
+		    JsOperand op;
+		    if (!popOperand(op,stack,vals,sp,context))
+			return gotError("ExpEvaluator stack underflow",instr.oper->lineNumber());
+		    JsValue& res = vals[sp++];
+		    res.boolean = false;
+		    switch (instr.opcode) {
+			case OpcNeg:
+			    res.number = -op.toNumber();
+			    break;
+			case OpcNot:
+			    res.number = ~op.valInteger();
+			    break;
+			default:
+			    res.number = op.valBoolean() ? 0 : 1;
+			    res.boolean = true;
+			    break;
+		    }
+		}
+		continue;
+	    case JsInstr::Drop:
+		if (sp) {
+		    sp--;
+		    continue;
+		}
+		break;
+	    case JsInstr::End:
+		if (sp) {
+		    vals[0] = vals[sp - 1];
+		    sp = 1;
+		    if (!flushBlock(stack))
+			return gotError("ExpEvaluator stack underflow",instr.oper->lineNumber());
+		    continue;
+		}
+		break;
+	    case JsInstr::Flush:
+	    case JsInstr::Trim:
+		sp = 0;
+		break;
+	    case JsInstr::JumpTrue:
+	    case JsInstr::JumpFalse:
+		if (!sp)
+		    break;
+		sp--;
+		if ((vals[sp].number != 0) != (instr.type == JsInstr::JumpTrue))
+		    continue;
+		// fall through
+	    case JsInstr::Jump:
+		{
+		    long int i = index + (long int)instr.value;
+		    if (i < 0 || i > (long int)n) {
+			spillValues(stack,vals,sp);
+			return gotError("Relative jump failed",instr.oper->lineNumber());
+		    }
+		    index = i;
+		}
+		continue;
+	    default:
+		break;
+	}
+	spillValues(stack,vals,sp);
+	if (!runOperation(stack,*instr.oper,context))
+	    return false;
+	if (runner->m_paused)
+	    return true;
+    }
+    spillValues(stack,vals,sp);
+    return true;
+}
+
+// Get an operand from the unboxed values or from the generic stack
+bool JsCode::popOperand(JsOperand& oper, ObjList& stack, JsValue* vals, unsigned int& sp, GenObject* context) const
+{
+    if (sp) {
+	oper.set(vals[--sp]);
+	return true;
+    }
+    oper.set(popValue(stack,context));
+    return oper.oper() != 0;
+}
+
+// Binary operators, result is always left unboxed unless it's a string
+bool JsCode::runBinary(ObjList& stack, const JsInstr& instr, JsValue* vals, unsigned int& sp, GenObject* context) const
+{
+    JsOperand op2;
+    JsOperand op1;
+    if (!(popOperand(op2,stack,vals,sp,context) && popOperand(op1,stack,vals,sp,context)))
+	return gotError("ExpEvaluator stack underflow",instr.oper->lineNumber());
+    int64_t val = 0;
+    bool boolRes = false;
+    switch (instr.opcode) {
+	case OpcAdd:
+	    if (op1.isNumber() && op2.isNumber())
+		break;
+	    // turn addition into concatenation
+	    {
+		String str;
+		op1.append(str);
+		op2.append(str);
+		spillValues(stack,vals,sp);
+		pushOne(stack,new ExpOperation(str));
+	    }
+	    return true;
+	case OpcDiv:
+	case OpcMod:
+	    if (!op2.toNumber())
+		return gotError("Division by zero",instr.oper->lineNumber());
+	    break;
+	default:
+	    break;
+    }
+    switch (instr.opcode) {
+	case OpcAdd:
+	case OpcSub:
+	case OpcMul:
+	case OpcDiv:
+	case OpcMod:
+	    {
+		val = ExpOperation::nonInteger();
+		int64_t op1Val = op1.toNumber();
+		int64_t op2Val = op2.toNumber();
+		if (op1Val == ExpOperation::nonInteger() || op2Val == ExpOperation::nonInteger())
+		    break;
+		switch (instr.opcode) {
+		    case OpcAdd:
+			val = op1Val + op2Val;
+			break;
+		    case OpcSub:
+			val = op1Val - op2Val;
+			break;
+		    case OpcMul:
+			val = op1Val * op2Val;
+			break;
+		    case OpcDiv:
+			val = op1Val / op2Val;
+			break;
+		    default:
+			val = op1Val % op2Val;
+			break;
+		}
+	    }
+	    break;
+	case OpcAnd:
+	    val = op1.valInteger() & op2.valInteger();
+	    break;
+	case OpcOr:
+	    val = op1.valInteger() | op2.valInteger();
+	    break;
+	case OpcXor:
+	    val = op1.valInteger() ^ op2.valInteger();
+	    break;
+	case OpcShl:
+	    val = op1.valInteger() << op2.valInteger();
+	    break;
+	case OpcShr:
+	    val = op1.valInteger() >> op2.valInteger();
+	    break;
+	case OpcLAnd:
+	    boolRes = op1.valBoolean() && op2.valBoolean();
+	    break;
+	case OpcLOr:
+	    boolRes = op1.valBoolean() || op2.valBoolean();
+	    break;
+	case OpcEq:
+	    boolRes = op1.equals(op2);
+	    break;
+	case OpcNe:
+	    boolRes = !op1.equals(op2);
+	    break;
+	case OpcLt:
+	    boolRes = op1.valInteger() < op2.valInteger();
+	    break;
+	case OpcGt:
+	    boolRes = op1.valInteger() > op2.valInteger();
+	    break;
+	case OpcLe:
+	    boolRes = op1.valInteger() <= op2.valInteger();
+	    break;
+	case OpcGe:
+	    boolRes = op1.valInteger() >= op2.valInteger();
+	    break;
+    }
+    JsValue& res = vals[sp++];
+    switch (instr.opcode) {
+	case OpcLAnd:
+	case OpcLOr:
+	case OpcEq:
+	case OpcNe:
+	case OpcLt:
+	case OpcGt:
+	case OpcLe:
+	case OpcGe:
+	    res.number = boolRes ? 1 : 0;
+	    res.boolean = true;
+	    break;
+	default:
+	    res.number = val;
+	    res.boolean = false;
+    }
+    return true;
+}
+
 bool JsCode::jumpToLabel(long int label, GenObject* context) const
 {
     if (!context)
@@ -3496,6 +4055,110 @@ ScriptContext* JsParser::createContext() const
     return new JsContext;
 }
 
+// Check if an object holds plain script data that can be copied field by field
+static bool forkData(const JsObject* obj)
+{
+    if (obj->frozen() || YOBJECT(JsFunction,obj) || obj->params().getParam(YSTRING("prototype")))
+	return false;
+    if (YOBJECT(JsArray,obj))
+	return obj->toString() == YSTRING("[object Array]");
+    return obj->toString() == YSTRING("[object Object]");
+}
+
+// Object of a context snapshot and its private copy in a fork, hashed by address
+class JsForkCopy : public GenObject
+{
+public:
+    inline JsForkCopy(const JsObject* src, JsObject* dst = 0)
+	: m_key(key(src)), m_src(src), m_dst(dst)
+	{ }
+    virtual const String& toString() const
+	{ return m_key; }
+    static inline String key(const JsObject* obj)
+	{ String tmp; tmp.printf("%p",obj); return tmp; }
+    String m_key;
+    const JsObject* m_src;
+    JsObject* m_dst;
+};
+
+// Freeze all objects reachable from a context snapshot so forks running in
+//  other threads can share them, collect the script data objects first
+static void forkFreeze(JsObject* obj, HashList& seen, HashList& data)
+{
+    for (ObjList* l = obj->params().paramList()->skipNull(); l; l = l->skipNext()) {
+	ExpWrapper* w = YOBJECT(ExpWrapper,l->get());
+	JsObject* jso = w ? YOBJECT(JsObject,w->object()) : 0;
+	if (!jso || seen.find(JsForkCopy::key(jso)))
+	    continue;
+	seen.append(new JsForkCopy(jso));
+	if (forkData(jso))
+	    data.append(new JsForkCopy(jso));
+	forkFreeze(jso,seen,data);
+	jso->freeze();
+    }
+}
+
+// Copy a script data object of a snapshot, keep references between objects
+//  copied and share everything else. Returns a new reference
+static JsObject* forkCopy(JsObject* src, Mutex* mtx, const HashList& data, HashList& copies)
+{
+    String key = JsForkCopy::key(src);
+    if (!data.find(key))
+	return src->ref() ? src : 0;
+    JsForkCopy* c = static_cast<JsForkCopy*>(copies[key]);
+    if (c)
+	return c->m_dst->ref() ? c->m_dst : 0;
+    JsArray* srcArray = YOBJECT(JsArray,src);
+    JsObject* dst = srcArray ? new JsArray(mtx,src->toString()) : new JsObject(mtx,src->toString());
+    copies.append(new JsForkCopy(src,dst));
+    for (ObjList* l = src->params().paramList()->skipNull(); l; l = l->skipNext()) {
+	const NamedString* ns = static_cast<const NamedString*>(l->get());
+	const ExpOperation* op = YOBJECT(ExpOperation,ns);
+	const ExpWrapper* w = YOBJECT(ExpWrapper,ns);
+	JsObject* jso = w ? YOBJECT(JsObject,w->object()) : 0;
+	if (jso) {
+	    ExpWrapper* nw = new ExpWrapper(forkCopy(jso,mtx,data,copies),w->name(),w->barrier());
+	    static_cast<String&>(*nw) = *w;
+	    nw->lineNumber(w->lineNumber());
+	    dst->params().addParam(nw);
+	}
+	else if (op)
+	    dst->params().addParam(op->clone());
+	else
+	    dst->params().addParam(ns->name(),*ns);
+    }
+    if (srcArray)
+	static_cast<JsArray*>(dst)->setLength(srcArray->length());
+    return dst;
+}
+
+// Create a Javascript context that inherits all fields of the original
+ScriptContext* JsParser::forkContext(ScriptContext* original)
+{
+    JsContext* base = YOBJECT(JsContext,original);
+    if (!(base && base->ref()))
+	return 0;
+    Lock mylock(base);
+    if (!base->frozen()) {
+	HashList seen(127);
+	forkFreeze(base,seen,base->m_forkData);
+	base->freeze();
+    }
+    JsContext* ctx = new JsContext;
+    static_cast<String&>(ctx->params()) = base->params();
+    // globals holding script data are copied, the rest is shared read only
+    HashList copies(127);
+    for (ObjList* l = base->params().paramList()->skipNull(); l; l = l->skipNext()) {
+	const ExpWrapper* w = YOBJECT(ExpWrapper,l->get());
+	JsObject* jso = w ? YOBJECT(JsObject,w->object()) : 0;
+	if (jso && base->m_forkData.find(JsForkCopy::key(jso)))
+	    ctx->params().setParam(new ExpWrapper(forkCopy(jso,ctx,base->m_forkData,copies),
+		w->name(),w->barrier()));
+    }
+    ctx->params().addParam(new ExpWrapper(base,JsObject::protoName()));
+    return ctx;
+}
+
 ScriptRun* JsParser::createRunner(ScriptCode* code, ScriptContext* context, const char* title) const
 {
     if (!code)
@@ -3544,7 +4207,7 @@ bool JsParser::parse(const char* text, bool fragment, const char* file, int len)
     jsc->simplify();
     DDebug(DebugAll,"Simplified: %s",jsc->ExpEvaluator::dump().c_str());
     if (m_allowLink) {
-	jsc->link();
+	jsc->link(m_allowBytecode);
 #ifdef DEBUG
 #ifdef XDEBUG
 	Debug(DebugAll,"Linked: %s",jsc->ExpEvaluator::dump(true).c_str());
@@ -253,6 +253,12 @@ void JsObject::setPrototype(GenObject* context, const String& objName)
 	    return;
     }
     JsObject* objCtr = YOBJECT(JsObject,ctxt->params().getParam(objName));
+    // constructors of a forked context are inherited from the original one
+    for (JsObject* base = YOBJECT(JsObject,ctxt); base && !objCtr; ) {
+	base = YOBJECT(JsObject,base->params().getParam(protoName()));
+	if (base)
+	    objCtr = YOBJECT(JsObject,base->params().getParam(objName));
+    }
     if (objCtr) {
 	JsObject* proto = YOBJECT(JsObject,objCtr->params().getParam(YSTRING("prototype")));
 	if (proto && proto->ref())
@@ -673,7 +679,7 @@ bool JsArray::runNative(ObjList& stack, const ExpOperation& oper, GenObject* con
 	if (!last)
 	    ExpEvaluator::pushOne(stack,new ExpWrapper(0,0));
 	else {
-	    params().paramList()->remove(last,false);
+	    params().clearParam(last,false);
 	    ExpOperation* op = YOBJECT(ExpOperation,last);
 	    if (!op) {
 		op = new ExpOperation(*last,0,true);
@@ -763,6 +769,7 @@ bool JsArray::runNative(ObjList& stack, const ExpOperation& oper, GenObject* con
 	    if (n2)
 		const_cast<String&>(n2->name()) = s1;
 	}
+	params().dropIndex();
 	ref();
 	ExpEvaluator::pushOne(stack,new ExpWrapper(this));
     }
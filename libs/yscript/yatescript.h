@@ -2494,7 +2494,7 @@ public:
      * @param allowTrace True to allow the script to enable performance tracing
      */
     inline JsParser(bool allowLink = true, bool allowTrace = false)
-	: m_allowLink(allowLink), m_allowTrace(allowTrace)
+	: m_allowLink(allowLink), m_allowTrace(allowTrace), m_allowBytecode(false)
 	{ }
 
     /**
@@ -2513,6 +2513,18 @@ public:
      */
     virtual ScriptContext* createContext() const;
 
+    /**
+     * Create a context that shares all fields of an already initialized one.
+     * Fields are looked up in the original context unless they are assigned
+     *  in the new context. Plain objects and arrays held by the original are
+     *  copied to the new context, all other objects reachable from it are
+     *  frozen on first fork and shared read only. Script functions are copied
+     *  to the new context on assignment.
+     * @param original Fully initialized Javascript context to share
+     * @return A new Javascript context, NULL if original is not a Javascript context
+     */
+    static ScriptContext* forkContext(ScriptContext* original);
+
     /**
      * Create a runner adequate for a block of parsed Javascript code
      * @param code Parsed code block
@@ -2605,6 +2617,14 @@ public:
     inline void trace(bool allowed = true)
 	{ m_allowTrace = allowed; }
 
+    /**
+     * Set whether linked Javascript code is also lowered to bytecode that
+     *  runs arithmetic, comparisons and jumps on unboxed values
+     * @param allowed True to allow bytecode execution, false otherwise
+     */
+    inline void bytecode(bool allowed = true)
+	{ m_allowBytecode = allowed; }
+
     /**
      * Parse and run a piece of Javascript code
      * @param text Source code fragment to execute
@@ -2655,6 +2675,7 @@ private:
     String m_parsedFile;
     bool m_allowLink;
     bool m_allowTrace;
+    bool m_allowBytecode;
 };
 
 }; // namespace TelEngine
@@ -25,6 +25,10 @@
 
 using namespace TelEngine;
 
+// Transaction timer wheel: number of slots and slot duration in milliseconds
+#define TCAP_SCHED_SLOTS 1024
+#define TCAP_SCHED_TICK 10
+
 #ifdef DEBUG
 static void dumpData(int debugLevel, SS7TCAP* tcap, String message, void* obj, NamedList& params,
 		    DataBlock data = DataBlock::empty())
@@ -38,6 +42,12 @@ static void dumpData(int debugLevel, SS7TCAP* tcap, String message, void* obj, N
 	    message.safe(),obj,tmp.c_str(),str.c_str());
     }
 }
+
+static inline void dumpData(int debugLevel, SS7TCAP* tcap, String message, void* obj, NamedList& params,
+		    const AsnCursor& data)
+{
+    dumpData(debugLevel,tcap,message,obj,params,DataBlock(data.data(),data.length()));
+}
 #endif
 
 TCAPUser::~TCAPUser()
@@ -263,13 +273,19 @@ SS7TCAP::SS7TCAP(const NamedList& params)
       m_defaultHopCounter(0),
       m_defaultRemotePC(0),
       m_remoteTypePC(SS7PointCode::Other),
-      m_trTimeout(300),
+      m_trTimeout(300000),
       m_transactionsMtx(true,"TCAPTransactions"),
+      m_transactions(params.getIntValue(YSTRING("transactions_hash"),1021,17,131071)),
+      m_trCount(0),
+      m_schedMtx(false,"TCAPSchedule"),
+      m_sched(TCAP_SCHED_SLOTS,TCAP_SCHED_TICK,Time::msecNow()),
       m_tcapType(UnknownTCAP),
       m_idsPool(0)
 {
     Debug(this,DebugAll,"SS7TCAP::SS7TCAP() [%p] created",this);
     m_recvMsgs = m_sentMsgs = m_discardMsgs = m_normalMsgs = m_abnormalMsgs = 0;
+    m_dialogs = m_dialogTimeouts = m_compTimeouts = m_latencyCount = 0;
+    m_latencyTotal = m_latencyMax = 0;
     m_ssnStatus = SCCPManagement::UserOutOfService;
 }
 
@@ -587,6 +603,13 @@ void SS7TCAP::status(NamedList& status)
     status.setParam("totalDiscarded",String(m_discardMsgs));
     status.setParam("totalNormal",String(m_normalMsgs));
     status.setParam("totalAbnormal",String(m_abnormalMsgs));
+    status.setParam("transactions",String(m_trCount));
+    status.setParam("totalDialogs",String(m_dialogs));
+    status.setParam("dialogTimeouts",String(m_dialogTimeouts));
+    status.setParam("componentTimeouts",String(m_compTimeouts));
+    // average and maximum time from reception to end of processing, in microseconds
+    status.setParam("avgLatency",String(m_latencyCount ? (unsigned int)(m_latencyTotal / m_latencyCount) : 0));
+    status.setParam("maxLatency",String((unsigned int)m_latencyMax));
 }
 
 void SS7TCAP::userStatus(NamedList& status)
@@ -606,10 +629,79 @@ SS7TCAPTransaction* SS7TCAP::getTransaction(const String& tid)
     return 0;
 }
 
+// Add a transaction to the table and schedule its first check
+void SS7TCAP::addTransaction(SS7TCAPTransaction* tr)
+{
+    if (!tr)
+	return;
+    tr->ref();
+    m_transactionsMtx.lock();
+    m_transactions.append(tr);
+    m_trCount++;
+    m_transactionsMtx.unlock();
+    incCounter(Dialogs);
+    scheduleTransaction(tr);
+}
+
 void SS7TCAP::removeTransaction(SS7TCAPTransaction* tr)
 {
+    if (!tr)
+	return;
     Lock lock(m_transactionsMtx);
-    m_transactions.remove(tr);
+    if (!m_transactions.remove(tr,false,true))
+	return;
+    if (m_trCount)
+	m_trCount--;
+    unscheduleTransaction(tr);
+    lock.drop();
+    TelEngine::destruct(tr);
+}
+
+// Schedule a transaction to be checked at given time or on next tick
+void SS7TCAP::scheduleTransaction(SS7TCAPTransaction* tr, u_int64_t when)
+{
+    if (!tr)
+	return;
+    Lock lck(m_schedMtx);
+    m_sched.schedule(tr->m_schedEntry,when);
+}
+
+// Remove a transaction from ready list and timer wheel for good
+void SS7TCAP::unscheduleTransaction(SS7TCAPTransaction* tr)
+{
+    Lock lck(m_schedMtx);
+    m_sched.cancel(tr->m_schedEntry,true);
+}
+
+// Handle components and transaction timeouts, remove the transaction if it ended
+void SS7TCAP::checkTransaction(SS7TCAPTransaction* tr, u_int64_t now)
+{
+    NamedList params("");
+    if (tr->transactionState() != SS7TCAPTransaction::Idle)
+	tr->checkComponents();
+    if (tr->endNow())
+	tr->setState(SS7TCAPTransaction::Idle);
+    if (tr->timedOut()) {
+	DDebug(this,DebugInfo,"SS7TCAP::timerTick() - transaction with id=%s(%p) timed out [%p]",tr->toString().c_str(),tr,this);
+	incCounter(DialogTimeouts);
+	tr->updateToEnd();
+	buildSCCPData(params,tr);
+	if (!tr->basicEnd())
+	    tr->transactionData(params);
+	sendToUser(params);
+	tr->setState(SS7TCAPTransaction::Idle);
+    }
+
+    if (tr->transactionState() == SS7TCAPTransaction::Idle)
+	removeTransaction(tr);
+    else {
+	u_int64_t next = tr->nextTimeout();
+	// a timer that already fired without ending anything is checked again on next tick
+	if (next && next <= now)
+	    next = now + TCAP_SCHED_TICK;
+	if (next)
+	    scheduleTransaction(tr,next);
+    }
 }
 
 void SS7TCAP::timerTick(const Time& when)
@@ -619,43 +711,29 @@ void SS7TCAP::timerTick(const Time& when)
 
     while (msg) {
 	processSCCPData(msg);
+	u_int64_t latency = Time::now() - msg->timestamp();
+	m_latencyTotal += latency;
+	m_latencyCount++;
+	if (latency > m_latencyMax)
+	    m_latencyMax = latency;
 	TelEngine::destruct(msg);
 	//break;
 	msg = dequeue();
     }
 
-    // update/handle rest of transactions
-    Lock lock(m_transactionsMtx);
-    ListIterator iter(m_transactions);
-    for (;;) {
-	SS7TCAPTransaction* tr = static_cast<SS7TCAPTransaction*>(iter.get());
-	// End of iteration?
-	if (!tr)
-	    break;
+    // move transactions from elapsed timer wheel slots to ready list
+    u_int64_t now = when.msec();
+    Lock lock(m_schedMtx);
+    m_sched.advance(now);
+
+    // update/handle only the transactions that had activity or a timer due
+    while (SS7TCAPTransaction* tr = static_cast<SS7TCAPTransaction*>(m_sched.get())) {
 	if (!tr->ref())
 	    continue;
 	lock.drop();
-	NamedList params("");
-	DataBlock data;
-	if (tr->transactionState() != SS7TCAPTransaction::Idle)
-	    tr->checkComponents();
-	if (tr->endNow())
-	    tr->setState(SS7TCAPTransaction::Idle);
-	if (tr->timedOut()) {
-	    DDebug(this,DebugInfo,"SS7TCAP::timerTick() - transaction with id=%s(%p) timed out [%p]",tr->toString().c_str(),tr,this);
-	    tr->updateToEnd();
-	    buildSCCPData(params,tr);
-	    if (!tr->basicEnd())
-		tr->transactionData(params);
-	    sendToUser(params);
-	    tr->setState(SS7TCAPTransaction::Idle);
-	}
-
-	if (tr->transactionState() == SS7TCAPTransaction::Idle)
-	    removeTransaction(tr);
+	checkTransaction(tr,now);
 	TelEngine::destruct(tr);
-	if (!lock.acquire(m_transactionsMtx))
-	    break;
+	lock.acquire(m_schedMtx);
     }
 }
 
@@ -668,8 +746,10 @@ HandledMSU SS7TCAP::processSCCPData(SS7TCAPMessage* msg)
 
     NamedList& msgParams = msg->msgParams();
     DataBlock& msgData = msg->msgData();
+    // walk the message with a cursor, msgData is left untouched until an error answer is built into it
+    AsnCursor msgCursor(msgData);
 
-    SS7TCAPError transactError = decodeTransactionPart(msgParams,msgData);
+    SS7TCAPError transactError = decodeTransactionPart(msgParams,msgCursor);
     if (transactError.error() != SS7TCAPError::NoError)
 	return handleError(transactError,msgParams,msgData);
 
@@ -699,10 +779,7 @@ HandledMSU SS7TCAP::processSCCPData(SS7TCAPMessage* msg)
 		String newID;
 		allocTransactionID(newID);
 		tr = buildTransaction(type,newID,msgParams,false);
-		tr->ref();
-		m_transactionsMtx.lock();
-		m_transactions.append(tr);
-		m_transactionsMtx.unlock();
+		addTransaction(tr);
 		msgParams.setParam(s_tcapLocalTID,newID);
 	    }
 	    break;
@@ -726,6 +803,7 @@ HandledMSU SS7TCAP::processSCCPData(SS7TCAPMessage* msg)
 	    transactError = tr->update((SS7TCAP::TCAPUserTransActions)type,msgParams,false);
 	    if (transactError.error() != SS7TCAPError::NoError) {
 		result = handleError(transactError,msgParams,msgData,tr);
+		scheduleTransaction(tr);
 		TelEngine::destruct(tr);
 		return result;
 	    }
@@ -735,9 +813,10 @@ HandledMSU SS7TCAP::processSCCPData(SS7TCAPMessage* msg)
 	    return result;
     }
     if (tr) {
-	transactError = tr->handleData(msgParams,msgData);
+	transactError = tr->handleData(msgParams,msgCursor);
 	if (transactError.error() != SS7TCAPError::NoError) {
 	    result = handleError(transactError,msgParams,msgData,tr);
+	    scheduleTransaction(tr);
 	    TelEngine::destruct(tr);
 	    return result;
 	}
@@ -765,6 +844,8 @@ HandledMSU SS7TCAP::processSCCPData(SS7TCAPMessage* msg)
 	}
 	else
 	    tr->setState(SS7TCAPTransaction::Idle);
+	// the transaction state or timers changed, check it on next tick
+	scheduleTransaction(tr);
 	TelEngine::destruct(tr);
     }
     result = HandledMSU::Accepted;
@@ -821,10 +902,7 @@ SS7TCAPError SS7TCAP::userRequest(NamedList& params)
 		tr = buildTransaction((SS7TCAP::TCAPUserTransActions)type,otid,params,true);
 		if (!TelEngine::null(user))
 		    tr->setUserName(user);
-		tr->ref();
-		m_transactionsMtx.lock();
-		m_transactions.append(tr);
-		m_transactionsMtx.unlock();
+		addTransaction(tr);
 		break;
 	    case SS7TCAP::TC_Continue:
 	    case SS7TCAP::TC_ConversationWithPerm:
@@ -842,6 +920,7 @@ SS7TCAPError SS7TCAP::userRequest(NamedList& params)
 		    }
 		    error = tr->update((SS7TCAP::TCAPUserTransActions)type,params);
 		    if (error.error() != SS7TCAPError::NoError) {
+			scheduleTransaction(tr);
 			TelEngine::destruct(tr);
 			return error;
 		    }
@@ -868,11 +947,13 @@ SS7TCAPError SS7TCAP::userRequest(NamedList& params)
     if (tr) {
 	error = tr->handleDialogPortion(params,true);
 	if (error.error() != SS7TCAPError::NoError) {
+	    scheduleTransaction(tr);
 	    TelEngine::destruct(tr);
 	    return error;
 	}
 	error = tr->handleComponents(params,true);
 	if (error.error() != SS7TCAPError::NoError) {
+	    scheduleTransaction(tr);
 	    TelEngine::destruct(tr);
 	    return error;
 	}
@@ -883,6 +964,7 @@ SS7TCAPError SS7TCAP::userRequest(NamedList& params)
 	}
 	else if (tr->transmitState() == SS7TCAPTransaction::NoTransmit)
 	    removeTransaction(tr);
+	scheduleTransaction(tr);
 	TelEngine::destruct(tr);
     }
     return error;
@@ -1220,7 +1302,8 @@ SS7TCAPTransaction::SS7TCAPTransaction(SS7TCAP* tcap, SS7TCAP::TCAPUserTransActi
 	const String& transactID, NamedList& params, u_int64_t timeout, bool initLocal)
     : Mutex(true,"TcapTransaction"),
       m_tcap(tcap), m_tcapType(SS7TCAP::UnknownTCAP), m_userName(""), m_localID(transactID), m_type(type),
-      m_localSCCPAddr(""), m_remoteSCCPAddr(""), m_basicEnd(true), m_endNow(false), m_timeout(timeout)
+      m_localSCCPAddr(""), m_remoteSCCPAddr(""), m_basicEnd(true), m_endNow(false), m_timeout(timeout),
+      m_schedEntry(this)
 {
 
     DDebug(m_tcap,DebugAll,"SS7TCAPTransaction(tcap = '%s' [%p], transactID = %s) created [%p]",
@@ -1259,7 +1342,7 @@ SS7TCAPError SS7TCAPTransaction::update(SS7TCAP::TCAPUserTransActions type, Name
     return error;
 }
 
-SS7TCAPError SS7TCAPTransaction::buildComponentError(SS7TCAPError& error, NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransaction::buildComponentError(SS7TCAPError& error, NamedList& params, AsnCursor& data)
 {
     if (error.error() == SS7TCAPError::NoError)
 	return error;
@@ -1477,6 +1560,7 @@ void SS7TCAPTransaction::checkComponents()
 	    switch (type) {
 		case SS7TCAP::TC_Invoke:
 		case SS7TCAP::TC_InvokeNotLast:
+			tcap()->incCounter(SS7TCAP::ComponentTimeouts);
 			if (comp->operationClass() != SS7TCAP::NoReport) {
 			    index++;
 			    comp->setType(SS7TCAP::TC_L_Cancel);
@@ -1517,6 +1601,19 @@ void SS7TCAPTransaction::checkComponents()
     }
 }
 
+u_int64_t SS7TCAPTransaction::nextTimeout()
+{
+    Lock l(this);
+    u_int64_t next = m_timeout.fireTime();
+    for (ObjList* o = m_components.skipNull(); o; o = o->skipNext()) {
+	u_int64_t t = static_cast<SS7TCAPComponent*>(o->get())->timerFireTime();
+	if (t && (!next || t < next))
+	    next = t;
+    }
+    // timers expire only after their fire time has passed
+    return next ? next + 1 : 0;
+}
+
 void SS7TCAPTransaction::setTransmitState(TransactionTransmit state)
 {
     Lock l(this);
@@ -1570,7 +1667,7 @@ void SS7TCAPTransaction::addSCCPAddressing(NamedList& fillParams, bool local)
     }
 }
 
-SS7TCAPError SS7TCAPTransaction::handleData(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransaction::handleData(NamedList& params, AsnCursor& data)
 {
     DDebug(tcap(),DebugAll,"SS7TCAPTransaction::handleData() transactionID=%s data length=%u [%p]",m_localID.c_str(),
 	   data.length(),this);
@@ -1861,7 +1958,7 @@ SS7TCAPTransaction* SS7TCAPANSI::buildTransaction(SS7TCAP::TCAPUserTransActions
     return new SS7TCAPTransactionANSI(this,type,transactID,params,m_trTimeout,initLocal);
 }
 
-SS7TCAPError SS7TCAPANSI::decodeTransactionPart(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPANSI::decodeTransactionPart(NamedList& params, AsnCursor& data)
 {
     SS7TCAPError error(SS7TCAP::ANSITCAP);
     if (data.length() < 2)  // should find out which is the minimal TCAP message length
@@ -2016,7 +2113,7 @@ SS7TCAPTransactionANSI::~SS7TCAPTransactionANSI()
 	   m_localID.c_str(),m_userName.c_str(),tcap()->refcount(),this);
 }
 
-SS7TCAPError SS7TCAPTransactionANSI::handleData(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransactionANSI::handleData(NamedList& params, AsnCursor& data)
 {
     XDebug(tcap(),DebugAll,"SS7TCAPTransactionANSI::handleData() transactionID=%s data length=%u [%p]",m_localID.c_str(),
 	   data.length(),this);
@@ -2137,7 +2234,7 @@ SS7TCAPError SS7TCAPTransactionANSI::update(SS7TCAP::TCAPUserTransActions type,
     return error;
 }
 
-SS7TCAPError SS7TCAPTransactionANSI::decodeDialogPortion(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransactionANSI::decodeDialogPortion(NamedList& params, AsnCursor& data)
 {
     XDebug(tcap(),DebugAll,"SS7TCAPTransactionANSI::decodeDialogPortion() for transaction with localID=%s [%p]",
 	m_localID.c_str(),this);
@@ -2252,7 +2349,7 @@ SS7TCAPError SS7TCAPTransactionANSI::decodeDialogPortion(NamedList& params, Data
 		error.setError(SS7TCAPError::Dialog_BadlyStructuredDialoguePortion);
 		return error;
 	    }
-	    DataBlock d((void*)data.data(0,len),len);
+	    AsnCursor d = data.head(len);
 	    data.cut(-len);
 
 	    // put encoding context in hexified form
@@ -2516,7 +2613,7 @@ void SS7TCAPTransactionANSI::encodeDialogPortion(NamedList& params, DataBlock& d
 #endif
 }
 
-SS7TCAPError SS7TCAPTransactionANSI::decodePAbort(SS7TCAPTransaction* tr, NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransactionANSI::decodePAbort(SS7TCAPTransaction* tr, NamedList& params, AsnCursor& data)
 {
     u_int8_t tag = data[0];
     SS7TCAPError error(SS7TCAP::ANSITCAP);
@@ -2615,7 +2712,7 @@ void SS7TCAPTransactionANSI::updateToEnd()
 	setTransactionType(SS7TCAP::TC_Response);
 }
 
-SS7TCAPError SS7TCAPTransactionANSI::decodeComponents(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransactionANSI::decodeComponents(NamedList& params, AsnCursor& data)
 {
     XDebug(tcap(),DebugAll,"SS7TCAPTransactionANSI::decodeComponents() [%p] - data length=%u",this,data.length());
 
@@ -3108,7 +3205,7 @@ SS7TCAPTransaction* SS7TCAPITU::buildTransaction(SS7TCAP::TCAPUserTransActions t
     return new SS7TCAPTransactionITU(this,type,transactID,params,m_trTimeout,initLocal);
 }
 
-SS7TCAPError SS7TCAPITU::decodeTransactionPart(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPITU::decodeTransactionPart(NamedList& params, AsnCursor& data)
 {
     SS7TCAPError error(SS7TCAP::ITUTCAP);
     if (data.length() < 2)
@@ -3300,7 +3397,7 @@ SS7TCAPTransactionITU::~SS7TCAPTransactionITU()
 	   m_localID.c_str(),m_userName.c_str(),this);
 }
 
-SS7TCAPError SS7TCAPTransactionITU::handleData(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransactionITU::handleData(NamedList& params, AsnCursor& data)
 {
     DDebug(tcap(),DebugAll,"SS7TCAPTransactionITU::handleData() transactionID=%s data length=%u [%p]",m_localID.c_str(),
 	   data.length(),this);
@@ -3332,7 +3429,7 @@ SS7TCAPError SS7TCAPTransactionITU::handleData(NamedList& params, DataBlock& dat
     return error;
 }
 
-bool SS7TCAPTransactionITU::testForDialog(DataBlock& data)
+bool SS7TCAPTransactionITU::testForDialog(AsnCursor& data)
 {
     return (data.length() && data[0] == SS7TCAPITU::DialogPortionTag);
 }
@@ -3748,7 +3845,7 @@ void SS7TCAPTransactionITU::encodePAbort(SS7TCAPTransaction* tr, NamedList& para
 #endif
 }
 
-SS7TCAPError SS7TCAPTransactionITU::decodePAbort(SS7TCAPTransaction* tr, NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransactionITU::decodePAbort(SS7TCAPTransaction* tr, NamedList& params, AsnCursor& data)
 {
     u_int8_t tag = data[0];
     SS7TCAPError error(SS7TCAP::ITUTCAP);
@@ -3788,7 +3885,7 @@ void SS7TCAPTransactionITU::updateToEnd()
 	m_basicEnd = false;
 }
 
-SS7TCAPError SS7TCAPTransactionITU::decodeDialogPortion(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransactionITU::decodeDialogPortion(NamedList& params, AsnCursor& data)
 {
     DDebug(tcap(),DebugAll,"SS7TCAPTransactionITU::decodeDialogPortion() for transaction with localID=%s [%p]",
     m_localID.c_str(),this);
@@ -3990,7 +4087,7 @@ SS7TCAPError SS7TCAPTransactionITU::decodeDialogPortion(NamedList& params, DataB
 		error.setError(SS7TCAPError::Dialog_BadlyStructuredDialoguePortion);
 		return error;
 	    }
-	    DataBlock d((void*)data.data(0,len),len);
+	    AsnCursor d = data.head(len);
 	    data.cut(-len);
 
 	    // put encoding context in hexified form
@@ -4175,7 +4272,7 @@ void SS7TCAPTransactionITU::encodeDialogPortion(NamedList& params, DataBlock& da
 #endif
 }
 
-SS7TCAPError SS7TCAPTransactionITU::decodeComponents(NamedList& params, DataBlock& data)
+SS7TCAPError SS7TCAPTransactionITU::decodeComponents(NamedList& params, AsnCursor& data)
 {
     XDebug(tcap(),DebugAll,"SS7TCAPTransactionITU::decodeComponents() [%p] - data length=%u",this,data.length());
 
@@ -4349,7 +4446,7 @@ SS7TCAPError SS7TCAPTransactionITU::decodeComponents(NamedList& params, DataBloc
 	else {
 	// decode Parameters (Set or Sequence) as payload
 	    int payloadLen = data.length() - (initLength - compLength);
-	    DataBlock d((void*)data.data(0,payloadLen),payloadLen);
+	    AsnCursor d = data.head(payloadLen);
 	    data.cut(-payloadLen);
 	    String dataHexified = "";
 	    dataHexified.hexify(d.data(),d.length(),' ');
@@ -4374,12 +4471,13 @@ void SS7TCAPTransactionITU::encodeComponents(NamedList& params, DataBlock& data)
     XDebug(tcap(),DebugAll,"SS7TCAPTransactionITU::encodeComponents() for transaction with localID=%s [%p]",m_localID.c_str(),this);
 
     int componentCount = params.getIntValue(s_tcapCompCount,0);
-    DataBlock compData;
     if (componentCount) {
+	// components and their fields are written last to first
+	AsnWriter compData;
 	int index = componentCount + 1;
 
 	while (--index) {
-	    DataBlock codedComp;
+	    unsigned int compMark = compData.mark();
 	    // encode parameters
 	    String compParam;
 	    compPrefix(compParam,index,false);
@@ -4398,10 +4496,9 @@ void SS7TCAPTransactionITU::encodeComponents(NamedList& params, DataBlock& data)
 		    u_int16_t codeErr = SS7TCAPError::codeFromError(tcap()->tcapType(),(SS7TCAPError::ErrorType)value->toInteger());
 		    u_int8_t problemTag = (codeErr & 0xff00) >> 8;
 		    u_int8_t code = codeErr & 0x000f;
-		    DataBlock db(DataBlock(&code,1));
-		    db.insert(ASNLib::buildLength(db));
-		    db.insert(DataBlock(&problemTag,1));
-		    codedComp.insert(db);
+		    unsigned int mark = compData.mark();
+		    compData.prependByte(code);
+		    compData.close(mark,problemTag);
 		}
 		else {
 		    Debug(tcap(),DebugWarn,"Missing mandatory 'problemCode' information for component with index='%d' from transaction "
@@ -4414,7 +4511,7 @@ void SS7TCAPTransactionITU::encodeComponents(NamedList& params, DataBlock& data)
 		if (!TelEngine::null(payloadHex)) {
 		    DataBlock payload;
 		    payload.unHexify(payloadHex->c_str(),payloadHex->length(),' ');
-		    codedComp.insert(payload);
+		    compData.prepend(payload);
 		    hasPayload = true;
 		}
 	    }
@@ -4422,26 +4519,24 @@ void SS7TCAPTransactionITU::encodeComponents(NamedList& params, DataBlock& data)
 	    if (compType == ReturnError) {
 		value = params.getParam(compParam + "." + s_tcapErrCodeType);
 		if (!TelEngine::null(value)) {
-		    int tag = 0;
-		    DataBlock db;
+		    unsigned int mark = compData.mark();
 		    if (*value == "local") {
-			tag = SS7TCAPITU::LocalTag;
 			int errCode = params.getIntValue(compParam + "." + s_tcapErrCode,0);
-			db = ASNLib::encodeInteger(errCode,false);
-			db.insert(ASNLib::buildLength(db));
+			compData.writeInteger(errCode,false);
+			compData.close(mark,(u_int8_t)SS7TCAPITU::LocalTag);
 		    }
 		    else if (*value == "global") {
-			tag = SS7TCAPITU::GlobalTag;
 			ASNObjId oid = String(params.getValue(compParam + "." + s_tcapErrCode));
-			db = ASNLib::encodeOID(oid,false);
-			db.insert(ASNLib::buildLength(db));
+			compData.prepend(ASNLib::encodeOID(oid,false));
+			compData.close(mark,(u_int8_t)SS7TCAPITU::GlobalTag);
 		    }
-		    db.insert(DataBlock(&tag,1));
-		    codedComp.insert(db);
+		    else
+			compData.prependByte(0);
 		}
 		else {
 		    Debug(tcap(),DebugWarn,"Missing mandatory 'errorCodeType' information for component with index='%d' from transaction "
 			    "with localID=%s [%p]",index,m_localID.c_str(),this);
+		    compData.reset(compMark);
 		    continue;
 		}
 	    }
@@ -4452,28 +4547,22 @@ void SS7TCAPTransactionITU::encodeComponents(NamedList& params, DataBlock& data)
 		compType == ReturnResultLast) {
 		value = params.getParam(compParam + "." + s_tcapOpCodeType);
 		if (!TelEngine::null(value)) {
-		    int tag = 0;
-		    DataBlock db;
 		    if (*value == "local") {
 			int opCode = params.getIntValue(compParam + "." + s_tcapOpCode,0);
-			db = ASNLib::encodeInteger(opCode,true);
+			compData.writeInteger(opCode,true);
 		    }
 		    else if (*value == "global") {
 			ASNObjId oid(params.getValue(compParam + "." + s_tcapOpCode));
-			db = ASNLib::encodeOID(oid,true);
-			//db.insert(ASNLib::buildLength(db));
-		    }
-		    codedComp.insert(db);
-		    if (compType != Invoke) {
-			tag = SS7TCAPITU::ParameterSeqTag;
-			codedComp.insert(ASNLib::buildLength(codedComp));
-			codedComp.insert(DataBlock(&tag,1));
+			compData.prepend(ASNLib::encodeOID(oid,true));
 		    }
+		    if (compType != Invoke)
+			compData.close(compMark,(u_int8_t)SS7TCAPITU::ParameterSeqTag);
 		}
 		else {
 		    if (compType == Invoke || hasPayload) {
 			Debug(tcap(),DebugWarn,"Missing mandatory 'operationCodeType' information for component with index='%d' from transaction "
 			    "with localID=%s [%p]",index,m_localID.c_str(),this);
+			compData.reset(compMark);
 			continue;
 		    }
 		}
@@ -4481,29 +4570,22 @@ void SS7TCAPTransactionITU::encodeComponents(NamedList& params, DataBlock& data)
 
 	    NamedString* invID = params.getParam(compParam + "." + s_tcapLocalCID);
 	    NamedString* linkID = params.getParam(compParam + "." + s_tcapRemoteCID);
-	    DataBlock db;
-	    u_int8_t val = 0;
+	    unsigned int mark = compData.mark();
 	    switch (compType) {
 		case Invoke:
 		    if (!TelEngine::null(linkID)) {
-			val = linkID->toInteger();
-			DataBlock db1;
-			db1.append(&val,sizeof(u_int8_t));
-			db1.insert(ASNLib::buildLength(db1));
-			val = SS7TCAPITU::LinkedIDTag;
-			db1.insert(DataBlock(&val,1));
-			codedComp.insert(db1);
+			compData.prependByte(linkID->toInteger());
+			compData.close(mark,(u_int8_t)SS7TCAPITU::LinkedIDTag);
+			mark = compData.mark();
 		    }
 		    if (!TelEngine::null(invID)) {
-			val = invID->toInteger();
-			db.append(&val,sizeof(u_int8_t));
-			db.insert(ASNLib::buildLength(db));
-			val = SS7TCAPITU::LocalTag;
-			db.insert(DataBlock(&val,1));
+			compData.prependByte(invID->toInteger());
+			compData.close(mark,(u_int8_t)SS7TCAPITU::LocalTag);
 		    }
 		    else {
 			Debug(tcap(),DebugWarn,"Missing mandatory 'localCID' information for component with index='%d' from transaction "
 			    "with localID=%s [%p]",index,m_localID.c_str(),this);
+			compData.reset(compMark);
 			continue;
 		    }
 		    break;
@@ -4511,15 +4593,13 @@ void SS7TCAPTransactionITU::encodeComponents(NamedList& params, DataBlock& data)
 		case ReturnError:
 		case ReturnResultNotLast:
 		    if (!TelEngine::null(linkID)) {
-			val = linkID->toInteger();
-			db.append(&val,sizeof(u_int8_t));
-			db.insert(ASNLib::buildLength(db));
-			val = SS7TCAPITU::LocalTag;
-			db.insert(DataBlock(&val,1));
+			compData.prependByte(linkID->toInteger());
+			compData.close(mark,(u_int8_t)SS7TCAPITU::LocalTag);
 		    }
 		    else {
 			Debug(tcap(),DebugWarn,"Missing mandatory 'remoteCID' information for component with index='%d' from transaction "
 			    "with localID=%s [%p]",index,m_localID.c_str(),this);
+			compData.reset(compMark);
 			continue;
 		    }
 		    break;
@@ -4527,35 +4607,25 @@ void SS7TCAPTransactionITU::encodeComponents(NamedList& params, DataBlock& data)
 		    if (TelEngine::null(linkID))
 			linkID = invID;
 		    if (!TelEngine::null(linkID)) {
-			val = linkID->toInteger();
-			db.append(&val,sizeof(u_int8_t));
-			db.insert(ASNLib::buildLength(db));
-			val = SS7TCAPITU::LocalTag;
-			db.insert(DataBlock(&val,1));
+			compData.prependByte(linkID->toInteger());
+			compData.close(mark,(u_int8_t)SS7TCAPITU::LocalTag);
 		    }
 		    else
-			db.insert(ASNLib::encodeNull(true));
+			compData.writeNull(true);
 		    break;
 		default:
 		    break;
 	    }
-	    codedComp.insert(db);
 
-	    if(codedComp.length()) {
-		codedComp.insert(ASNLib::buildLength(codedComp));
-		codedComp.insert(DataBlock(&compType,1));
-	    }
+	    if (compData.mark() != compMark)
+		compData.close(compMark,(u_int8_t)compType);
 
 	    params.clearParam(compParam,'.'); // clear all params for this component
-	    compData.insert(codedComp);
 	}
 
 	if (compData.length()) {
-	    compData.insert(ASNLib::buildLength(compData));
-	    int tag = SS7TCAPITU::ComponentPortionTag;
-	    compData.insert(DataBlock(&tag,1));
-
-	    data.insert(compData);
+	    compData.close(0,(u_int8_t)SS7TCAPITU::ComponentPortionTag);
+	    compData.insertTo(data);
 	}
     }
 
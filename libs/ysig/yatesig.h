@@ -128,6 +128,7 @@ class SS7TCAPANSI;                       // SS7 ANSI TCAP implementation
 class SS7TCAPTransactionANSI;            // SS7 TCAP ANSI Transaction
 class SS7TCAPITU;                        // SS7 ITU TCAP implementation
 class SS7TCAPTransactionITU;             // SS7 TCAP ITU Transaction
+class AsnCursor;                         // ASN.1 decoding cursor, see yateasn.h
 // ISDN
 class ISDNLayer2;                        // Abstract ISDN layer 2 (Q.921) message transport
 class ISDNLayer3;                        // Abstract ISDN layer 3 (Q.931) message transport
@@ -10745,7 +10746,7 @@ public:
      * @param notice Flag if this is a notification, true if it is, false if it's a message
      */
     inline SS7TCAPMessage(NamedList& params, DataBlock& data, bool notice = false)
-	: m_msgParams(params), m_msgData(data), m_notice(notice)
+	: m_msgParams(params), m_msgData(data), m_notice(notice), m_time(Time::now())
 	{}
 
     /**
@@ -10769,10 +10770,18 @@ public:
     inline bool& isNotice()
 	{ return m_notice; }
 
+    /**
+     * Get the time when this message was received from SCCP
+     * @return Creation time of this message in microseconds
+     */
+    inline u_int64_t timestamp() const
+	{ return m_time; }
+
 private:
     NamedList m_msgParams;
     DataBlock m_msgData;
     bool m_notice;
+    u_int64_t m_time;
 };
 
 /**
@@ -10839,7 +10848,7 @@ public:
     };
 
     /**
-     * Type of message counters
+     * Type of message and transaction counters
      */
     enum TCAPCounter {
 	IncomingMsgs,
@@ -10847,6 +10856,9 @@ public:
 	DiscardedMsgs,
 	NormalMsgs,
 	AbnormalMsgs,
+	Dialogs,                 // transactions created
+	DialogTimeouts,          // transactions ended by the transaction timer
+	ComponentTimeouts,       // operations cancelled by their invocation timer
     };
 
     /**
@@ -11005,6 +11017,22 @@ public:
      */
     void removeTransaction(SS7TCAPTransaction* tr);
 
+    /**
+     * Schedule a transaction to be checked by timerTick()
+     * This method is thread safe
+     * @param tr The transaction to schedule
+     * @param when Time in milliseconds when the transaction must be checked,
+     *  0 to check it on the next tick. An earlier pending check is kept
+     */
+    void scheduleTransaction(SS7TCAPTransaction* tr, u_int64_t when = 0);
+
+    /**
+     * Retrieve the number of current transactions
+     * @return Number of transactions held by this TCAP
+     */
+    inline unsigned int transactionCount() const
+	{ return m_trCount; }
+
     /**
      * Method called periodically to do processing and timeout checks
      * @param when Time to use as computing base for events and timeouts
@@ -11077,6 +11105,15 @@ public:
 	    case AbnormalMsgs:
 		m_abnormalMsgs++;
 		break;
+	    case Dialogs:
+		m_dialogs++;
+		break;
+	    case DialogTimeouts:
+		m_dialogTimeouts++;
+		break;
+	    case ComponentTimeouts:
+		m_compTimeouts++;
+		break;
 	    default:
 		break;
 	}
@@ -11100,6 +11137,12 @@ public:
 		return m_normalMsgs;
 	    case AbnormalMsgs:
 		return m_abnormalMsgs;
+	    case Dialogs:
+		return m_dialogs;
+	    case DialogTimeouts:
+		return m_dialogTimeouts;
+	    case ComponentTimeouts:
+		return m_compTimeouts;
 	    default:
 		break;
 	}
@@ -11139,9 +11182,12 @@ public:
 	{ return lookup(comp,s_compPrimitives,TC_Unknown); }
 
 protected:
-    virtual SS7TCAPError decodeTransactionPart(NamedList& params, DataBlock& data) = 0;
+    virtual SS7TCAPError decodeTransactionPart(NamedList& params, AsnCursor& data) = 0;
     virtual void encodeTransactionPart(NamedList& params, DataBlock& data) = 0;
     bool sendSCCPNotify(NamedList& params);
+    void addTransaction(SS7TCAPTransaction* tr);
+    void unscheduleTransaction(SS7TCAPTransaction* tr);
+    void checkTransaction(SS7TCAPTransaction* tr, u_int64_t now);
     // list of TCAP users attached to this TCAP instance
     ObjList m_users;
     Mutex m_usersMtx;
@@ -11157,9 +11203,14 @@ protected:
     SS7PointCode::Type m_remoteTypePC;
     u_int64_t m_trTimeout;
 
-    // list of current TCAP transactions
+    // current TCAP transactions, hashed by local transaction ID
     Mutex m_transactionsMtx;
-    ObjList m_transactions;
+    HashList m_transactions;
+    unsigned int m_trCount;
+
+    // transactions waiting to be checked or waiting for a timeout
+    Mutex m_schedMtx;
+    TimerWheel m_sched;
     // type of TCAP
     TCAPType m_tcapType;
 
@@ -11172,6 +11223,13 @@ protected:
     unsigned int m_discardMsgs;
     unsigned int m_normalMsgs;
     unsigned int m_abnormalMsgs;
+    unsigned int m_dialogs;
+    unsigned int m_dialogTimeouts;
+    unsigned int m_compTimeouts;
+    // time from reception to the end of processing of received messages, in microseconds
+    u_int64_t m_latencyTotal;
+    u_int64_t m_latencyMax;
+    unsigned int m_latencyCount;
 
     // Subsystem Status
     SCCPManagement::LocalBroadcast m_ssnStatus;
@@ -11343,7 +11401,7 @@ public:
      * @param data Data to decode
      * @return A TCAP error encountered whilst decoding
      */
-    virtual SS7TCAPError handleData(NamedList& params, DataBlock& data) = 0;
+    virtual SS7TCAPError handleData(NamedList& params, AsnCursor& data) = 0;
 
     /**
      * An update request for this transaction
@@ -11366,10 +11424,10 @@ public:
      * Build a Reject component in answer to an encoutered error during decoding of the component portion
      * @param error The encountered error
      * @param params Decoded TCAP message parameters
-     * @param data DataBlock containing the rest of the coded TCAP message
+     * @param data Cursor over the rest of the coded TCAP message
      * @return A report error
      */
-    virtual SS7TCAPError buildComponentError(SS7TCAPError& error, NamedList& params, DataBlock& data);
+    virtual SS7TCAPError buildComponentError(SS7TCAPError& error, NamedList& params, AsnCursor& data);
 
     /**
      * Update components
@@ -11514,6 +11572,12 @@ public:
     inline bool timedOut()
 	{ return m_timeout.timeout(); }
 
+    /**
+     * Retrieve the earliest time when the transaction or one of its components times out
+     * @return Time in milliseconds after which a timeout occurs, 0 if no timer is running
+     */
+    u_int64_t nextTimeout();
+
     /**
      * Find a component with given id
      * @param id Id of component to find
@@ -11540,10 +11604,10 @@ public:
 
     /**
      * @param params NamedList reference to fill with the decoded dialog information
-     * @param data DataBlock reference from which to decode the dialog information
+     * @param data Cursor from which to decode the dialog information
      * @return A TCAP error encountered whilst decoding
      */
-    virtual SS7TCAPError decodeDialogPortion(NamedList& params, DataBlock& data) = 0;
+    virtual SS7TCAPError decodeDialogPortion(NamedList& params, AsnCursor& data) = 0;
 
     /**
      * @param params NamedList reference from which to take the dialog information to encode
@@ -11553,10 +11617,10 @@ public:
 
     /**
      * @param params NamedList reference to fill with the decoded component information
-     * @param data DataBlock reference from which to decode the component information
+     * @param data Cursor from which to decode the component information
      * @return A TCAP error encountered whilst decoding
      */
-    virtual SS7TCAPError decodeComponents(NamedList& params, DataBlock& data) = 0;
+    virtual SS7TCAPError decodeComponents(NamedList& params, AsnCursor& data) = 0;
 
     /**
      * @param params NamedList reference from which to take the component information to encode
@@ -11582,6 +11646,11 @@ protected:
     bool m_basicEnd; // basic or prearranged end (specified by user when sending a Response)
     bool m_endNow; // delete immediately after sending
     SignallingTimer m_timeout;
+
+private:
+    friend class SS7TCAP;
+    // TCAP scheduling, protected by the TCAP's schedule mutex
+    TimerWheelEntry m_schedEntry;        // TCAP timer wheel scheduling state
 };
 
 /**
@@ -11691,6 +11760,13 @@ public:
     inline bool timedOut()
 	{ return m_opTimer.timeout(); }
 
+    /**
+     * Retrieve the time when the invocation timer fires
+     * @return Timer fire time in milliseconds, 0 if the timer is not running
+     */
+    inline u_int64_t timerFireTime() const
+	{ return m_opTimer.fireTime(); }
+
     /**
      * Set component state
      * @param state The state to be set
@@ -11812,7 +11888,7 @@ public:
 	bool initLocal = true);
 
 private:
-    SS7TCAPError decodeTransactionPart(NamedList& params, DataBlock& data);
+    SS7TCAPError decodeTransactionPart(NamedList& params, AsnCursor& data);
     void encodeTransactionPart(NamedList& params, DataBlock& data);
 };
 
@@ -11868,7 +11944,7 @@ public:
      * @param data Data to decode
      * @return A TCAP error encountered whilst decoding
      */
-    virtual SS7TCAPError handleData(NamedList& params, DataBlock& data);
+    virtual SS7TCAPError handleData(NamedList& params, AsnCursor& data);
 
     /**
      * An update request for this transaction
@@ -11899,9 +11975,9 @@ public:
      * Decode P-Abort TCAP message portion
      * @param tr The transaction on which the abort was signalled
      * @param params NamedList reference to fill with the decoded P-Abort information
-     * @param data DataBlock reference from which to decode P-Abort information
+     * @param data Cursor from which to decode P-Abort information
      */
-    static SS7TCAPError decodePAbort(SS7TCAPTransaction* tr, NamedList& params, DataBlock& data);
+    static SS7TCAPError decodePAbort(SS7TCAPTransaction* tr, NamedList& params, AsnCursor& data);
 
     /**
      * Update the state of this transaction to end the transaction
@@ -11927,9 +12003,9 @@ public:
     static const TokenDict s_ansiTransactTypes[];
 
 private:
-    SS7TCAPError decodeDialogPortion(NamedList& params, DataBlock& data);
+    SS7TCAPError decodeDialogPortion(NamedList& params, AsnCursor& data);
     void encodeDialogPortion(NamedList& params, DataBlock& data);
-    SS7TCAPError decodeComponents(NamedList& params, DataBlock& data);
+    SS7TCAPError decodeComponents(NamedList& params, AsnCursor& data);
     void encodeComponents(NamedList& params, DataBlock& data);
 
     SS7TCAP::TCAPUserTransActions m_prevType;
@@ -11998,7 +12074,7 @@ public:
 	bool initLocal = true);
 
 private:
-    SS7TCAPError decodeTransactionPart(NamedList& params, DataBlock& data);
+    SS7TCAPError decodeTransactionPart(NamedList& params, AsnCursor& data);
     void encodeTransactionPart(NamedList& params, DataBlock& data);
 };
 
@@ -12074,7 +12150,7 @@ public:
      * @param data Data to decode
      * @return A TCAP error encountered whilst decoding
      */
-    virtual SS7TCAPError handleData(NamedList& params, DataBlock& data);
+    virtual SS7TCAPError handleData(NamedList& params, AsnCursor& data);
 
     /**
      * An update request for this transaction
@@ -12105,10 +12181,10 @@ public:
      * Decode P-Abort TCAP message portion
      * @param tr The transaction on which the abort was signalled
      * @param params NamedList reference to fill with the decoded P-Abort information
-     * @param data DataBlock reference from which to decode P-Abort information
+     * @param data Cursor from which to decode P-Abort information
      * @return A report error
      */
-    static SS7TCAPError decodePAbort(SS7TCAPTransaction* tr, NamedList& params, DataBlock& data);
+    static SS7TCAPError decodePAbort(SS7TCAPTransaction* tr, NamedList& params, AsnCursor& data);
 
     /**
      * Update the state of this transaction to end the transaction
@@ -12127,7 +12203,7 @@ public:
      * @param data Data from which the transaction is decoded
      * @return True if dialog portion is present, false otherwise
      */
-    bool testForDialog(DataBlock& data);
+    bool testForDialog(AsnCursor& data);
 
     /**
      * Encode dialog portion of transaction
@@ -12142,7 +12218,7 @@ public:
      * @param data Data to decodeCaps
      * @return A report error
      */
-    SS7TCAPError decodeDialogPortion(NamedList& params, DataBlock& data);
+    SS7TCAPError decodeDialogPortion(NamedList& params, AsnCursor& data);
 
     /**
      * Update transaction state
@@ -12174,7 +12250,7 @@ public:
     static const TokenDict s_resultPDUValues[];
 
 private:
-    SS7TCAPError decodeComponents(NamedList& params, DataBlock& data);
+    SS7TCAPError decodeComponents(NamedList& params, AsnCursor& data);
     void encodeComponents(NamedList& params, DataBlock& data);
 
     String m_appCtxt;
@@ -648,8 +648,10 @@ void AnalyzerChan::checkTimers(Message& msg, const Time& tmr)
 {
     if (m_stopTime && (m_stopTime < tmr))
 	msgDrop(msg,"finished");
-    else
+    else {
+	scheduleTimers(m_stopTime);
 	Channel::checkTimers(msg,tmr);
+    }
 }
 
 void AnalyzerChan::startChannel(NamedList& params)
@@ -677,8 +679,10 @@ void AnalyzerChan::startChannel(NamedList& params)
 void AnalyzerChan::setDuration(NamedList& params)
 {
     int t = params.getIntValue("duration",120000);
-    if (t > 0)
+    if (t > 0) {
 	m_stopTime = Time::now() + 1000 * (uint64_t)t;
+	scheduleTimers(m_stopTime);
+    }
 }
 
 void AnalyzerChan::addSource()
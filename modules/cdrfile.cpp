@@ -37,6 +37,7 @@ using namespace TelEngine;
 namespace { // anonymous
 
 class CdrFileHandler;
+class CdrFileWriter;
 
 class CdrFilePlugin : public Plugin
 {
@@ -52,33 +53,103 @@ INIT_PLUGIN(CdrFilePlugin);
 
 class CdrFileHandler : public MessageHandler, public Mutex
 {
+    friend class CdrFileWriter;
 public:
     CdrFileHandler(const char *name)
 	: MessageHandler(name,100,__plugin.name()),
 	  Mutex(false,"CdrFileHandler"),
-	  m_file(-1), m_combined(false)
+	  m_file(-1), m_combined(false),
+	  m_fileMutex(false,"CdrFileHandler::file"),
+	  m_batch(0), m_backlog(0), m_interval(0), m_stop(false), m_writer(0)
 	{ }
     virtual ~CdrFileHandler();
     virtual bool received(Message &msg);
     void init(const char *fname, bool tabsep, bool combined, const char* format);
+    void batching(unsigned int batch, unsigned int backlog, unsigned int interval);
 private:
+    // Write out the buffered records
+    void flush();
     int m_file;
     bool m_combined;
     String m_format;
+    // Serializes writes to the file, buffer is protected by the handler mutex
+    Mutex m_fileMutex;
+    String m_buffer;
+    unsigned int m_batch;
+    unsigned int m_backlog;
+    u_int64_t m_interval;
+    bool m_stop;
+    CdrFileWriter* m_writer;
+};
+
+// Writes buffered records in the background
+class CdrFileWriter : public Thread
+{
+public:
+    inline CdrFileWriter(CdrFileHandler* handler)
+	: Thread("CDR File Writer"),
+	  m_handler(handler)
+	{ }
+    virtual void run();
+    virtual void cleanup();
+private:
+    CdrFileHandler* m_handler;
 };
 
 CdrFileHandler::~CdrFileHandler()
 {
-    Lock lock(this);
+    // Stop the writer, it writes out the buffered records before exiting
+    lock();
+    m_stop = true;
+    while (m_writer) {
+	unlock();
+	Thread::idle();
+	lock();
+    }
+    unlock();
+    flush();
+    Lock lock(m_fileMutex);
     if (m_file >= 0) {
 	::close(m_file);
 	m_file = -1;
     }
 }
 
+// Write out the buffered records with a single system call
+void CdrFileHandler::flush()
+{
+    Lock lock(this);
+    if (m_buffer.null())
+	return;
+    String buf = m_buffer;
+    m_buffer.clear();
+    Lock flock(m_fileMutex);
+    lock.drop();
+    if (m_file >= 0)
+	YIGNORE(::write(m_file,buf.c_str(),buf.length()));
+}
+
+void CdrFileHandler::batching(unsigned int batch, unsigned int backlog, unsigned int interval)
+{
+    Lock lock(this);
+    m_batch = batch;
+    m_backlog = (backlog > batch) ? backlog : batch;
+    m_interval = 1000 * (u_int64_t)interval;
+    if (m_writer || !m_batch)
+	return;
+    m_writer = new CdrFileWriter(this);
+    if (!m_writer->startup()) {
+	Alarm("cdrfile","system",DebugWarn,"Failed to start the CDR writer thread");
+	m_writer = 0;
+	m_batch = 0;
+    }
+}
+
 void CdrFileHandler::init(const char *fname, bool tabsep, bool combined, const char* format)
 {
+    flush();
     Lock lock(this);
+    Lock flock(m_fileMutex);
     if (m_file >= 0) {
 	::close(m_file);
 	m_file = -1;
@@ -123,15 +194,52 @@ bool CdrFileHandler::received(Message &msg)
         return false;
 
     Lock lock(this);
-    if ((m_file >= 0) && m_format) {
-	String str = m_format;
+    if ((m_file < 0) || m_format.null())
+	return false;
+    String str = m_format;
+    if (m_batch) {
+	// format outside the lock, the writer thread does the file access
+	lock.drop();
 	str += EOLN;
 	msg.replaceParams(str);
-	YIGNORE(::write(m_file,str.c_str(),str.length()));
+	lock.acquire(this);
+	m_buffer += str;
+	if (m_buffer.length() < m_backlog)
+	    return false;
+	// writer is not keeping up, write from this thread
+	lock.drop();
+	flush();
+	return false;
     }
+    str += EOLN;
+    msg.replaceParams(str);
+    YIGNORE(::write(m_file,str.c_str(),str.length()));
     return false;
 };
 
+void CdrFileWriter::run()
+{
+    u_int64_t next = Time::now() + m_handler->m_interval;
+    while (!(m_handler->m_stop || check(false))) {
+	Thread::idle();
+	m_handler->lock();
+	bool wait = (m_handler->m_buffer.length() < m_handler->m_batch);
+	m_handler->unlock();
+	if (wait && (Time::now() < next))
+	    continue;
+	m_handler->flush();
+	next = Time::now() + m_handler->m_interval;
+    }
+    m_handler->flush();
+}
+
+// Also called when the thread is killed, the handler must not use it anymore
+void CdrFileWriter::cleanup()
+{
+    Lock lock(m_handler);
+    m_handler->m_writer = 0;
+}
+
 CdrFilePlugin::CdrFilePlugin()
     : Plugin("cdrfile",true),
       m_handler(0)
@@ -154,9 +262,13 @@ void CdrFilePlugin::initialize()
 	m_handler = new CdrFileHandler("call.cdr");
 	Engine::install(m_handler);
     }
-    if (m_handler)
+    if (m_handler) {
 	m_handler->init(file,cfg.getBoolValue("general","tabs",true),
 	    cfg.getBoolValue("general","combined",false),cfg.getValue("general","format"));
+	m_handler->batching(cfg.getIntValue("general","batch",0,0),
+	    cfg.getIntValue("general","backlog",1048576,0),
+	    cfg.getIntValue("general","interval",1000,10,60000));
+    }
 }
 
 }; // anonymous namespace
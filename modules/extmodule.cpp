@@ -31,6 +31,7 @@
 
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #endif
 
 #include <string.h>
@@ -56,6 +57,26 @@ namespace { // anonymous
 // Safety wait time after we flushed watchers, relays or messages (in ms)
 #define WAIT_FLUSH 5
 
+// Interval to check asynchronous messages for timeout (in usec)
+#define ASYNC_CHECK 100000
+
+// Size of the hash of messages waiting for an answer
+#define WAITING_HASH 17
+
+// Binary frame types, each frame is a 32 bit big endian length of the rest
+#define FRAME_TEXT 'T'
+#define FRAME_MESSAGE 'M'
+#define FRAME_ANSWER 'A'
+// Parameter value length that requests deleting the parameter
+#define FRAME_CLEAR 0xffffffff
+
+// Default size of each shared memory ring
+#define SHM_SIZE 1048576
+// Minimum size of each shared memory ring
+#define SHM_MIN 65536
+// Maximum size of each shared memory ring
+#define SHM_MAX 67108864
+
 static Configuration s_cfg;
 static ObjList s_chans;
 static ObjList s_modules;
@@ -64,8 +85,11 @@ static Mutex s_uses(false,"ExtModUse");
 static int s_waitFlush = WAIT_FLUSH;
 static int s_timeout = MSG_TIMEOUT;
 static bool s_timebomb = false;
+static bool s_async = false;
 static bool s_pluginSafe = true;
 static const char* s_trackName = 0;
+static String s_shmPath;
+static unsigned int s_shmSize = SHM_SIZE;
 
 static const char* s_cmds[] = {
     "info",
@@ -152,6 +176,55 @@ private:
     bool m_waiting;
 };
 
+// Sequential reader of the fields of a binary frame
+class FrameReader
+{
+public:
+    inline FrameReader(const unsigned char* data, unsigned int len)
+	: m_data(data), m_len(len)
+	{ }
+    bool getInt(u_int32_t& val);
+    bool getString(String& str);
+    bool getMessage(Message& msg);
+private:
+    const unsigned char* m_data;
+    unsigned int m_len;
+};
+
+// One direction of the shared memory transport, the data follows the header
+// Head is advanced only by the producer and tail only by the consumer
+struct ShmRing
+{
+    u_int32_t magic;
+    u_int32_t size;
+    u_int32_t pad1[14];
+    volatile u_int32_t head;
+    u_int32_t pad2[15];
+    volatile u_int32_t tail;
+    u_int32_t pad3[15];
+};
+
+// Shared memory file holding a ring for each direction
+class ShmLink
+{
+public:
+    static ShmLink* create(const String& dir, unsigned int size);
+    ~ShmLink();
+    bool write(const void* data, unsigned int len);
+    int read(DataBlock& buf);
+    inline const String& path() const
+	{ return m_path; }
+private:
+    ShmLink(const String& path, void* map, unsigned int size);
+    String m_path;
+    void* m_map;
+    unsigned int m_size;
+    ShmRing* m_out;
+    ShmRing* m_in;
+    unsigned char* m_outData;
+    unsigned char* m_inData;
+};
+
 // Great idea - thanks, Maciek!
 class ExtMessage : public Message
 {
@@ -168,6 +241,7 @@ public:
 	{ return m_receiver == recv; }
     inline int decode(const char* str)
 	{ return Message::decode(str,m_id); }
+    bool decode(FrameReader& frame);
     inline const String& id() const
 	{ return m_id; }
 private:
@@ -179,9 +253,13 @@ private:
 class MsgHolder : public GenObject, public Semaphore
 {
 public:
-    MsgHolder(Message &msg);
+    MsgHolder(Message &msg, bool async = false);
+    virtual const String& toString() const
+	{ return m_id; }
     Message &m_msg;
     bool m_ret;
+    bool m_async;
+    u_int64_t m_start;
     String m_id;
     bool decode(const char *s);
     inline const Message* msg() const
@@ -224,7 +302,9 @@ public:
     virtual void destruct();
     virtual bool received(Message& msg, int id);
     bool processLine(const char* line);
-    bool outputLine(const char* line);
+    bool processFrame(const unsigned char* data, unsigned int len);
+    bool outputLine(const char* line, int after = 0);
+    bool outputMessage(const Message& msg, const String& id);
     void reportError(const char* line);
     void returnMsg(const Message* msg, const char* id, bool accepted);
     bool addWatched(const String& name);
@@ -248,8 +328,14 @@ public:
     inline bool dead() const
 	{ return m_dead || m_quit || (m_use <= 0); }
     void describe(String& rval) const;
+    void checkAsync(u_int64_t now);
 
 private:
+    // Changes applied after writing the line that announces them
+    enum {
+	SwitchFraming = 1,
+	SwitchShm = 2
+    };
     ExtModReceiver(const char* script, const char* args,
 	File* ain, File* aout, ExtModChan* chan);
     ExtModReceiver(const char* name, Stream* io, ExtModChan* chan,
@@ -258,7 +344,15 @@ private:
     void closeIn();
     void closeOut();
     void closeAudio();
-    bool outputLineInternal(const char* line, int len);
+    bool outputItem(const char* line, const Message* msg, const char* id,
+	char type, u_int32_t val, int after = 0, const String* holder = 0);
+    int outputData(const char* data, int len, bool binary, int after);
+    bool outputInternal(const char* data, int len, bool newline);
+    bool answerMessage(const String& id, const char* line, FrameReader* frame, bool handled);
+    void enqueueMessage(ExtMessage* m);
+    int readShm();
+    void answered(const MsgHolder* holder);
+    bool queueAsync(Message& msg, bool& fail);
     int m_role;
     bool m_dead;
     bool m_quit;
@@ -280,12 +374,24 @@ private:
     bool m_scripted;
     DataBlock m_buffer;
     String m_script, m_args;
-    ObjList m_waiting;
+    HashList m_waiting;
     ObjList m_relays;
     String m_trackName;
     String m_reason;
     bool m_dumparray;
     bool m_nonBlock;
+    bool m_async;
+    unsigned int m_asyncCount;
+    u_int64_t m_asyncCheck;
+    unsigned int m_answers;
+    unsigned int m_timeouts;
+    u_int64_t m_latency;
+    u_int64_t m_maxLatency;
+    bool m_binIn;
+    bool m_binOut;
+    ShmLink* m_shm;
+    bool m_shmOut;
+    DataBlock m_frame;
 };
 
 class ExtThread : public Thread
@@ -608,8 +714,8 @@ void ExtModChan::disconnected(bool final, const char *reason)
 }
 
 
-MsgHolder::MsgHolder(Message &msg)
-    : m_msg(msg), m_ret(false)
+MsgHolder::MsgHolder(Message &msg, bool async)
+    : m_msg(msg), m_ret(false), m_async(async), m_start(Time::now())
 {
     // the address of this object should be unique
     char buf[64];
@@ -652,6 +758,247 @@ static String dumpArray(const Array *a)
     return r;
 }
 
+bool FrameReader::getInt(u_int32_t& val)
+{
+    if (m_len < 4)
+	return false;
+    val = ((u_int32_t)m_data[0] << 24) | ((u_int32_t)m_data[1] << 16) |
+	((u_int32_t)m_data[2] << 8) | m_data[3];
+    m_data += 4;
+    m_len -= 4;
+    return true;
+}
+
+bool FrameReader::getString(String& str)
+{
+    u_int32_t len = 0;
+    if (!getInt(len) || (len > m_len))
+	return false;
+    str.assign((const char*)m_data,len);
+    m_data += len;
+    m_len -= len;
+    return true;
+}
+
+// Read name, return value and parameters, same rules as Message::commonDecode()
+bool FrameReader::getMessage(Message& msg)
+{
+    String tmp;
+    if (!getString(tmp))
+	return false;
+    if (tmp)
+	msg = tmp;
+    u_int32_t count = 0;
+    if (!(getString(msg.retValue()) && getInt(count)))
+	return false;
+    String name;
+    while (count--) {
+	u_int32_t len = 0;
+	if (!(getString(name) && name && getInt(len)))
+	    return false;
+	if (len == FRAME_CLEAR) {
+	    msg.clearParam(name);
+	    continue;
+	}
+	if (len > m_len)
+	    return false;
+	tmp.assign((const char*)m_data,len);
+	m_data += len;
+	m_len -= len;
+	msg.setParam(name,tmp);
+    }
+    return !m_len;
+}
+
+static inline unsigned char* putInt(unsigned char* p, u_int32_t val)
+{
+    p[0] = (unsigned char)(val >> 24);
+    p[1] = (unsigned char)(val >> 16);
+    p[2] = (unsigned char)(val >> 8);
+    p[3] = (unsigned char)val;
+    return p + 4;
+}
+
+static inline unsigned char* putString(unsigned char* p, const String& str)
+{
+    p = putInt(p,str.length());
+    if (str.length())
+	::memcpy(p,str.c_str(),str.length());
+    return p + str.length();
+}
+
+// Build a binary frame carrying a message or an answer to one
+// The value is the message time for requests and handled flag for answers
+static void encodeFrame(DataBlock& buf, char type, const Message& msg,
+    const String& id, u_int32_t val)
+{
+    // the length of a NamedList is its parameter count, not of its name
+    const String& name = msg;
+    unsigned int len = 1 + 4 + id.length() + 4 + 4 + name.length() +
+	4 + msg.retValue().length() + 4;
+    unsigned int count = 0;
+    for (const ObjList* l = msg.paramList()->skipNull(); l; l = l->skipNext()) {
+	const NamedString* ns = static_cast<const NamedString*>(l->get());
+	len += 8 + ns->name().length() + ns->length();
+	count++;
+    }
+    buf.resize(len + 4);
+    unsigned char* p = putInt((unsigned char*)buf.data(),len);
+    *p++ = type;
+    p = putString(p,id);
+    p = putInt(p,val);
+    p = putString(p,msg);
+    p = putString(p,msg.retValue());
+    p = putInt(p,count);
+    for (const ObjList* l = msg.paramList()->skipNull(); l; l = l->skipNext()) {
+	const NamedString* ns = static_cast<const NamedString*>(l->get());
+	p = putString(p,ns->name());
+	p = putString(p,*ns);
+    }
+}
+
+// Build a binary frame carrying a protocol text line
+static void encodeFrame(DataBlock& buf, const char* line, unsigned int len)
+{
+    buf.resize(len + 5);
+    unsigned char* p = putInt((unsigned char*)buf.data(),len + 1);
+    *p++ = FRAME_TEXT;
+    ::memcpy(p,line,len);
+}
+
+
+// Marker placed in the header of an initialized ring
+#define SHM_MAGIC 0x5953484d
+
+ShmLink::ShmLink(const String& path, void* map, unsigned int size)
+    : m_path(path), m_map(map), m_size(size)
+{
+    unsigned char* p = (unsigned char*)map;
+    m_out = (ShmRing*)p;
+    m_outData = p + sizeof(ShmRing);
+    m_in = (ShmRing*)(m_outData + size);
+    m_inData = (unsigned char*)m_in + sizeof(ShmRing);
+}
+
+ShmLink::~ShmLink()
+{
+#ifndef _WINDOWS
+    ::munmap(m_map,2 * (sizeof(ShmRing) + m_size));
+    File::remove(m_path);
+#endif
+}
+
+// Create a new shared memory file only accessible by the current user
+// Both rings use the same power of 2 size
+ShmLink* ShmLink::create(const String& dir, unsigned int size)
+{
+#ifdef _WINDOWS
+    return 0;
+#else
+    static unsigned int s_index = 0;
+    unsigned int ringSize = SHM_MIN;
+    while ((ringSize < size) && (ringSize < SHM_MAX))
+	ringSize <<= 1;
+    s_mutex.lock();
+    unsigned int idx = ++s_index;
+    s_mutex.unlock();
+    String path(dir);
+    if (!path.endsWith("/"))
+	path << "/";
+    path << "yate-extmod-" << (int)::getpid() << "-" << idx;
+    int fd = ::open(path,O_RDWR | O_CREAT | O_EXCL,0600);
+    if (fd < 0) {
+	Debug("ExtModule",DebugWarn,"Could not create shared memory '%s': %d %s",
+	    path.c_str(),errno,strerror(errno));
+	return 0;
+    }
+    size_t len = 2 * (sizeof(ShmRing) + ringSize);
+    void* map = MAP_FAILED;
+    if (::ftruncate(fd,len) == 0)
+	map = ::mmap(0,len,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    int err = errno;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+	Debug("ExtModule",DebugWarn,"Could not map shared memory '%s': %d %s",
+	    path.c_str(),err,strerror(err));
+	File::remove(path);
+	return 0;
+    }
+    ShmLink* link = new ShmLink(path,map,ringSize);
+    ShmRing* rings[2] = { link->m_out, link->m_in };
+    for (int i = 0; i < 2; i++) {
+	rings[i]->size = ringSize;
+	rings[i]->head = 0;
+	rings[i]->tail = 0;
+	__sync_synchronize();
+	rings[i]->magic = SHM_MAGIC;
+    }
+    return link;
+#endif
+}
+
+// Copy a complete frame in the outgoing ring, fails if there is no room yet
+bool ShmLink::write(const void* data, unsigned int len)
+{
+#ifdef _WINDOWS
+    return false;
+#else
+    u_int32_t head = m_out->head;
+    u_int32_t tail = m_out->tail;
+    if (len > m_size - (head - tail))
+	return false;
+    __sync_synchronize();
+    unsigned int pos = head & (m_size - 1);
+    unsigned int first = m_size - pos;
+    if (first > len)
+	first = len;
+    ::memcpy(m_outData + pos,data,first);
+    if (len > first)
+	::memcpy(m_outData,(const unsigned char*)data + first,len - first);
+    // make the data visible before publishing the new head
+    __sync_synchronize();
+    m_out->head = head + len;
+    return true;
+#endif
+}
+
+// Extract the body of a complete frame from the incoming ring
+// Return body length, zero if there is no frame or negative if corrupted
+int ShmLink::read(DataBlock& buf)
+{
+#ifdef _WINDOWS
+    return -1;
+#else
+    u_int32_t tail = m_in->tail;
+    u_int32_t avail = m_in->head - tail;
+    if (!avail)
+	return 0;
+    if ((avail < 4) || (avail > m_size))
+	return -1;
+    __sync_synchronize();
+    unsigned char hdr[4];
+    for (int i = 0; i < 4; i++)
+	hdr[i] = m_inData[(tail + i) & (m_size - 1)];
+    u_int32_t len = ((u_int32_t)hdr[0] << 24) | ((u_int32_t)hdr[1] << 16) |
+	((u_int32_t)hdr[2] << 8) | hdr[3];
+    if (!len || (len > avail - 4))
+	return -1;
+    if (buf.length() < len)
+	buf.resize(len);
+    unsigned int pos = (tail + 4) & (m_size - 1);
+    unsigned int first = m_size - pos;
+    if (first > len)
+	first = len;
+    ::memcpy(buf.data(),m_inData + pos,first);
+    if (len > first)
+	::memcpy((unsigned char*)buf.data() + first,m_inData,len - first);
+    // the data must be copied before releasing the space to the producer
+    __sync_synchronize();
+    m_in->tail = tail + 4 + len;
+    return len;
+#endif
+}
+
 ExtMessage::~ExtMessage()
 {
     if (m_receiver) {
@@ -672,6 +1019,15 @@ void ExtMessage::startup(ExtModReceiver* recv)
     Engine::enqueue(this);
 }
 
+bool ExtMessage::decode(FrameReader& frame)
+{
+    u_int32_t tm = 0;
+    if (!(frame.getString(m_id) && frame.getInt(tm) && frame.getMessage(*this)))
+	return false;
+    msgTime() = tm ? ((u_int64_t)1000000) * tm : Time::now();
+    return true;
+}
+
 void ExtMessage::dispatched(bool accepted)
 {
     m_accepted = accepted;
@@ -824,7 +1180,11 @@ ExtModReceiver::ExtModReceiver(const char* script, const char* args, File* ain,
       m_selfWatch(false), m_reenter(false), m_setdata(true), m_writing(false),
       m_timeout(s_timeout), m_timebomb(s_timebomb), m_restart(false), m_scripted(false),
       m_nonBlock(false),
-      m_buffer(0,DEF_INCOMING_LINE), m_script(script), m_args(args), m_trackName(s_trackName)
+      m_buffer(0,DEF_INCOMING_LINE), m_script(script), m_args(args),
+      m_waiting(WAITING_HASH), m_trackName(s_trackName),
+      m_async(s_async), m_asyncCount(0), m_asyncCheck(0),
+      m_answers(0), m_timeouts(0), m_latency(0), m_maxLatency(0),
+      m_binIn(false), m_binOut(false), m_shm(0), m_shmOut(false)
 {
     Debug(DebugAll,"ExtModReceiver::ExtModReceiver(\"%s\",\"%s\") [%p]",script,args,this);
     m_script.trimBlanks();
@@ -843,7 +1203,11 @@ ExtModReceiver::ExtModReceiver(const char* name, Stream* io, ExtModChan* chan, i
       m_selfWatch(false), m_reenter(false), m_setdata(true), m_writing(false),
       m_timeout(s_timeout), m_timebomb(s_timebomb), m_restart(false), m_scripted(false),
       m_nonBlock(false),
-      m_buffer(0,DEF_INCOMING_LINE), m_script(name), m_args(conn), m_trackName(s_trackName)
+      m_buffer(0,DEF_INCOMING_LINE), m_script(name), m_args(conn),
+      m_waiting(WAITING_HASH), m_trackName(s_trackName),
+      m_async(s_async), m_asyncCount(0), m_asyncCheck(0),
+      m_answers(0), m_timeouts(0), m_latency(0), m_maxLatency(0),
+      m_binIn(false), m_binOut(false), m_shm(0), m_shmOut(false)
 {
     Debug(DebugAll,"ExtModReceiver::ExtModReceiver(\"%s\",%p,%p) [%p]",name,io,chan,this);
     m_script.trimBlanks();
@@ -876,6 +1240,9 @@ void ExtModReceiver::destruct()
     tmp = m_out;
     m_out = 0;
     delete tmp;
+    ShmLink* shm = m_shm;
+    m_shm = 0;
+    delete shm;
 }
 
 void ExtModReceiver::closeIn()
@@ -941,13 +1308,29 @@ bool ExtModReceiver::flush()
 	    p->setDelete(false);
     }
     bool flushed = false;
-    if (m_waiting.get()) {
-	Debug(DebugInfo,"ExtModReceiver releasing %u pending messages [%p]",
-	    m_waiting.count(),this);
+    ObjList async;
+    unsigned int n = m_waiting.count();
+    if (n) {
+	Debug(DebugInfo,"ExtModReceiver releasing %u pending messages [%p]",n,this);
+	// synchronous waiters notice their holder is gone, suspended messages
+	//  are resumed as not handled after unlocking
+	for (unsigned int i = 0; i < m_waiting.length(); i++) {
+	    ObjList* l = m_waiting.getList(i);
+	    for (l = l ? l->skipNull() : 0; l; l = l->skipNext()) {
+		MsgHolder* h = static_cast<MsgHolder*>(l->get());
+		if (h->m_async)
+		    async.append(h);
+	    }
+	}
 	m_waiting.clear();
+	m_asyncCount = 0;
 	needWait = flushed = true;
     }
     unlock();
+    while (MsgHolder* h = static_cast<MsgHolder*>(async.remove(false))) {
+	h->m_msg.resume(false);
+	TelEngine::destruct(h);
+    }
     if (needWait && s_pluginSafe) {
 	int ms = s_waitFlush;
 	// During shutdown longer delays are not acceptable
@@ -1035,9 +1418,18 @@ bool ExtModReceiver::received(Message &msg, int id)
 
     use();
     bool fail = false;
+    // Only messages delivered by our relays (id 0) can be suspended, direct
+    //  callers like call.execute need the result before returning
+    if (m_async && !m_nonBlock && !id && queueAsync(msg,fail)) {
+	unlock();
+	if (fail && m_timebomb)
+	    die();
+	unuse();
+	return false;
+    }
     u_int64_t tout = (m_timeout > 0) ? Time::now() + 1000 * m_timeout : 0;
     MsgHolder h(msg);
-    if (outputLine(msg.encode(h.m_id))) {
+    if (outputMessage(msg,h.m_id)) {
 	if (m_nonBlock) {
 	    DDebug(DebugAll,"ExtMod queued non-blocking message %p '%s' [%p]",&msg,msg.c_str(),this);
 	    unlock();
@@ -1059,11 +1451,12 @@ bool ExtModReceiver::received(Message &msg, int id)
     while (ok) {
 	h.lock(Thread::idleUsec());
 	lock();
-	ok = (m_waiting.find(&h) != 0);
+	ok = (m_waiting[h.m_id] == &h);
 	if (ok && tout && (Time::now() > tout)) {
 	    Alarm("extmodule","performance",DebugWarn,"Message %p '%s' did not return in %d msec [%p]",
 		&msg,msg.c_str(),m_timeout,this);
-	    m_waiting.remove(&h,false);
+	    m_waiting.remove(&h,false,true);
+	    m_timeouts++;
 	    ok = false;
 	    fail = true;
 	}
@@ -1077,6 +1470,80 @@ bool ExtModReceiver::received(Message &msg, int id)
     return h.m_ret;
 }
 
+// Send a message to the script and suspend its dispatching until the answer
+// Must be called with the receiver locked once, it is unlocked while writing
+bool ExtModReceiver::queueAsync(Message& msg, bool& fail)
+{
+    if (!msg.suspend())
+	return false;
+    MsgHolder* h = new MsgHolder(msg,true);
+    m_waiting.append(h)->setDelete(false);
+    m_asyncCount++;
+    String id(h->m_id);
+    DDebug(DebugAll,"ExtMod suspending message %p '%s' [%p]",&msg,msg.c_str(),this);
+    // the message may be answered and resumed as soon as it is written
+    if (outputItem(0,&msg,id,FRAME_MESSAGE,(u_int32_t)msg.msgTime().sec(),0,&id))
+	return true;
+    Debug(DebugWarn,"ExtMod could not queue message %s [%p]",id.c_str(),this);
+    // message may have been released meanwhile if the script died
+    h = static_cast<MsgHolder*>(m_waiting[id]);
+    if (h) {
+	m_waiting.remove(h,false,true);
+	m_asyncCount--;
+	h->m_msg.resume(false);
+	TelEngine::destruct(h);
+    }
+    fail = true;
+    return true;
+}
+
+// Update answer statistics, must be called with the receiver locked
+void ExtModReceiver::answered(const MsgHolder* holder)
+{
+    u_int64_t lat = Time::now() - holder->m_start;
+    m_answers++;
+    m_latency += lat;
+    if (m_maxLatency < lat)
+	m_maxLatency = lat;
+}
+
+// Resume as not handled the suspended messages that waited too long
+void ExtModReceiver::checkAsync(u_int64_t now)
+{
+    if (!m_asyncCount || (now < m_asyncCheck) || (m_timeout <= 0))
+	return;
+    m_asyncCheck = now + ASYNC_CHECK;
+    u_int64_t limit = now - 1000 * (u_int64_t)m_timeout;
+    ObjList expired;
+    lock();
+    for (unsigned int i = 0; i < m_waiting.length(); i++) {
+	ObjList* l = m_waiting.getList(i);
+	for (l = l ? l->skipNull() : 0; l; ) {
+	    MsgHolder* h = static_cast<MsgHolder*>(l->get());
+	    if (h->m_async && (h->m_start < limit)) {
+		l->remove(false);
+		expired.append(h);
+		m_asyncCount--;
+		m_timeouts++;
+		l = l->skipNull();
+	    }
+	    else
+		l = l->skipNext();
+	}
+    }
+    unlock();
+    if (!expired.skipNull())
+	return;
+    while (MsgHolder* h = static_cast<MsgHolder*>(expired.remove(false))) {
+	Alarm("extmodule","performance",DebugWarn,"Message %p '%s' did not return in %d msec [%p]",
+	    h->msg(),h->msg()->c_str(),m_timeout,this);
+	h->m_msg.resume(false);
+	TelEngine::destruct(h);
+    }
+    if (m_timebomb)
+	die();
+}
+
 bool ExtModReceiver::create(const char *script, const char *args)
 {
 #ifdef _WINDOWS
@@ -1202,10 +1669,24 @@ void ExtModReceiver::run()
     bool invalid = true;
     DDebug(DebugAll,"ExtModReceiver::run() entering loop [%p]",this);
     for (;;) {
+	checkAsync(Time::now());
+	// the shared memory ring takes over after negotiation, the stream still signals EOF
+	int frames = m_shm ? readShm() : 0;
+	if (frames < 0)
+	    return;
+	if (frames)
+	    invalid = false;
+	// a full buffer holds an incomplete line or frame
+	if (posinbuf >= (int)m_buffer.length() - 1) {
+	    Debug("ExtModule",DebugWarn,"Overflow reading in buffer of length %u, closing [%p]",
+		m_buffer.length(),this);
+	    return;
+	}
 	use();
 	lock();
 	char* buffer = static_cast<char*>(m_buffer.data());
-	int readsize = m_in ? m_in->readData(buffer+posinbuf,m_buffer.length()-posinbuf) : 0;
+	// keep room for the string terminator
+	int readsize = m_in ? m_in->readData(buffer+posinbuf,m_buffer.length()-posinbuf-1) : 0;
 	unlock();
 	if (unuse())
 	    return;
@@ -1225,7 +1706,8 @@ void ExtModReceiver::run()
 	    Lock mylock(this);
 	    if (m_in && m_in->canRetry()) {
 		mylock.drop();
-		Thread::idle();
+		if (!frames)
+		    Thread::idle();
 		continue;
 	    }
 	    if (!m_quit)
@@ -1234,13 +1716,37 @@ void ExtModReceiver::run()
 	}
 	XDebug(DebugAll,"ExtModReceiver::run() read %d",readsize);
 	int totalsize = readsize + posinbuf;
-	if (totalsize >= (int)m_buffer.length()) {
-	    Debug("ExtModule",DebugWarn,"Overflow reading in buffer of length %u, closing [%p]",
-		m_buffer.length(),this);
-	    return;
-	}
 	buffer[totalsize]=0;
 	for (;;) {
+	    if (m_binIn) {
+		if (totalsize < 4)
+		    break;
+		const unsigned char* frame = (const unsigned char*)buffer;
+		unsigned int len = ((unsigned int)frame[0] << 24) | ((unsigned int)frame[1] << 16) |
+		    ((unsigned int)frame[2] << 8) | frame[3];
+		if (len >= m_buffer.length() - 5) {
+		    Debug("ExtModule",DebugWarn,"Frame of length %u overflows buffer of length %u, closing [%p]",
+			len,m_buffer.length(),this);
+		    return;
+		}
+		if ((unsigned int)totalsize < len + 4)
+		    break;
+		readsize = len + 4;
+		invalid = false;
+		use();
+		bool goOut = processFrame(frame + 4,len);
+		if (unuse() || goOut)
+		    return;
+		if (totalsize >= (int)m_buffer.length()) {
+		    Debug("ExtModule",DebugWarn,"Lost data shrinking read buffer to %u, closing [%p]",
+			m_buffer.length(),this);
+		    return;
+		}
+		totalsize -= readsize;
+		buffer = static_cast<char*>(m_buffer.data());
+		::memmove(buffer,buffer+readsize,totalsize+1);
+		continue;
+	    }
 	    char *eoline = ::strchr(buffer,'\n');
 	    if (!eoline && ((int)::strlen(buffer) < totalsize))
 		eoline=buffer+::strlen(buffer);
@@ -1270,21 +1776,95 @@ void ExtModReceiver::run()
     }
 }
 
-bool ExtModReceiver::outputLine(const char* line)
+// Process the frames waiting in the shared memory ring, return how many
+//  or negative if the receiver must stop
+int ExtModReceiver::readShm()
+{
+    int frames = 0;
+    // allow checking the stream and timeouts even if the peer keeps writing
+    while (frames < 64) {
+	int len = m_shm->read(m_frame);
+	if (!len)
+	    break;
+	if (len < 0) {
+	    Debug("ExtModule",DebugWarn,"Corrupted shared memory ring '%s', closing [%p]",
+		m_shm->path().c_str(),this);
+	    return -1;
+	}
+	frames++;
+	use();
+	bool goOut = processFrame((const unsigned char*)m_frame.data(),len);
+	if (unuse() || goOut)
+	    return -1;
+    }
+    return frames;
+}
+
+bool ExtModReceiver::outputLine(const char* line, int after)
 {
     if (TelEngine::null(line))
 	return true;
-    int len = ::strlen(line);
+    return outputItem(line,0,0,0,0,after);
+}
+
+bool ExtModReceiver::outputMessage(const Message& msg, const String& id)
+{
+    return outputItem(0,&msg,id,FRAME_MESSAGE,(u_int32_t)msg.msgTime().sec());
+}
+
+// Encode a protocol line, a message or an answer in the current output mode
+bool ExtModReceiver::outputItem(const char* line, const Message* msg, const char* id,
+    char type, u_int32_t val, int after, const String* holder)
+{
+    for (;;) {
+	// a suspended message is released if the script dies or times out
+	if (holder && !m_waiting[*holder])
+	    return false;
+	bool binary = m_binOut;
+	String text;
+	DataBlock frame;
+	if (binary) {
+	    if (msg)
+		encodeFrame(frame,type,*msg,id,val);
+	    else
+		encodeFrame(frame,line,::strlen(line));
+	}
+	else if (msg) {
+	    text = (type == FRAME_ANSWER) ? msg->encode(val != 0,id) : msg->encode(id);
+	    line = text;
+	}
+	// writing may wait for the script, the reader must be able to proceed
+	if (holder)
+	    unlock();
+	int res = binary ?
+	    outputData((const char*)frame.data(),frame.length(),true,after) :
+	    outputData(line,::strlen(line),false,after);
+	if (holder)
+	    lock();
+	if (res >= 0)
+	    return (res > 0);
+	// the output mode was switched meanwhile, encode again
+    }
+}
+
+// Serialize writers, switch output mode while still owning the stream
+// Return 1 on success, 0 on failure, -1 if the output mode has changed
+int ExtModReceiver::outputData(const char* data, int len, bool binary, int after)
+{
     if (m_dead || !m_out || !m_out->valid() || !use())
-	return false;
+	return 0;
     uint64_t tout = (m_timeout > 0) ? (Time::now() + 1000 * (uint64_t)m_timeout) : 0;
     for (;;) {
 	Lock mylock(this);
 	if (m_dead || !m_out || !m_out->valid()) {
 	    unuse();
-	    return false;
+	    return 0;
 	}
 	if (!m_writing) {
+	    if (binary != m_binOut) {
+		unuse();
+		return -1;
+	    }
 	    m_writing = true;
 	    break;
 	}
@@ -1293,34 +1873,56 @@ bool ExtModReceiver::outputLine(const char* line)
 		Alarm("extmodule","performance",DebugWarn,"Timeout %d msec for %d characters [%p]",
 		    m_timeout,len,this);
 	    unuse();
-	    return false;
+	    return 0;
 	}
 	mylock.drop();
 	Thread::idle();
     }
-    bool ok = outputLineInternal(line,len);
+    bool ok = outputInternal(data,len,!binary);
+    if (after & SwitchFraming)
+	m_binOut = m_binIn;
+    if (after & SwitchShm)
+	m_shmOut = (m_shm != 0);
     m_writing = false;
     unuse();
-    return ok;
+    return ok ? 1 : 0;
 }
 
-bool ExtModReceiver::outputLineInternal(const char* line, int len)
+bool ExtModReceiver::outputInternal(const char* data, int len, bool newline)
 {
-    DDebug("ExtModReceiver",DebugAll,"outputLine len=%d '%s' [%p]",len,line,this);
+    DDebug("ExtModReceiver",DebugAll,"outputData len=%d%s [%p]",len,
+	(newline ? " line" : ""),this);
+    if (m_shmOut) {
+	// the reader releases space in the ring at its own pace
+	uint64_t tout = (m_timeout > 0) ? (Time::now() + 1000 * (uint64_t)m_timeout) : 0;
+	while (!m_shm->write(data,len)) {
+	    if (m_dead || !m_out || !m_out->valid())
+		return false;
+	    if (tout && tout < Time::now()) {
+		Debug("ExtModReceiver",DebugWarn,"Shared memory ring full for %d msec [%p]",
+		    m_timeout,this);
+		return false;
+	    }
+	    Thread::idle();
+	}
+	return true;
+    }
     // since m_out can be non-blocking (the socket) we have to loop
     while (m_out && m_out->valid() && (len > 0) && !m_dead) {
-	int w = m_out->writeData(line,len);
+	int w = m_out->writeData(data,len);
 	if (w < 0) {
 	    if (m_dead || !m_out || !m_out->canRetry())
 		return false;
 	}
 	else {
-	    line += w;
+	    data += w;
 	    len -= w;
 	}
 	if (len > 0)
 	    Thread::idle();
     }
+    if (!newline)
+	return (len <= 0);
     char nl = '\n';
     for (;;) {
 	if (m_dead || !m_out)
@@ -1344,8 +1946,7 @@ void ExtModReceiver::reportError(const char* line)
 
 void ExtModReceiver::returnMsg(const Message* msg, const char* id, bool accepted)
 {
-    String ret(msg->encode(accepted,id));
-    if (!outputLine(ret) && m_timebomb)
+    if (!outputItem(0,msg,id,FRAME_ANSWER,accepted) && m_timebomb)
 	die();
 }
 
@@ -1416,26 +2017,12 @@ bool ExtModReceiver::processLine(const char* line)
 	    Debug(DebugWarn,"Expecting %%%%>connect, received '%s' [%p]",id.c_str(),this);
 	return true;
     }
-    else if (id.startsWith("%%<message:")) {
-	Lock mylock(this);
-	ObjList *p = &m_waiting;
-	for (; p; p=p->next()) {
-	    MsgHolder *msg = static_cast<MsgHolder *>(p->get());
-	    if (msg && msg->decode(line)) {
-		DDebug("ExtModReceiver",DebugInfo,"Matched message %p [%p]",msg->msg(),this);
-		if (m_chan && (m_chan->waitMsg() == msg->msg())) {
-		    DDebug("ExtModReceiver",DebugNote,"Entering wait mode on channel %p [%p]",m_chan,this);
-		    m_chan->waitMsg(0);
-		    m_chan->waiting(true);
-		}
-		msg->unlock();
-		p->remove(false);
-		return false;
-	    }
-	}
-	Debug("ExtModReceiver",(m_dead ? DebugInfo : DebugWarn),
-	    "Unmatched%s message: %s [%p]",(m_dead ? " dead" : ""),line,this);
-	return false;
+    else if (id.startSkip("%%<message:",false)) {
+	// answers are matched by the id we generated, skip decoding all others
+	int sep = id.find(':');
+	if (sep > 0)
+	    id = String::msgUnescape(id.substr(0,sep));
+	return answerMessage(id,line,0,false);
     }
     else if (id.startSkip("%%>install:",false)) {
 	int prio = 100;
@@ -1522,6 +2109,7 @@ bool ExtModReceiver::processLine(const char* line)
 	    val.trimBlanks();
 	    id = id.substr(0,col);
 	    bool ok = false;
+	    int after = 0;
 	    Lock mylock(this);
 	    if (m_dead)
 		return false;
@@ -1636,11 +2224,41 @@ bool ExtModReceiver::processLine(const char* line)
 		val = m_nonBlock;
 		ok = true;
 	    }
+	    else if (id == "async") {
+		m_async = val.toBoolean(m_async);
+		val = m_async;
+		ok = true;
+	    }
+	    else if (id == "framing") {
+		// the answer still uses the old framing, shared memory needs binary
+		bool binary = (val == YSTRING("binary"));
+		ok = val.null() || binary || ((val == YSTRING("text")) && !m_shm);
+		if (ok && val && (binary != m_binIn)) {
+		    m_binIn = binary;
+		    after = SwitchFraming;
+		}
+		val = m_binIn ? "binary" : "text";
+	    }
+	    else if (id == "transport") {
+		if (val == YSTRING("shm")) {
+		    // the answer carries the path and is the last data sent on the stream
+		    if (m_binIn && !m_shm && s_shmPath) {
+			m_shm = ShmLink::create(s_shmPath,s_shmSize);
+			ok = (m_shm != 0);
+		    }
+		    if (ok)
+			after = SwitchShm;
+		}
+		else
+		    ok = val.null();
+		val = m_shm ? m_shm->path().c_str() : "stream";
+	    }
 	    DDebug("ExtModReceiver",DebugAll,"Set '%s'='%s' %s",
 		id.c_str(),val.c_str(),ok ? "ok" : "failed");
 	    String out("%%<setlocal:");
 	    out << id << ":" << val << ":" << ok;
-	    outputLine(out);
+	    mylock.drop();
+	    outputLine(out,after);
 	    return false;
 	}
     }
@@ -1652,57 +2270,139 @@ bool ExtModReceiver::processLine(const char* line)
     else {
 	ExtMessage* m = new ExtMessage;
 	if (m->decode(line) == -2) {
-	    DDebug("ExtModReceiver",DebugAll,"Created message %p '%s' [%p]",m,m->c_str(),this);
-	    lock();
-	    bool note = true;
-	    while (!m_dead && m_chan && m_chan->waiting()) {
-		if (note) {
-		    note = false;
-		    Debug("ExtModReceiver",DebugNote,"Waiting before enqueueing new message %p '%s' [%p]",
-			m,m->c_str(),this);
+	    enqueueMessage(m);
+	    return false;
+	}
+	m->destruct();
+    }
+    reportError(line);
+    return false;
+}
+
+// Match an answer from the text line or binary frame to a waiting message
+bool ExtModReceiver::answerMessage(const String& id, const char* line, FrameReader* frame,
+    bool handled)
+{
+    Lock mylock(this);
+    MsgHolder* msg = static_cast<MsgHolder*>(m_waiting[id]);
+    bool ok = false;
+    if (msg) {
+	if (frame) {
+	    msg->m_ret = handled;
+	    ok = frame->getMessage(msg->m_msg);
+	}
+	else
+	    ok = msg->decode(line);
+    }
+    if (ok) {
+	DDebug("ExtModReceiver",DebugInfo,"Matched message %p [%p]",msg->msg(),this);
+	if (m_chan && (m_chan->waitMsg() == msg->msg())) {
+	    DDebug("ExtModReceiver",DebugNote,"Entering wait mode on channel %p [%p]",m_chan,this);
+	    m_chan->waitMsg(0);
+	    m_chan->waiting(true);
+	}
+	m_waiting.remove(msg,false,true);
+	answered(msg);
+	if (msg->m_async) {
+	    m_asyncCount--;
+	    mylock.drop();
+	    msg->m_msg.resume(msg->m_ret);
+	    TelEngine::destruct(msg);
+	}
+	else
+	    msg->unlock();
+	return false;
+    }
+    Debug("ExtModReceiver",(m_dead ? DebugInfo : DebugWarn),
+	"Unmatched%s message: %s [%p]",(m_dead ? " dead" : ""),(line ? line : id.c_str()),this);
+    return false;
+}
+
+// Enqueue a message received from the external module
+void ExtModReceiver::enqueueMessage(ExtMessage* m)
+{
+    DDebug("ExtModReceiver",DebugAll,"Created message %p '%s' [%p]",m,m->c_str(),this);
+    lock();
+    bool note = true;
+    while (!m_dead && m_chan && m_chan->waiting()) {
+	if (note) {
+	    note = false;
+	    Debug("ExtModReceiver",DebugNote,"Waiting before enqueueing new message %p '%s' [%p]",
+		m,m->c_str(),this);
+	}
+	unlock();
+	Thread::yield();
+	if (m_dead) {
+	    m->destruct();
+	    return;
+	}
+	lock();
+    }
+    ExtModChan* chan = 0;
+    if ((m_role == RoleChannel) && !m_chan && m_setdata && (*m == "call.execute")) {
+	// we delayed channel creation as there was nothing to ref() it
+	chan = new ExtModChan(this);
+	m_chan = chan;
+	m->setParam("id",chan->id());
+    }
+    if (m_setdata)
+	m->userData(m_chan);
+    // now the newly created channel is referenced by the message
+    if (chan)
+	chan->deref();
+    const String& id = m->id();
+    if (id && !chan) {
+	// Copy the user data pointer from waiting message with same id
+	MsgHolder *h = static_cast<MsgHolder *>(m_waiting[id]);
+	if (h) {
+	    RefObject* ud = h->m_msg.userData();
+	    Debug("ExtModReceiver",DebugAll,"Copying data pointer %p from %p '%s' [%p]",
+		ud,h->msg(),h->msg()->c_str(),this);
+	    m->userData(ud);
+	}
+    }
+    m->startup(this);
+    unlock();
+}
+
+bool ExtModReceiver::processFrame(const unsigned char* data, unsigned int len)
+{
+    if (m_dead)
+	return false;
+    if (m_quit)
+	return true;
+    if (len) {
+	FrameReader frame(data + 1,len - 1);
+	switch (data[0]) {
+	    case FRAME_TEXT:
+		{
+		    String line((const char*)data + 1,len - 1);
+		    if (line)
+			return processLine(line);
 		}
-		unlock();
-		Thread::yield();
-		if (m_dead) {
-		    m->destruct();
-		    return false;
+		return false;
+	    case FRAME_ANSWER:
+		{
+		    String id;
+		    u_int32_t handled = 0;
+		    if (frame.getString(id) && frame.getInt(handled))
+			return answerMessage(id,0,&frame,handled != 0);
 		}
-		lock();
-	    }
-	    ExtModChan* chan = 0;
-	    if ((m_role == RoleChannel) && !m_chan && m_setdata && (*m == "call.execute")) {
-		// we delayed channel creation as there was nothing to ref() it
-		chan = new ExtModChan(this);
-		m_chan = chan;
-		m->setParam("id",chan->id());
-	    }
-	    if (m_setdata)
-		m->userData(m_chan);
-	    // now the newly created channel is referenced by the message
-	    if (chan)
-		chan->deref();
-	    id = m->id();
-	    if (id && !chan) {
-		// Copy the user data pointer from waiting message with same id
-		ObjList *p = &m_waiting;
-		for (; p; p=p->next()) {
-		    MsgHolder *h = static_cast<MsgHolder *>(p->get());
-		    if (h && (h->m_id == id)) {
-			RefObject* ud = h->m_msg.userData();
-			Debug("ExtModReceiver",DebugAll,"Copying data pointer %p from %p '%s' [%p]",
-			    ud,h->msg(),h->msg()->c_str(),this);
-			m->userData(ud);
-			break;
+		break;
+	    case FRAME_MESSAGE:
+		if (m_role != RoleUnknown) {
+		    ExtMessage* m = new ExtMessage;
+		    if (m->decode(frame)) {
+			enqueueMessage(m);
+			return false;
 		    }
+		    m->destruct();
 		}
-	    }
-	    m->startup(this);
-	    unlock();
-	    return false;
+		break;
 	}
-	m->destruct();
     }
-    reportError(line);
+    Debug("ExtModReceiver",DebugWarn,"Invalid frame type 0x%02x length %u [%p]",
+	(len ? data[0] : 0),len,this);
     return false;
 }
 
@@ -1731,6 +2431,21 @@ void ExtModReceiver::describe(String& rval) const
 	rval << ", autorestart";
     if (m_pid > 0)
 	rval << ", pid=" << m_pid;
+    if (m_async)
+	rval << ", async, pending=" << m_asyncCount;
+    if (m_binIn)
+	rval << ", binary";
+    if (m_shm)
+	rval << ", shm=" << m_shm->path();
+    if (m_answers || m_timeouts) {
+	rval << ", answers=" << m_answers << ", timeouts=" << m_timeouts;
+	if (m_answers) {
+	    char buf[64];
+	    ::sprintf(buf,", latency=%.1f/%.1f ms",
+		(double)m_latency / (1000.0 * m_answers),m_maxLatency / 1000.0);
+	    rval << buf;
+	}
+    }
     rval << "\r\n";
 }
 
@@ -2055,6 +2770,9 @@ void ExtModulePlugin::initialize()
     s_cfg.load();
     s_timeout = s_cfg.getIntValue("general","timeout",MSG_TIMEOUT);
     s_timebomb = s_cfg.getBoolValue("general","timebomb",false);
+    s_async = s_cfg.getBoolValue("general","async",false);
+    s_shmPath = s_cfg.getValue("general","shm_path","/dev/shm");
+    s_shmSize = s_cfg.getIntValue("general","shm_size",SHM_SIZE,SHM_MIN,SHM_MAX);
     s_trackName = s_cfg.getBoolValue("general","trackparam",false) ?
 	name().c_str() : (const char*)0;
     int wf = s_cfg.getIntValue("general","waitflush",WAIT_FLUSH);
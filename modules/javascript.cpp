@@ -59,7 +59,9 @@ protected:
 private:
     bool evalContext(String& retVal, const String& cmd, ScriptContext* context = 0);
     void clearPostHook();
+    ScriptContext* assistContext();
     JsParser m_assistCode;
+    RefPointer<ScriptContext> m_assistBase;
     MessagePostHook* m_postHook;
     bool m_started;
 };
@@ -92,7 +94,7 @@ public:
     virtual bool msgRoute(Message& msg);
     virtual bool msgDisconnect(Message& msg, const String& reason);
     void msgPostExecute(const Message& msg, bool handled);
-    bool init();
+    bool init(bool forked = false);
     inline State state() const
 	{ return m_state; }
     inline const char* stateName() const
@@ -155,8 +157,9 @@ class JsShared : public JsObject
 {
     YCLASS(JsShared,JsObject)
 public:
-    inline JsShared(Mutex* mtx)
-	: JsObject("Shared",mtx,true)
+    inline JsShared(Mutex* mtx, SharedVars* vars)
+	: JsObject("Shared",mtx,true),
+	  m_vars(vars)
 	{
 	    params().addParam(new ExpFunction("inc"));
 	    params().addParam(new ExpFunction("dec"));
@@ -164,9 +167,13 @@ public:
 	    params().addParam(new ExpFunction("set"));
 	    params().addParam(new ExpFunction("clear"));
 	    params().addParam(new ExpFunction("exists"));
+	    params().addParam(new ExpFunction("getVars"));
+	    params().addParam(new ExpFunction("clearAll"));
 	}
 protected:
     bool runNative(ObjList& stack, const ExpOperation& oper, GenObject* context);
+private:
+    RefPointer<SharedVars> m_vars;
 };
 
 class JsTimeEvent : public RefObject
@@ -254,7 +261,8 @@ public:
 	    params().addParam(new ExpFunction("started"));
 	    if (name)
 		params().addParam(new ExpOperation(name,"name"));
-	    params().addParam(new ExpWrapper(new JsShared(mtx),"shared"));
+	    params().addParam(new ExpWrapper(new JsShared(mtx,&Engine::sharedVars()),"shared"));
+	    params().addParam(new ExpFunction("sharedVars"));
 	    params().addParam(new ExpFunction("runParams"));
 	    params().addParam(new ExpFunction("configFile"));
 	    params().addParam(new ExpFunction("setInterval"));
@@ -759,7 +767,9 @@ static bool s_engineStop = false;
 static bool s_allowAbort = false;
 static bool s_allowTrace = false;
 static bool s_allowLink = true;
+static bool s_allowBytecode = false;
 static bool s_autoExt = true;
+static bool s_forkContext = false;
 static unsigned int s_maxFile = 500000;
 
 UNLOAD_PLUGIN(unloadNow)
@@ -798,18 +808,10 @@ static bool contextLoad(ScriptRun* runner, const char* name, const char* libs =
     return runner && contextLoad(runner->context(),name,libs,objs);
 }
 
-// Initialize a script context, populate global objects
-static void contextInit(ScriptRun* runner, const char* name = 0, JsAssist* assist = 0)
+// Populate global objects that do not depend on the script instance
+static void contextShared(ScriptContext* ctx)
 {
-    if (!runner)
-	return;
-    ScriptContext* ctx = runner->context();
-    if (!ctx)
-	return;
     JsObject::initialize(ctx);
-    JsEngine::initialize(ctx,name);
-    if (assist)
-	JsChannel::initialize(ctx,assist);
     JsMessage::initialize(ctx);
     JsFile::initialize(ctx);
     JsConfigFile::initialize(ctx);
@@ -817,10 +819,30 @@ static void contextInit(ScriptRun* runner, const char* name = 0, JsAssist* assis
     JsHasher::initialize(ctx);
     JsJSON::initialize(ctx);
     JsDNS::initialize(ctx);
+}
+
+// Populate global objects specific to a script instance
+static void contextInstance(ScriptContext* ctx, const char* name, JsAssist* assist)
+{
+    JsEngine::initialize(ctx,name);
+    if (assist)
+	JsChannel::initialize(ctx,assist);
     if (s_autoExt)
 	contextLoad(ctx,name);
 }
 
+// Initialize a script context, populate global objects
+static void contextInit(ScriptRun* runner, const char* name = 0, JsAssist* assist = 0)
+{
+    if (!runner)
+	return;
+    ScriptContext* ctx = runner->context();
+    if (!ctx)
+	return;
+    contextShared(ctx);
+    contextInstance(ctx,name,assist);
+}
+
 // Build a tabular dump of an Object or Array
 static void dumpTable(const ExpOperation& oper, String& str, const char* eol)
 {
@@ -1267,6 +1289,19 @@ bool JsEngine::runNative(ObjList& stack, const ExpOperation& oper, GenObject* co
 	else
 	    return false;
     }
+    else if (oper.name() == YSTRING("sharedVars")) {
+	if (oper.number() != 1)
+	    return false;
+	ExpOperation* op = popValue(stack,context);
+	if (!op)
+	    return false;
+	RefPointer<SharedVars> vars;
+	if (Engine::sharedVars(vars,*op))
+	    ExpEvaluator::pushOne(stack,new ExpWrapper(new JsShared(mutex(),vars),*op));
+	else
+	    ExpEvaluator::pushOne(stack,new ExpWrapper(0,*op));
+	TelEngine::destruct(op);
+    }
     else if (oper.name() == YSTRING("runParams")) {
 	if (oper.number() == 0) {
 	    JsObject* jso = new JsObject(context,mutex());
@@ -1584,7 +1619,7 @@ bool JsShared::runNative(ObjList& stack, const ExpOperation& oper, GenObject* co
 	    mod--;
 	else
 	    mod = 0;
-	ExpEvaluator::pushOne(stack,new ExpOperation((int64_t)Engine::sharedVars().inc(*param,mod)));
+	ExpEvaluator::pushOne(stack,new ExpOperation((int64_t)m_vars->inc(*param,mod)));
     }
     else if (oper.name() == YSTRING("dec")) {
 	ObjList args;
@@ -1604,7 +1639,7 @@ bool JsShared::runNative(ObjList& stack, const ExpOperation& oper, GenObject* co
 	    mod--;
 	else
 	    mod = 0;
-	ExpEvaluator::pushOne(stack,new ExpOperation((int64_t)Engine::sharedVars().dec(*param,mod)));
+	ExpEvaluator::pushOne(stack,new ExpOperation((int64_t)m_vars->dec(*param,mod)));
     }
     else if (oper.name() == YSTRING("get")) {
 	if (oper.number() != 1)
@@ -1613,7 +1648,7 @@ bool JsShared::runNative(ObjList& stack, const ExpOperation& oper, GenObject* co
 	if (!param)
 	    return false;
 	String buf;
-	Engine::sharedVars().get(*param,buf);
+	m_vars->get(*param,buf);
 	TelEngine::destruct(param);
 	ExpEvaluator::pushOne(stack,new ExpOperation(buf));
     }
@@ -1628,7 +1663,7 @@ bool JsShared::runNative(ObjList& stack, const ExpOperation& oper, GenObject* co
 	    TelEngine::destruct(val);
 	    return false;
 	}
-	Engine::sharedVars().set(*param,*val);
+	m_vars->set(*param,*val);
 	TelEngine::destruct(param);
 	TelEngine::destruct(val);
     }
@@ -1638,7 +1673,7 @@ bool JsShared::runNative(ObjList& stack, const ExpOperation& oper, GenObject* co
 	ExpOperation* param = popValue(stack,context);
 	if (!param)
 	    return false;
-	Engine::sharedVars().clear(*param);
+	m_vars->clear(*param);
 	TelEngine::destruct(param);
     }
     else if (oper.name() == YSTRING("exists")) {
@@ -1647,9 +1682,35 @@ bool JsShared::runNative(ObjList& stack, const ExpOperation& oper, GenObject* co
 	ExpOperation* param = popValue(stack,context);
 	if (!param)
 	    return false;
-	ExpEvaluator::pushOne(stack,new ExpOperation(Engine::sharedVars().exists(*param)));
+	ExpEvaluator::pushOne(stack,new ExpOperation(m_vars->exists(*param)));
 	TelEngine::destruct(param);
     }
+    else if (oper.name() == YSTRING("getVars")) {
+	// snapshot of all variables or only those starting with a prefix
+	ExpOperation* prefix = 0;
+	switch (oper.number()) {
+	    case 1:
+		prefix = popValue(stack,context);
+		if (!prefix)
+		    return false;
+	    case 0:
+		break;
+	    default:
+		return false;
+	}
+	JsObject* jso = new JsObject(context,mutex());
+	if (prefix)
+	    m_vars->copy(jso->params(),*prefix);
+	else
+	    m_vars->copy(jso->params());
+	TelEngine::destruct(prefix);
+	ExpEvaluator::pushOne(stack,new ExpWrapper(jso,oper.name()));
+    }
+    else if (oper.name() == YSTRING("clearAll")) {
+	if (oper.number())
+	    return false;
+	m_vars->clearAll();
+    }
     else
 	return JsObject::runNative(stack,oper,context);
     return true;
@@ -4100,13 +4161,21 @@ const char* JsAssist::stateName(State st)
     return lookup(st,s_states,"???");
 }
 
-bool JsAssist::init()
+bool JsAssist::init(bool forked)
 {
     if (!m_runner)
 	return false;
-    contextInit(m_runner,id(),this);
-    if (ScriptRun::Invalid == m_runner->reset(true))
-	return false;
+    if (forked) {
+	// shared globals and script functions are inherited from the snapshot
+	contextInstance(m_runner->context(),id(),this);
+	if (ScriptRun::Invalid == m_runner->reset(false))
+	    return false;
+    }
+    else {
+	contextInit(m_runner,id(),this);
+	if (ScriptRun::Invalid == m_runner->reset(true))
+	    return false;
+    }
     ScriptContext* ctx = m_runner->context();
     ScriptContext* chan = YOBJECT(ScriptContext,ctx->getField(m_runner->stack(),YSTRING("Channel"),m_runner));
     if (chan) {
@@ -4341,6 +4410,7 @@ JsGlobal::JsGlobal(const char* scriptName, const char* fileName, bool relPath, b
 	m_jsCode.adjustPath(*this);
     m_jsCode.setMaxFileLen(s_maxFile);
     m_jsCode.link(s_allowLink);
+    m_jsCode.bytecode(s_allowBytecode);
     m_jsCode.trace(s_allowTrace);
     DDebug(&__plugin,DebugAll,"Loading global Javascript '%s' from '%s'",name().c_str(),c_str());
     if (m_jsCode.parseFile(*this))
@@ -4636,6 +4706,7 @@ bool JsModule::evalContext(String& retVal, const String& cmd, ScriptContext* con
     parser.basePath(s_basePath,s_libsPath);
     parser.setMaxFileLen(s_maxFile);
     parser.link(s_allowLink);
+    parser.bytecode(s_allowBytecode);
     parser.trace(s_allowTrace);
     if (!parser.parse(cmd)) {
 	retVal << "parsing failed\r\n";
@@ -4792,18 +4863,41 @@ ChanAssist* JsModule::create(Message& msg, const String& id)
     if ((msg == YSTRING("chan.startup")) && (msg[YSTRING("direction")] == YSTRING("outgoing")))
 	return 0;
     lock();
-    ScriptRun* runner = m_assistCode.createRunner(0,NATIVE_TITLE);
+    ScriptContext* ctx = s_forkContext ? assistContext() : 0;
+    ScriptRun* runner = m_assistCode.createRunner(ctx,NATIVE_TITLE);
     unlock();
-    if (!runner)
+    if (!runner) {
+	TelEngine::destruct(ctx);
 	return 0;
+    }
     DDebug(this,DebugInfo,"Creating Javascript for '%s'",id.c_str());
     JsAssist* ca = new JsAssist(this,id,runner);
-    if (ca->init())
+    bool ok = ca->init(ctx != 0);
+    TelEngine::destruct(ctx);
+    if (ok)
 	return ca;
     TelEngine::destruct(ca);
     return 0;
 }
 
+// Fork a channel context from the snapshot of initialized routing script globals
+ScriptContext* JsModule::assistContext()
+{
+    if (!m_assistBase) {
+	ScriptCode* code = m_assistCode.code();
+	if (!code)
+	    return 0;
+	ScriptContext* ctx = m_assistCode.createContext();
+	contextShared(ctx);
+	if (code->initialize(ctx))
+	    m_assistBase = ctx;
+	TelEngine::destruct(ctx);
+	if (!m_assistBase)
+	    return 0;
+    }
+    return JsParser::forkContext(m_assistBase);
+}
+
 bool JsModule::unload()
 {
     clearPostHook();
@@ -4834,6 +4928,7 @@ void JsModule::initialize()
     s_libsPath = tmp;
     s_maxFile = cfg.getIntValue("general","max_length",500000,32768,2097152);
     s_autoExt = cfg.getBoolValue("general","auto_extensions",true);
+    s_forkContext = cfg.getBoolValue("general","fork_context",false);
     s_allowAbort = cfg.getBoolValue("general","allow_abort");
     bool changed = false;
     if (cfg.getBoolValue("general","allow_trace") != s_allowTrace) {
@@ -4844,13 +4939,19 @@ void JsModule::initialize()
 	s_allowLink = !s_allowLink;
 	changed = true;
     }
+    if (cfg.getBoolValue("general","allow_bytecode") != s_allowBytecode) {
+	s_allowBytecode = !s_allowBytecode;
+	changed = true;
+    }
     tmp = cfg.getValue("general","routing");
     Engine::runParams().replaceParams(tmp);
     lock();
     if (changed || m_assistCode.scriptChanged(tmp,s_basePath,s_libsPath)) {
+	m_assistBase = 0;
 	m_assistCode.clear();
 	m_assistCode.setMaxFileLen(s_maxFile);
 	m_assistCode.link(s_allowLink);
+	m_assistCode.bytecode(s_allowBytecode);
 	m_assistCode.trace(s_allowTrace);
 	m_assistCode.basePath(s_basePath,s_libsPath);
 	m_assistCode.adjustPath(tmp);
@@ -30,6 +30,7 @@
 
 #ifndef OPENSSL_NO_AES
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 #endif
 
 #ifndef OPENSSL_NO_DES
@@ -116,7 +117,7 @@ private:
 };
 
 #ifndef OPENSSL_NO_AES
-// AES Counter Mode
+// AES Counter Mode, uses EVP so it benefits from hardware acceleration
 class AesCtrCipher : public Cipher
 {
 public:
@@ -130,19 +131,57 @@ public:
     virtual bool initVector(const void* vect, unsigned int len, Direction dir);
     virtual bool encrypt(void* outData, unsigned int len, const void* inpData);
     virtual bool decrypt(void* outData, unsigned int len, const void* inpData);
-protected:
-    AES_KEY* m_key;
+private:
+    EVP_CIPHER_CTX* m_ctx;
+    bool m_keySet;
     unsigned char m_initVector[AES_BLOCK_SIZE];
 };
 
 //AES - Cipher Feedback Mode
-class AesCfbCipher : public AesCtrCipher
+class AesCfbCipher : public Cipher
 {
 public:
     AesCfbCipher();
     virtual ~AesCfbCipher();
+    virtual unsigned int blockSize() const
+	{ return AES_BLOCK_SIZE; }
+    virtual unsigned int initVectorSize() const
+	{ return AES_BLOCK_SIZE; }
+    virtual bool setKey(const void* key, unsigned int len, Direction dir);
+    virtual bool initVector(const void* vect, unsigned int len, Direction dir);
     virtual bool encrypt(void* outData, unsigned int len, const void* inpData);
     virtual bool decrypt(void* outData, unsigned int len, const void* inpData);
+private:
+    AES_KEY* m_key;
+    unsigned char m_initVector[AES_BLOCK_SIZE];
+};
+
+// AES Galois/Counter Mode authenticated encryption with 96 bit IV and 128 bit tag
+class AesGcmCipher : public Cipher
+{
+public:
+    AesGcmCipher();
+    virtual ~AesGcmCipher();
+    virtual unsigned int blockSize() const
+	{ return AES_BLOCK_SIZE; }
+    virtual unsigned int initVectorSize() const
+	{ return 12; }
+    virtual unsigned int tagSize() const
+	{ return 16; }
+    virtual bool setKey(const void* key, unsigned int len, Direction dir);
+    virtual bool initVector(const void* vect, unsigned int len, Direction dir);
+    virtual bool encrypt(void* outData, unsigned int len, const void* inpData);
+    virtual bool decrypt(void* outData, unsigned int len, const void* inpData);
+    virtual bool encryptAuth(void* data, unsigned int len,
+	const void* aad, unsigned int aadLen, void* tag);
+    virtual bool decryptAuth(void* data, unsigned int len,
+	const void* aad, unsigned int aadLen, const void* tag);
+private:
+    bool process(void* outData, unsigned int len, const void* inpData,
+	const void* aad, unsigned int aadLen, int enc);
+    EVP_CIPHER_CTX* m_ctx;
+    bool m_keySet;
+    unsigned char m_initVector[12];
 };
 
 #endif
@@ -603,24 +642,41 @@ bool SslHandler::received(Message& msg)
 
 #ifndef OPENSSL_NO_AES
 AesCtrCipher::AesCtrCipher()
-    : m_key(0)
+    : m_ctx(0), m_keySet(false)
 {
-    m_key = new AES_KEY;
-    DDebug(&__plugin,DebugAll,"AesCtrCipher::AesCtrCipher() key=%p [%p]",m_key,this);
+    m_ctx = ::EVP_CIPHER_CTX_new();
+    ::memset(m_initVector,0,AES_BLOCK_SIZE);
+    DDebug(&__plugin,DebugAll,"AesCtrCipher::AesCtrCipher() ctx=%p [%p]",m_ctx,this);
 }
 
 AesCtrCipher::~AesCtrCipher()
 {
-    DDebug(&__plugin,DebugAll,"AesCtrCipher::~AesCtrCipher() key=%p [%p]",m_key,this);
-    delete m_key;
+    DDebug(&__plugin,DebugAll,"AesCtrCipher::~AesCtrCipher() ctx=%p [%p]",m_ctx,this);
+    if (m_ctx)
+	::EVP_CIPHER_CTX_free(m_ctx);
 }
 
 bool AesCtrCipher::setKey(const void* key, unsigned int len, Direction dir)
 {
-    if (!(key && len && m_key))
+    if (!(key && len && m_ctx))
 	return false;
-    // AES_ctr128_encrypt is its own inverse
-    return 0 == AES_set_encrypt_key((const unsigned char*)key,len*8,m_key);
+    const EVP_CIPHER* type = 0;
+    switch (len) {
+	case 16:
+	    type = ::EVP_aes_128_ctr();
+	    break;
+	case 24:
+	    type = ::EVP_aes_192_ctr();
+	    break;
+	case 32:
+	    type = ::EVP_aes_256_ctr();
+	    break;
+	default:
+	    return false;
+    }
+    // counter mode is its own inverse so we always set up for encryption
+    m_keySet = (1 == ::EVP_EncryptInit_ex(m_ctx,type,0,(const unsigned char*)key,0));
+    return m_keySet;
 }
 
 bool AesCtrCipher::initVector(const void* vect, unsigned int len, Direction dir)
@@ -638,37 +694,64 @@ bool AesCtrCipher::initVector(const void* vect, unsigned int len, Direction dir)
 
 bool AesCtrCipher::encrypt(void* outData, unsigned int len, const void* inpData)
 {
-    if (!(outData && len))
+    if (!(outData && len && m_keySet))
 	return false;
     if (!inpData)
 	inpData = outData;
-    unsigned int num = 0;
-    unsigned char eCountBuf[AES_BLOCK_SIZE];
-    AES_ctr128_encrypt(
-	(const unsigned char*)inpData,
-	(unsigned char*)outData,
-	len,
-	m_key,
-	m_initVector,
-	eCountBuf,
-	&num);
+    int outLen = 0;
+    if (1 != ::EVP_EncryptInit_ex(m_ctx,0,0,0,m_initVector))
+	return false;
+    if (1 != ::EVP_EncryptUpdate(m_ctx,(unsigned char*)outData,&outLen,
+	    (const unsigned char*)inpData,len))
+	return false;
+    // advance the counter past the blocks we used, like AES_ctr128_encrypt did
+    unsigned int blocks = (len + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+    for (int i = AES_BLOCK_SIZE - 1; blocks && (i >= 0); i--) {
+	blocks += m_initVector[i];
+	m_initVector[i] = blocks & 0xff;
+	blocks >>= 8;
+    }
     return true;
 }
 
 bool AesCtrCipher::decrypt(void* outData, unsigned int len, const void* inpData)
 {
-    // AES_ctr128_encrypt is its own inverse
+    // counter mode is its own inverse
     return encrypt(outData,len,inpData);
 }
 
 AesCfbCipher::AesCfbCipher()
+    : m_key(0)
 {
+    m_key = new AES_KEY;
     DDebug(&__plugin,DebugAll,"AesCfbCipher::AesCfbCipher() key=%p [%p]",m_key,this);
 }
 
 AesCfbCipher::~AesCfbCipher()
 {
     DDebug(&__plugin,DebugAll,"AesCfbCipher::~AesCfbCipher() key=%p [%p]",m_key,this);
+    delete m_key;
+}
+
+bool AesCfbCipher::setKey(const void* key, unsigned int len, Direction dir)
+{
+    if (!(key && len && m_key))
+	return false;
+    // CFB uses the encryption key schedule in both directions
+    return 0 == AES_set_encrypt_key((const unsigned char*)key,len*8,m_key);
+}
+
+bool AesCfbCipher::initVector(const void* vect, unsigned int len, Direction dir)
+{
+    if (len && !vect)
+	return false;
+    if (len > AES_BLOCK_SIZE)
+	len = AES_BLOCK_SIZE;
+    if (len < AES_BLOCK_SIZE)
+	::memset(m_initVector,0,AES_BLOCK_SIZE);
+    if (len)
+	::memcpy(m_initVector,vect,len);
+    return true;
 }
 
 bool AesCfbCipher::encrypt(void* outData, unsigned int len, const void* inpData)
@@ -707,6 +790,110 @@ bool AesCfbCipher::decrypt(void* outData, unsigned int len, const void* inpData)
     return true;
 }
 
+AesGcmCipher::AesGcmCipher()
+    : m_ctx(0), m_keySet(false)
+{
+    m_ctx = ::EVP_CIPHER_CTX_new();
+    ::memset(m_initVector,0,sizeof(m_initVector));
+    DDebug(&__plugin,DebugAll,"AesGcmCipher::AesGcmCipher() ctx=%p [%p]",m_ctx,this);
+}
+
+AesGcmCipher::~AesGcmCipher()
+{
+    DDebug(&__plugin,DebugAll,"AesGcmCipher::~AesGcmCipher() ctx=%p [%p]",m_ctx,this);
+    if (m_ctx)
+	::EVP_CIPHER_CTX_free(m_ctx);
+}
+
+bool AesGcmCipher::setKey(const void* key, unsigned int len, Direction dir)
+{
+    if (!(key && len && m_ctx))
+	return false;
+    const EVP_CIPHER* type = 0;
+    switch (len) {
+	case 16:
+	    type = ::EVP_aes_128_gcm();
+	    break;
+	case 24:
+	    type = ::EVP_aes_192_gcm();
+	    break;
+	case 32:
+	    type = ::EVP_aes_256_gcm();
+	    break;
+	default:
+	    return false;
+    }
+    // expand the key once, each packet only sets a new IV and direction
+    m_keySet = (1 == ::EVP_CipherInit_ex(m_ctx,type,0,0,0,1)) &&
+	(1 == ::EVP_CIPHER_CTX_ctrl(m_ctx,EVP_CTRL_GCM_SET_IVLEN,sizeof(m_initVector),0)) &&
+	(1 == ::EVP_CipherInit_ex(m_ctx,0,0,(const unsigned char*)key,0,1));
+    return m_keySet;
+}
+
+bool AesGcmCipher::initVector(const void* vect, unsigned int len, Direction dir)
+{
+    if (len && !vect)
+	return false;
+    if (len > sizeof(m_initVector))
+	len = sizeof(m_initVector);
+    if (len < sizeof(m_initVector))
+	::memset(m_initVector,0,sizeof(m_initVector));
+    if (len)
+	::memcpy(m_initVector,vect,len);
+    return true;
+}
+
+bool AesGcmCipher::process(void* outData, unsigned int len, const void* inpData,
+    const void* aad, unsigned int aadLen, int enc)
+{
+    if (!m_keySet)
+	return false;
+    int outLen = 0;
+    if (1 != ::EVP_CipherInit_ex(m_ctx,0,0,0,m_initVector,enc))
+	return false;
+    if (aad && aadLen && (1 != ::EVP_CipherUpdate(m_ctx,0,&outLen,(const unsigned char*)aad,aadLen)))
+	return false;
+    if (len && (1 != ::EVP_CipherUpdate(m_ctx,(unsigned char*)outData,&outLen,
+	    (const unsigned char*)(inpData ? inpData : outData),len)))
+	return false;
+    return true;
+}
+
+bool AesGcmCipher::encrypt(void* outData, unsigned int len, const void* inpData)
+{
+    // without a tag this is just the counter mode part of GCM
+    return outData && len && process(outData,len,inpData,0,0,1);
+}
+
+bool AesGcmCipher::decrypt(void* outData, unsigned int len, const void* inpData)
+{
+    return outData && len && process(outData,len,inpData,0,0,0);
+}
+
+bool AesGcmCipher::encryptAuth(void* data, unsigned int len,
+    const void* aad, unsigned int aadLen, void* tag)
+{
+    if (!(tag && (data || !len)))
+	return false;
+    unsigned char dummy[AES_BLOCK_SIZE];
+    int outLen = 0;
+    return process(data,len,0,aad,aadLen,1) &&
+	(1 == ::EVP_CipherFinal_ex(m_ctx,dummy,&outLen)) &&
+	(1 == ::EVP_CIPHER_CTX_ctrl(m_ctx,EVP_CTRL_GCM_GET_TAG,tagSize(),tag));
+}
+
+bool AesGcmCipher::decryptAuth(void* data, unsigned int len,
+    const void* aad, unsigned int aadLen, const void* tag)
+{
+    if (!(tag && (data || !len)))
+	return false;
+    unsigned char dummy[AES_BLOCK_SIZE];
+    int outLen = 0;
+    return process(data,len,0,aad,aadLen,0) &&
+	(1 == ::EVP_CIPHER_CTX_ctrl(m_ctx,EVP_CTRL_GCM_SET_TAG,tagSize(),const_cast<void*>(tag))) &&
+	(::EVP_CipherFinal_ex(m_ctx,dummy,&outLen) > 0);
+}
+
 #endif
 
 #ifndef OPENSSL_NO_DES
@@ -869,6 +1056,11 @@ bool CipherHandler::received(Message& msg)
 	    *ppCipher = new AesCfbCipher();
 	return true;
     }
+    if (*name == "aes_gcm") {
+	if (ppCipher)
+	    *ppCipher = new AesGcmCipher();
+	return true;
+    }
 #endif
 #ifndef OPENSSL_NO_DES
     if (*name == "des_cbc") {
@@ -103,6 +103,14 @@ static const char* s_rnow[] =
     0
 };
 
+static const char* s_mprof[] =
+{
+    "on",
+    "off",
+    "reset",
+    0
+};
+
 static const CommandInfo s_cmdInfo[] =
 {
     // Unauthenticated commands
@@ -126,6 +134,7 @@ static const CommandInfo s_cmdInfo[] =
 #ifdef HAVE_COREDUMPER
     { "coredump", "[filename]", 0, "Dumps memory image of running Yate to a file" },
 #endif
+    { "mutex", "[on|off|reset|count]", s_mprof, "Show mutex contention statistics or control collecting them" },
     { "drop", "{chan|*|all} [reason]", s_dall, "Drops one or all active calls" },
     { "call", "chan target", 0, "Execute an outgoing call" },
     { "control", "chan [operation] [param=val] [param=...]", 0, "Apply arbitrary control operations to a channel or entity" },
@@ -1590,6 +1599,27 @@ bool Connection::processLine(const char *line, bool saveLine)
 	writeStr(str);
     }
 #endif
+    else if (str.startSkip("mutex"))
+    {
+	str.trimSpaces();
+	if (str == YSTRING("reset")) {
+	    Mutex::profileReset();
+	    str = "Mutex statistics cleared\r\n";
+	}
+	else if (str.isBoolean()) {
+	    bool on = Mutex::profiling(str.toBoolean());
+	    str = "Mutex profiling: ";
+	    str << (on ? "on\r\n" : "off\r\n");
+	}
+	else {
+	    int count = str.toInteger(20,0,0);
+	    str = "Mutex profiling: ";
+	    str << (Mutex::profiling() ? "on" : "off");
+	    str << ", wait and hold times in usec\r\n";
+	    Mutex::profileReport(str,count);
+	}
+	writeStr(str);
+    }
 #ifdef HAVE_COREDUMPER
     else if (str.startSkip("coredump"))
     {
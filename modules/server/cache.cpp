@@ -21,12 +21,18 @@
 
 #include <yatephone.h>
 
+#include <string.h>
+
+#ifndef _WINDOWS
+#include <sys/mman.h>
+#endif
 
 using namespace TelEngine;
 namespace { // anonymous
 
 class CacheItem;                         // A cache item
 class Cache;                             // A cache hash list
+class SnapshotReader;                    // Cache snapshot file parser
 class CacheThread;                       // Base class for cache threads
 class CacheExpireThread;                 // Cache expire thread
 class CacheLoadThread;                   // Cache load thread
@@ -37,6 +43,18 @@ class CacheModule;
 #define EXPIRE_CHECK_MAX 300
 // Min value for cache reload interval in seconds
 #define CACHE_RELOAD_MIN 10
+// Average number of items in a hash list triggering cache resize
+#define CACHE_LOAD_FACTOR 8
+// Max number of hash lists a cache can grow to
+#define CACHE_SIZE_MAX 131071
+
+// Snapshot file layout (numbers are little endian):
+//  magic, change marker
+//  items: id, expire time in usec (0: never), u32 number of params, param name/value
+//  trailer: SNAPSHOT_END, u32 number of items
+// Strings are stored as u32 length followed by data
+#define SNAPSHOT_MAGIC "YCS1"
+#define SNAPSHOT_END 0xffffffff
 
 class CacheItem : public NamedList
 {
@@ -76,7 +94,7 @@ public:
 	{ return m_loadInterval != 0 || m_reload != 0; }
     // Retrieve the mutex protecting a given list
     inline unsigned int index(const String& str) const
-	{ return str.hash() % m_list.length(); }
+	{ return str.hash() % m_list->length(); }
     // Safely retrieve the id matching parameter
     inline void getIdParam(String& param) {
 	    Lock lck(this);
@@ -90,8 +108,9 @@ public:
 	    return !param.null();
 	}
     // Safely retrieve DB load info
-    void getDbLoad(String& account, String& query, unsigned int& loadChunk,
-	Thread::Priority& loadPrio);
+    // Return true if the query loads only the items changed since last load
+    bool getDbLoad(String& account, String& query, unsigned int& loadChunk,
+	Thread::Priority& loadPrio, String& since, bool full);
     void getDbLoadItemCmd(String& account, String& query, Thread::Priority& loadPrio);
     // Schedule a cache re-load
     bool scheduleLoad(const NamedList& params);
@@ -124,8 +143,16 @@ public:
 	    Lock lock(this);
 	    addUnsafe(array,row,cols);
 	}
-    // Add items from Array rows. Return the number of added rows
-    unsigned int addRows(Array& array);
+    // Add items from Array rows. Return the number of added or removed rows
+    // Set trackDelta to remember the newest change marker found in rows
+    // Set delta when loading changed rows to remove the ones marked as deleted
+    unsigned int addRows(Array& array, bool trackDelta = false, bool delta = false);
+    // Remove items with ids from list, clear the list. Return the number of processed ids
+    unsigned int remove(ObjList& ids);
+    // Load items from snapshot file. Return the number of loaded items
+    unsigned int loadSnapshot();
+    // Save items to snapshot file
+    bool saveSnapshot();
     // Clear the cache
     unsigned int clear();
     // Remove an item, decrease the item counter
@@ -139,7 +166,8 @@ public:
 	{ return m_prefixMask; }
     // Set chunk limit and offset to a query
     // Return the number of replaced params
-    static int setLimits(String& query, unsigned int chunk, unsigned int offset);
+    static int setLimits(String& query, unsigned int chunk, unsigned int offset,
+	const String& since = String::empty());
 protected:
     virtual void destroyed();
     // (Re)init
@@ -155,9 +183,20 @@ protected:
     CacheItem* findPrefix(const String& id);
     // Adjust cache length to limit
     void adjustToLimit(CacheItem* skipAdded);
+    // Insert an item in a hash list keeping the list sorted by expire time
+    static void insertUnsafe(HashList& list, CacheItem* item);
+    // Grow the hash table if items don't fit the load factor anymore
+    inline void checkSize() {
+	    if (m_autoResize && m_count > m_list->length() * CACHE_LOAD_FACTOR)
+		resize();
+	}
+    // Rebuild the hash table with more lists
+    void resize();
 
     String m_name;                       // Cache name
-    HashList m_list;                     // The list holding the cache
+    HashList* m_list;                    // The list holding the cache
+    unsigned int m_size;                 // Configured number of hash lists
+    bool m_autoResize;                   // Grow hash table when items are added
     u_int64_t m_cacheTtl;                // Cache item TTL (in us)
     unsigned int m_count;                // Current number of items
     unsigned int m_limit;                // Limit the number of cache items
@@ -181,6 +220,34 @@ protected:
     String m_queryLoadItemCmd;           // Database load item on command query
     String m_querySave;                  // Database save query
     String m_queryExpire;                // Database expire query
+    String m_queryLoadDelta;             // Database load changed items query
+    String m_deltaParam;                 // Change marker column
+    String m_deleteParam;                // Deleted item column
+    String m_deltaMark;                  // Newest change marker loaded
+    String m_snapshot;                   // Snapshot file path
+};
+
+class SnapshotReader
+{
+public:
+    inline SnapshotReader(const unsigned char* data, unsigned int len)
+	: m_data(data), m_len(len), m_pos(0), m_ok(true)
+	{ }
+    inline bool ok() const
+	{ return m_ok; }
+    // Read a little endian number
+    u_int64_t number(unsigned int len);
+    // Read a length prefixed string
+    bool string(String& str);
+    // Check and skip expected data
+    bool match(const char* str, unsigned int len);
+    // Check and skip the items trailer
+    bool end();
+private:
+    const unsigned char* m_data;
+    unsigned int m_len;
+    unsigned int m_pos;
+    bool m_ok;
 };
 
 class CacheThread : public Thread, public GenObject
@@ -205,9 +272,10 @@ public:
 class CacheLoadThread : public CacheThread
 {
 public:
-    inline CacheLoadThread(const String name, Thread::Priority prio, ObjList* items)
+    inline CacheLoadThread(const String name, Thread::Priority prio, ObjList* items,
+	bool full)
 	: CacheThread("CacheLoadThread",prio),
-	m_cache(name), m_items(items)
+	m_cache(name), m_items(items), m_full(full)
 	{}
     ~CacheLoadThread()
 	{ TelEngine::destruct(m_items); }
@@ -215,6 +283,7 @@ public:
 private:
     String m_cache;
     ObjList* m_items;
+    bool m_full;
 };
 
 class CacheModule : public Module
@@ -243,7 +312,11 @@ public:
     // Load a cache from database
     // Optionally load specific items only (the list will be consumed)
     // Set async=false from loading thread
-    void loadCache(const String& name, bool async = true, ObjList* items = 0);
+    // Set full=true to load all items even if only changed ones can be loaded
+    void loadCache(const String& name, bool async = true, ObjList* items = 0,
+	bool full = false);
+    // Save all caches having a snapshot file
+    void saveCaches();
 protected:
     virtual void initialize();
     virtual bool received(Message& msg, int id);
@@ -266,6 +339,8 @@ protected:
     void commandLoad(Cache* cache, NamedList& params, String& retVal);
     // Cache flush handler
     void commandFlush(Cache* cache, NamedList& params, String& retVal);
+    // Cache save handler
+    void commandSave(Cache* cache, String& retVal);
     // Help message handler
     bool commandHelp(String& retVal, const String& line);
 
@@ -288,6 +363,7 @@ static unsigned int s_limit = 0;         // Default cache limit
 static unsigned int s_loadChunk = 0;     // The number of cache items to load in each DB load query
 static unsigned int s_maxChunks = 1000;  // Maximum number of chunks to load in a cache
 static Thread::Priority s_loadPrio = Thread::Normal; // Cache load thread priority
+static bool s_autoResize = true;         // Grow cache hash tables by default
 static unsigned int s_cacheTtlSec = 0;   // Default cache item time to live (in seconds)
 static u_int64_t s_checkToutInterval = 0;// Interval to check cache timeout
 
@@ -300,17 +376,20 @@ static const String s_caches[] = {"lnp", "cnam", ""};
 enum CacheCommands {
     CmdLoad = 0,
     CmdFlush,
+    CmdSave,
     CmdCount
 };
-static const String s_cmd[CmdCount] = {"load","flush"};
-static const String s_cmdCacheFormat = "cache {load|flush} cache_name [[param=value]...]";
+static const String s_cmd[CmdCount] = {"load","flush","save"};
+static const String s_cmdCacheFormat = "cache {load|flush|save} cache_name [[param=value]...]";
 static const String s_cmdFormat[CmdCount] = {
     "cache load cache_name [[param=value]...]",
-    "cache flush cache_name [[param=value]...]"
+    "cache flush cache_name [[param=value]...]",
+    "cache save cache_name"
 };
 static const String s_cmdHelp[CmdCount] = {
     "Load a cache from database. Use 'id' (can be repeated) parameter to load specific item(s) only",
-    "Flush (clear) a cache's memory. Use 'id' (can be repeated) parameter to delete specific item(s) only"
+    "Flush (clear) a cache's memory. Use 'id' (can be repeated) parameter to delete specific item(s) only",
+    "Save a cache's items to its snapshot file"
 };
 
 
@@ -400,13 +479,96 @@ static void fillList(NamedList& list, String& buf)
 	list.addParam(static_cast<NamedString*>(gen));
 }
 
+// Check if a change marker is newer than another one
+// Markers are compared as numbers if both are numeric
+static bool newerMark(const String& mark, const String& than)
+{
+    if (!mark)
+	return false;
+    if (!than)
+	return true;
+    int64_t m = mark.toInt64(-1);
+    int64_t t = than.toInt64(-1);
+    if (m >= 0 && t >= 0)
+	return m > t;
+    return ::strcmp(mark,than) > 0;
+}
+
+// Append a little endian number to snapshot data
+static inline void snapPut(DataBlock& buf, u_int64_t val, unsigned int len)
+{
+    unsigned char tmp[8];
+    for (unsigned int i = 0; i < len; i++, val >>= 8)
+	tmp[i] = (unsigned char)val;
+    buf.append(tmp,len);
+}
+
+// Append a length prefixed string to snapshot data
+static inline void snapPut(DataBlock& buf, const String& str)
+{
+    snapPut(buf,str.length(),4);
+    if (str)
+	buf.append((void*)str.c_str(),str.length());
+}
+
+
+/*
+ * SnapshotReader
+ */
+u_int64_t SnapshotReader::number(unsigned int len)
+{
+    if (!m_ok || m_pos + len > m_len) {
+	m_ok = false;
+	return 0;
+    }
+    u_int64_t val = 0;
+    for (unsigned int i = len; i; i--)
+	val = (val << 8) | m_data[m_pos + i - 1];
+    m_pos += len;
+    return val;
+}
+
+bool SnapshotReader::string(String& str)
+{
+    unsigned int len = (unsigned int)number(4);
+    if (!m_ok || len > m_len - m_pos) {
+	m_ok = false;
+	return false;
+    }
+    str.assign((const char*)m_data + m_pos,len);
+    m_pos += len;
+    return true;
+}
+
+bool SnapshotReader::match(const char* str, unsigned int len)
+{
+    if (!m_ok || m_pos + len > m_len || ::memcmp(m_data + m_pos,str,len))
+	m_ok = false;
+    else
+	m_pos += len;
+    return m_ok;
+}
+
+bool SnapshotReader::end()
+{
+    if (!m_ok || m_pos + 4 > m_len) {
+	m_ok = false;
+	return false;
+    }
+    if (::memcmp(m_data + m_pos,"\xff\xff\xff\xff",4))
+	return false;
+    m_pos += 4;
+    return true;
+}
+
 
 /*
  * Cache
  */
 Cache::Cache(const String& name, int size, const NamedList& params)
     : Mutex(false,"Cache"),
-    m_name(name), m_list(size), m_cacheTtl(0), m_count(0), m_limit(0),
+    m_name(name), m_list(new HashList(size)), m_size(size), m_autoResize(false),
+    m_cacheTtl(0), m_count(0), m_limit(0),
     m_limitOverflow(0), m_loadChunk(0), m_prefixMin(0), m_prefixMask(0),
     m_loadPrio(Thread::Normal),
     m_loading(false), m_loadInterval(0), m_nextLoad(0),
@@ -414,7 +576,7 @@ Cache::Cache(const String& name, int size, const NamedList& params)
 
 {
     Debug(&__plugin,DebugInfo,"Cache(%s) size=%u [%p]",
-	m_name.c_str(),m_list.length(),this);
+	m_name.c_str(),m_list->length(),this);
     m_expireParam << "cache_" << m_name << "_expires";
     doUpdate(params,true);
 }
@@ -431,6 +593,7 @@ bool Cache::reload(const Time& time, bool force)
     lock();
     String tmp;
     ObjList* items = 0;
+    bool full = false;
     if (!m_reload) {
 	if (m_loadInterval && !m_loading && (force || !m_nextLoad || m_nextLoad <= time))
 	    tmp = toString();
@@ -440,6 +603,7 @@ bool Cache::reload(const Time& time, bool force)
 	    m_reload--;
 	    if (!m_reload) {
 		tmp = toString();
+		full = true;
 		TelEngine::destruct(m_reloadItems);
 	    }
 	}
@@ -463,7 +627,7 @@ bool Cache::reload(const Time& time, bool force)
     if (!tmp)
 	return false;
     DDebug(&__plugin,DebugInfo,"Cache(%s) re-loading [%p]",m_name.c_str(),this);
-    __plugin.loadCache(tmp,true,items);
+    __plugin.loadCache(tmp,true,items,full);
     return true;
 }
 
@@ -530,14 +694,21 @@ bool Cache::copyParams(const String& id, NamedList& list, const String* cpParams
 }
 
 // Safely retrieve DB load info
-void Cache::getDbLoad(String& account, String& query, unsigned int& loadChunk,
-    Thread::Priority& loadPrio)
+// Return true if the query loads only the items changed since last load
+bool Cache::getDbLoad(String& account, String& query, unsigned int& loadChunk,
+    Thread::Priority& loadPrio, String& since, bool full)
 {
     Lock lock(this);
     account = (m_accountLoadCache ? m_accountLoadCache : m_account);
-    query = m_queryLoadCache;
     loadChunk = m_loadChunk;
     loadPrio = m_loadPrio;
+    if (!full && m_queryLoadCache && m_queryLoadDelta && m_deltaMark) {
+	query = m_queryLoadDelta;
+	since = m_deltaMark;
+	return true;
+    }
+    query = m_queryLoadCache;
+    return false;
 }
 
 void Cache::getDbLoadItemCmd(String& account, String& query, Thread::Priority& loadPrio)
@@ -613,10 +784,10 @@ void Cache::expire(const Time& time)
 	Engine::enqueue(m);
     }
     unsigned int oldCount = m_count;
-    for (unsigned int i = 0; i < m_list.length(); i++) {
+    for (unsigned int i = 0; i < m_list->length(); i++) {
 	if (exiting())
 	    break;
-	ObjList* list = m_list.getHashList(i);
+	ObjList* list = m_list->getHashList(i);
 	if (list)
 	    list = list->skipNull();
 	// Stop when found a non timed out item:
@@ -648,8 +819,10 @@ unsigned int Cache::add(ObjList& list)
     return added;
 }
 
-// Add items from Array rows. Return the number of added rows
-unsigned int Cache::addRows(Array& array)
+// Add items from Array rows. Return the number of added or removed rows
+// Set trackDelta to remember the newest change marker found in rows
+// Set delta when loading changed rows to remove the ones marked as deleted
+unsigned int Cache::addRows(Array& array, bool trackDelta, bool delta)
 {
     int rows = array.getRows();
     if (rows < 2)
@@ -661,6 +834,10 @@ unsigned int Cache::addRows(Array& array)
     String** titles = new String*[cols];
     lock();
     ObjList* params = m_copyParams.split(',',false);
+    String deltaParam = m_deltaParam;
+    String deleteParam;
+    if (delta)
+	deleteParam = m_deleteParam;
     unlock();
     int colId = -1;
     for (int i = 0; i < cols; i++) {
@@ -673,7 +850,8 @@ unsigned int Cache::addRows(Array& array)
 	    colId = i;
 	    titles[i] = title;
 	}
-	else if (*title == YSTRING("expires") || params->find(*title))
+	else if (*title == YSTRING("expires") || params->find(*title) ||
+	    *title == deltaParam || *title == deleteParam)
 	    titles[i] = title;
     }
     TelEngine::destruct(params);
@@ -685,6 +863,8 @@ unsigned int Cache::addRows(Array& array)
     }
     unsigned int added = 0;
     ObjList pending;
+    ObjList deleted;
+    String mark;
     for (int row = 1; row < rows; row++) {
 	NamedList* p = new NamedList("");
 	for (int i = 0; i < cols; i++) {
@@ -700,32 +880,60 @@ unsigned int Cache::addRows(Array& array)
 	    else
 		p->addParam(titles[i]->c_str(),*colVal);
 	}
-	if (*p)
-	    pending.append(p);
-	else
+	if (trackDelta && deltaParam) {
+	    const String& crt = (*p)[deltaParam];
+	    if (newerMark(crt,mark))
+		mark = crt;
+	}
+	// Deleted flag may be boolean or numeric as returned by database
+	const String& del = deleteParam ? (*p)[deleteParam] : String::empty();
+	if (!*p)
+	    TelEngine::destruct(p);
+	else if (del.toBoolean(del.toInteger() != 0)) {
+	    deleted.append(new String(*p));
 	    TelEngine::destruct(p);
+	}
+	else
+	    pending.append(p);
 	if (0 != (row % 500))
 	    continue;
 	// Add pending items, take a breath to let others do their job
 	added += add(pending);
 	pending.clear();
+	added += remove(deleted);
 	Thread::idle();
 	if (exiting())
 	    break;
     }
     // Add remaining items
     added += add(pending);
+    added += remove(deleted);
+    if (mark) {
+	Lock lck(this);
+	if (newerMark(mark,m_deltaMark))
+	    m_deltaMark = mark;
+    }
     // Don't release columns and titles content: they are owned by the array
     delete[] columns;
     delete[] titles;
     return added;
 }
 
+// Remove items with ids from list, clear the list. Return the number of processed ids
+unsigned int Cache::remove(ObjList& ids)
+{
+    unsigned int n = 0;
+    for (ObjList* o = ids.skipNull(); o; o = o->skipNext(), n++)
+	remove(o->get()->toString());
+    ids.clear();
+    return n;
+}
+
 // Clear the cache
 unsigned int Cache::clear()
 {
     Lock lck(this);
-    m_list.clear();
+    m_list->clear();
     unsigned int n = m_count;
     m_count = 0;
     m_prefixMask = 0;
@@ -739,7 +947,7 @@ unsigned int Cache::remove(const String& id, bool regexp)
 	return 0;
     if (!regexp) {
 	Lock lck(this);
-	ObjList* list = m_list.getHashList(id);
+	ObjList* list = m_list->getHashList(id);
 	GenObject* gen = list ? list->remove(id,false) : 0;
 	if (!gen)
 	    return 0;
@@ -750,9 +958,17 @@ unsigned int Cache::remove(const String& id, bool regexp)
 	return 1;
     }
     unsigned int removed = 0;
-    for (unsigned int i = 0; i < m_list.length(); i++) {
+    unsigned int size = 0;
+    for (unsigned int i = 0; ; i++) {
 	Lock lck(this);
-	ObjList* list = m_list.getHashList(i);
+	if (size != m_list->length()) {
+	    // Hash table was resized meanwhile: start over, items moved around
+	    size = m_list->length();
+	    i = 0;
+	}
+	if (i >= size)
+	    break;
+	ObjList* list = m_list->getHashList(i);
 	if (list)
 	    list = list->skipNull();
 	while (list) {
@@ -792,8 +1008,8 @@ void Cache::dump(const char* oper)
     String data("\r\n-----");
     unsigned int n = 0;
     int64_t now = (int64_t)Time::now();
-    for (unsigned int i = 0; i < m_list.length(); i++) {
-	ObjList* list = m_list.getHashList(i);
+    for (unsigned int i = 0; i < m_list->length(); i++) {
+	ObjList* list = m_list->getHashList(i);
 	if (list)
 	    list = list->skipNull();
 	String rowData;
@@ -819,11 +1035,13 @@ void Cache::dump(const char* oper)
 
 // Set chunk limit and offset to a query
 // Return the number of replaced params
-int Cache::setLimits(String& query, unsigned int chunk, unsigned int offset)
+int Cache::setLimits(String& query, unsigned int chunk, unsigned int offset,
+    const String& since)
 {
     NamedList params("");
     params.addParam("chunk",String(chunk));
     params.addParam("offset",String(offset));
+    params.addParam("since",since);
     return params.replaceParams(query);
 }
 
@@ -831,6 +1049,8 @@ void Cache::destroyed()
 {
     Debug(&__plugin,DebugInfo,"Cache(%s) destroyed [%p]",m_name.c_str(),this);
     clear();
+    delete m_list;
+    m_list = 0;
     TelEngine::destruct(m_reloadItems);
     RefObject::destroyed();
 }
@@ -847,7 +1067,7 @@ void Cache::doUpdate(const NamedList& params, bool first)
 	int ttl = safeValue(params.getIntValue("ttl",s_cacheTtlSec));
 	m_cacheTtl = (u_int64_t)adjustedCacheTtl(ttl) * 1000000;
     }
-    m_limit = adjustedCacheLimit(params.getIntValue("limit",s_limit),m_list.length());
+    m_limit = adjustedCacheLimit(params.getIntValue("limit",s_limit),m_size);
     if (m_limit)
 	m_limitOverflow = m_limit + (m_limit / 100);
     else
@@ -863,6 +1083,11 @@ void Cache::doUpdate(const NamedList& params, bool first)
     m_queryLoadItemCmd = params.getValue("query_loaditem_command",m_queryLoadItem);
     m_querySave = params.getValue("query_save");
     m_queryExpire = params.getValue("query_expire");
+    m_queryLoadDelta = params.getValue("query_loaddelta");
+    m_deltaParam = params.getValue("delta_param","changed");
+    m_deleteParam = params.getValue("delete_param");
+    m_snapshot = params.getValue("snapshot");
+    m_autoResize = params.getBoolValue("autoresize",s_autoResize);
     // Minimum sanity check for cache load
     if (m_loadChunk && m_queryLoadCache) {
 	String tmp = m_queryLoadCache;
@@ -872,6 +1097,15 @@ void Cache::doUpdate(const NamedList& params, bool first)
 	    m_loadChunk = 0;
 	}
     }
+    if (m_queryLoadDelta) {
+	String tmp = m_queryLoadDelta;
+	if (m_queryLoadDelta.find("${since}") < 0 || !m_deltaParam ||
+	    (m_loadChunk && setLimits(tmp,m_loadChunk,0) < 3)) {
+	    Debug(&__plugin,DebugNote,"Cache(%s) invalid query_loaddelta='%s' for loadchunk=%u [%p]",
+		m_name.c_str(),m_queryLoadDelta.c_str(),m_loadChunk,this);
+	    m_queryLoadDelta.clear();
+	}
+    }
     if ((m_accountLoadCache || m_account) && m_queryLoadCache) {
 	unsigned int interval = params.getIntValue("reload_interval");
 	if (interval)
@@ -896,13 +1130,14 @@ void Cache::doUpdate(const NamedList& params, bool first)
 	all << " query_loaditem_command=" << m_queryLoadItemCmd;
 	all << " query_save=" << m_querySave;
 	all << " query_expire=" << m_queryExpire;
+	all << " query_loaddelta=" << m_queryLoadDelta;
 	all << " shortest_prefix=" << m_prefixMin;
     }
 #endif
     Debug(&__plugin,DebugInfo,
-	"Cache(%s) updated ttl=%u limit=%u reload_interval=%u copyparams='%s'%s [%p]",
+	"Cache(%s) updated ttl=%u limit=%u reload_interval=%u autoresize=%s snapshot='%s' copyparams='%s'%s [%p]",
 	m_name.c_str(),(unsigned int)(m_cacheTtl / 1000000),m_limit,m_loadInterval,
-	m_copyParams.safe(),all.safe(),this);
+	String::boolText(m_autoResize),m_snapshot.safe(),m_copyParams.safe(),all.safe(),this);
 }
 
 // Add an item to the cache. Remove an existing one
@@ -912,7 +1147,7 @@ CacheItem* Cache::addUnsafe(const String& id, const NamedList& params, const Str
     XDebug(&__plugin,DebugAll,"Cache::add(%s,%p,'%s',%u) [%p]",
 	id.c_str(),&params,TelEngine::c_safe(cpParams),dbSave,this);
     unsigned int idx = index(id);
-    ObjList* list = m_list.getHashList(idx);
+    ObjList* list = m_list->getHashList(idx);
     if (list)
 	list = list->skipNull();
     u_int64_t expires = m_cacheTtl;
@@ -970,7 +1205,7 @@ CacheItem* Cache::addUnsafe(const String& id, const NamedList& params, const Str
     else if (list)
 	list->append(item);
     else
-	m_list.append(item);
+	m_list->append(item);
     unsigned int len = id.length();
     if (len > 0 && len <= 32)
 	m_prefixMask |= (1 << (len - 1));
@@ -992,6 +1227,7 @@ CacheItem* Cache::addUnsafe(const String& id, const NamedList& params, const Str
     m_count++;
     if (m_limitOverflow && m_count > m_limitOverflow)
 	adjustToLimit(item);
+    checkSize();
     return item;
 }
 
@@ -1018,7 +1254,7 @@ CacheItem* Cache::addUnsafe(Array& array, int row, int cols)
 // Find a cache item. This method is not thread safe
 CacheItem* Cache::find(const String& id)
 {
-    ObjList* o = m_list.find(id);
+    ObjList* o = m_list->find(id);
     return o ? static_cast<CacheItem*>(o->get()) : 0;
 }
 
@@ -1053,8 +1289,8 @@ void Cache::adjustToLimit(CacheItem* skipAdded)
 	m_name.c_str(),m_limit,m_count,this);
     while (m_count > m_limit) {
 	CacheItem* found = 0;
-	for (unsigned int i = 0; i < m_list.length(); i++) {
-	    ObjList* list = m_list.getHashList(i);
+	for (unsigned int i = 0; i < m_list->length(); i++) {
+	    ObjList* list = m_list->getHashList(i);
 	    if (list)
 		list = list->skipNull();
 	    CacheItem* item = list ? static_cast<CacheItem*>(list->get()) : 0;
@@ -1065,18 +1301,194 @@ void Cache::adjustToLimit(CacheItem* skipAdded)
 	}
 	if (found) {
 	    dumpItem(*this,*found,"removing oldest");
-	    m_list.remove(found);
+	    m_list->remove(found);
 	    m_count--;
 	    continue;
 	}
 	Debug(&__plugin,DebugGoOn,
 	    "Cache(%s) can't find the oldest item count=%u limit=%u [%p]",
 	    m_name.c_str(),m_count,m_limit,this);
-	m_count = m_list.count();
+	m_count = m_list->count();
 	break;
     }
 }
 
+// Insert an item in a hash list keeping the list sorted by expire time
+void Cache::insertUnsafe(HashList& list, CacheItem* item)
+{
+    ObjList* l = list.getHashList(item->toString());
+    for (l = l ? l->skipNull() : 0; l; l = l->skipNext()) {
+	if (static_cast<CacheItem*>(l->get())->expires() > item->expires()) {
+	    l->insert(item);
+	    return;
+	}
+    }
+    list.append(item);
+}
+
+// Rebuild the hash table with more lists
+void Cache::resize()
+{
+    unsigned int size = m_list->length();
+    if (size >= CACHE_SIZE_MAX)
+	return;
+    size = size * 2 + 1;
+    if (size > CACHE_SIZE_MAX)
+	size = CACHE_SIZE_MAX;
+    u_int64_t start = Time::now();
+    HashList* list = new HashList(size);
+    for (unsigned int i = 0; i < m_list->length(); i++) {
+	ObjList* l = m_list->getHashList(i);
+	while (l && (l = l->skipNull()))
+	    insertUnsafe(*list,static_cast<CacheItem*>(l->remove(false)));
+    }
+    delete m_list;
+    m_list = list;
+    Debug(&__plugin,DebugInfo,"Cache(%s) resized to %u lists for %u items in %u usec [%p]",
+	m_name.c_str(),size,m_count,(unsigned int)(Time::now() - start),this);
+}
+
+// Load items from snapshot file. Return the number of loaded items
+unsigned int Cache::loadSnapshot()
+{
+    Lock lck(this);
+    if (!m_snapshot || !File::exists(m_snapshot))
+	return 0;
+    File f;
+    int64_t len = f.openPath(m_snapshot) ? f.length() : -1;
+    if (len <= 0 || len >= 0x7fffffff) {
+	Debug(&__plugin,DebugNote,"Cache(%s) can't read snapshot '%s' [%p]",
+	    m_name.c_str(),m_snapshot.c_str(),this);
+	return 0;
+    }
+    u_int64_t start = Time::now();
+    void* map = 0;
+    DataBlock buf;
+#ifndef _WINDOWS
+    map = ::mmap(0,len,PROT_READ,MAP_PRIVATE,f.handle(),0);
+    if (map == MAP_FAILED)
+	map = 0;
+#endif
+    const unsigned char* data = (const unsigned char*)map;
+    if (!data) {
+	buf.resize((unsigned int)len);
+	if (f.readData(buf.data(),buf.length()) == (int)len)
+	    data = (const unsigned char*)buf.data();
+    }
+    SnapshotReader rd(data,data ? (unsigned int)len : 0);
+    String mark;
+    rd.match(SNAPSHOT_MAGIC,4);
+    rd.string(mark);
+    u_int64_t now = Time::now();
+    unsigned int loaded = 0;
+    unsigned int skipped = 0;
+    bool complete = false;
+    while (rd.ok() && !rd.end()) {
+	String id;
+	if (!rd.string(id))
+	    break;
+	u_int64_t expires = rd.number(8);
+	unsigned int n = (unsigned int)rd.number(4);
+	CacheItem* item = new CacheItem(id,NamedList::empty(),String::empty(),expires);
+	for (unsigned int i = 0; i < n && rd.ok(); i++) {
+	    String name;
+	    String value;
+	    if (rd.string(name) && rd.string(value))
+		item->addParam(name,value);
+	}
+	if (!rd.ok() || !id || (expires && expires < now) || find(id)) {
+	    TelEngine::destruct(item);
+	    skipped++;
+	    continue;
+	}
+	insertUnsafe(*m_list,item);
+	unsigned int idLen = id.length();
+	if (idLen <= 32)
+	    m_prefixMask |= (1 << (idLen - 1));
+	m_count++;
+	loaded++;
+	checkSize();
+    }
+    if (rd.ok())
+	complete = (rd.number(4) == loaded + skipped) && rd.ok();
+#ifndef _WINDOWS
+    if (map)
+	::munmap(map,len);
+#endif
+    // Changes since the snapshot was made can be loaded only if it is consistent
+    if (complete)
+	m_deltaMark = mark;
+    else
+	Debug(&__plugin,DebugWarn,"Cache(%s) snapshot '%s' is truncated or corrupted [%p]",
+	    m_name.c_str(),m_snapshot.c_str(),this);
+    if (m_limitOverflow && m_count > m_limitOverflow)
+	adjustToLimit(0);
+    Debug(&__plugin,DebugInfo,
+	"Cache(%s) loaded %u items (skipped=%u) from snapshot '%s' in %u usec mark='%s' [%p]",
+	m_name.c_str(),loaded,skipped,m_snapshot.c_str(),(unsigned int)(Time::now() - start),
+	m_deltaMark.safe(),this);
+    return loaded;
+}
+
+// Save items to snapshot file
+// The cache is locked for one hash list at a time
+bool Cache::saveSnapshot()
+{
+    lock();
+    String path = m_snapshot;
+    unlock();
+    if (!path)
+	return false;
+    u_int64_t start = Time::now();
+    DataBlock buf(65536);
+    unsigned int n = 0;
+    unsigned int size = 0;
+    for (unsigned int i = 0; ; i++) {
+	Lock lck(this);
+	if (size != m_list->length()) {
+	    // Hash table was resized meanwhile: start over
+	    size = m_list->length();
+	    i = 0;
+	    n = 0;
+	    buf.clear();
+	    buf.append((void*)SNAPSHOT_MAGIC,4);
+	    snapPut(buf,m_deltaMark);
+	}
+	if (i >= size)
+	    break;
+	ObjList* l = m_list->getHashList(i);
+	for (l = l ? l->skipNull() : 0; l; l = l->skipNext(), n++) {
+	    CacheItem* item = static_cast<CacheItem*>(l->get());
+	    snapPut(buf,*item);
+	    snapPut(buf,item->expires(),8);
+	    snapPut(buf,item->count(),4);
+	    NamedIterator iter(*item);
+	    for (const NamedString* ns = 0; 0 != (ns = iter.get());) {
+		snapPut(buf,ns->name());
+		snapPut(buf,*ns);
+	    }
+	}
+    }
+    snapPut(buf,SNAPSHOT_END,4);
+    snapPut(buf,n,4);
+    // Write a new file and replace the old one so a crash won't leave a partial snapshot
+    String tmp = path + ".tmp";
+    File f;
+    bool ok = f.openPath(tmp,true,false,true) && (f.writeData(buf.data(),buf.length()) == (int)buf.length());
+    f.terminate();
+    if (ok)
+	ok = File::rename(tmp,path);
+    if (!ok) {
+	Debug(&__plugin,DebugWarn,"Cache(%s) failed to save snapshot '%s' [%p]",
+	    m_name.c_str(),path.c_str(),this);
+	File::remove(tmp);
+	return false;
+    }
+    Debug(&__plugin,DebugInfo,"Cache(%s) saved %u items to snapshot '%s' in %u usec [%p]",
+	m_name.c_str(),n,path.c_str(),(unsigned int)(Time::now() - start),this);
+    return true;
+}
+
 
 /*
  * CacheThread
@@ -1132,7 +1544,7 @@ void CacheLoadThread::run()
 	currentName(),m_cache.c_str(),this);
     ObjList* items = m_items;
     m_items = 0;
-    __plugin.loadCache(m_cache,false,items);
+    __plugin.loadCache(m_cache,false,items,m_full);
     Debug(&__plugin,DebugAll,"%s stopped cache=%s [%p]",
 	currentName(),m_cache.c_str(),this);
 }
@@ -1144,6 +1556,11 @@ void CacheLoadThread::run()
 bool EngineHandler::received(Message& msg)
 {
     if (!m_start) {
+	static bool s_saved = false;
+	if (!s_saved) {
+	    s_saved = true;
+	    __plugin.saveCaches();
+	}
 	Lock lck(__plugin);
 	return 0 != CacheThread::s_threads.skipNull();
     }
@@ -1189,6 +1606,7 @@ void CacheModule::setupCache(const String& name, const NamedList& params)
 	    return;
 	unsigned int size = adjustedCacheSize(params.getIntValue("size",s_size));
 	*c = new Cache(name,size,params);
+	(*c)->loadSnapshot();
 	// Install relays
 	if (lnp) {
 	    // LnpBefore is an alias for Route
@@ -1219,9 +1637,9 @@ void CacheModule::setupCache(const String& name, const NamedList& params)
 
 // Start cache load thread
 // Optionally load specific items only (the list will be consumed)
-void CacheModule::loadCache(const String& name, bool async, ObjList* items)
+void CacheModule::loadCache(const String& name, bool async, ObjList* items, bool full)
 {
-    XDebug(this,DebugAll,"loadCache(%s,%u)",name.c_str(),async);
+    XDebug(this,DebugAll,"loadCache(%s,%u,%p,%u)",name.c_str(),async,items,full);
     RefPointer<Cache> cache;
     getCache(cache,name);
     if (!cache) {
@@ -1230,10 +1648,12 @@ void CacheModule::loadCache(const String& name, bool async, ObjList* items)
     }
     String account;
     String query;
+    String since;
     unsigned int chunk = 0;
     Thread::Priority prio = Thread::Normal;
+    bool delta = false;
     if (!items)
-	cache->getDbLoad(account,query,chunk,prio);
+	delta = cache->getDbLoad(account,query,chunk,prio,since,full);
     else
 	cache->getDbLoadItemCmd(account,query,prio);
     if (!(account && query)) {
@@ -1243,7 +1663,7 @@ void CacheModule::loadCache(const String& name, bool async, ObjList* items)
     }
     if (async) {
 	cache = 0;
-	(new CacheLoadThread(name,prio,items))->startup();
+	(new CacheLoadThread(name,prio,items,full))->startup();
 	return;
     }
     bool load = cache->startLoad();
@@ -1263,17 +1683,18 @@ void CacheModule::loadCache(const String& name, bool async, ObjList* items)
 	max = items->count();
 	crtItem = items->skipNull();
     }
-    Debug(this,DebugInfo,"Loading cache '%s' %s=%u",
-	name.c_str(),(!items ? "chunks" : "items"),max);
+    Debug(this,DebugInfo,"Loading cache '%s' %s=%u%s%s",
+	name.c_str(),(!items ? "chunks" : "items"),max,
+	(delta ? " changed since " : ""),(delta ? since.c_str() : ""));
     // NOTE: Don't return from the loop: we must notify the cache
     for (unsigned int i = 0; i < max; i++) {
 	String* id = 0;
 	Message m("database");
 	m.addParam("account",account);
 	if (!items) {
-	    if (chunk) {
+	    if (chunk || delta) {
 		String tmp = query;
-		Cache::setLimits(tmp,chunk,offset);
+		Cache::setLimits(tmp,chunk,offset,since);
 		m.addParam("query",tmp);
 	    }
 	    else
@@ -1326,7 +1747,7 @@ void CacheModule::loadCache(const String& name, bool async, ObjList* items)
 	}
 	offset += loadedRows;
 	loaded += loadedRows;
-	unsigned int added = cache->addRows(*a);
+	unsigned int added = cache->addRows(*a,!items,delta);
 	cache = 0;
 	if (added < loadedRows)
 	    failed += loadedRows - added;
@@ -1344,12 +1765,26 @@ void CacheModule::loadCache(const String& name, bool async, ObjList* items)
     cache->endLoad(triggerReload);
     cache->dump("CacheModule::loadCache()");
     u_int32_t mask = cache->prefixMask();
-    cache = 0;
     Debug(this,DebugInfo,"Loaded %u items (failed=%u) in cache '%s', mask 0x%X",
 	loaded,failed,name.c_str(),mask);
+    if (loaded && !exiting())
+	cache->saveSnapshot();
+    cache = 0;
     updateCacheReload();
 }
 
+// Save all caches having a snapshot file
+void CacheModule::saveCaches()
+{
+    for (int i = 0; s_caches[i]; i++) {
+	RefPointer<Cache> cache;
+	getCache(cache,s_caches[i]);
+	if (cache)
+	    cache->saveSnapshot();
+	cache = 0;
+    }
+}
+
 void CacheModule::initialize()
 {
     static bool s_first = true;
@@ -1367,6 +1802,7 @@ void CacheModule::initialize()
     else if (s_maxChunks > 10000)
 	s_maxChunks = 10000;
     s_loadPrio = Thread::priority(cfg.getValue("general","loadcache_priority"));
+    s_autoResize = cfg.getBoolValue("general","autoresize",true);
     s_cacheTtlSec = adjustedCacheTtl(cfg.getIntValue("general","ttl"));
     unsigned int tmp = safeValue(cfg.getIntValue("general","expire_check_interval",10));
     if (tmp > s_cacheTtlSec)
@@ -1523,6 +1959,9 @@ bool CacheModule::commandExecute(String& retVal, const String& line)
 	    case CmdFlush:
 		commandFlush(cache,params,retVal);
 		break;
+	    case CmdSave:
+		commandSave(cache,retVal);
+		break;
 	    default:
 		retVal << "Command not implemented!!!";
 	}
@@ -1733,6 +2172,17 @@ void CacheModule::commandFlush(Cache* cache, NamedList& params, String& retVal)
     retVal << "Flushed " << n << " item(s)";
 }
 
+// Cache save handler
+void CacheModule::commandSave(Cache* cache, String& retVal)
+{
+    if (!cache)
+	return;
+    if (cache->saveSnapshot())
+	retVal << "Saved " << cache->count() << " item(s)";
+    else
+	retVal << "Failed to save cache";
+}
+
 // Help message handler
 bool CacheModule::commandHelp(String& retVal, const String& line)
 {
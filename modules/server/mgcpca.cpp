@@ -2268,6 +2268,15 @@ void MGCPPlugin::statusParams(String& str)
     str.append("spans=",",") << s_spans.count();
     str.append("chans=",",") << s_wrappers.count();
     s_mutex.unlock();
+    if (!s_engine)
+	return;
+    NamedList params("");
+    s_engine->status(params);
+    for (unsigned int i = 0; i < params.length(); i++) {
+	NamedString* ns = params.getParam(i);
+	if (ns)
+	    str.append(ns->name(),",") << "=" << *ns;
+    }
 }
 
 void MGCPPlugin::statusDetail(String& str)
@@ -118,6 +118,7 @@ protected:
     virtual bool received(Message& msg, int id);
     virtual bool commandComplete(Message& msg, const String& partLine,
 	const String& partWord);
+    virtual void statusParams(String& str);
     bool handleControl(Message& msg);
 private:
     SDPParser m_parser;
@@ -749,6 +750,20 @@ void MGCPPlugin::activate(bool standby)
     unlock();
 }
 
+void MGCPPlugin::statusParams(String& str)
+{
+    Driver::statusParams(str);
+    if (!s_engine)
+	return;
+    NamedList params("");
+    s_engine->status(params);
+    for (unsigned int i = 0; i < params.length(); i++) {
+	NamedString* ns = params.getParam(i);
+	if (ns)
+	    str.append(ns->name(),",") << "=" << *ns;
+    }
+}
+
 void MGCPPlugin::initialize()
 {
     Output("Initializing module MGCP Gateway");
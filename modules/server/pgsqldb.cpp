@@ -22,6 +22,8 @@
 #include <yatephone.h>
 
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include <libpq-fe.h>
 
 using namespace TelEngine;
@@ -29,11 +31,27 @@ namespace { // anonymous
 
 class PGConn;                            // A database connection
 class PgAccount;                         // Database account holding the connection(s)
+class PgStatement;                       // A statement prepared on a connection
 
 static ObjList s_accounts;
 Mutex s_conmutex(false,"PgSQL::acc");
 static unsigned int s_failedConns;
 
+// A statement prepared on a connection, the string holds the query template
+class PgStatement : public String
+{
+public:
+    inline PgStatement(const String& text, unsigned int serial)
+	: String(text), m_used(0), m_failed(false)
+	{ m_name << "yate_stmt_" << serial; }
+    // Server side name of the statement
+    String m_name;
+    // Last use sequence, the least recently used one is released first
+    u_int64_t m_used;
+    // Server refused to prepare it, always send the query as text
+    bool m_failed;
+};
+
 // A database connection
 class PgConn : public String
 {
@@ -54,6 +72,10 @@ public:
     // Return number of rows, -1 for non-retryable errors and -2 to retry
     int queryDb(const char* query, Message* dest);
     virtual void destruct();
+    inline unsigned int cacheHits() const
+	{ return m_cacheHits; }
+    inline unsigned int roundTrips() const
+	{ return m_roundTrips; }
 protected:
     // Called when new connection is established
     virtual void justConnected() { }
@@ -62,10 +84,38 @@ protected:
     // Perform the query, fill the message with data
     // Return number of rows, -1 for non-retryable errors and -2 to retry
     int queryDbInternal(const char* query, Message* dest);
+    // Execute the query as a prepared statement
+    // Return -3 if the query must be sent as text instead
+    int queryPrepared(const char* query, Message* dest, u_int64_t timeout);
+    // Find or create the prepared statement of a query template
+    PgStatement* statement(const String& text, bool& cached);
+#ifdef LIBPQ_HAS_PIPELINING
+    // Prepare and execute a new statement in a single round trip
+    int preparePipelined(PgStatement* stmt, const char* query, int n, const char** params,
+	Message* dest, u_int64_t timeout);
+#endif
+    // Send all pending output, return false on failure
+    bool flushDb(u_int64_t timeout);
+    // Wait until a result can be retrieved without blocking
+    bool waitResult(u_int64_t timeout);
+    // Discard the results of the last command, optionally return the first status
+    bool skipResults(u_int64_t timeout, ExecStatusType* stat = 0);
+    // Collect the results of the last command sent
+    int queryResults(const char* query, Message* dest, u_int64_t timeout, PgStatement* stmt = 0);
+    // Process one result of a query
+    void queryResult(PGresult* res, const char* query, Message* dest, int& totalRows, int& affectedRows);
+    // Report a query timeout and drop the connection
+    int queryTimeout(Message* dest);
 
     PgAccount* m_account;
     bool m_busy;
     PGconn* m_conn;
+    HashList m_statements;
+    ObjList m_release;
+    unsigned int m_stmtSerial;
+    u_int64_t m_stmtUsed;
+    unsigned int m_cacheHits;
+    unsigned int m_roundTrips;
 };
 
 // A notification listener connection
@@ -107,6 +157,8 @@ public:
 	{ return m_errorQueries; }
     inline unsigned int queryTime()
         { return (unsigned int) m_queryTime; }
+    unsigned int cacheHits();
+    unsigned int roundTrips();
 
 protected:
     inline void incErrorQueriesSafe() {
@@ -122,6 +174,8 @@ private:
     String m_encoding;
     int m_retry;
     u_int64_t m_timeout;
+    unsigned int m_prepared;
+    bool m_pipeline;
     PgConn* m_connPool;
     unsigned int m_connPoolSize;
     PgListenConn* m_notifyListener;
@@ -161,12 +215,145 @@ public:
 };
 
 
+// Statements that can be prepared
+static const char* s_preparable[] = {
+    "SELECT", "INSERT", "UPDATE", "DELETE", "WITH", "VALUES", 0
+};
+
+// Keywords that can be followed by a literal value
+static const char* s_beforeValue[] = {
+    "SELECT", "WHEN", "THEN", "ELSE", "LIKE", "ILIKE", "AND", "OR", "NOT", "BETWEEN", 0
+};
+
+static inline bool isWordChar(char c)
+{
+    return ('_' == c) || ::isalnum((unsigned char)c);
+}
+
+// Check if the word ending at a given position is one of a list
+static bool endsWord(const char* start, const char* end, const char** words)
+{
+    const char* p = end;
+    while (p > start && isWordChar(p[-1]))
+	p--;
+    unsigned int len = end - p;
+    if (!len)
+	return false;
+    for (; *words; words++)
+	if ((::strlen(*words) == len) && !::strncasecmp(p,*words,len))
+	    return true;
+    return false;
+}
+
+// Check if a quoted literal at a given position holds a value that can be bound
+// Typed literals like DATE '...' or E'...' must be kept in the query text
+static bool bindable(const char* start, const char* pos)
+{
+    if (pos > start && isWordChar(pos[-1]))
+	return false;
+    while (pos > start && ::isspace((unsigned char)pos[-1]))
+	pos--;
+    if (pos == start)
+	return false;
+    if (::strchr("=(,<>!+-*/%|",pos[-1]))
+	return true;
+    return endsWord(start,pos,s_beforeValue);
+}
+
+// Build the template of a query by turning the quoted literals into parameters
+// Return false if the query is not a single statement that can be prepared
+static bool buildTemplate(const char* query, String& text, ObjList& values, bool escapes)
+{
+    while (::isspace((unsigned char)*query))
+	query++;
+    const char* p = query;
+    while (isWordChar(*p))
+	p++;
+    if (!endsWord(query,p,s_preparable))
+	return false;
+    const char* copied = query;
+    ObjList* add = &values;
+    unsigned int params = 0;
+    while (*p) {
+	switch (*p) {
+	    case '\'':
+		{
+		    String val;
+		    bool bind = bindable(query,p);
+		    const char* q = p + 1;
+		    for (;;) {
+			if (!*q)
+			    return false;
+			if ('\'' == *q) {
+			    if ('\'' != q[1])
+				break;
+			    q++;
+			}
+			else if (escapes && ('\\' == *q)) {
+			    // do not interpret escapes, keep the literal in the query
+			    bind = false;
+			    val << *q++;
+			    if (!*q)
+				return false;
+			}
+			val << *q++;
+		    }
+		    if (bind) {
+			text.append(copied,p - copied);
+			text << "$" << ++params;
+			add = add->append(new String(val));
+			copied = q + 1;
+		    }
+		    p = q + 1;
+		}
+		continue;
+	    case '"':
+		p = ::strchr(p + 1,'"');
+		if (!p)
+		    return false;
+		break;
+	    case '-':
+		if ('-' == p[1]) {
+		    p = ::strchr(p,'\n');
+		    if (!p)
+			p = query + ::strlen(query);
+		    continue;
+		}
+		break;
+	    case '/':
+		if ('*' == p[1]) {
+		    p = ::strstr(p + 2,"*/");
+		    if (!p)
+			return false;
+		    p++;
+		}
+		break;
+	    case '$':
+		// dollar quoted strings or explicit parameters
+		return false;
+	    case ';':
+		// allow a single trailing statement separator
+		for (const char* q = p + 1; *q; q++)
+		    if (!::isspace((unsigned char)*q))
+			return false;
+		text.append(copied,p - copied);
+		return true;
+	}
+	p++;
+    }
+    text.append(copied,p - copied);
+    return true;
+}
+
+
 //
 // PgConn
 //
 PgConn::PgConn(PgAccount* account)
     : m_account(account), m_busy(false),
-    m_conn(0)
+    m_conn(0), m_statements(33),
+    m_stmtSerial(0), m_stmtUsed(0),
+    m_cacheHits(0), m_roundTrips(0)
 {
 }
 
@@ -198,6 +385,9 @@ void PgConn::dropDb()
 {
     if (!m_conn)
 	return;
+    // prepared statements are lost with the server session
+    m_statements.clear();
+    m_release.clear();
     PGconn* tmp = m_conn;
     m_conn = 0;
     XDebug(&module,DebugAll,"Connection '%s' dropped [%p]",c_str(),m_account);
@@ -315,6 +505,11 @@ int PgConn::queryDbInternal(const char* query, Message* dest)
 	// no retry - initDb already tried and failed...
 	return -1;
     u_int64_t timeout = Time::now() + m_account->m_timeout;
+    if (m_account->m_prepared) {
+	int res = queryPrepared(query,dest,timeout);
+	if (res != -3)
+	    return res;
+    }
     if (!PQsendQuery(m_conn,query)) {
 	// a connection failure cannot be detected at this point so any
 	//  error must be caused by the query itself - bad syntax or so
@@ -325,26 +520,238 @@ int PgConn::queryDbInternal(const char* query, Message* dest)
 	// non-retryable, query should be fixed
 	return -1;
     }
+    if (!flushDb(timeout)) {
+	if (dest)
+	    dest->setParam("error","flush failure");
+	return -2;
+    }
+    return queryResults(query,dest,timeout);
+}
+
+// Execute the query as a prepared statement
+// Return -3 if the query must be sent as text instead
+int PgConn::queryPrepared(const char* query, Message* dest, u_int64_t timeout)
+{
+    String text;
+    ObjList values;
+    const char* scs = PQparameterStatus(m_conn,"standard_conforming_strings");
+    if (!buildTemplate(query,text,values,!(scs && !::strcmp(scs,"on"))))
+	return -3;
+    bool cached = false;
+    PgStatement* stmt = statement(text,cached);
+    if (!stmt)
+	return -3;
+    unsigned int n = values.count();
+    const char** params = new const char*[n + 1];
+    n = 0;
+    for (ObjList* o = values.skipNull(); o; o = o->skipNext())
+	params[n++] = static_cast<String*>(o->get())->c_str();
+    int res = -3;
+    if (cached) {
+	m_cacheHits++;
+	if (PQsendQueryPrepared(m_conn,stmt->m_name,n,params,0,0,0))
+	    res = flushDb(timeout) ? queryResults(query,dest,timeout,stmt) : -2;
+	delete[] params;
+	return res;
+    }
+    DDebug(&module,DebugAll,"Preparing '%s' for '%s' as '%s' [%p]",
+	text.c_str(),c_str(),stmt->m_name.c_str(),m_account);
+#ifdef LIBPQ_HAS_PIPELINING
+    if (m_account->m_pipeline && PQenterPipelineMode(m_conn)) {
+	res = preparePipelined(stmt,query,n,params,dest,timeout);
+	delete[] params;
+	return res;
+    }
+#endif
+    // without pipelining each command takes a round trip
+    while (String* rel = static_cast<String*>(m_release.remove(false))) {
+	String cmd = "DEALLOCATE " + *rel;
+	TelEngine::destruct(rel);
+	if (!(PQsendQueryParams(m_conn,cmd,0,0,0,0,0,0) && flushDb(timeout) && skipResults(timeout))) {
+	    delete[] params;
+	    return -2;
+	}
+    }
+    ExecStatusType stat = PGRES_FATAL_ERROR;
+    if (!(PQsendPrepare(m_conn,stmt->m_name,text,n,0) && flushDb(timeout) && skipResults(timeout,&stat)))
+	res = -2;
+    else if (PGRES_COMMAND_OK != stat)
+	stmt->m_failed = true;
+    else if (PQsendQueryPrepared(m_conn,stmt->m_name,n,params,0,0,0))
+	res = flushDb(timeout) ? queryResults(query,dest,timeout,stmt) : -2;
+    delete[] params;
+    return res;
+}
 
-    if (PQflush(m_conn)) {
-	Debug(&module,DebugWarn,"Flush for '%s' failed: %s [%p]",
+#ifdef LIBPQ_HAS_PIPELINING
+// Release old statements, prepare and execute in a single round trip
+int PgConn::preparePipelined(PgStatement* stmt, const char* query, int n, const char** params,
+    Message* dest, u_int64_t timeout)
+{
+    unsigned int releases = 0;
+    bool ok = true;
+    while (String* rel = static_cast<String*>(m_release.remove(false))) {
+	String cmd = "DEALLOCATE " + *rel;
+	TelEngine::destruct(rel);
+	ok = ok && PQsendQueryParams(m_conn,cmd,0,0,0,0,0,0);
+	releases++;
+    }
+    ok = ok && PQsendPrepare(m_conn,stmt->m_name,*stmt,n,0)
+	&& PQsendQueryPrepared(m_conn,stmt->m_name,n,params,0,0,0)
+	&& PQpipelineSync(m_conn) && flushDb(timeout);
+    if (!ok) {
+	Debug(&module,DebugWarn,"Pipeline for '%s' failed: %s [%p]",
 	    c_str(),PQerrorMessage(m_conn),m_account);
 	dropDb();
-	if (dest)
-	    dest->setParam("error",PQerrorMessage(m_conn));
 	return -2;
     }
-
+    m_roundTrips++;
     int totalRows = 0;
     int affectedRows = 0;
-    while (Time::now() < timeout) {
-	PQconsumeInput(m_conn);
-	if (PQisBusy(m_conn)) {
-	    Thread::yield();
+    bool aborted = false;
+    // results of each command are terminated by a NULL
+    unsigned int cmd = 0;
+    while (waitResult(timeout)) {
+	PGresult* res = PQgetResult(m_conn);
+	if (!res) {
+	    cmd++;
 	    continue;
 	}
+	ExecStatusType stat = PQresultStatus(res);
+	if (PGRES_PIPELINE_SYNC == stat) {
+	    PQclear(res);
+	    PQexitPipelineMode(m_conn);
+	    if (aborted) {
+		// a failed release aborts all the commands that follow it
+		if (!stmt->m_failed)
+		    m_statements.remove(stmt,true,true);
+		return -3;
+	    }
+	    Debug(&module,DebugAll,"Query for '%s' returned %d rows, %d affected [%p]",
+		c_str(),totalRows,affectedRows,m_account);
+	    if (dest) {
+		dest->setParam("rows",String(totalRows));
+		dest->setParam("affected",String(affectedRows));
+	    }
+	    return totalRows;
+	}
+	if (PGRES_PIPELINE_ABORTED == stat)
+	    aborted = true;
+	else if (cmd == releases) {
+	    if (PGRES_COMMAND_OK != stat) {
+		Debug(&module,DebugInfo,"Query '%s' for '%s' cannot be prepared: %s [%p]",
+		    stmt->c_str(),c_str(),PQresultErrorMessage(res),m_account);
+		stmt->m_failed = true;
+	    }
+	}
+	else if (cmd > releases)
+	    queryResult(res,query,dest,totalRows,affectedRows);
+	PQclear(res);
+    }
+    return queryTimeout(dest);
+}
+#endif
+
+// Find or create the prepared statement of a query template
+PgStatement* PgConn::statement(const String& text, bool& cached)
+{
+    PgStatement* stmt = static_cast<PgStatement*>(m_statements[text]);
+    if (stmt) {
+	if (stmt->m_failed)
+	    return 0;
+	stmt->m_used = ++m_stmtUsed;
+	cached = true;
+	return stmt;
+    }
+    if (m_statements.count() >= m_account->m_prepared) {
+	// release the least recently used statement
+	PgStatement* old = 0;
+	for (unsigned int i = 0; i < m_statements.length(); i++) {
+	    for (ObjList* o = m_statements.getList(i); o; o = o->skipNext()) {
+		PgStatement* s = static_cast<PgStatement*>(o->get());
+		if (s && (!old || (s->m_used < old->m_used)))
+		    old = s;
+	    }
+	}
+	if (old) {
+	    if (!old->m_failed)
+		m_release.append(new String(old->m_name));
+	    m_statements.remove(old,true,true);
+	}
+    }
+    stmt = new PgStatement(text,++m_stmtSerial);
+    stmt->m_used = ++m_stmtUsed;
+    m_statements.append(stmt);
+    return stmt;
+}
+
+// Send all pending output, return false on failure
+bool PgConn::flushDb(u_int64_t timeout)
+{
+    for (;;) {
+	int res = PQflush(m_conn);
+	if (!res)
+	    return true;
+	if (res < 0 || Time::now() >= timeout)
+	    break;
+	Thread::yield();
+    }
+    Debug(&module,DebugWarn,"Flush for '%s' failed: %s [%p]",
+	c_str(),PQerrorMessage(m_conn),m_account);
+    dropDb();
+    return false;
+}
+
+// Wait until a result can be retrieved without blocking
+bool PgConn::waitResult(u_int64_t timeout)
+{
+    while (Time::now() < timeout) {
+	PQconsumeInput(m_conn);
+	if (!PQisBusy(m_conn))
+	    return true;
+	Thread::yield();
+    }
+    return false;
+}
+
+// Discard the results of the last command, optionally return the first status
+bool PgConn::skipResults(u_int64_t timeout, ExecStatusType* stat)
+{
+    m_roundTrips++;
+    bool first = true;
+    while (waitResult(timeout)) {
+	PGresult* res = PQgetResult(m_conn);
+	if (!res)
+	    return true;
+	if (first && stat)
+	    *stat = PQresultStatus(res);
+	first = false;
+	PQclear(res);
+    }
+    queryTimeout(0);
+    return false;
+}
+
+// Collect the results of the last command sent
+// Return number of rows, -1 for non-retryable errors and -2 to retry
+int PgConn::queryResults(const char* query, Message* dest, u_int64_t timeout, PgStatement* stmt)
+{
+    m_roundTrips++;
+    int totalRows = 0;
+    int affectedRows = 0;
+    const char* stale = 0;
+    while (waitResult(timeout)) {
 	PGresult* res = PQgetResult(m_conn);
 	if (!res) {
+	    if (stale) {
+		// retry, the statement will be prepared again
+		Debug(&module,DebugInfo,"Statement '%s' for '%s' is stale (%s) [%p]",
+		    stmt->m_name.c_str(),c_str(),stale,m_account);
+		if (::strcmp(stale,"26000"))
+		    m_release.append(new String(stmt->m_name));
+		m_statements.remove(stmt,true,true);
+		return -2;
+	    }
 	    // last result already received and processed - exit successfully
 	    Debug(&module,DebugAll,"Query for '%s' returned %d rows, %d affected [%p]",
 		c_str(),totalRows,affectedRows,m_account);
@@ -354,74 +761,93 @@ int PgConn::queryDbInternal(const char* query, Message* dest)
 	    }
 	    return totalRows;
 	}
-	ExecStatusType stat = PQresultStatus(res);
-	switch (stat) {
-	    case PGRES_TUPLES_OK:
-		// we got some data - but maybe zero rows or binary...
-		if (dest) {
-		    affectedRows += String(PQcmdTuples(res)).toInteger();
-		    int columns = PQnfields(res);
-		    int rows = PQntuples(res);
-		    if (rows > 0) {
-			totalRows += rows;
-			dest->setParam("columns",String(columns));
-			if (dest->getBoolValue("results",true) && !PQbinaryTuples(res)) {
-			    Array *a = new Array(columns,rows+1);
-			    for (int k = 0; k < columns; k++) {
-				ObjList* column = a->getColumn(k);
-				if (column)
-				    column->set(new String(PQfname(res,k)));
-				else {
+	if (stmt && (PGRES_FATAL_ERROR == PQresultStatus(res))) {
+	    // statement released by the server or its plan invalidated by schema changes
+	    const char* state = PQresultErrorField(res,PG_DIAG_SQLSTATE);
+	    if (state && (!::strcmp(state,"26000") || !::strcmp(state,"0A000")))
+		stale = (*state == '2') ? "26000" : "0A000";
+	}
+	if (!stale)
+	    queryResult(res,query,dest,totalRows,affectedRows);
+	PQclear(res);
+    }
+    return queryTimeout(dest);
+}
+
+// Process one result of a query
+void PgConn::queryResult(PGresult* res, const char* query, Message* dest, int& totalRows, int& affectedRows)
+{
+    ExecStatusType stat = PQresultStatus(res);
+    switch (stat) {
+	case PGRES_TUPLES_OK:
+	    // we got some data - but maybe zero rows or binary...
+	    if (dest) {
+		affectedRows += String(PQcmdTuples(res)).toInteger();
+		int columns = PQnfields(res);
+		int rows = PQntuples(res);
+		if (rows > 0) {
+		    totalRows += rows;
+		    dest->setParam("columns",String(columns));
+		    if (dest->getBoolValue("results",true) && !PQbinaryTuples(res)) {
+			Array *a = new Array(columns,rows+1);
+			for (int k = 0; k < columns; k++) {
+			    ObjList* column = a->getColumn(k);
+			    if (column)
+				column->set(new String(PQfname(res,k)));
+			    else {
+				Debug(&module,DebugGoOn,
+				    "Query '%s' for '%s': No array column for %d [%p]",
+				    query,c_str(),k,m_account);
+				continue;
+			    }
+			    for (int j = 0; j < rows; j++) {
+				column = column->next();
+				if (!column) {
+				    // Stop now: we won't get the next row
 				    Debug(&module,DebugGoOn,
-					"Query '%s' for '%s': No array column for %d [%p]",
-					query,c_str(),k,m_account);
-				    continue;
-				}
-				for (int j = 0; j < rows; j++) {
-				    column = column->next();
-				    if (!column) {
-					// Stop now: we won't get the next row
-					Debug(&module,DebugGoOn,
-					    "Query '%s' for '%s': No array row %d in column %d [%p]",
-					    query,c_str(),j + 1,k,m_account);
-					break;
-				    }
-				    // skip over NULL values
-				    if (PQgetisnull(res,j,k))
-					continue;
-				    GenObject* v = 0;
-				    if (PQfformat(res,k))
-					v = new DataBlock(PQgetvalue(res,j,k),PQgetlength(res,j,k));
-				    else
-					v = new String(PQgetvalue(res,j,k));
-				    column->set(v);
+					"Query '%s' for '%s': No array row %d in column %d [%p]",
+					query,c_str(),j + 1,k,m_account);
+				    break;
 				}
+				// skip over NULL values
+				if (PQgetisnull(res,j,k))
+				    continue;
+				GenObject* v = 0;
+				if (PQfformat(res,k))
+				    v = new DataBlock(PQgetvalue(res,j,k),PQgetlength(res,j,k));
+				else
+				    v = new String(PQgetvalue(res,j,k));
+				column->set(v);
 			    }
-			    dest->userData(a);
-			    a->deref();
 			}
+			dest->userData(a);
+			a->deref();
 		    }
 		}
-		break;
-	    case PGRES_COMMAND_OK:
-		if (dest)
-		    affectedRows += String(PQcmdTuples(res)).toInteger();
-		// no data returned
-		break;
-	    case PGRES_COPY_IN:
-	    case PGRES_COPY_OUT:
-		// data transfers - ignore them
-		break;
-	    default:
-		Debug(&module,DebugWarn,"Query '%s' for '%s' error: %s [%p]",
-		    query,c_str(),PQresultErrorMessage(res),m_account);
-		if (dest)
-		    dest->setParam("error",PQresultErrorMessage(res));
-		m_account->incErrorQueriesSafe();
-		module.changed();
-	}
-	PQclear(res);
+	    }
+	    break;
+	case PGRES_COMMAND_OK:
+	    if (dest)
+		affectedRows += String(PQcmdTuples(res)).toInteger();
+	    // no data returned
+	    break;
+	case PGRES_COPY_IN:
+	case PGRES_COPY_OUT:
+	    // data transfers - ignore them
+	    break;
+	default:
+	    Debug(&module,DebugWarn,"Query '%s' for '%s' error: %s [%p]",
+		query,c_str(),PQresultErrorMessage(res),m_account);
+	    if (dest)
+		dest->setParam("error",PQresultErrorMessage(res));
+	    m_account->incErrorQueriesSafe();
+	    module.changed();
     }
+}
+
+// Report a query timeout and drop the connection
+int PgConn::queryTimeout(Message* dest)
+{
     Debug(&module,DebugWarn,"Query timed out for '%s' [%p]",c_str(),m_account);
     if (dest)
 	dest->setParam("error","query timeout");
@@ -547,6 +973,8 @@ PgAccount::PgAccount(const NamedList& sect)
 	m_timeout = 500000;
     m_retry = sect.getIntValue("retry",5);
     m_encoding = sect.getValue("encoding");
+    m_prepared = sect.getIntValue("prepared",0,0,1000);
+    m_pipeline = sect.getBoolValue("pipeline",true);
     m_connPoolSize = sect.getIntValue("poolsize",1,1);
     m_connPool = new PgConn[m_connPoolSize];
     for (unsigned int i = 0; i < m_connPoolSize; i++) {
@@ -558,8 +986,8 @@ PgAccount::PgAccount(const NamedList& sect)
 	m_notifyListener = new PgListenConn(this, listen);
 	m_notifyListener->assign(m_name + ".notify");
     }
-    Debug(&module,DebugInfo,"Database account '%s' created poolsize=%u [%p]",
-	m_name.c_str(),m_connPoolSize,this);
+    Debug(&module,DebugInfo,"Database account '%s' created poolsize=%u prepared=%u [%p]",
+	m_name.c_str(),m_connPoolSize,m_prepared,this);
 }
 
 // Init the connections the connection
@@ -675,6 +1103,22 @@ int PgAccount::queryDb(const char* query, Message* dest)
     return res;
 }
 
+unsigned int PgAccount::cacheHits()
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < m_connPoolSize; i++)
+	n += m_connPool[i].cacheHits();
+    return n;
+}
+
+unsigned int PgAccount::roundTrips()
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < m_connPoolSize; i++)
+	n += m_connPool[i].roundTrips();
+    return n;
+}
+
 bool PgAccount::hasConn()
 {
     for (unsigned int i = 0; i < m_connPoolSize; i++)
@@ -723,7 +1167,7 @@ PgModule::~PgModule()
 void PgModule::statusModule(String& str)
 {
     Module::statusModule(str);
-    str.append("format=Total|Failed|Errors|AvgExecTime",",");
+    str.append("format=Total|Failed|Errors|AvgExecTime|CacheHits|RoundTrips",",");
 }
 
 void PgModule::statusParams(String& str)
@@ -745,6 +1189,7 @@ void PgModule::statusDetail(String& str)
 	    str << (acc->queryTime() / (acc->total() - acc->failed()) / 1000); //miliseconds
         else
 	    str << "0";
+	str << "|" << acc->cacheHits() << "|" << acc->roundTrips();
     }
     s_conmutex.unlock();
 }
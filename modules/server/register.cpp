@@ -21,6 +21,9 @@
 
 #include <yatephone.h>
 
+#include <string.h>
+#include <ctype.h>
+
 using namespace TelEngine;
 namespace { // anonymous
 
@@ -62,6 +65,8 @@ public:
     virtual bool loadQuery();
     virtual void initQuery();
     virtual void chkConfig();
+    inline int type() const
+	{ return m_type; }
 
 protected:
     bool copyParams(Message &msg, Array *a, const String& resultName);
@@ -73,6 +78,60 @@ protected:
     String m_account;
 };
 
+class CdrWriterThread;
+
+// Queues CDR queries and writes them in batches from its own thread
+class CdrWriter : public Mutex
+{
+    friend class CdrWriterThread;
+public:
+    CdrWriter(const String& name, bool critical);
+    // Start the writer thread
+    bool startup();
+    // Queue a query, spill it to disk if the backlog is full
+    // Return false if the writer is stopped or the query could not be kept,
+    //  the caller must then send it directly
+    bool queue(const String& account, const String& query);
+    // Flush all queued queries and stop the thread
+    void finish();
+private:
+    void run();
+    // Write all queued queries to the database
+    void flush();
+    // Dispatch one query, possibly holding many rows
+    bool send(const String& account, const String& query, unsigned int rows, bool keep = true);
+    // Append a query to the spool file
+    bool spill(const String& account, const String& query);
+    // Write queries from the spool file to the database
+    void replay();
+    String m_name;
+    bool m_critical;
+    unsigned int m_batch;
+    u_int64_t m_interval;
+    unsigned int m_backlog;
+    String m_spool;
+    ObjList m_queue;
+    ObjList* m_last;
+    unsigned int m_count;
+    bool m_spilled;
+    bool m_stop;
+    CdrWriterThread* m_thread;
+};
+
+class CdrWriterThread : public Thread
+{
+public:
+    inline CdrWriterThread(CdrWriter* writer)
+	: Thread("CDR Writer"),
+	  m_writer(writer)
+	{ }
+    virtual void run()
+	{ m_writer->run(); }
+    virtual void cleanup();
+private:
+    CdrWriter* m_writer;
+};
+
 class CDRHandler : public AAAHandler
 {
 public:
@@ -81,6 +140,8 @@ public:
     virtual const String& name() const;
     virtual bool received(Message& msg);
     virtual bool loadQuery();
+    // Write out the queued queries and stop the writer thread
+    void finish();
 
 protected:
     String m_name;
@@ -88,6 +149,7 @@ protected:
     String m_queryUpdate;
     String m_queryCombined;
     bool m_critical;
+    CdrWriter* m_writer;
 };
 
 // Base class for event notification handlers
@@ -586,14 +648,316 @@ bool AAAHandler::received(Message& msg)
     return false;
 }
 
+// Split a single row INSERT into the part up to VALUES and the row itself
+static bool splitInsert(const String& query, String& prefix, String& row)
+{
+    const char* s = query.c_str();
+    while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+	s++;
+    if (::strncasecmp(s,"INSERT",6))
+	return false;
+    const char* values = 0;
+    const char* open = 0;
+    int depth = 0;
+    char quote = 0;
+    for (const char* p = s; *p; p++) {
+	char c = *p;
+	if (quote) {
+	    if (c == quote)
+		quote = 0;
+	    continue;
+	}
+	switch (c) {
+	    case '\'':
+	    case '"':
+		quote = c;
+		continue;
+	    case '(':
+		if (values && !open)
+		    open = p;
+		depth++;
+		continue;
+	    case ')':
+		if (--depth == 0 && open) {
+		    // the row must end the query
+		    const char* e = p + 1;
+		    while (*e == ' ' || *e == '\t' || *e == '\r' || *e == '\n' || *e == ';')
+			e++;
+		    if (*e)
+			return false;
+		    prefix.assign(s,values - s);
+		    row.assign(values,p + 1 - values);
+		    return true;
+		}
+		continue;
+	}
+	if (!(depth || values || ::strncasecmp(p,"VALUES",6)) && (p > s)
+	    && !(isalnum(p[-1]) || p[-1] == '_') && !(isalnum(p[6]) || p[6] == '_')) {
+	    values = p + 6;
+	    p += 5;
+	}
+	else if (values && !open && depth == 0 && c > ' ')
+	    // something else than a row follows VALUES
+	    return false;
+    }
+    return false;
+}
+
+CdrWriter::CdrWriter(const String& name, bool critical)
+    : Mutex(false,"CdrWriter"),
+      m_name(name), m_critical(critical),
+      m_last(&m_queue), m_count(0), m_spilled(false),
+      m_stop(false), m_thread(0)
+{
+    m_batch = s_cfg.getIntValue(name,"batch_size",100,1,1000);
+    m_interval = 1000 * (u_int64_t)s_cfg.getIntValue(name,"batch_interval",1000,10,60000);
+    m_backlog = s_cfg.getIntValue(name,"batch_backlog",10000,m_batch);
+    m_spool = s_cfg.getValue(name,"batch_spool");
+    Engine::runParams().replaceParams(m_spool);
+    // queries left by a previous run are written first
+    m_spilled = m_spool && (File::exists(m_spool) || File::exists(m_spool + ".replay"));
+}
+
+bool CdrWriter::startup()
+{
+    Lock mylock(this);
+    if (m_thread)
+	return true;
+    m_thread = new CdrWriterThread(this);
+    if (m_thread->startup())
+	return true;
+    m_thread = 0;
+    return false;
+}
+
+// Queue a query, spill it to disk if the backlog is full
+bool CdrWriter::queue(const String& account, const String& query)
+{
+    Lock mylock(this);
+    if (!m_thread)
+	return false;
+    if (m_count >= m_backlog) {
+	if (m_spool && spill(account,query))
+	    return true;
+	// slow down the caller rather than losing the CDR
+	Debug(&module,DebugMild,"CDR backlog of '%s' full, writing query synchronously",
+	    m_name.c_str());
+	return false;
+    }
+    m_last = m_last->append(new NamedString(account,query));
+    m_count++;
+    return true;
+}
+
+// Flush all queued queries and stop the thread
+void CdrWriter::finish()
+{
+    Lock mylock(this);
+    if (!m_thread)
+	return;
+    // not cancelling the thread, it could not wait for database locks
+    m_stop = true;
+    mylock.drop();
+    while (true) {
+	Lock lck(this);
+	if (!m_thread)
+	    break;
+	lck.drop();
+	Thread::idle();
+    }
+}
+
+// The writer may be deleted as soon as finish() sees the thread is gone
+void CdrWriterThread::cleanup()
+{
+    Lock mylock(m_writer);
+    m_writer->m_thread = 0;
+}
+
+void CdrWriter::run()
+{
+    Debug(&module,DebugInfo,"CDR writer for '%s' started, batch=%u interval=" FMT64U " backlog=%u",
+	m_name.c_str(),m_batch,m_interval / 1000,m_backlog);
+    u_int64_t next = Time::now() + m_interval;
+    while (!(m_stop || Thread::check(false))) {
+	Thread::idle();
+	if (m_count < m_batch && Time::now() < next)
+	    continue;
+	flush();
+	if (m_spilled && !m_count)
+	    replay();
+	next = Time::now() + m_interval;
+    }
+    // engine is stopping, write out what is left
+    flush();
+}
+
+// Write all queued queries to the database
+void CdrWriter::flush()
+{
+    Lock mylock(this);
+    if (!m_count)
+	return;
+    ObjList list;
+    ObjList* add = &list;
+    while (GenObject* o = m_queue.remove(false))
+	add = add->append(o);
+    m_last = &m_queue;
+    m_count = 0;
+    mylock.drop();
+    // consecutive rows inserted with the same statement are merged in a single query
+    String account;
+    String prefix;
+    String query;
+    unsigned int rows = 0;
+    String pre;
+    String row;
+    for (ObjList* o = list.skipNull(); o; o = o->skipNext()) {
+	NamedString* q = static_cast<NamedString*>(o->get());
+	bool insert = splitInsert(*q,pre,row);
+	if (insert && prefix && (rows < m_batch) && (account == q->name()) && (pre == prefix)) {
+	    query << "," << row;
+	    rows++;
+	    continue;
+	}
+	if (rows)
+	    send(account,query,rows);
+	account = q->name();
+	query = *q;
+	rows = 1;
+	if (insert) {
+	    prefix = pre;
+	    query = pre + row;
+	}
+	else
+	    prefix.clear();
+    }
+    if (rows)
+	send(account,query,rows);
+}
+
+// Dispatch one query, possibly holding many rows
+// If it fails and a spool file is set the query is kept there
+bool CdrWriter::send(const String& account, const String& query, unsigned int rows, bool keep)
+{
+    Message m("database");
+    AAAHandler::prepareQuery(m,account,query,false);
+    bool error = !Engine::dispatch(m) || m.getParam("error");
+    if (m_critical && (s_critical != error)) {
+	s_critical = error;
+	module.changed();
+    }
+    if (!error)
+	return true;
+    Debug(&module,DebugWarn,"CDR writer for '%s' failed to write %u rows%s",
+	m_name.c_str(),rows,((keep && m_spool) ? ", spilling" : ""));
+    if (keep && m_spool) {
+	Lock mylock(this);
+	spill(account,query);
+    }
+    return false;
+}
+
+// Append a query to the spool file, must be called with the lock held
+bool CdrWriter::spill(const String& account, const String& query)
+{
+    File f;
+    if (!f.openPath(m_spool,true,false,true,true)) {
+	Alarm(&module,"system",DebugWarn,"Failed to open CDR spool '%s' for query: %s",
+	    m_spool.c_str(),query.c_str());
+	return false;
+    }
+    String buf;
+    buf << String::msgEscape(account) << ":" << String::msgEscape(query) << "\n";
+    f.writeData(buf.c_str(),buf.length());
+    if (!m_spilled)
+	Debug(&module,DebugMild,"CDR writer for '%s' spilling to '%s'",
+	    m_name.c_str(),m_spool.c_str());
+    m_spilled = true;
+    return true;
+}
+
+// Write queries from the spool file to the database
+void CdrWriter::replay()
+{
+    String name = m_spool + ".replay";
+    Lock mylock(this);
+    m_spilled = false;
+    // new queries are spilled to a fresh file while the old one is replayed
+    if (!(File::exists(name) || File::rename(m_spool,name)))
+	return;
+    mylock.drop();
+    File f;
+    if (!f.openPath(name)) {
+	Alarm(&module,"system",DebugWarn,"Failed to open CDR spool '%s'",name.c_str());
+	return;
+    }
+    Debug(&module,DebugInfo,"CDR writer for '%s' replaying '%s'",m_name.c_str(),name.c_str());
+    unsigned int sent = 0;
+    unsigned int kept = 0;
+    String line;
+    char buf[4096];
+    for (;;) {
+	int rd = f.readData(buf,sizeof(buf));
+	if (rd <= 0)
+	    break;
+	const char* p = buf;
+	const char* e = buf + rd;
+	while (p < e) {
+	    const char* nl = (const char*)::memchr(p,'\n',e - p);
+	    if (!nl) {
+		line.append(p,e - p);
+		break;
+	    }
+	    line.append(p,nl - p);
+	    p = nl + 1;
+	    int sep = line.find(':');
+	    if (sep > 0) {
+		String account = line.substr(0,sep).msgUnescape();
+		String query = line.substr(sep + 1).msgUnescape();
+		// after the first failure keep the rest for the next attempt
+		if (!kept && !Thread::check(false) && send(account,query,1,false))
+		    sent++;
+		else {
+		    Lock lck(this);
+		    spill(account,query);
+		    kept++;
+		}
+	    }
+	    line.clear();
+	}
+    }
+    f.terminate();
+    File::remove(name);
+    mylock.acquire(this);
+    m_spilled = m_spilled || File::exists(m_spool);
+    mylock.drop();
+    Debug(&module,DebugInfo,"CDR writer for '%s' replayed %u queries, kept %u",
+	m_name.c_str(),sent,kept);
+}
+
+
 CDRHandler::CDRHandler(const char* hname, int prio)
-    : AAAHandler("call.cdr",Cdr,prio), m_name(hname)
+    : AAAHandler("call.cdr",Cdr,prio), m_name(hname), m_writer(0)
 {
     m_critical = s_cfg.getBoolValue(m_name,"critical",(m_name == "call.cdr"));
+    if (s_cfg.getIntValue(m_name,"batch_size") > 0) {
+	m_writer = new CdrWriter(m_name,m_critical);
+	if (!m_writer->startup())
+	    Alarm(&module,"system",DebugWarn,"Failed to start CDR writer for '%s'",m_name.c_str());
+    }
 }
 
 CDRHandler::~CDRHandler()
 {
+    finish();
+    delete m_writer;
+}
+
+void CDRHandler::finish()
+{
+    if (m_writer)
+	m_writer->finish();
 }
 
 const String& CDRHandler::name() const
@@ -644,6 +1008,8 @@ bool CDRHandler::received(Message& msg)
     msg.replaceParams(account,true);
     if (query.null() || account.null())
 	return false;
+    if (m_writer && m_writer->queue(account,query))
+	return false;
 
     // failure while accounting is critical
     Message m("database");
@@ -1002,6 +1368,15 @@ bool RegistModule::received(Message& msg, int id)
 	}
 	return false;
     }
+    if (id == Halt) {
+	// write queued CDRs while the database modules are still running
+	for (ObjList* l = s_handlers.skipNull(); l; l = l->skipNext()) {
+	    AAAHandler* h = YOBJECT(AAAHandler,l->get());
+	    if (h && (h->type() == AAAHandler::Cdr))
+		static_cast<CDRHandler*>(h)->finish();
+	}
+	return false;
+    }
     return Module::received(msg,id);
 }
 
@@ -1086,6 +1461,7 @@ void RegistModule::initialize()
     s_unregister_expired = s_cfg.getBoolValue("general","unregister_expired",false);
     s_errOffline = s_cfg.getBoolValue("call.route","offlineauto",true);
     Engine::install(new MessageRelay("engine.start",this,Private,150));
+    installRelay(Halt);
     addHandler("call.cdr",AAAHandler::Cdr);
     addHandler("linetracker",AAAHandler::Cdr);
     addHandler("user.auth",AAAHandler::Auth);
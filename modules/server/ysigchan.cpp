@@ -46,6 +46,7 @@ class IsupEncodeHandler;                 // Handler for "isup.encode" message
 class SigNotifier;                       // Class for handling received notifications
 class SigSS7Tcap;                        // SS7 TCAP - Transaction Capabilities Application Part
 class SigTCAPUser;                       // Default TCAP user
+class GTTranslator;                      // SCCP Global Title Translator
 
 // The signalling channel
 class SigChannel : public Channel
@@ -354,8 +355,9 @@ public:
 	{ }
     virtual ~SigSccpGtt();
     virtual bool initialize(NamedList& params);
+    virtual void status(String& retVal);
 private:
-    GTT* m_gtt;
+    GTTranslator* m_gtt;
 };
 
 // MTP Traffic Testing
@@ -814,6 +816,51 @@ public:
     virtual void cleanup();
 };
 
+// A Global Title translation rule loaded from the rules file
+class GTTRule : public RefObject
+{
+public:
+    GTTRule(const NamedList& params, SS7PointCode::Type type);
+    virtual const String& toString() const
+	{ return m_name; }
+    // Check if the rule applies to the translation type, plan and nature
+    bool matches(int translation, int plan, int nature) const;
+    // Number of optional filters set, more specific rules are checked first
+    unsigned int filters() const;
+    // Pick a destination and fill in the translated address
+    void translate(NamedList& route, unsigned int index, SCCP* sccp) const;
+    inline bool valid() const
+	{ return m_valid && (m_primary.length() || m_backup.length()); }
+    inline const String& prefix() const
+	{ return m_prefix; }
+    String m_name;
+    String m_prefix;
+    int m_translation;
+    int m_plan;
+    int m_nature;
+    int m_ssn;
+    String m_route;
+    String m_sccp;
+    unsigned int m_strip;
+    String m_prepend;
+    NamedList m_params;
+    DataBlock m_primary;                 // Load shared point codes (packed, unsigned int each)
+    DataBlock m_backup;                  // Backup point codes used when no primary is available
+    u_int64_t m_hits;
+    unsigned int m_next;
+    bool m_valid;
+};
+
+// Digit trie node of a compiled GTT rule table
+class GTTNode
+{
+public:
+    GTTNode();
+    ~GTTNode();
+    GTTNode* m_child[16];
+    ObjList m_rules;
+};
+
 // Implementation for a SCCP Global Title Translator
 class GTTranslator : public GTT
 {
@@ -825,6 +872,21 @@ public:
 	    const String& nextPrefix);
     virtual bool initialize(const NamedList* config);
     virtual void updateTables(const NamedList& params);
+    void status(String& retVal);
+protected:
+    // (Re)load the rules file, replace the current table only if it was read
+    void loadRules(const NamedList& config);
+    // Find the best rule for the digits, return a referenced rule or 0
+    GTTRule* findRule(const String& digits, int translation, int plan, int nature,
+	unsigned int& index);
+private:
+    Mutex m_rulesMutex;
+    GTTNode* m_root;
+    ObjList m_rules;
+    bool m_fallback;
+    u_int64_t m_translated;
+    u_int64_t m_dispatched;
+    u_int64_t m_failed;
 };
 
 class SCCPUserDummy : public SCCPUser
@@ -852,6 +914,35 @@ static int s_floodEvents = 20;
 static const char s_miniHelp[] = "sigdump component [filename]";
 static const char s_fullHelp[] = "Command to dump signalling data to a file";
 
+// Numbering plan and nature of address names used by GTT rules
+static const TokenDict s_gtPlan[] = {
+    { "unknown",          0x00 },
+    { "isdn",             0x01 },
+    { "e164",             0x01 },
+    { "generic",          0x02 },
+    { "data",             0x03 },
+    { "x121",             0x03 },
+    { "telex",            0x04 },
+    { "maritime-mobile",  0x05 },
+    { "e210",             0x05 },
+    { "e211",             0x05 },
+    { "land-mobile",      0x06 },
+    { "e212",             0x06 },
+    { "isdn-mobile",      0x07 },
+    { "e214",             0x07 },
+    { "network-specific", 0x0e },
+    { 0, 0 }
+};
+
+static const TokenDict s_gtNature[] = {
+    { "unknown",                     0x00 },
+    { "subscriber",                  0x01 },
+    { "national-reserved",           0x02 },
+    { "national-significant",        0x03 },
+    { "international",               0x04 },
+    { 0, 0 }
+};
+
 const TokenDict SigFactory::s_compNames[] = {
     { "isdn-q921",        SigISDNLayer2 },
     { "isdn-q931",        SigISDNLayer3 },
@@ -3392,6 +3483,12 @@ bool SigSccpGtt::initialize(NamedList& params)
     return m_gtt && m_gtt->initialize(&params);
 }
 
+void SigSccpGtt::status(String& retVal)
+{
+    if (m_gtt)
+	m_gtt->status(retVal);
+}
+
 /**
  * SigTesting
  */
@@ -4177,6 +4274,12 @@ void SigSS7Tcap::status(String& retVal)
     retVal << ",totalDiscarded=" << p.getValue("totalDiscarded","0");
     retVal << ",totalNormal=" << p.getValue("totalNormal","0");
     retVal << ",totalAbnormal=" << p.getValue("totalAbnormal","0");
+    retVal << ",transactions=" << p.getValue("transactions","0");
+    retVal << ",totalDialogs=" << p.getValue("totalDialogs","0");
+    retVal << ",dialogTimeouts=" << p.getValue("dialogTimeouts","0");
+    retVal << ",componentTimeouts=" << p.getValue("componentTimeouts","0");
+    retVal << ",avgLatency=" << p.getValue("avgLatency","0");
+    retVal << ",maxLatency=" << p.getValue("maxLatency","0");
 }
 
 /**
@@ -4995,13 +5098,176 @@ bool SCCPUserDummy::managementNotify(SCCP::Type type, NamedList &params)
     return true;
 }
 
+/**
+ * class GTTRule
+ */
+
+// Retrieve a numeric rule or address field, -1 if missing or invalid
+static int gttValue(const NamedList& params, const String& name, const TokenDict* dict = 0)
+{
+    const String& val = params[name];
+    if (val.null())
+	return -1;
+    return lookup(val,dict,-1);
+}
+
+// Convert a GT digit to a trie child index, -1 if not a digit
+static inline int gttDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    if (c >= 'a' && c <= 'f')
+	return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+	return c - 'A' + 10;
+    return -1;
+}
+
+// Parse a comma separated list of point codes into a block of packed values
+static void gttPointCodes(DataBlock& dest, const String& list, SS7PointCode::Type type,
+    const String& rule)
+{
+    ObjList* l = list.split(',',false);
+    for (ObjList* o = l->skipNull(); o; o = o->skipNext()) {
+	String* s = static_cast<String*>(o->get());
+	s->trimBlanks();
+	SS7PointCode pc;
+	if (s->null())
+	    continue;
+	if (!pc.assign(*s,type)) {
+	    Debug(&plugin,DebugWarn,"GTT rule '%s': invalid point code '%s'",
+		rule.c_str(),s->c_str());
+	    continue;
+	}
+	unsigned int packed = pc.pack(type);
+	dest.append(&packed,sizeof(packed));
+    }
+    TelEngine::destruct(l);
+}
+
+// Pick the first available point code starting at a given index
+static bool gttPick(const DataBlock& pcs, unsigned int index, SS7Layer3* net,
+    SS7PointCode::Type type, unsigned int& pc)
+{
+    unsigned int n = pcs.length() / sizeof(unsigned int);
+    const unsigned int* p = static_cast<const unsigned int*>(pcs.data());
+    for (unsigned int i = 0; i < n; i++) {
+	unsigned int crt = p[(index + i) % n];
+	if (net && !(net->getRouteState(type,crt) & SS7Route::NotProhibited))
+	    continue;
+	pc = crt;
+	return true;
+    }
+    return false;
+}
+
+GTTRule::GTTRule(const NamedList& params, SS7PointCode::Type type)
+    : m_name(params), m_prefix(params["prefix"]),
+      m_translation(gttValue(params,YSTRING("translation"))),
+      m_plan(gttValue(params,YSTRING("plan"),s_gtPlan)),
+      m_nature(gttValue(params,YSTRING("nature"),s_gtNature)),
+      m_ssn(gttValue(params,YSTRING("ssn"))),
+      m_route(params["route"]), m_sccp(params["sccp"]),
+      m_strip(params.getIntValue(YSTRING("strip"),0,0)), m_prepend(params["prepend"]),
+      m_params(""), m_hits(0), m_next(0), m_valid(false)
+{
+    m_prefix.trimBlanks();
+    for (unsigned int i = 0; i < m_prefix.length(); i++) {
+	if (gttDigit(m_prefix.at(i)) >= 0)
+	    continue;
+	Debug(&plugin,DebugWarn,"GTT rule '%s': invalid prefix '%s'",
+	    m_name.c_str(),m_prefix.c_str());
+	return;
+    }
+    gttPointCodes(m_primary,params["pointcode"],type,m_name);
+    gttPointCodes(m_backup,params["backup"],type,m_name);
+    m_valid = true;
+    for (unsigned int i = 0; i < params.length(); i++) {
+	NamedString* ns = params.getParam(i);
+	if (ns && (ns->name().startsWith("gt.") || ns->name().startsWith("CallingPartyAddress.")))
+	    m_params.addParam(ns->name(),*ns);
+    }
+}
+
+bool GTTRule::matches(int translation, int plan, int nature) const
+{
+    return (m_translation < 0 || m_translation == translation) &&
+	(m_plan < 0 || m_plan == plan) && (m_nature < 0 || m_nature == nature);
+}
+
+unsigned int GTTRule::filters() const
+{
+    return (m_translation >= 0 ? 1 : 0) + (m_plan >= 0 ? 1 : 0) + (m_nature >= 0 ? 1 : 0);
+}
+
+void GTTRule::translate(NamedList& route, unsigned int index, SCCP* sccp) const
+{
+    if (m_strip || m_prepend) {
+	String gt = route["gt"];
+	gt = m_prepend + gt.substr(m_strip);
+	route.setParam("gt",gt);
+    }
+    if (m_ssn >= 0)
+	route.setParam("ssn",String(m_ssn));
+    if (m_route)
+	route.setParam("route",m_route);
+    if (m_sccp)
+	route.setParam("sccp",m_sccp);
+    route.copyParams(m_params);
+    SS7SCCP* ss7 = YOBJECT(SS7SCCP,sccp);
+    RefPointer<SS7Layer3> net = ss7 ? ss7->network() : 0;
+    SS7PointCode::Type type = ss7 ? ss7->getLocalPointCodeType() : SS7PointCode::Other;
+    unsigned int pc = 0;
+    if (!gttPick(m_primary,index,net,type,pc) && !gttPick(m_backup,0,net,type,pc)) {
+	// Nothing known to be available, let the network report the failure
+	if (!gttPick(m_primary,index,0,type,pc))
+	    gttPick(m_backup,0,0,type,pc);
+    }
+    route.setParam("pointcode",String(pc));
+    // Local routing to another sccp uses the remote point code
+    if (m_sccp)
+	route.setParam("RemotePC",String(pc));
+}
+
+
+/**
+ * class GTTNode
+ */
+
+GTTNode::GTTNode()
+{
+    for (int i = 0; i < 16; i++)
+	m_child[i] = 0;
+}
+
+GTTNode::~GTTNode()
+{
+    for (int i = 0; i < 16; i++)
+	delete m_child[i];
+}
+
+
 /**
  * class GTTranslator
  */
 
+// Copy the address parameters needed for a translation
+static void copyGTParams(NamedList& dest, const NamedList& gt, const String& prefix,
+    const String& nextPrefix)
+{
+    dest.copyParam(gt,YSTRING("HopCounter"));
+    dest.copyParam(gt,YSTRING("MessageReturn"));
+    dest.copyParam(gt,YSTRING("LocalPC"));
+    dest.copyParam(gt,YSTRING("generated"));
+    dest.copySubParams(gt,nextPrefix + ".",false);
+    dest.copySubParams(gt,prefix + ".");
+}
+
 GTTranslator::GTTranslator(const NamedList& params)
     : SignallingComponent(params.safe("GTT"),&params,"ss7-gtt"),
-      GTT(params)
+      GTT(params),
+      m_rulesMutex(false,"GTTRules"), m_root(0), m_fallback(true),
+      m_translated(0), m_dispatched(0), m_failed(0)
 {
     DDebug(this,DebugAll,"Crated Global Title Translator [%p]",this);
 }
@@ -5009,30 +5275,147 @@ GTTranslator::GTTranslator(const NamedList& params)
 GTTranslator::~GTTranslator()
 {
     DDebug(this,DebugAll,"Destroying Global Title Translator [%p]",this);
+    delete m_root;
 }
 
 NamedList* GTTranslator::routeGT(const NamedList& gt, const String& prefix, const String& nextPrefix)
 {
-    // TODO keep a cache!!
-    // Verify if the requested gt exists in cache
-    // if exists return the cached translation of th GT
-    // if not exists send it for translation
+    unsigned int index = 0;
+    GTTRule* rule = findRule(gt[prefix + ".gt"],
+	gttValue(gt,prefix + ".gt.translation"),
+	gttValue(gt,prefix + ".gt.plan",s_gtPlan),
+	gttValue(gt,prefix + ".gt.nature",s_gtNature),index);
+    if (rule) {
+	NamedList* route = new NamedList("sccp.route");
+	copyGTParams(*route,gt,prefix,nextPrefix);
+	rule->translate(*route,index,sccp());
+	XDebug(this,DebugAll,"Translated GT '%s' using rule '%s'",
+	    gt.getValue(prefix + ".gt"),rule->toString().c_str());
+	TelEngine::destruct(rule);
+	return route;
+    }
+    if (!m_fallback) {
+	Lock lock(m_rulesMutex);
+	m_failed++;
+	return 0;
+    }
     Message* msg = new Message("sccp.route");
     const char* name = sccp() ? sccp()->toString().c_str() : (const char*)0;
     msg->addParam("component",name,false);
     msg->addParam("translator",toString(),false);
-    msg->copyParam(gt,YSTRING("HopCounter"));
-    msg->copyParam(gt,YSTRING("MessageReturn"));
-    msg->copyParam(gt,YSTRING("LocalPC"));
-    msg->copyParam(gt,YSTRING("generated"));
-    msg->copySubParams(gt,nextPrefix + ".",false);
-    msg->copySubParams(gt,prefix + ".");
-    if (Engine::dispatch(msg)) // Append the translated GT to cache
+    copyGTParams(*msg,gt,prefix,nextPrefix);
+    bool ok = Engine::dispatch(msg);
+    Lock lock(m_rulesMutex);
+    if (ok) {
+	m_dispatched++;
 	return msg;
+    }
+    m_failed++;
+    lock.drop();
     TelEngine::destruct(msg);
     return 0;
 }
 
+GTTRule* GTTranslator::findRule(const String& digits, int translation, int plan, int nature,
+    unsigned int& index)
+{
+    Lock lock(m_rulesMutex);
+    GTTRule* found = 0;
+    GTTNode* node = m_root;
+    for (unsigned int i = 0; node; i++) {
+	for (ObjList* o = node->m_rules.skipNull(); o; o = o->skipNext()) {
+	    GTTRule* r = static_cast<GTTRule*>(o->get());
+	    if (r->matches(translation,plan,nature)) {
+		found = r;
+		break;
+	    }
+	}
+	if (i >= digits.length())
+	    break;
+	int d = gttDigit(digits.at(i));
+	node = (d >= 0) ? node->m_child[d] : 0;
+    }
+    if (!(found && found->ref()))
+	return 0;
+    found->m_hits++;
+    index = found->m_next++;
+    m_translated++;
+    return found;
+}
+
+void GTTranslator::loadRules(const NamedList& config)
+{
+    m_fallback = config.getBoolValue(YSTRING("fallback"),true);
+    const String& name = config["rules"];
+    GTTNode* root = 0;
+    ObjList rules;
+    if (name) {
+	// A plain name is looked up in the configuration directory
+	String file = name;
+	Engine::runParams().replaceParams(file);
+	if (file.find('/') < 0)
+	    file = Engine::configFile(file);
+	Configuration cfg(file);
+	if (!cfg.load()) {
+	    Debug(this,DebugWarn,"Failed to load GTT rules from '%s', keeping %u rules",
+		cfg.c_str(),m_rules.count());
+	    return;
+	}
+	const char* pct = config.getValue(YSTRING("pointcodetype"));
+	SS7SCCP* ss7 = YOBJECT(SS7SCCP,sccp());
+	SS7PointCode::Type type = pct ? SS7PointCode::lookup(pct) :
+	    (ss7 ? ss7->getLocalPointCodeType() : SS7PointCode::ITU);
+	root = new GTTNode;
+	unsigned int n = cfg.sections();
+	for (unsigned int i = 0; i < n; i++) {
+	    NamedList* sect = cfg.getSection(i);
+	    if (!sect || sect->null() || !sect->getBoolValue(YSTRING("enable"),true))
+		continue;
+	    GTTRule* rule = new GTTRule(*sect,type);
+	    if (!rule->valid()) {
+		Debug(this,DebugWarn,"Ignoring invalid GTT rule '%s'",sect->c_str());
+		TelEngine::destruct(rule);
+		continue;
+	    }
+	    GTTNode* node = root;
+	    for (unsigned int d = 0; d < rule->prefix().length(); d++) {
+		int idx = gttDigit(rule->prefix().at(d));
+		if (!node->m_child[idx])
+		    node->m_child[idx] = new GTTNode;
+		node = node->m_child[idx];
+	    }
+	    // Keep the more specific rules first, in file order otherwise
+	    ObjList* o = node->m_rules.skipNull();
+	    for (; o; o = o->skipNext())
+		if (static_cast<GTTRule*>(o->get())->filters() < rule->filters())
+		    break;
+	    if (o)
+		o->insert(rule)->setDelete(false);
+	    else
+		node->m_rules.append(rule)->setDelete(false);
+	    rules.append(rule);
+	}
+    }
+    Lock lock(m_rulesMutex);
+    // Keep hit counters of rules that survived the reload
+    for (ObjList* o = rules.skipNull(); o; o = o->skipNext()) {
+	GTTRule* rule = static_cast<GTTRule*>(o->get());
+	GTTRule* old = static_cast<GTTRule*>(m_rules[rule->toString()]);
+	if (old)
+	    rule->m_hits = old->m_hits;
+    }
+    m_rules.clear();
+    GenObject* obj = 0;
+    while ((obj = rules.remove(false)))
+	m_rules.append(obj);
+    GTTNode* old = m_root;
+    m_root = root;
+    lock.drop();
+    delete old;
+    if (name)
+	Debug(this,DebugInfo,"Loaded %u GTT rules from '%s'",m_rules.count(),name.c_str());
+}
+
 void GTTranslator::updateTables(const NamedList& params)
 {
     Message* msg = new Message("sccp.update");
@@ -5042,7 +5425,26 @@ void GTTranslator::updateTables(const NamedList& params)
 
 bool GTTranslator::initialize(const NamedList* config)
 {
-    return GTT::initialize(config);
+    bool ok = GTT::initialize(config);
+    if (config)
+	loadRules(*config);
+    return ok;
+}
+
+void GTTranslator::status(String& retVal)
+{
+    Lock lock(m_rulesMutex);
+    retVal << "type=" << componentType();
+    retVal << ";rules=" << m_rules.count();
+    retVal << ",translated=" << m_translated;
+    retVal << ",dispatched=" << m_dispatched;
+    retVal << ",failed=" << m_failed;
+    String hits;
+    for (ObjList* o = m_rules.skipNull(); o; o = o->skipNext()) {
+	GTTRule* rule = static_cast<GTTRule*>(o->get());
+	hits.append(rule->toString(),",") << "=" << rule->m_hits;
+    }
+    retVal.append(hits,";");
 }
 
 /**
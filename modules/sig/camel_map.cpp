@@ -222,13 +222,13 @@ public:
     static const XMLMap s_xmlMap[];
     void reset();
     void handleMAPDialog(XmlElement* root, NamedList& params);
-    bool decodeDialogPDU(XmlElement* el, const AppCtxt* ctxt, DataBlock& data);
+    bool decodeDialogPDU(XmlElement* el, const AppCtxt* ctxt, AsnCursor& data);
     XmlElement* addToXml(XmlElement* root, const XMLMap* map, NamedString* val);
     void addComponentsToXml(XmlElement* root, NamedList& params, const AppCtxt* ctxt);
     const XMLMap* findMap(String& elem);
     void addParametersToXml(XmlElement* elem, String& payloadHex, Operation* op, bool searchArgs = true);
-    void decodeTcapToXml(TelEngine::XmlElement*, TelEngine::DataBlock&, Operation* op, unsigned int index = 0, bool seachArgs = true);
-    bool decodeOperation(Operation* op, XmlElement* elem, DataBlock& data, bool searchArgs = true);
+    void decodeTcapToXml(TelEngine::XmlElement*, TelEngine::AsnCursor&, Operation* op, unsigned int index = 0, bool seachArgs = true);
+    bool decodeOperation(Operation* op, XmlElement* elem, AsnCursor& data, bool searchArgs = true);
 private:
     TcapXApplication* m_app;
     MsgType m_type;
@@ -528,7 +528,7 @@ static const TokenDict s_dict_numPlan[] = {
 struct MapCamelType {
     TcapXApplication::ParamType type;
     TcapXApplication::EncType encoding;
-    bool (*decode)(const Parameter*, MapCamelType*, AsnTag& tag, DataBlock&, XmlElement*, bool, int& err);
+    bool (*decode)(const Parameter*, MapCamelType*, AsnTag& tag, AsnCursor&, XmlElement*, bool, int& err);
     bool (*encode)(const Parameter*, MapCamelType*, DataBlock&, XmlElement*, int& err);
 };
 
@@ -545,6 +545,15 @@ static AsnTag s_noTag(AsnTag::Universal, AsnTag::Primitive, 0);
 static AsnTag s_enumTag(AsnTag::Universal, AsnTag::Primitive, 10);
 static AsnTag s_boolTag(AsnTag::Universal, AsnTag::Primitive, 1);
 
+// Prepend the tag and the length of the whole data with a single insert
+static void addHeader(DataBlock& data, const AsnTag& tag)
+{
+    AsnWriter hdr(16);
+    hdr.prependLength(data.length());
+    hdr.prepend(tag.coding());
+    hdr.insertTo(data);
+}
+
 static const Parameter* findParam(const Parameter* param, const String& tag)
 {
     if (!param)
@@ -688,7 +697,7 @@ static bool encodeParam(const Parameter* param, DataBlock& data, XmlElement* ele
     return ok;
 }
 
-static bool decodeRaw(XmlElement* elem, DataBlock& data, bool singleParam = false)
+static bool decodeRaw(XmlElement* elem, AsnCursor& data, bool singleParam = false)
 {
     if (!(elem && data.length()))
 	return false;
@@ -776,8 +785,17 @@ static bool decodeRaw(XmlElement* elem, DataBlock& data, bool singleParam = fals
 	}
 	else {
 	    int len = ASNLib::decodeLength(data);
-	    DataBlock payload(data.data(),len);
+	    bool checkEoC = (len == ASNLib::IndefiniteForm);
+	    if (checkEoC) {
+		AsnCursor d(data);
+		len = ASNLib::parseUntilEoC(d);
+	    }
+	    else if (len < 0)
+		return false;
+	    AsnCursor payload = data.head(len);
 	    data.cut(-len);
+	    if (checkEoC)
+		ASNLib::matchEOC(data);
 	    decodeRaw(child,payload);
 	}
 	if (singleParam)
@@ -786,7 +804,7 @@ static bool decodeRaw(XmlElement* elem, DataBlock& data, bool singleParam = fals
     return true;
 }
 
-static bool decodeParam(const Parameter* param, AsnTag& tag, DataBlock& data, XmlElement* elem, bool addEnc, int& err)
+static bool decodeParam(const Parameter* param, AsnTag& tag, AsnCursor& data, XmlElement* elem, bool addEnc, int& err)
 {
     if (!(param && elem && data.length()))
 	return false;
@@ -863,7 +881,7 @@ void encodeBCD(const String& digits, DataBlock& data)
     data.append(&buf,j);
 }
 
-static bool decodeTBCD(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeTBCD(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -892,12 +910,11 @@ static bool encodeTBCD(const Parameter* param, MapCamelType* type, DataBlock& da
     XDebug(&__plugin,DebugAll,"encodeTBCD(param=%s[%p],elem=%s[%p])",param->name.c_str(),param,elem->getTag().c_str(),elem);
     const String& text = elem->getText();
     encodeBCD(text,data);
-    data.insert(ASNLib::buildLength(data));
-    data.insert(param->tag.coding());
+    addHeader(data,param->tag);
     return true;
 }
 
-static bool decodeTel(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeTel(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -942,12 +959,11 @@ static bool encodeTel(const Parameter* param, MapCamelType* type, DataBlock& dat
     const String& digits = elem->getText();
     encodeBCD(digits,data);
 
-    data.insert(ASNLib::buildLength(data));
-    data.insert(param->tag.coding());
+    addHeader(data,param->tag);
     return true;
 }
 
-static bool decodeHex(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeHex(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -968,7 +984,7 @@ static bool decodeHex(const Parameter* param, MapCamelType* type, AsnTag& tag, D
 	return false;
     String octets;
     if (checkEoC) {
-	DataBlock d(data.data(),data.length());
+	AsnCursor d(data);
 	int l = ASNLib::parseUntilEoC(d);
 	octets.hexify(data.data(),l,' ');
 	data.cut(-l);
@@ -992,12 +1008,11 @@ static bool encodeHex(const Parameter* param, MapCamelType* type, DataBlock& dat
 	Debug(&__plugin,DebugWarn,"Failed to parse hexified string '%s'",text.c_str());
 	return false;
     }
-    data.insert(ASNLib::buildLength(data));
-    data.insert(param->tag.coding());;
+    addHeader(data,param->tag);
     return true;
 }
 
-static bool decodeOID(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeOID(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1026,12 +1041,11 @@ static bool encodeOID(const Parameter* param, MapCamelType* type, DataBlock& dat
     XDebug(&__plugin,DebugAll,"encodeOID(param=%s[%p],elem=%s[%p])",param->name.c_str(),param,elem->getTag().c_str(),elem);
     ASNObjId oid = elem->getText();
     data.append(ASNLib::encodeOID(oid,false));
-    data.insert(ASNLib::buildLength(data));
-    data.insert(param->tag.coding());
+    addHeader(data,param->tag);
     return true;
 }
 
-static bool decodeNull(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeNull(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1058,12 +1072,11 @@ static bool encodeNull(const Parameter* param, MapCamelType* type, DataBlock& da
     XDebug(&__plugin,DebugAll,"encodeNull(param=%s[%p],elem=%s[%p])",param->name.c_str(),param,elem->getTag().c_str(),elem);
     ASNObjId oid = elem->getText();
     data.append(ASNLib::encodeNull(false));
-    data.insert(ASNLib::buildLength(data));
-    data.insert(param->tag.coding());
+    addHeader(data,param->tag);
     return true;
 }
 
-static bool decodeInt(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeInt(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1091,12 +1104,11 @@ static bool encodeInt(const Parameter* param, MapCamelType* type, DataBlock& dat
     XDebug(&__plugin,DebugAll,"encodeInt(param=%s[%p],elem=%s[%p])",param->name.c_str(),param,elem->getTag().c_str(),elem);
     u_int64_t val = elem->getText().toInteger();
     data.append(ASNLib::encodeInteger(val,false));
-    data.insert(ASNLib::buildLength(data));
-    data.insert(param->tag.coding());
+    addHeader(data,param->tag);
     return true;
 }
 
-static bool decodeSeq(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeSeq(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1173,13 +1185,12 @@ static bool encodeSeq(const Parameter* param, MapCamelType* type, DataBlock& dat
     }
 
     if (param->tag != s_noTag) {
-	data.insert(ASNLib::buildLength(data));
-	data.insert(param->tag.coding());
+	addHeader(data,param->tag);
     }
     return true;
 }
 
-static bool decodeSeqOf(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc,
+static bool decodeSeqOf(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc,
 	    int& err)
 {
     if (!(param && type && data.length() && parent))
@@ -1262,14 +1273,13 @@ static bool encodeSeqOf(const Parameter* param, MapCamelType* type, DataBlock& d
 	}
     }
     if (param->tag != s_noTag) {
-	data.insert(ASNLib::buildLength(data));
-	data.insert(param->tag.coding());
+	addHeader(data,param->tag);
     }
     return true;
 }
 
 
-static bool decodeChoice(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeChoice(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1330,8 +1340,7 @@ static bool encodeChoice(const Parameter* param, MapCamelType* type, DataBlock&
 		}
 		data.append(db);
 		if (param->tag != s_noTag) {
-		    data.insert(ASNLib::buildLength(data));
-		    data.insert(param->tag.coding());
+		    addHeader(data,param->tag);
 		}
 		TelEngine::destruct(child);
 		return true;
@@ -1348,7 +1357,7 @@ static bool encodeChoice(const Parameter* param, MapCamelType* type, DataBlock&
     return false;
 }
 
-static bool decodeEnumerated(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeEnumerated(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1403,13 +1412,12 @@ static bool encodeEnumerated(const Parameter* param, MapCamelType* type, DataBlo
 	data.append(&enumVal,sizeof(enumVal));
     }
     if (param->tag != s_noTag) {
-	data.insert(ASNLib::buildLength(data));
-	data.insert(param->tag.coding());
+	addHeader(data,param->tag);
     }
     return true;
 }
 
-static bool decodeBitString(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeBitString(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1483,8 +1491,7 @@ static bool encodeBitString(const Parameter* param, MapCamelType* type, DataBloc
 	data.append(ASNLib::encodeBitString(val,false));
     }
     if (param->tag != s_noTag) {
-	data.insert(ASNLib::buildLength(data));
-	data.insert(param->tag.coding());
+	addHeader(data,param->tag);
     }
     return true;
 }
@@ -1512,7 +1519,7 @@ static const char* const s_gsm7esc[128] = {
     "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", ""
 };
 
-static void decodeGSM7Bit(DataBlock& data, int& len, String& decoded)
+static void decodeGSM7Bit(AsnCursor& data, int& len, String& decoded)
 {
     u_int8_t bits = 0;
     u_int16_t buf = 0;
@@ -1538,7 +1545,7 @@ static void decodeGSM7Bit(DataBlock& data, int& len, String& decoded)
 	decoded.assign(decoded,decoded.length()-1);
 }
 
-static bool decodeGSMString(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeGSMString(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1626,13 +1633,12 @@ static bool encodeGSMString(const Parameter* param, MapCamelType* type, DataBloc
     encodeGSM7Bit(str,data);
 
     if (param->tag != s_noTag) {
-	data.insert(ASNLib::buildLength(data));
-	data.insert(param->tag.coding());
+	addHeader(data,param->tag);
     }
     return true;
 }
 
-static bool decodeFlags(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeFlags(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1697,13 +1703,12 @@ static bool encodeFlags(const Parameter* param, MapCamelType* type, DataBlock& d
     }
     data.append(&byte,sizeof(byte));
     if (param->tag != s_noTag) {
-	data.insert(ASNLib::buildLength(data));
-	data.insert(param->tag.coding());
+	addHeader(data,param->tag);
     }
     return true;
 }
 
-static bool decodeString(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeString(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1737,13 +1742,12 @@ static bool encodeString(const Parameter* param, MapCamelType* type, DataBlock&
     const String& text = elem->getText();
     data.append(ASNLib::encodeString(text,ASNLib::PRINTABLE_STR,false));
     if (param->tag != s_noTag) {
-	data.insert(ASNLib::buildLength(data));
-	data.insert(param->tag.coding());
+	addHeader(data,param->tag);
     }
     return true;
 }
 
-static bool decodeBool(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data, XmlElement* parent, bool addEnc, int& err)
+static bool decodeBool(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data, XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
 	return false;
@@ -1775,8 +1779,7 @@ static bool encodeBool(const Parameter* param, MapCamelType* type, DataBlock& da
     bool val = elem->getText().toBoolean();
     data.append(ASNLib::encodeBoolean(val,false));
     if (param->tag != s_noTag) {
-	data.insert(ASNLib::buildLength(data));
-	data.insert(param->tag.coding());
+	addHeader(data,param->tag);
     }
     return true;
 }
@@ -1905,7 +1908,7 @@ static void setDigits(DataBlock& data, const char* val, unsigned char nai, int b
     data.append(buf,len);
 }
 
-static bool decodeCallNumber(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data,
+static bool decodeCallNumber(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data,
 	XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
@@ -2040,8 +2043,7 @@ static bool encodeCallNumber(const Parameter* param, MapCamelType* type, DataBlo
     const String& digits = elem->getText();
     setDigits(data,digits,nai,b2,b0);
 
-    data.insert(ASNLib::buildLength(data));
-    data.insert(param->tag.coding());
+    addHeader(data,param->tag);
     return true;
 }
 
@@ -2073,7 +2075,7 @@ static const String s_reasonOrigAttr = "reason_original";
 static const String s_counterAttr = "counter";
 static const String s_reasonAttr = "reason";
 
-static bool decodeRedir(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data,
+static bool decodeRedir(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data,
 	XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
@@ -2129,8 +2131,7 @@ static bool encodeRedir(const Parameter* param, MapCamelType* type, DataBlock& d
     b1 |= (lookup(elem->attribute(s_reasonAttr),s_dict_redir_reason,0) & 0x0f) << 4;
     data.append(&b1,sizeof(b1));
 
-    data.insert(ASNLib::buildLength(data));
-    data.insert(param->tag.coding());
+    addHeader(data,param->tag);
     return true;
 }
 
@@ -2196,7 +2197,7 @@ static const String s_transferModeAttr = "transfermode";
 static const String s_transferRateAttr = "transferrate";
 static const String s_multiplierAttr = "multiplier";
 
-static bool decodeUSI(const Parameter* param, MapCamelType* type, AsnTag& tag, DataBlock& data,
+static bool decodeUSI(const Parameter* param, MapCamelType* type, AsnTag& tag, AsnCursor& data,
 	XmlElement* parent, bool addEnc, int& err)
 {
     if (!(param && type && data.length() && parent))
@@ -7451,12 +7452,13 @@ void TcapToXml::handleMAPDialog(XmlElement* root, NamedList& params)
 	return;
     DataBlock db;
     db.unHexify(param->c_str(),param->length(),' ');
-    if (decodeDialogPDU(parent,mapCtxt,db)) {
+    AsnCursor data(db);
+    if (decodeDialogPDU(parent,mapCtxt,data)) {
 	params.clearParam(s_tcapEncodingContent);
     }
 }
 
-bool TcapToXml::decodeDialogPDU(XmlElement* el, const AppCtxt* ctxt, DataBlock& data)
+bool TcapToXml::decodeDialogPDU(XmlElement* el, const AppCtxt* ctxt, AsnCursor& data)
 {
     if (!(el && ctxt))
 	return false;
@@ -7640,11 +7642,12 @@ void TcapToXml::addParametersToXml(XmlElement* elem, String& payloadHex, Operati
     DDebug(&__plugin,DebugAll,"TcapToXml::addParametersToXml(elem=%s[%p], payload=%s, op=%s[%p], searchArgs=%s) [%p]",
 	    elem->getTag().c_str(),elem,payloadHex.c_str(),(op ? op->name.c_str() : ""),op,String::boolText(searchArgs),this);
 
-    DataBlock data;
-    if (!data.unHexify(payloadHex.c_str(),payloadHex.length(),' ')) {
+    DataBlock payload;
+    if (!payload.unHexify(payloadHex.c_str(),payloadHex.length(),' ')) {
 	DDebug(&__plugin,DebugAll,"TcapToXml::addParamtersToXml() invalid hexified payload=%s [%p]",payloadHex.c_str(),this);
 	return;
     }
+    AsnCursor data(payload);
     if (elem->getTag() == s_component) {
 	AsnTag tag = (op ? (searchArgs ? op->argTag : op->retTag) : s_noTag);
 	AsnTag decTag;
@@ -7664,7 +7667,7 @@ void TcapToXml::addParametersToXml(XmlElement* elem, String& payloadHex, Operati
     decodeTcapToXml(elem,data,op,0,searchArgs);
 }
 
-void TcapToXml::decodeTcapToXml(XmlElement* elem, DataBlock& data, Operation* op, unsigned int index, bool searchArgs)
+void TcapToXml::decodeTcapToXml(XmlElement* elem, AsnCursor& data, Operation* op, unsigned int index, bool searchArgs)
 {
     DDebug(&__plugin,DebugAll,"TcapToXml::decodeTcapToXml(elem=%s[%p],op=%s[%p], searchArgs=%s) [%p]",
 	    elem->getTag().c_str(),elem,(op ? op->name.c_str() : ""),op,String::boolText(searchArgs),this);
@@ -7677,7 +7680,7 @@ void TcapToXml::decodeTcapToXml(XmlElement* elem, DataBlock& data, Operation* op
 	decodeRaw(elem,data);
 }
 
-bool TcapToXml::decodeOperation(Operation* op, XmlElement* elem, DataBlock& data, bool searchArgs)
+bool TcapToXml::decodeOperation(Operation* op, XmlElement* elem, AsnCursor& data, bool searchArgs)
 {
     if (!(op && elem && m_app))
 	return false;
@@ -7861,8 +7864,7 @@ bool XmlToTcap::encodeComponent(DataBlock& payload, XmlElement* elem, bool searc
     if (elem->getTag() == s_component) {
 	AsnTag tag = ( op ? (searchArgs ? op->argTag : op->retTag) : s_noTag);
 	if (tag != s_noTag) {
-	    payload.insert(ASNLib::buildLength(payload));
-	    payload.insert(tag.coding());
+	    addHeader(payload,tag);
 	}
     }
     return true;
@@ -9071,6 +9073,8 @@ TcapXModule::TcapXModule()
       m_usersMtx(true,"TCAPXUsers")
 {
     Output("Loaded TCAPXML module");
+    // TCAP components are created by the signalling channel
+    initAfter("sig");
 }
 
 TcapXModule::~TcapXModule()
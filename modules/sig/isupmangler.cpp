@@ -87,7 +87,11 @@ class IsupMangler : public Plugin
 public:
     inline IsupMangler()
 	: Plugin("isupmangler")
-	{ Output("Loaded module ISUP Mangler"); }
+	{
+	    Output("Loaded module ISUP Mangler");
+	    // manglers are attached to the engine the signalling channel creates
+	    initAfter("sig");
+	}
     inline ~IsupMangler()
 	{ Output("Unloading module ISUP Mangler"); }
     virtual void initialize();
@@ -1503,6 +1503,7 @@ SS7LNPDriver::SS7LNPDriver()
       m_lnp(0)
 {
     Output("Loaded module SS7LnpAnsi");
+    initAfter("sig");
 }
 
 SS7LNPDriver::~SS7LNPDriver()
@@ -0,0 +1,685 @@
+/**
+ * asnbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * ASN.1 BER decode and encode benchmark on TCAP/MAP messages
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "benchmark.h"
+#include <yatesig.h>
+#include <yateasn.h>
+#include <yatexml.h>
+
+#include <string.h>
+
+namespace { // anonymous
+
+class AsnBench : public BenchPlugin
+{
+public:
+    AsnBench();
+protected:
+    virtual void check(const String& args, BenchChecks& checks);
+    virtual bool run(const String& args, String& error);
+private:
+    bool loadFile(const String& path, ObjList& msgs, String& error);
+    void checkWalk(BenchChecks& checks);
+    void checkTcap(BenchChecks& checks);
+    void checkMap(const NamedList& params, BenchChecks& checks);
+    bool runWalk(const NamedList& params, String& error);
+    bool runTcap(const NamedList& params, String& error);
+    bool runMap(const NamedList& params, String& error);
+};
+
+// Receives the indications of the TCAP decoder
+class BenchUser : public TCAPUser
+{
+public:
+    inline BenchUser()
+	: TCAPUser("asnbench"),
+	  m_last(""), m_count(0)
+	{ }
+    virtual bool tcapIndication(NamedList& params);
+    virtual int managementState()
+	{ return SCCPManagement::UserInService; }
+    NamedList m_last;
+    unsigned int m_count;
+};
+
+// Talks to camel_map as a XML application, keeps the last message received
+class MapClient : public XmlDomParser
+{
+public:
+    MapClient();
+    virtual ~MapClient();
+    bool open(const NamedList& params, String& error);
+    bool receive(unsigned int count);
+    inline XmlElement* last() const
+	{ return m_last; }
+protected:
+    virtual void gotElement(const NamedList& element, bool empty);
+    virtual void endElement(const String& name);
+private:
+    void gotRoot();
+    Socket m_socket;
+    XmlElement* m_last;
+    unsigned int m_received;
+    unsigned int m_timeout;
+};
+
+INIT_PLUGIN(AsnBench);
+
+// Built in ITU TCAP messages carrying MAP operations
+static const char* s_samples[] = {
+    // Begin, AARQ dialogue, sendRoutingInfoForSM invoke
+    "62 43 48 04 00 00 00 01 6b 1a 28 18 06 07 00 11 86 05 01 01 01 a0 0d 60 0b a1 09 06 07 04 00 00 01 00 14 03 "
+    "6c 1f a1 1d 02 01 01 02 01 2d 30 15 80 07 91 44 77 58 10 05 f0 81 01 ff 82 07 91 44 77 58 10 05 f8",
+    // End, sendRoutingInfoForSM returnResultLast
+    "64 1d 49 04 00 00 00 01 6c 15 a2 13 02 01 01 30 0e 02 01 2d 30 09 04 07 91 44 77 58 10 05 f0",
+    // Continue, processUnstructuredSS-Request invoke
+    "65 23 48 04 00 00 00 02 49 04 00 00 00 01 6c 15 a1 13 02 01 02 02 01 3b 30 0b 04 01 0f 04 06 aa 51 0c 36 1b 03",
+    // Begin with indefinite lengths, mo-forwardSM invoke
+    "62 80 48 04 00 00 00 03 6c 80 a1 80 02 01 03 02 01 2e 30 80 80 07 91 44 77 58 10 05 f0 "
+    "04 08 32 14 80 00 00 00 00 f1 00 00 00 00 00 00 00 00",
+    0
+};
+
+struct MapOperation {
+    const char* name;
+    // hex encoded Invoke component, the argument follows 8 octets of header
+    const char* component;
+    const char* opCode;
+    // one of the arguments decoded by camel_map
+    const char* tag;
+    const char* value;
+};
+
+// MAP operations sent in TCAP Unidirectional messages
+static const MapOperation s_operations[] = {
+    { "sendRoutingInfoForSM",
+	"a1 1d 02 01 01 02 01 2d 30 15 80 07 91 44 77 58 10 05 f0 81 01 ff 82 07 91 44 77 58 10 05 f8",
+	"45", "msisdn", "44778501500" },
+    { "processUnstructuredSS-Request",
+	"a1 12 02 01 02 02 01 3b 30 0a 04 01 0f 04 05 aa 18 0c 36 02",
+	"59", "ussd-String", "*100#" },
+    { "mo-forwardSM",
+	"a1 24 02 01 03 02 01 2e 30 1c 84 07 91 44 77 58 10 05 f8 82 07 91 44 77 58 10 05 f0 "
+	"04 08 32 14 80 00 00 00 00 f1",
+	"46", "serviceCentreAddressDA", "44778501508" },
+    { 0, 0, 0, 0, 0 }
+};
+
+// Messages in flight while benchmarking camel_map
+#define MAP_WINDOW 100
+
+// Number of sample messages packed in the synthetic large message
+#define BULK_COUNT 64
+
+// TCAP registered in the signalling engine for camel_map to attach to
+static SS7TCAPITU* s_mapTcap = 0;
+
+// Read the header of the next element, return the content length or -1 on error
+template <class T> static int readHeader(T& data, AsnTag& tag, bool& eoc)
+{
+    if (!data.length())
+	return -1;
+    AsnTag::decode(tag,data);
+    if (tag.coding().length() > data.length())
+	return -1;
+    data.cut(-(int)tag.coding().length());
+    int len = ASNLib::decodeLength(data);
+    eoc = (len == ASNLib::IndefiniteForm && tag.type() == AsnTag::Constructor);
+    if (eoc) {
+	T tmp(data);
+	len = ASNLib::parseUntilEoC(tmp);
+    }
+    if (len < 0 || len > (int)data.length())
+	return -1;
+    return len;
+}
+
+// Walk all elements copying each content the way the DataBlock decoders do
+static unsigned int walkBlock(DataBlock& data)
+{
+    unsigned int count = 0;
+    bool eoc = false;
+    while (data.length()) {
+	// a tag caches its coding, it must not be reused for the next element
+	AsnTag tag;
+	int len = readHeader(data,tag,eoc);
+	if (len < 0)
+	    break;
+	count++;
+	DataBlock content(data.data(),len);
+	data.cut(-len);
+	if (eoc)
+	    ASNLib::matchEOC(data);
+	if (tag.type() == AsnTag::Constructor)
+	    count += walkBlock(content);
+    }
+    return count;
+}
+
+// Walk all elements using sub cursors, no data is copied
+static unsigned int walkCursor(AsnCursor& data)
+{
+    unsigned int count = 0;
+    bool eoc = false;
+    while (data.length()) {
+	// a tag caches its coding, it must not be reused for the next element
+	AsnTag tag;
+	int len = readHeader(data,tag,eoc);
+	if (len < 0)
+	    break;
+	count++;
+	AsnCursor content = data.head(len);
+	data.cut(-len);
+	if (eoc)
+	    ASNLib::matchEOC(data);
+	if (tag.type() == AsnTag::Constructor)
+	    count += walkCursor(content);
+    }
+    return count;
+}
+
+// Encode elements in document order, inserting each header before its content
+static void encodeBlock(AsnCursor data, DataBlock& out)
+{
+    bool eoc = false;
+    while (data.length()) {
+	AsnTag tag;
+	int len = readHeader(data,tag,eoc);
+	if (len < 0)
+	    break;
+	DataBlock elem;
+	if (tag.type() == AsnTag::Constructor)
+	    encodeBlock(data.head(len),elem);
+	else
+	    elem.assign(data.data(),len);
+	elem.insert(ASNLib::buildLength(elem));
+	elem.insert(tag.coding());
+	out.append(elem);
+	data.cut(-len);
+	if (eoc)
+	    ASNLib::matchEOC(data);
+    }
+}
+
+// Encode siblings last to first so each header is prepended after its content
+static void encodeWriter(AsnCursor data, AsnWriter& out)
+{
+    AsnTag tag;
+    bool eoc = false;
+    int len = readHeader(data,tag,eoc);
+    if (len < 0)
+	return;
+    AsnCursor content = data.head(len);
+    data.cut(-len);
+    if (eoc)
+	ASNLib::matchEOC(data);
+    encodeWriter(data,out);
+    unsigned int mark = out.mark();
+    if (tag.type() == AsnTag::Constructor)
+	encodeWriter(content,out);
+    else
+	out.prepend(content.data(),content.length());
+    out.close(mark,tag);
+}
+
+static inline double nsPerMsg(u_int64_t usec, u_int64_t msgs)
+{
+    return msgs ? (usec * 1000.0) / msgs : 0.0;
+}
+
+static inline double ratio(u_int64_t slow, u_int64_t fast)
+{
+    return fast ? (double)slow / fast : 0.0;
+}
+
+// Wrap a component in a TCAP Unidirectional message
+static void unidirectional(const char* component, DataBlock& msg)
+{
+    static const u_int8_t s_portion = 0x6c;
+    static const u_int8_t s_uni = 0x61;
+    msg.unHexify(component);
+    msg.insert(ASNLib::buildLength(msg));
+    msg.insert(DataBlock((void*)&s_portion,1));
+    msg.insert(ASNLib::buildLength(msg));
+    msg.insert(DataBlock((void*)&s_uni,1));
+}
+
+// Find an element anywhere below a parent
+static XmlElement* findElement(XmlElement* parent, const String& tag)
+{
+    if (!parent)
+	return 0;
+    for (XmlElement* x = parent->findFirstChild(); x; x = parent->findNextChild(x)) {
+	if (x->getTag() == tag)
+	    return x;
+	XmlElement* found = findElement(x,tag);
+	if (found)
+	    return found;
+    }
+    return 0;
+}
+
+// Get the TCAP used by camel_map, create and register it on first use
+static SS7TCAP* mapTcap(const NamedList& params)
+{
+    if (s_mapTcap)
+	return s_mapTcap;
+    SignallingEngine* engine = SignallingEngine::self(true);
+    NamedList p(params.getValue(YSTRING("tcap"),"asnbench"));
+    s_mapTcap = new SS7TCAPITU(p);
+    engine->insert(s_mapTcap);
+    // nothing else may have started the engine that processes received messages
+    engine->start();
+    // camel_map looks up its TCAP when initialized
+    Engine::init("camel_map");
+    return s_mapTcap;
+}
+
+
+bool BenchUser::tcapIndication(NamedList& params)
+{
+    m_count++;
+    m_last = params;
+    // no dialogue follows, release the transaction on next timer tick
+    params.setParam("tcap.transaction.endNow",String::boolText(true));
+    return true;
+}
+
+
+MapClient::MapClient()
+    : XmlDomParser("AsnBench"),
+      m_last(0), m_received(0), m_timeout(2000)
+{
+}
+
+MapClient::~MapClient()
+{
+    TelEngine::destruct(m_last);
+}
+
+// Connect to the camel_map listener, register the capabilities of the samples
+bool MapClient::open(const NamedList& params, String& error)
+{
+    SocketAddr addr(AF_INET);
+    addr.host(params.getValue(YSTRING("map_host"),"127.0.0.1"));
+    addr.port(params.getIntValue(YSTRING("map_port"),5555));
+    m_timeout = params.getIntValue(YSTRING("map_timeout"),2000,100);
+    if (!(m_socket.create(AF_INET,SOCK_STREAM) && m_socket.connect(addr))) {
+	error << "could not connect to camel_map at " << addr.addr();
+	return false;
+    }
+    m_socket.setBlocking(false);
+    String xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	"<m xmlns=\"http://yate.null.ro/xml/tcap/v1\"><c>SMSC</c><c>Services</c></m>";
+    if (m_socket.writeData(xml.c_str(),xml.length()) != (int)xml.length() || !receive(1)) {
+	error = "camel_map did not accept the capabilities";
+	return false;
+    }
+    return true;
+}
+
+// Read until count more messages were received
+bool MapClient::receive(unsigned int count)
+{
+    unsigned int target = m_received + count;
+    u_int64_t limit = Time::now() + 1000 * (u_int64_t)m_timeout;
+    char buf[8192];
+    while (m_received < target) {
+	if (Time::now() > limit)
+	    return false;
+	bool readOk = false;
+	if (!(m_socket.select(&readOk,0,0,10000) && readOk))
+	    continue;
+	int rd = m_socket.readData(buf,sizeof(buf) - 1);
+	if (rd <= 0) {
+	    if (rd < 0 && m_socket.canRetry())
+		continue;
+	    return false;
+	}
+	buf[rd] = '\0';
+	if (!parse(buf) && error() != XmlSaxParser::Incomplete)
+	    return false;
+    }
+    return true;
+}
+
+void MapClient::gotElement(const NamedList& element, bool empty)
+{
+    XmlDomParser::gotElement(element,empty);
+    if (empty)
+	gotRoot();
+}
+
+void MapClient::endElement(const String& name)
+{
+    XmlDomParser::endElement(name);
+    gotRoot();
+}
+
+void MapClient::gotRoot()
+{
+    if (!(document() && document()->root(true)))
+	return;
+    TelEngine::destruct(m_last);
+    m_last = document()->takeRoot(true);
+    document()->reset();
+    m_received++;
+}
+
+
+AsnBench::AsnBench()
+    : BenchPlugin("asnbench","AsnBench")
+{
+}
+
+// Load messages from a file holding one hex encoded message per line
+bool AsnBench::loadFile(const String& path, ObjList& msgs, String& error)
+{
+    File f;
+    if (!f.openPath(path)) {
+	error << "could not open '" << path << "'";
+	return false;
+    }
+    int64_t len = f.length();
+    if (len <= 0 || len > 0x4000000) {
+	error << "invalid size of '" << path << "'";
+	return false;
+    }
+    DataBlock buf(0,(unsigned int)len);
+    if (f.readData(buf.data(),buf.length()) != (int)len) {
+	error << "could not read '" << path << "'";
+	return false;
+    }
+    String text((const char*)buf.data(),buf.length());
+    ObjList* lines = text.split('\n',false);
+    for (ObjList* l = lines->skipNull(); l; l = l->skipNext()) {
+	String hex = l->get()->toString();
+	hex.trimBlanks();
+	if (hex.null() || hex.startsWith("#") || hex.startsWith(";"))
+	    continue;
+	DataBlock* msg = new DataBlock;
+	if (msg->unHexify(hex) && msg->length())
+	    msgs.append(msg);
+	else {
+	    Debug(this,DebugMild,"Skipping invalid hex line '%s'",hex.c_str());
+	    TelEngine::destruct(msg);
+	}
+    }
+    TelEngine::destruct(lines);
+    if (!msgs.skipNull()) {
+	error << "no messages in '" << path << "'";
+	return false;
+    }
+    return true;
+}
+
+// Both generic walks and both encoders must agree on every sample
+void AsnBench::checkWalk(BenchChecks& checks)
+{
+    unsigned int n = 0;
+    for (const char** s = s_samples; *s; s++, n++) {
+	DataBlock msg;
+	msg.unHexify(*s);
+	DataBlock tmp(msg);
+	AsnCursor cur(msg);
+	unsigned int elements = walkBlock(tmp);
+	checks.check(elements && walkCursor(cur) == elements,
+	    "sample %u: decoders disagree on element count",n);
+	DataBlock encBlock;
+	encodeBlock(AsnCursor(msg),encBlock);
+	AsnWriter writer(msg.length());
+	encodeWriter(AsnCursor(msg),writer);
+	checks.check(encBlock.length() == writer.length() &&
+	    !::memcmp(encBlock.data(),writer.data(),writer.length()),
+	    "sample %u: encoders produced different output",n);
+    }
+}
+
+// The TCAP decoder must find the operation and its arguments
+void AsnBench::checkTcap(BenchChecks& checks)
+{
+    NamedList p("asnbench-tcap");
+    SS7TCAPITU* tcap = new SS7TCAPITU(p);
+    BenchUser* user = new BenchUser;
+    user->attach(tcap);
+    for (const MapOperation* op = s_operations; op->name; op++) {
+	DataBlock msg;
+	unidirectional(op->component,msg);
+	NamedList params("");
+	SS7TCAPMessage sccp(params,msg);
+	user->m_last.clearParams();
+	tcap->processSCCPData(&sccp);
+	const NamedList& res = user->m_last;
+	checks.check(res[YSTRING("tcap.request.type")] == YSTRING("Unidirectional") &&
+	    res[YSTRING("tcap.component.count")] == YSTRING("1") &&
+	    res[YSTRING("tcap.component.1.operationCode")] == op->opCode &&
+	    res[YSTRING("tcap.component.1")] == String(op->component).substr(24),
+	    "%s: TCAP decoded type '%s' operation '%s' argument '%s'",op->name,
+	    res[YSTRING("tcap.request.type")].safe(),res[YSTRING("tcap.component.1.operationCode")].safe(),
+	    res[YSTRING("tcap.component.1")].safe());
+    }
+    tcap->timerTick(Time());
+    checks.check(!tcap->transactionCount(),"%u TCAP transactions left",tcap->transactionCount());
+    user->attach(0);
+    TelEngine::destruct(user);
+    TelEngine::destruct(tcap);
+}
+
+// camel_map must decode the arguments of each operation
+void AsnBench::checkMap(const NamedList& params, BenchChecks& checks)
+{
+    SS7TCAP* tcap = mapTcap(params);
+    MapClient client;
+    String error;
+    bool ok = client.open(params,error);
+    if (!checks.check(ok,"%s",error.safe()))
+	return;
+    for (const MapOperation* op = s_operations; op->name; op++) {
+	DataBlock msg;
+	unidirectional(op->component,msg);
+	NamedList sccp("");
+	tcap->receivedData(msg,sccp);
+	if (!checks.check(client.receive(1),"%s: no answer from camel_map",op->name))
+	    return;
+	XmlElement* x = findElement(client.last(),op->tag);
+	checks.check(x && x->getText() == op->value,"%s: camel_map decoded %s '%s'",
+	    op->name,op->tag,(x ? x->getText().c_str() : ""));
+    }
+}
+
+void AsnBench::check(const String& args, BenchChecks& checks)
+{
+    NamedList params(name());
+    ObjList* words = splitArgs(args,params);
+    if (!words->skipNull()) {
+	words->append(new String("walk"));
+	words->append(new String("tcap"));
+    }
+    if (words->find("walk") && params[YSTRING("file")].null())
+	checkWalk(checks);
+    if (words->find("tcap"))
+	checkTcap(checks);
+    if (words->find("map"))
+	checkMap(params,checks);
+    TelEngine::destruct(words);
+}
+
+// asnbench [walk] [tcap] [map] [param=value...]
+bool AsnBench::run(const String& args, String& error)
+{
+    NamedList params(name());
+    ObjList* words = splitArgs(args,params);
+    if (!words->skipNull()) {
+	words->append(new String("walk"));
+	words->append(new String("tcap"));
+    }
+    String line;
+    line << "iterations=" << params.getIntValue(YSTRING("iterations"),20000,1);
+    report(line,params);
+    bool ok = (!words->find("walk") || runWalk(params,error)) &&
+	(!words->find("tcap") || runTcap(params,error)) &&
+	(!words->find("map") || runMap(params,error));
+    TelEngine::destruct(words);
+    return ok;
+}
+
+// Generic walk and encoding, copying blocks against cursors and back to front writer
+bool AsnBench::runWalk(const NamedList& params, String& error)
+{
+    unsigned int iterations = params.getIntValue(YSTRING("iterations"),20000,1);
+    ObjList msgs;
+    const String& path = params[YSTRING("file")];
+    if (path) {
+	if (!loadFile(path,msgs,error))
+	    return false;
+    }
+    else {
+	DataBlock bulk;
+	for (const char** s = s_samples; *s; s++) {
+	    DataBlock* msg = new DataBlock;
+	    msg->unHexify(*s);
+	    msgs.append(msg);
+	    bulk.append(*msg);
+	}
+	// Large message to show how the copying scales with the size
+	DataBlock* big = new DataBlock;
+	for (unsigned int i = 0; i < BULK_COUNT; i++)
+	    big->append(bulk);
+	big->insert(ASNLib::buildLength(*big));
+	u_int8_t seq = ASNLib::SEQUENCE | AsnTag::Constructor;
+	big->insert(DataBlock(&seq,1));
+	msgs.append(big);
+    }
+    String line;
+    for (ObjList* l = msgs.skipNull(); l; l = l->skipNext()) {
+	const DataBlock& msg = *static_cast<DataBlock*>(l->get());
+	DataBlock tmp(msg);
+	unsigned int elements = walkBlock(tmp);
+	u_int64_t start = Time::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+	    DataBlock data(msg);
+	    walkBlock(data);
+	}
+	u_int64_t decBlock = Time::now() - start;
+	start = Time::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+	    AsnCursor data(msg);
+	    walkCursor(data);
+	}
+	u_int64_t decCursor = Time::now() - start;
+	start = Time::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+	    DataBlock data;
+	    encodeBlock(AsnCursor(msg),data);
+	}
+	u_int64_t encBlockTime = Time::now() - start;
+	start = Time::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+	    AsnWriter data(msg.length() + 16);
+	    encodeWriter(AsnCursor(msg),data);
+	}
+	u_int64_t encWriterTime = Time::now() - start;
+
+	line.clear();
+	line.printf("size=%u elements=%u decode: datablock %.0f ns cursor %.0f ns (x%.1f)"
+	    " encode: insert %.0f ns writer %.0f ns (x%.1f)",
+	    msg.length(),elements,
+	    nsPerMsg(decBlock,iterations),nsPerMsg(decCursor,iterations),ratio(decBlock,decCursor),
+	    nsPerMsg(encBlockTime,iterations),nsPerMsg(encWriterTime,iterations),
+	    ratio(encBlockTime,encWriterTime));
+	report(line,params);
+    }
+    return true;
+}
+
+// Full TCAP decoding: transaction, component portion, transaction setup and release
+bool AsnBench::runTcap(const NamedList& params, String& error)
+{
+    unsigned int iterations = params.getIntValue(YSTRING("iterations"),20000,1);
+    NamedList p("asnbench-tcap");
+    SS7TCAPITU* tcap = new SS7TCAPITU(p);
+    BenchUser* user = new BenchUser;
+    user->attach(tcap);
+    String line;
+    for (const MapOperation* op = s_operations; op->name; op++) {
+	DataBlock msg;
+	unidirectional(op->component,msg);
+	NamedList sccp("");
+	user->m_count = 0;
+	u_int64_t start = Time::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+	    SS7TCAPMessage m(sccp,msg);
+	    tcap->processSCCPData(&m);
+	    if (!(i & 63))
+		tcap->timerTick(Time());
+	}
+	tcap->timerTick(Time());
+	u_int64_t usec = Time::now() - start;
+	if (user->m_count != iterations) {
+	    error << "TCAP delivered " << user->m_count << " of " << iterations << " " << op->name;
+	    break;
+	}
+	line.clear();
+	line.printf("tcap %s size=%u: %.0f ns/message",op->name,msg.length(),nsPerMsg(usec,iterations));
+	report(line,params);
+    }
+    user->attach(0);
+    TelEngine::destruct(user);
+    TelEngine::destruct(tcap);
+    return error.null();
+}
+
+// TCAP and camel_map decoding up to the XML received by an application
+bool AsnBench::runMap(const NamedList& params, String& error)
+{
+    unsigned int iterations = params.getIntValue(YSTRING("map_iterations"),2000,1);
+    SS7TCAP* tcap = mapTcap(params);
+    MapClient client;
+    if (!client.open(params,error))
+	return false;
+    String line;
+    for (const MapOperation* op = s_operations; op->name; op++) {
+	DataBlock msg;
+	unidirectional(op->component,msg);
+	NamedList sccp("");
+	u_int64_t start = Time::now();
+	for (unsigned int i = 0; i < iterations; i += MAP_WINDOW) {
+	    unsigned int n = iterations - i;
+	    if (n > MAP_WINDOW)
+		n = MAP_WINDOW;
+	    for (unsigned int j = 0; j < n; j++)
+		tcap->receivedData(msg,sccp);
+	    if (!client.receive(n)) {
+		error << "camel_map did not answer all " << op->name;
+		return false;
+	    }
+	}
+	u_int64_t usec = Time::now() - start;
+	line.clear();
+	line.printf("map %s size=%u: %.0f ns/message",op->name,msg.length(),nsPerMsg(usec,iterations));
+	report(line,params);
+    }
+    return true;
+}
+
+}; // anonymous namespace
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,330 @@
+/**
+ * benchmark.h
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Common part of the benchmark modules
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H
+
+#include <yatengine.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+
+using namespace TelEngine;
+namespace { // anonymous
+
+/**
+ * Counts the correctness checks done before a benchmark is timed.
+ * Each check compares the result of the optimized code with the one of the
+ *  code it replaced or with a known good value.
+ */
+class BenchChecks
+{
+public:
+    /**
+     * Constructor
+     * @param dbg Debug enabler that reports the failed checks
+     */
+    inline BenchChecks(const DebugEnabler* dbg)
+	: m_dbg(dbg), m_checks(0), m_failed(0)
+	{ }
+
+    /**
+     * Count a check, report it if it failed
+     * @param ok Result of the check
+     * @param format Description of the check, printf style
+     * @return The value of ok
+     */
+    bool check(bool ok, const char* format, ...) FORMAT_CHECK(3);
+
+    /**
+     * Get the number of checks done so far
+     * @return Number of checks
+     */
+    inline unsigned int checks() const
+	{ return m_checks; }
+
+    /**
+     * Get the number of failed checks
+     * @return Number of checks that failed
+     */
+    inline unsigned int failed() const
+	{ return m_failed; }
+
+private:
+    const DebugEnabler* m_dbg;
+    unsigned int m_checks;
+    unsigned int m_failed;
+};
+
+/**
+ * Base of the benchmark modules.
+ * The benchmark runs from the "<name> [arguments]" rmanager command or once
+ *  the engine started when the [<name>] section of yate.conf has a 'run' key.
+ * Correctness checks always run first, timing is skipped if any failed.
+ */
+class BenchPlugin : public Plugin
+{
+public:
+    /**
+     * Report loading of the module
+     * @param name Name of the module, also the name of the command
+     * @param title Prefix of the output lines
+     */
+    BenchPlugin(const char* name, const char* title);
+
+    /**
+     * Install the command and startup handlers on first call
+     */
+    virtual void initialize();
+
+    /**
+     * Run the checks then the benchmark
+     * @param args Arguments of the command
+     * @param result String to append a one line summary to
+     * @return True if all checks passed and the benchmark completed
+     */
+    bool execute(const String& args, String& result);
+
+    /**
+     * Run the benchmark configured in yate.conf, called in its own thread
+     * @param sect The [<name>] section of yate.conf
+     * @return True if the benchmark succeeded
+     */
+    virtual bool startup(const NamedList& sect);
+
+    /**
+     * Get the prefix of the output lines
+     * @return Title of the benchmark
+     */
+    inline const String& title() const
+	{ return m_title; }
+
+    /**
+     * Split a command line in words and param=value pairs.
+     * The [<name>] section of yate.conf provides the defaults.
+     * @param line Command line arguments
+     * @param params List to fill with the parameters
+     * @return Newly allocated list of the words that are not parameters
+     */
+    ObjList* splitArgs(const String& line, NamedList& params) const;
+
+    /**
+     * Output a line of results, append it to the file in 'output' if set
+     * @param line Text to report
+     * @param params Parameters of the run
+     */
+    void report(const String& line, const NamedList& params) const;
+
+protected:
+    /**
+     * Check the optimized code against the old one before timing it
+     * @param args Arguments of the command
+     * @param checks Counter of the checks
+     */
+    virtual void check(const String& args, BenchChecks& checks)
+	{ }
+
+    /**
+     * Run the timed part of the benchmark
+     * @param args Arguments of the command
+     * @param error String to set to the reason of a failure
+     * @return True on success
+     */
+    virtual bool run(const String& args, String& error) = 0;
+
+private:
+    String m_title;
+    bool m_first;
+};
+
+// Handles the command that runs the benchmark
+class BenchCommand : public MessageHandler
+{
+public:
+    inline BenchCommand(BenchPlugin& plugin)
+	: MessageHandler("engine.command",100,plugin.name()),
+	  m_plugin(plugin)
+	{ }
+    virtual bool received(Message& msg);
+private:
+    BenchPlugin& m_plugin;
+};
+
+// Starts the benchmark configured in yate.conf once all modules are loaded
+class BenchStart : public MessageHandler
+{
+public:
+    inline BenchStart(BenchPlugin& plugin)
+	: MessageHandler("engine.start",100,plugin.name()),
+	  m_plugin(plugin)
+	{ }
+    virtual bool received(Message& msg);
+private:
+    BenchPlugin& m_plugin;
+};
+
+// Runs the configured benchmark without blocking the engine
+class BenchStartThread : public Thread
+{
+public:
+    inline BenchStartThread(BenchPlugin& plugin)
+	: Thread(plugin.title()),
+	  m_plugin(plugin)
+	{ }
+    virtual void run();
+private:
+    BenchPlugin& m_plugin;
+};
+
+
+bool BenchChecks::check(bool ok, const char* format, ...)
+{
+    m_checks++;
+    if (ok)
+	return true;
+    m_failed++;
+    char buf[512];
+    va_list va;
+    va_start(va,format);
+    ::vsnprintf(buf,sizeof(buf),format,va);
+    va_end(va);
+    Debug(m_dbg,DebugWarn,"Check failed: %s",buf);
+    return false;
+}
+
+
+bool BenchCommand::received(Message& msg)
+{
+    String line = msg[YSTRING("line")];
+    if (!line.startSkip(m_plugin.name()))
+	return false;
+    m_plugin.execute(line,msg.retValue());
+    msg.retValue() << "\r\n";
+    return true;
+}
+
+bool BenchStart::received(Message& msg)
+{
+    const NamedList* sect = Engine::config().getSection(m_plugin.name());
+    if (sect && sect->getParam(YSTRING("run")))
+	(new BenchStartThread(m_plugin))->startup();
+    return false;
+}
+
+void BenchStartThread::run()
+{
+    const NamedList* sect = Engine::config().getSection(m_plugin.name());
+    if (!sect)
+	return;
+    bool ok = m_plugin.startup(*sect);
+    if (sect->getBoolValue(YSTRING("exit")))
+	Engine::halt(ok ? 0 : 1);
+}
+
+
+BenchPlugin::BenchPlugin(const char* name, const char* title)
+    : Plugin(name),
+      m_title(title), m_first(true)
+{
+    Output("Loaded module %s",title);
+}
+
+void BenchPlugin::initialize()
+{
+    Output("Initializing module %s",m_title.c_str());
+    if (!m_first)
+	return;
+    m_first = false;
+    Engine::install(new BenchCommand(*this));
+    // other modules must be initialized before they can be measured
+    Engine::install(new BenchStart(*this));
+}
+
+bool BenchPlugin::execute(const String& args, String& result)
+{
+    BenchChecks checks(this);
+    check(args,checks);
+    if (checks.checks())
+	Output("%s: %u checks, %u failed",m_title.c_str(),checks.checks(),checks.failed());
+    if (checks.failed()) {
+	result << m_title << ": " << checks.failed() << " of " << checks.checks() <<
+	    " checks failed, benchmark not run";
+	return false;
+    }
+    String error;
+    if (!run(args,error)) {
+	result << m_title << " failed: " << error;
+	return false;
+    }
+    result << m_title << " done, check the output";
+    return true;
+}
+
+// The run key holds the command arguments
+bool BenchPlugin::startup(const NamedList& sect)
+{
+    String result;
+    bool ok = execute(sect[YSTRING("run")],result);
+    if (!ok)
+	Debug(this,DebugWarn,"%s",result.c_str());
+    return ok;
+}
+
+inline ObjList* BenchPlugin::splitArgs(const String& line, NamedList& params) const
+{
+    const NamedList* sect = Engine::config().getSection(name());
+    if (sect)
+	params.copyParams(*sect);
+    ObjList* words = new ObjList;
+    ObjList* list = line.split(' ',false);
+    for (ObjList* l = list->skipNull(); l; l = l->skipNext()) {
+	const String& word = l->get()->toString();
+	int pos = word.find('=');
+	if (pos > 0)
+	    params.setParam(word.substr(0,pos),word.substr(pos + 1));
+	else
+	    words->append(new String(word));
+    }
+    TelEngine::destruct(list);
+    return words;
+}
+
+inline void BenchPlugin::report(const String& line, const NamedList& params) const
+{
+    Output("%s: %s",m_title.c_str(),line.c_str());
+    const String& path = params[YSTRING("output")];
+    if (path.null())
+	return;
+    File f;
+    if (!f.openPath(path,true,false,true,true)) {
+	Debug(this,DebugWarn,"Could not open results file '%s'",path.c_str());
+	return;
+    }
+    String tmp;
+    tmp << "time=" << Time::secNow() << " " << line << "\n";
+    f.writeData(tmp.c_str(),tmp.length());
+}
+
+}; // anonymous namespace
+
+#endif /* __BENCHMARK_H */
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
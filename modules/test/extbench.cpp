@@ -0,0 +1,625 @@
+/**
+ * extbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * External module protocol throughput benchmark
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "benchmark.h"
+
+#include <string.h>
+
+#ifndef _WINDOWS
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace { // anonymous
+
+// Name of the message handled by the benchmark peer
+#define PING "extbench.ping"
+
+// Maximum time to wait for all answers in msec
+#define BENCH_TIMEOUT 60000
+
+// Messages kept in flight, a new one is enqueued as each finishes
+#define BENCH_WINDOW 500
+
+enum Mode {
+    Text,
+    Binary,
+    Shm
+};
+
+static const TokenDict s_modes[] = {
+    { "text", Text },
+    { "binary", Binary },
+    { "binary+shm", Shm },
+    { 0, 0 }
+};
+
+class ExtBench : public BenchPlugin
+{
+public:
+    ExtBench();
+protected:
+    virtual void check(const String& args, BenchChecks& checks);
+    virtual bool run(const String& args, String& error);
+private:
+    u_int64_t runOnce(const String& path, int mode, unsigned int count);
+};
+
+// Counts the dispatched messages
+class BenchMessage : public Message
+{
+public:
+    BenchMessage(unsigned int index);
+    virtual void dispatched(bool accepted);
+};
+
+// Stands in for an external script, answers every message as handled
+class BenchPeer : public Thread
+{
+public:
+    BenchPeer(int mode);
+    virtual ~BenchPeer();
+    bool connect(const String& path);
+    virtual void run();
+    inline void stop()
+	{ m_stop = true; }
+private:
+    bool sendLine(const String& line);
+    bool readLine(String& line);
+    bool readReply(const char* prefix, String& val);
+    bool writeAll(const void* data, unsigned int len);
+    bool mapShm(const String& path);
+    void processText();
+    void processFrames(unsigned char* data, unsigned int& len, DataBlock& out);
+    void runShm();
+    int m_mode;
+    bool m_binary;
+    volatile bool m_stop;
+    Socket m_socket;
+    DataBlock m_buffer;
+    unsigned int m_used;
+    void* m_map;
+    unsigned int m_mapLen;
+};
+
+INIT_PLUGIN(ExtBench);
+
+static Mutex s_mutex(false,"ExtBench");
+static unsigned int s_dispatched = 0;
+static unsigned int s_handled = 0;
+static unsigned int s_queued = 0;
+static unsigned int s_count = 0;
+
+// Parameters similar to what a call routing script receives
+static const char* s_params[] = {
+    "id", "sip/123", "module", "sip", "caller", "0040212345678", "called", "1234",
+    "callername", "John Doe", "billid", "1500000000-42", "address", "192.168.1.10:5060",
+    "formats", "alaw,mulaw,g729", "rtp_forward", "possible", "osip_User-Agent", "Bench/1.0",
+    0, 0
+};
+
+static inline u_int32_t getInt(const unsigned char* p)
+{
+    return ((u_int32_t)p[0] << 24) | ((u_int32_t)p[1] << 16) | ((u_int32_t)p[2] << 8) | p[3];
+}
+
+static inline unsigned char* putInt(unsigned char* p, u_int32_t val)
+{
+    p[0] = (unsigned char)(val >> 24);
+    p[1] = (unsigned char)(val >> 16);
+    p[2] = (unsigned char)(val >> 8);
+    p[3] = (unsigned char)val;
+    return p + 4;
+}
+
+static inline unsigned char* putString(unsigned char* p, const String& str)
+{
+    p = putInt(p,str.length());
+    ::memcpy(p,str.c_str(),str.length());
+    return p + str.length();
+}
+
+// Decode a string field, advance the pointer
+static bool getString(const unsigned char*& p, unsigned int& len, String& str)
+{
+    if (len < 4)
+	return false;
+    u_int32_t l = getInt(p);
+    if (l > len - 4)
+	return false;
+    str.assign((const char*)p + 4,l);
+    p += 4 + l;
+    len -= 4 + l;
+    return true;
+}
+
+// Build a text frame in the same way the engine does
+static void appendTextFrame(DataBlock& out, const String& line)
+{
+    DataBlock frame(0,line.length() + 5);
+    unsigned char* p = putInt((unsigned char*)frame.data(),line.length() + 1);
+    *p++ = 'T';
+    ::memcpy(p,line.c_str(),line.length());
+    out += frame;
+}
+
+// Decode a message frame as a script library would and append the answer
+static bool answerFrame(const unsigned char* p, unsigned int len, DataBlock& out)
+{
+    if (!len || (*p != 'M'))
+	return false;
+    p++;
+    len--;
+    String id;
+    if (!getString(p,len,id) || (len < 4))
+	return false;
+    p += 4;
+    len -= 4;
+    Message msg("");
+    String tmp;
+    if (!(getString(p,len,tmp) && getString(p,len,msg.retValue())) || (len < 4))
+	return false;
+    msg = tmp;
+    u_int32_t count = getInt(p);
+    p += 4;
+    len -= 4;
+    String val;
+    while (count--) {
+	if (!(getString(p,len,tmp) && getString(p,len,val)))
+	    return false;
+	msg.addParam(tmp,val);
+    }
+    msg.retValue() = "pong";
+    msg.setParam("echo",msg.getValue(YSTRING("index")));
+    const String& name = msg;
+    unsigned int size = 1 + 4 + id.length() + 4 + 4 + name.length() + 4 + msg.retValue().length() + 4;
+    count = 0;
+    for (const ObjList* l = msg.paramList()->skipNull(); l; l = l->skipNext()) {
+	const NamedString* ns = static_cast<const NamedString*>(l->get());
+	size += 8 + ns->name().length() + ns->length();
+	count++;
+    }
+    DataBlock frame(0,size + 4);
+    unsigned char* w = putInt((unsigned char*)frame.data(),size);
+    *w++ = 'A';
+    w = putString(w,id);
+    w = putInt(w,1);
+    w = putString(w,msg);
+    w = putString(w,msg.retValue());
+    w = putInt(w,count);
+    for (const ObjList* l = msg.paramList()->skipNull(); l; l = l->skipNext()) {
+	const NamedString* ns = static_cast<const NamedString*>(l->get());
+	w = putString(w,ns->name());
+	w = putString(w,*ns);
+    }
+    out += frame;
+    return true;
+}
+
+
+BenchMessage::BenchMessage(unsigned int index)
+    : Message(PING)
+{
+    for (const char** p = s_params; *p; p += 2)
+	addParam(p[0],p[1]);
+    addParam("index",String(index));
+}
+
+void BenchMessage::dispatched(bool accepted)
+{
+    s_mutex.lock();
+    s_dispatched++;
+    // the answer must carry back the changes made by the peer
+    if (accepted && (retValue() == YSTRING("pong")) &&
+	    ((*this)[YSTRING("echo")] == (*this)[YSTRING("index")]))
+	s_handled++;
+    unsigned int next = s_queued;
+    bool more = (next < s_count);
+    if (more)
+	s_queued++;
+    s_mutex.unlock();
+    if (more)
+	Engine::enqueue(new BenchMessage(next));
+}
+
+
+BenchPeer::BenchPeer(int mode)
+    : Thread("ExtBench Peer"),
+      m_mode(mode), m_binary(false), m_stop(false),
+      m_buffer(0,65536), m_used(0), m_map(0), m_mapLen(0)
+{
+}
+
+BenchPeer::~BenchPeer()
+{
+#ifndef _WINDOWS
+    if (m_map)
+	::munmap(m_map,m_mapLen);
+#endif
+}
+
+bool BenchPeer::writeAll(const void* data, unsigned int len)
+{
+    const char* p = (const char*)data;
+    while (len) {
+	int w = m_socket.writeData(p,len);
+	if (w < 0 && m_socket.canRetry()) {
+	    Thread::usleep(100);
+	    continue;
+	}
+	if (w <= 0)
+	    return false;
+	p += w;
+	len -= w;
+    }
+    return true;
+}
+
+bool BenchPeer::sendLine(const String& line)
+{
+    if (!m_binary)
+	return writeAll((line + "\n").c_str(),line.length() + 1);
+    DataBlock frame;
+    appendTextFrame(frame,line);
+    return writeAll(frame.data(),frame.length());
+}
+
+// Read one protocol line in the current framing
+bool BenchPeer::readLine(String& line)
+{
+    for (;;) {
+	unsigned char* buf = (unsigned char*)m_buffer.data();
+	if (m_binary) {
+	    if (m_used >= 4) {
+		unsigned int len = getInt(buf);
+		if (m_used >= len + 4) {
+		    if (!len || (buf[4] != 'T'))
+			return false;
+		    line.assign((const char*)buf + 5,len - 1);
+		    m_used -= len + 4;
+		    ::memmove(buf,buf + len + 4,m_used);
+		    return true;
+		}
+	    }
+	}
+	else {
+	    unsigned char* eol = (unsigned char*)::memchr(buf,'\n',m_used);
+	    if (eol) {
+		line.assign((const char*)buf,eol - buf);
+		m_used -= (eol - buf) + 1;
+		::memmove(buf,eol + 1,m_used);
+		return true;
+	    }
+	}
+	if (m_used >= m_buffer.length())
+	    return false;
+	int r = m_socket.readData(buf + m_used,m_buffer.length() - m_used);
+	if (r <= 0)
+	    return false;
+	m_used += r;
+    }
+}
+
+// Wait for the answer to a request, return the value from the answer
+bool BenchPeer::readReply(const char* prefix, String& val)
+{
+    String line;
+    while (readLine(line)) {
+	if (!line.startSkip(prefix,false))
+	    continue;
+	int pos = line.rfind(':');
+	if (pos < 0)
+	    return false;
+	val = line.substr(0,pos);
+	return line.substr(pos + 1).toBoolean();
+    }
+    return false;
+}
+
+bool BenchPeer::mapShm(const String& path)
+{
+#ifdef _WINDOWS
+    return false;
+#else
+    int fd = ::open(path,O_RDWR);
+    if (fd < 0)
+	return false;
+    // each ring has a header of 192 octets with its data size at offset 4
+    u_int32_t hdr[2];
+    bool ok = (::read(fd,hdr,sizeof(hdr)) == (int)sizeof(hdr));
+    if (ok) {
+	m_mapLen = 2 * (192 + hdr[1]);
+	m_map = ::mmap(0,m_mapLen,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	if (m_map == MAP_FAILED) {
+	    m_map = 0;
+	    ok = false;
+	}
+    }
+    ::close(fd);
+    return ok;
+#endif
+}
+
+bool BenchPeer::connect(const String& path)
+{
+    SocketAddr addr;
+    if (!(addr.assign(AF_UNIX) && addr.host(path) &&
+	    m_socket.create(AF_UNIX,SOCK_STREAM) && m_socket.connect(addr))) {
+	Debug("extbench",DebugWarn,"Could not connect to '%s'",path.c_str());
+	return false;
+    }
+    String val;
+    if (!(sendLine("%%>connect:global:extbench") && sendLine("%%>setlocal:async:true") &&
+	    readReply("%%<setlocal:async:",val)))
+	return false;
+    if (m_mode != Text) {
+	if (!(sendLine("%%>setlocal:framing:binary") && readReply("%%<setlocal:framing:",val)))
+	    return false;
+	m_binary = true;
+    }
+    if (!(sendLine("%%>install:100:" PING) && readReply("%%<install:100:",val)))
+	return false;
+    if (m_mode == Shm) {
+	if (!(sendLine("%%>setlocal:transport:shm") && readReply("%%<setlocal:transport:",val)
+		&& mapShm(val))) {
+	    Debug("extbench",DebugWarn,"Could not set up shared memory transport");
+	    return false;
+	}
+    }
+    return true;
+}
+
+// Answer messages received as text lines
+void BenchPeer::processText()
+{
+    String out;
+    char* buf = (char*)m_buffer.data();
+    for (;;) {
+	char* eol = (char*)::memchr(buf,'\n',m_used);
+	if (!eol)
+	    break;
+	*eol = '\0';
+	Message msg("");
+	String id;
+	if (msg.decode(buf,id) == -2) {
+	    msg.retValue() = "pong";
+	    msg.setParam("echo",msg.getValue(YSTRING("index")));
+	    out << msg.encode(true,id) << "\n";
+	}
+	m_used -= (eol - buf) + 1;
+	::memmove(buf,eol + 1,m_used);
+    }
+    if (out)
+	writeAll(out.c_str(),out.length());
+}
+
+// Answer complete frames from a buffer, keep any partial frame
+void BenchPeer::processFrames(unsigned char* data, unsigned int& len, DataBlock& out)
+{
+    unsigned int pos = 0;
+    while (len - pos >= 4) {
+	unsigned int flen = getInt(data + pos);
+	if (len - pos - 4 < flen)
+	    break;
+	answerFrame(data + pos + 4,flen,out);
+	pos += flen + 4;
+    }
+    len -= pos;
+    ::memmove(data,data + pos,len);
+}
+
+// Exchange frames through the shared memory rings
+void BenchPeer::runShm()
+{
+    unsigned char* base = (unsigned char*)m_map;
+    volatile u_int32_t* inHdr = (volatile u_int32_t*)base;
+    unsigned int size = inHdr[1];
+    unsigned char* inData = base + 192;
+    volatile u_int32_t* outHdr = (volatile u_int32_t*)(inData + size);
+    unsigned char* outData = (unsigned char*)outHdr + 192;
+    DataBlock in(0,size);
+    DataBlock out;
+    while (!m_stop) {
+	// head is at offset 64, tail at offset 128
+	u_int32_t head = inHdr[16];
+	u_int32_t tail = inHdr[32];
+	unsigned int avail = head - tail;
+	if (!avail) {
+	    Thread::usleep(100);
+	    continue;
+	}
+	__sync_synchronize();
+	unsigned int pos = tail & (size - 1);
+	unsigned int first = (avail < size - pos) ? avail : size - pos;
+	::memcpy(in.data(),inData + pos,first);
+	if (avail > first)
+	    ::memcpy((unsigned char*)in.data() + first,inData,avail - first);
+	__sync_synchronize();
+	inHdr[32] = tail + avail;
+	// the engine writes only complete frames
+	unsigned int len = avail;
+	out.clear();
+	processFrames((unsigned char*)in.data(),len,out);
+	// answers may not fit at once if the engine is slow to consume them
+	const unsigned char* p = (const unsigned char*)out.data();
+	unsigned int left = out.length();
+	while (left && !m_stop) {
+	    u_int32_t oHead = outHdr[16];
+	    unsigned int room = size - (oHead - outHdr[32]);
+	    // write whole frames only
+	    unsigned int chunk = 0;
+	    while (chunk < left) {
+		unsigned int flen = getInt(p + chunk) + 4;
+		if (chunk + flen > room)
+		    break;
+		chunk += flen;
+	    }
+	    if (!chunk) {
+		Thread::usleep(100);
+		continue;
+	    }
+	    __sync_synchronize();
+	    unsigned int opos = oHead & (size - 1);
+	    unsigned int ofirst = (chunk < size - opos) ? chunk : size - opos;
+	    ::memcpy(outData + opos,p,ofirst);
+	    if (chunk > ofirst)
+		::memcpy(outData,p + ofirst,chunk - ofirst);
+	    __sync_synchronize();
+	    outHdr[16] = oHead + chunk;
+	    p += chunk;
+	    left -= chunk;
+	}
+    }
+}
+
+void BenchPeer::run()
+{
+    if (m_map) {
+	runShm();
+	return;
+    }
+    m_socket.setBlocking(false);
+    DataBlock out;
+    while (!m_stop) {
+	int r = m_socket.readData((char*)m_buffer.data() + m_used,m_buffer.length() - m_used);
+	if (r <= 0) {
+	    if ((r < 0) && m_socket.canRetry()) {
+		Thread::usleep(100);
+		continue;
+	    }
+	    break;
+	}
+	m_used += r;
+	if (m_binary) {
+	    out.clear();
+	    processFrames((unsigned char*)m_buffer.data(),m_used,out);
+	    if (out.length())
+		writeAll(out.data(),out.length());
+	}
+	else
+	    processText();
+    }
+}
+
+
+
+ExtBench::ExtBench()
+    : BenchPlugin("extbench","ExtBench")
+{
+}
+
+// Dispatch messages answered by a peer in the given mode, return usec
+u_int64_t ExtBench::runOnce(const String& path, int mode, unsigned int count)
+{
+    BenchPeer* peer = new BenchPeer(mode);
+    if (!peer->connect(path)) {
+	delete peer;
+	return 0;
+    }
+    s_mutex.lock();
+    s_dispatched = s_handled = 0;
+    s_count = count;
+    s_queued = (count < BENCH_WINDOW) ? count : BENCH_WINDOW;
+    unsigned int first = s_queued;
+    s_mutex.unlock();
+    if (!peer->startup())
+	return 0;
+    u_int64_t start = Time::now();
+    for (unsigned int i = 0; i < first; i++)
+	Engine::enqueue(new BenchMessage(i));
+    u_int64_t limit = start + 1000 * (u_int64_t)BENCH_TIMEOUT;
+    unsigned int done = 0;
+    unsigned int handled = 0;
+    while (Time::now() < limit) {
+	s_mutex.lock();
+	done = s_dispatched;
+	handled = s_handled;
+	s_mutex.unlock();
+	if (done >= count)
+	    break;
+	Thread::msleep(1);
+    }
+    u_int64_t elapsed = Time::now() - start;
+    s_mutex.lock();
+    s_count = 0;
+    s_mutex.unlock();
+    peer->stop();
+    // let the engine release the connection before the next run
+    Thread::msleep(100);
+    if (handled < count) {
+	Debug("extbench",DebugWarn,"Mode %s: only %u of %u messages were handled (%u dispatched)",
+	    lookup(mode,s_modes),handled,count,done);
+	return 0;
+    }
+    return elapsed ? elapsed : 1;
+}
+
+// extbench [socket] [count], the socket defaults to the one in yate.conf
+static bool parseArgs(const String& args, String& path, int& count)
+{
+    String line(args);
+    line.trimBlanks();
+    int pos = line.find(' ');
+    path = (pos > 0) ? line.substr(0,pos) : line;
+    if (pos > 0)
+	count = line.substr(pos + 1).toInteger(count);
+    if (count < 1)
+	count = 1;
+    if (path.null())
+	path = Engine::config().getValue("extbench","socket");
+    return !path.null();
+}
+
+// Every transport must return all answers with the changes made by the peer
+void ExtBench::check(const String& args, BenchChecks& checks)
+{
+    String path;
+    int count = 0;
+    if (!parseArgs(args,path,count))
+	return;
+    for (const TokenDict* m = s_modes; m->token; m++)
+	checks.check(runOnce(path,m->value,BENCH_WINDOW) != 0,"mode %s lost or changed answers",m->token);
+}
+
+bool ExtBench::run(const String& args, String& error)
+{
+    String path;
+    int count = 20000;
+    if (!parseArgs(args,path,count)) {
+	error = "no socket to connect to";
+	return false;
+    }
+    for (const TokenDict* m = s_modes; m->token; m++) {
+	u_int64_t usec = runOnce(path,m->value,count);
+	if (!usec) {
+	    error << "mode " << m->token << " failed";
+	    return false;
+	}
+	Output("ExtBench: %s x %u messages: " FMT64U " usec, %.0f msg/s",
+	    m->token,count,usec,1000000.0 * count / usec);
+    }
+    return true;
+}
+
+}; // anonymous namespace
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
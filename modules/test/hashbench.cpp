@@ -0,0 +1,186 @@
+/**
+ * hashbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * MD5, SHA1 and SHA256 throughput benchmark
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "benchmark.h"
+
+#include <string.h>
+
+namespace { // anonymous
+
+class HashBench : public BenchPlugin
+{
+public:
+    HashBench();
+protected:
+    virtual void check(const String& args, BenchChecks& checks);
+    virtual bool run(const String& args, String& error);
+};
+
+INIT_PLUGIN(HashBench);
+
+// Message sizes: SIP digest strings, SRTP packets, full MTU, bulk data
+static const unsigned int s_sizes[] = { 64, 180, 1500, 16384, 0 };
+
+// Number of small messages hashed by one multi-buffer call
+#define MANY_COUNT 256
+
+// Hash len octets per message until total octets are processed, return usec
+template <class H> static u_int64_t hashSingle(const unsigned char* data,
+    unsigned int len, u_int64_t total)
+{
+    u_int64_t start = Time::now();
+    for (u_int64_t done = 0; done < total; done += len) {
+	H h(data,len);
+	h.rawDigest();
+    }
+    return Time::now() - start;
+}
+
+// Hash the same total in batches of MANY_COUNT messages, return usec
+template <class H> static u_int64_t hashMany(const unsigned char* data,
+    unsigned int len, u_int64_t total)
+{
+    const void* bufs[MANY_COUNT];
+    unsigned int lens[MANY_COUNT];
+    unsigned char out[MANY_COUNT * 32];
+    for (unsigned int i = 0; i < MANY_COUNT; i++) {
+	bufs[i] = data + (i & 63);
+	lens[i] = len;
+    }
+    u_int64_t batch = (u_int64_t)len * MANY_COUNT;
+    u_int64_t start = Time::now();
+    for (u_int64_t done = 0; done < total; done += batch)
+	H::digestMany(out,bufs,lens,MANY_COUNT);
+    return Time::now() - start;
+}
+
+static inline double rate(u_int64_t total, u_int64_t usec)
+{
+    return usec ? (double)total / usec : 0.0;
+}
+
+template <class H> static void benchOne(const char* name, const unsigned char* data,
+    u_int64_t total)
+{
+    unsigned int accel = Hasher::accelerated();
+    for (const unsigned int* s = s_sizes; *s; s++) {
+	Hasher::setAccelerated(false);
+	u_int64_t portable = hashSingle<H>(data,*s,total);
+	Hasher::setAccelerated(true);
+	u_int64_t fast = hashSingle<H>(data,*s,total);
+	u_int64_t many = 0;
+	if (*s <= 1500)
+	    many = hashMany<H>(data,*s,total);
+	String tmp;
+	if (many)
+	    tmp.printf(", multi-buffer %.1f MB/s",rate(total,many));
+	Output("HashBench: %s %u bytes: portable %.1f MB/s, accelerated (0x%x) %.1f MB/s%s",
+	    name,*s,rate(total,portable),accel,rate(total,fast),tmp.safe());
+    }
+}
+
+// Compare the accelerated single and multi-buffer digests with the portable ones
+template <class H> static void checkOne(const char* name, const char* abc,
+    const unsigned char* data, BenchChecks& checks)
+{
+    static const unsigned int s_lens[] = { 1, 55, 56, 63, 64, 65, 119, 180, 1500, 16384, 0 };
+    unsigned int len = H::rawLength();
+    Hasher::setAccelerated(false);
+    H known("abc",3);
+    checks.check(known.hexDigest() == abc,"%s of 'abc' is %s",name,known.hexDigest().c_str());
+    for (const unsigned int* l = s_lens; *l; l++) {
+	const void* bufs[MANY_COUNT];
+	unsigned int lens[MANY_COUNT];
+	DataBlock portable(0,MANY_COUNT * len);
+	unsigned char* p = (unsigned char*)portable.data();
+	Hasher::setAccelerated(false);
+	for (unsigned int i = 0; i < MANY_COUNT; i++) {
+	    bufs[i] = data + (i & 63);
+	    lens[i] = *l;
+	    H h(bufs[i],*l);
+	    ::memcpy(p + i * len,h.rawDigest(),len);
+	}
+	Hasher::setAccelerated(true);
+	bool ok = true;
+	for (unsigned int i = 0; ok && i < MANY_COUNT; i++) {
+	    H h(bufs[i],*l);
+	    ok = !::memcmp(p + i * len,h.rawDigest(),len);
+	}
+	checks.check(ok,"%s of %u bytes: accelerated and portable digests differ",name,*l);
+	if (*l > 1500)
+	    continue;
+	DataBlock many(0,MANY_COUNT * len);
+	ok = H::digestMany((unsigned char*)many.data(),bufs,lens,MANY_COUNT);
+	checks.check(ok && !::memcmp(many.data(),portable.data(),portable.length()),
+	    "%s of %u bytes: multi-buffer and portable digests differ",name,*l);
+    }
+}
+
+// Fill a buffer large enough for all sizes plus the multi-buffer offsets
+static const unsigned char* fillData(DataBlock& buf)
+{
+    buf.assign(0,16384 + 64);
+    unsigned char* data = (unsigned char*)buf.data();
+    for (unsigned int i = 0; i < buf.length(); i++)
+	data[i] = (unsigned char)(i * 13 + 7);
+    return data;
+}
+
+
+HashBench::HashBench()
+    : BenchPlugin("hashbench","HashBench")
+{
+}
+
+void HashBench::check(const String& args, BenchChecks& checks)
+{
+    unsigned int accel = Hasher::accelerated();
+    DataBlock buf;
+    const unsigned char* data = fillData(buf);
+    checkOne<MD5>("MD5","900150983cd24fb0d6963f7d28e17f72",data,checks);
+    checkOne<SHA1>("SHA1","a9993e364706816aba3e25717850c26c9cd0d89d",data,checks);
+    checkOne<SHA256>("SHA256","ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",data,checks);
+    Hasher::setAccelerated(accel != 0);
+}
+
+// hashbench [megabytes]
+bool HashBench::run(const String& args, String& error)
+{
+    int megs = 64;
+    String line(args);
+    line >> megs;
+    if (megs < 1)
+	megs = 1;
+    unsigned int accel = Hasher::accelerated();
+    Hasher::setAccelerated(true);
+    DataBlock buf;
+    const unsigned char* data = fillData(buf);
+    u_int64_t total = (u_int64_t)megs << 20;
+    benchOne<MD5>("MD5",data,total);
+    benchOne<SHA1>("SHA1",data,total);
+    benchOne<SHA256>("SHA256",data,total);
+    Hasher::setAccelerated(accel != 0);
+    return true;
+}
+
+}; // anonymous namespace
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
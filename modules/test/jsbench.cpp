@@ -0,0 +1,248 @@
+/**
+ * jsbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Javascript evaluator benchmark
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "benchmark.h"
+#include <yatescript.h>
+
+namespace { // anonymous
+
+class JsBench : public BenchPlugin
+{
+public:
+    JsBench();
+protected:
+    virtual void check(const String& args, BenchChecks& checks);
+    virtual bool run(const String& args, String& error);
+private:
+    u_int64_t runOnce(const char* source, unsigned int loops, bool bytecode, String& result);
+};
+
+INIT_PLUGIN(JsBench);
+
+struct BenchScript {
+    const char* name;
+    const char* source;
+};
+
+// Each script defines a test(n) function and stores its result in global 'result'
+static const BenchScript s_scripts[] = {
+    { "routing",
+	"function test(n) {\n"
+	"  var hits = 0;\n"
+	"  for (var i = 0; i < n; i++) {\n"
+	"    var called = \"0040\" + (212345000 + i % 1000);\n"
+	"    var prefix = called.substr(0,4);\n"
+	"    if (prefix == \"0040\" && called.length == 13)\n"
+	"      hits = hits + called.substr(4,3).length;\n"
+	"    var target = \"sip/sip:\" + called + \"@gw\" + (i % 4) + \".example.com\";\n"
+	"    if (target.indexOf(\"gw2\") >= 0)\n"
+	"      hits++;\n"
+	"  }\n"
+	"  return hits;\n"
+	"}\n"
+	"result = test(loops);\n"
+    },
+    { "loops",
+	"function test(n) {\n"
+	"  var sum = 0;\n"
+	"  for (var i = 0; i < n; i++) {\n"
+	"    for (var j = 0; j < 10; j++) {\n"
+	"      if ((i + j) % 3 == 0 && j != 5)\n"
+	"        sum = sum + (i * j & 255) - (j << 2);\n"
+	"      else\n"
+	"        sum = sum - 1;\n"
+	"    }\n"
+	"  }\n"
+	"  var k = 0;\n"
+	"  while (k < n) {\n"
+	"    k++;\n"
+	"    if (k % 7 == 0)\n"
+	"      continue;\n"
+	"    sum = sum + k / 3;\n"
+	"  }\n"
+	"  return sum;\n"
+	"}\n"
+	"result = test(loops);\n"
+    },
+    { "fields",
+	"function test(n) {\n"
+	"  var obj = { calls: 0, answered: 0, trunk: { id: 7, weight: 3 } };\n"
+	"  var arr = [ 1, 2, 3, 4, 5, 6, 7, 8 ];\n"
+	"  for (var i = 0; i < n; i++) {\n"
+	"    obj.calls = obj.calls + 1;\n"
+	"    if (obj.trunk.weight * 2 > i % 10)\n"
+	"      obj.answered = obj.answered + arr[i % 8];\n"
+	"    obj.last = obj.trunk.id + i;\n"
+	"  }\n"
+	"  return obj.calls + obj.answered + obj.last;\n"
+	"}\n"
+	"result = test(loops);\n"
+    },
+    { "message",
+	"function build() {\n"
+	"  var msg = { called: \"0040212345678\", caller: \"1234\", billid: \"1-2\" };\n"
+	"  for (var i = 0; i < 80; i++)\n"
+	"    msg[\"osip_X-Header-\" + i] = \"value \" + i;\n"
+	"  msg.line = \"trunk1\";\n"
+	"  msg.reason = \"\";\n"
+	"  return msg;\n"
+	"}\n"
+	"function test(n) {\n"
+	"  var msg = build();\n"
+	"  var found = 0;\n"
+	"  for (var i = 0; i < n; i++) {\n"
+	"    if (msg.line == \"trunk1\" && msg.called.length > 10)\n"
+	"      found++;\n"
+	"    if (msg.reason == \"\")\n"
+	"      msg.billid = msg.caller + \"-\" + i;\n"
+	"    found = found + msg[\"osip_X-Header-\" + (i % 80)].length;\n"
+	"  }\n"
+	"  return found + msg.billid;\n"
+	"}\n"
+	"result = test(loops);\n"
+    },
+    { 0, 0 }
+};
+
+struct CheckScript {
+    const char* name;
+    const char* source;
+    const char* expected;
+};
+
+// Semantics checks, bytecode and interpreter must store the expected 'result'
+// Operands are read from variables so the optimizer can't fold them
+static const CheckScript s_checks[] = {
+    { "nan",
+	"var x = \"x\"; var n = 5; var r = \"\";\n"
+	"r = r + \"a\" + (n * x) + \";\";\n"
+	"r = r + (n * x) + \"b;\";\n"
+	"r = r + (-(n * x) + 1) + \";\";\n"
+	"if ((n * x)) r = r + \"true;\";\n"
+	"if (!(n * x)) r = r + \"false;\";\n"
+	"r = r + ((n * x) && true) + ((n * x) || false) + \";\";\n"
+	"r = r + ((n * x) < 1) + ((n * x) >= 0) + \";\";\n"
+	"result = r;\n",
+	"aNaN;NaNb;NaN;true;truetrue;truetrue;"
+    },
+    { "concat",
+	"var n = 5; var s = \"s\"; var r = \"\";\n"
+	"r = r + (n - 2) + (n > 1) + \";\";\n"
+	"r = r + s + (n * 2) + (n < 1) + \";\";\n"
+	"r = r + ((n + 1) + s) + (s + (n + 1)) + \";\";\n"
+	"result = r;\n",
+	"3true;s10false;6ss6;"
+    },
+    { "equality",
+	"var x = \"x\"; var n = 5; var t = \"true\"; var f = \"5\"; var r = \"\";\n"
+	"if ((n * x) == \"NaN\") r = r + \"a\";\n"
+	"if ((n * x) != \"NaN\") r = r + \"b\";\n"
+	"if ((n * x) == (n * x)) r = r + \"c\";\n"
+	"if ((n > 1) == t) r = r + \"d\";\n"
+	"if ((n > 1) == 1) r = r + \"e\";\n"
+	"if ((n + 0) == f) r = r + \"f\";\n"
+	"if (f == (n + 0)) r = r + \"g\";\n"
+	"if ((n + 0) != f) r = r + \"h\";\n"
+	"if ((n > 1) == (n != 0)) r = r + \"i\";\n"
+	"if ((n - 5) == (n < 0)) r = r + \"j\";\n"
+	"result = r;\n",
+	"acdfgi"
+    },
+    { 0, 0, 0 }
+};
+
+
+JsBench::JsBench()
+    : BenchPlugin("jsbench","JsBench")
+{
+}
+
+// Run one script, return execution time in usec, 0 on failure
+u_int64_t JsBench::runOnce(const char* source, unsigned int loops, bool bytecode, String& result)
+{
+    JsParser parser;
+    parser.bytecode(bytecode);
+    if (!parser.parse(source))
+	return 0;
+    ScriptContext* ctx = parser.createContext();
+    ctx->params().setParam(new ExpOperation((int64_t)loops,"loops"));
+    ScriptRun* runner = parser.createRunner(ctx);
+    u_int64_t start = Time::now();
+    ScriptRun::Status st = runner->run();
+    u_int64_t elapsed = Time::now() - start;
+    result = ctx->params()["result"];
+    TelEngine::destruct(runner);
+    TelEngine::destruct(ctx);
+    if (st != ScriptRun::Succeeded)
+	return 0;
+    return elapsed ? elapsed : 1;
+}
+
+// Bytecode and interpreter must store the same result for every script
+void JsBench::check(const String& args, BenchChecks& checks)
+{
+    for (const CheckScript* c = s_checks; c->name; c++) {
+	String res1;
+	String res2;
+	if (!checks.check(runOnce(c->source,1,false,res1) && runOnce(c->source,1,true,res2),
+		"script '%s' failed to run",c->name))
+	    continue;
+	checks.check(res1 == c->expected && res2 == c->expected,
+	    "script '%s' expected '%s', generic '%s', bytecode '%s'",
+	    c->name,c->expected,res1.c_str(),res2.c_str());
+    }
+    for (const BenchScript* s = s_scripts; s->name; s++) {
+	String res1;
+	String res2;
+	if (!checks.check(runOnce(s->source,100,false,res1) && runOnce(s->source,100,true,res2),
+		"script '%s' failed to run",s->name))
+	    continue;
+	checks.check(res1 == res2,"script '%s' results differ: generic '%s', bytecode '%s'",
+	    s->name,res1.c_str(),res2.c_str());
+    }
+}
+
+// jsbench [loops]
+bool JsBench::run(const String& args, String& error)
+{
+    int loops = 20000;
+    String line(args);
+    line >> loops;
+    if (loops < 1)
+	loops = 1;
+    for (const BenchScript* s = s_scripts; s->name; s++) {
+	String res1;
+	String res2;
+	u_int64_t generic = runOnce(s->source,loops,false,res1);
+	u_int64_t bytecode = runOnce(s->source,loops,true,res2);
+	if (!(generic && bytecode)) {
+	    error << "script '" << s->name << "' failed to run";
+	    return false;
+	}
+	Output("JsBench: %s x %u loops: generic " FMT64U " usec, bytecode " FMT64U " usec, speedup %.2f",
+	    s->name,loops,generic,bytecode,(double)generic / (double)bytecode);
+    }
+    return true;
+}
+
+}; // anonymous namespace
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
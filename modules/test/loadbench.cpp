@@ -0,0 +1,576 @@
+/**
+ * loadbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Message dispatch, routing and call throughput load generator
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "benchmark.h"
+#include <yatephone.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WINDOWS
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+namespace { // anonymous
+
+class LoadBench : public BenchPlugin
+{
+public:
+    LoadBench();
+    virtual bool startup(const NamedList& sect);
+protected:
+    virtual void check(const String& args, BenchChecks& checks);
+    virtual bool run(const String& args, String& error);
+private:
+    void checkWorkload(const String& workload, const NamedList& params, BenchChecks& checks);
+    bool runWorkload(const String& workload, const NamedList& params);
+    bool runCalls(const NamedList& params, String& line);
+};
+
+// Operation repeated by the worker threads, must be thread safe
+class Workload : public GenObject
+{
+public:
+    inline Workload(const char* name)
+	: m_name(name)
+	{ }
+    virtual const String& toString() const
+	{ return m_name; }
+    virtual bool once(unsigned int index) = 0;
+    virtual void describe(String& line) const
+	{ }
+private:
+    String m_name;
+};
+
+// One of many handlers of the message storm
+class StormHandler : public MessageHandler
+{
+public:
+    inline StormHandler(unsigned int priority, bool last)
+	: MessageHandler("loadbench.storm",priority,"loadbench"),
+	  m_last(last)
+	{ }
+    virtual bool received(Message& msg)
+	{ return m_last && msg.getIntValue(YSTRING("index"),-1) >= 0; }
+private:
+    bool m_last;
+};
+
+// Dispatch a private message through a chain of handlers
+class StormWork : public Workload
+{
+public:
+    StormWork(unsigned int handlers);
+    virtual ~StormWork();
+    virtual bool once(unsigned int index);
+    virtual void describe(String& line) const
+	{ line << " handlers=" << m_handlers.count(); }
+private:
+    ObjList m_handlers;
+};
+
+// Route calls through the installed routing modules
+class RouteWork : public Workload
+{
+public:
+    inline RouteWork(const NamedList& params)
+	: Workload("route"),
+	  m_caller(params.getValue(YSTRING("caller"),"loadbench")),
+	  m_called(params.getValue(YSTRING("called"))),
+	  m_range(params.getIntValue(YSTRING("range"),1000,1)),
+	  m_base(params.getIntValue(YSTRING("base"),0,0))
+	{ }
+    virtual bool once(unsigned int index);
+    virtual void describe(String& line) const
+	{ line << " called=" << m_called << " range=" << m_range; }
+    bool route(unsigned int index, String& target);
+private:
+    String m_caller;
+    String m_called;
+    unsigned int m_range;
+    unsigned int m_base;
+};
+
+// State shared by the threads running one workload, outlives all of them
+class BenchRun : public RefObject, public Mutex
+{
+public:
+    BenchRun(Workload& work, unsigned int ops, unsigned int threads);
+    virtual ~BenchRun();
+    void work(unsigned int first);
+    void wait();
+    unsigned int collect();
+    Workload& m_work;
+    u_int64_t* m_samples;
+    unsigned int* m_done;
+    unsigned int m_ops;
+    unsigned int m_threads;
+    unsigned int m_running;
+    unsigned int m_failed;
+    Semaphore m_finished;
+};
+
+class BenchWorker : public Thread
+{
+public:
+    inline BenchWorker(BenchRun* run, unsigned int first)
+	: Thread("LoadBench Worker"),
+	  m_run(run), m_first(first)
+	{ m_run->ref(); }
+    virtual ~BenchWorker()
+	{ TelEngine::destruct(m_run); }
+    virtual void run();
+private:
+    BenchRun* m_run;
+    unsigned int m_first;
+};
+
+// Counts the media received by the calls
+class CountConsumer : public DataConsumer
+{
+public:
+    virtual unsigned long Consume(const DataBlock& data, unsigned long tStamp, unsigned long flags);
+};
+
+// Calling side of a generated call
+class BenchCall : public CallEndpoint
+{
+public:
+    inline BenchCall(unsigned int index)
+	: CallEndpoint("loadbench/" + String(index)),
+	  m_finish(0)
+	{ }
+    u_int64_t m_finish;
+};
+
+INIT_PLUGIN(LoadBench);
+
+static const char* s_workloads = "dispatch,route,calls";
+static Mutex s_mediaMutex(false,"LoadBenchMedia");
+static u_int64_t s_mediaBytes = 0;
+
+// Process CPU time (user + system) in usec
+static u_int64_t cpuTime()
+{
+#ifdef _WINDOWS
+    return 0;
+#else
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF,&usage))
+	return 0;
+    return (u_int64_t)usage.ru_utime.tv_sec * 1000000 + usage.ru_utime.tv_usec +
+	(u_int64_t)usage.ru_stime.tv_sec * 1000000 + usage.ru_stime.tv_usec;
+#endif
+}
+
+static int sampleCompare(const void* a, const void* b)
+{
+    u_int64_t va = *static_cast<const u_int64_t*>(a);
+    u_int64_t vb = *static_cast<const u_int64_t*>(b);
+    return (va < vb) ? -1 : ((va > vb) ? 1 : 0);
+}
+
+// Sort latency samples and append percentiles to a report line
+static void percentiles(String& line, const char* prefix, u_int64_t* samples, unsigned int n)
+{
+    if (!n) {
+	line << " " << prefix << "p50_usec=0 " << prefix << "p90_usec=0 " <<
+	    prefix << "p99_usec=0 " << prefix << "max_usec=0";
+	return;
+    }
+    ::qsort(samples,n,sizeof(u_int64_t),sampleCompare);
+    static const unsigned int pct[] = { 50, 90, 99, 0 };
+    for (const unsigned int* p = pct; *p; p++)
+	line << " " << prefix << "p" << *p << "_usec=" << samples[((n - 1) * *p) / 100];
+    line << " " << prefix << "max_usec=" << samples[n - 1];
+}
+
+static inline double perSecond(unsigned int ops, u_int64_t usec)
+{
+    return usec ? (1000000.0 * ops) / usec : 0.0;
+}
+
+
+StormWork::StormWork(unsigned int handlers)
+    : Workload("dispatch")
+{
+    for (unsigned int i = 1; i <= handlers; i++) {
+	StormHandler* h = new StormHandler(i * 10,(i == handlers));
+	m_handlers.append(h);
+	Engine::install(h);
+    }
+}
+
+StormWork::~StormWork()
+{
+    for (ObjList* l = m_handlers.skipNull(); l; l = l->skipNext())
+	Engine::uninstall(static_cast<MessageHandler*>(l->get()));
+}
+
+bool StormWork::once(unsigned int index)
+{
+    Message m("loadbench.storm");
+    m.addParam("index",String(index));
+    m.addParam("module","loadbench");
+    return Engine::dispatch(m);
+}
+
+bool RouteWork::once(unsigned int index)
+{
+    String target;
+    return route(index,target);
+}
+
+bool RouteWork::route(unsigned int index, String& target)
+{
+    Message m("call.route");
+    m.addParam("module","loadbench");
+    m.addParam("id","loadbench/" + String(index));
+    m.addParam("caller",m_caller);
+    String called(m_called);
+    called << (m_base + (index % m_range));
+    m.addParam("called",called);
+    if (!Engine::dispatch(m))
+	return false;
+    target = m.retValue();
+    return !target.null();
+}
+
+
+BenchRun::BenchRun(Workload& work, unsigned int ops, unsigned int threads)
+    : Mutex(false,"LoadBenchRun"),
+      m_work(work), m_samples(new u_int64_t[ops]), m_done(new unsigned int[threads]),
+      m_ops(ops), m_threads(threads), m_running(threads), m_failed(0),
+      m_finished(threads,"LoadBenchDone",0)
+{
+    ::memset(m_samples,0,ops * sizeof(u_int64_t));
+    ::memset(m_done,0,threads * sizeof(unsigned int));
+}
+
+BenchRun::~BenchRun()
+{
+    delete[] m_samples;
+    delete[] m_done;
+}
+
+// Run every m_threads operation starting at first
+void BenchRun::work(unsigned int first)
+{
+    unsigned int failed = 0;
+    unsigned int done = 0;
+    for (unsigned int i = first; i < m_ops; i += m_threads) {
+	if (Engine::exiting()) {
+	    failed += (m_ops - i + m_threads - 1) / m_threads;
+	    break;
+	}
+	u_int64_t t = Time::now();
+	if (!m_work.once(i))
+	    failed++;
+	m_samples[i] = Time::now() - t;
+	done++;
+    }
+    lock();
+    m_done[first] = done;
+    m_failed += failed;
+    m_running--;
+    unlock();
+    m_finished.unlock();
+}
+
+void BenchRun::wait()
+{
+    lock();
+    while (m_running) {
+	unlock();
+	m_finished.lock(100000);
+	lock();
+    }
+    unlock();
+}
+
+// Move the samples of completed operations to the start of the array
+// Return how many operations were timed, threads that stopped early or did
+//  not start leave their remaining slots unused
+unsigned int BenchRun::collect()
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < m_ops; i++) {
+	if ((i / m_threads) < m_done[i % m_threads])
+	    m_samples[n++] = m_samples[i];
+    }
+    return n;
+}
+
+void BenchWorker::run()
+{
+    m_run->work(m_first);
+}
+
+
+unsigned long CountConsumer::Consume(const DataBlock& data, unsigned long tStamp, unsigned long flags)
+{
+    Lock mylock(s_mediaMutex);
+    s_mediaBytes += data.length();
+    return invalidStamp();
+}
+
+
+LoadBench::LoadBench()
+    : BenchPlugin("loadbench","LoadBench")
+{
+}
+
+// The run key holds a list of workloads, each with optional parameters
+//  prefixed by its name that override the common ones
+bool LoadBench::startup(const NamedList& sect)
+{
+    bool ok = true;
+    ObjList* list = String(sect.getValue("run")).split(',',false);
+    for (ObjList* l = list->skipNull(); l && !Engine::exiting(); l = l->skipNext()) {
+	String name = l->get()->toString();
+	NamedList params(sect);
+	params.copySubParams(sect,name.trimBlanks() + ".",true,true);
+	BenchChecks checks(this);
+	checkWorkload(name,params,checks);
+	Output("%s: workload=%s %u checks, %u failed",title().c_str(),name.c_str(),
+	    checks.checks(),checks.failed());
+	if (checks.failed()) {
+	    Debug(this,DebugWarn,"%u of %u checks failed, workload '%s' not run",
+		checks.failed(),checks.checks(),name.c_str());
+	    ok = false;
+	}
+	else if (!runWorkload(name,params))
+	    ok = false;
+    }
+    TelEngine::destruct(list);
+    return ok;
+}
+
+void LoadBench::check(const String& args, BenchChecks& checks)
+{
+    NamedList params(name());
+    ObjList* words = splitArgs(args,params);
+    if (words->get())
+	checkWorkload(words->get()->toString(),params,checks);
+    TelEngine::destruct(words);
+}
+
+// One operation must succeed before many are timed, routing must find the
+//  same target with linear and indexed parameter lookups
+void LoadBench::checkWorkload(const String& workload, const NamedList& params, BenchChecks& checks)
+{
+    if (workload == YSTRING("dispatch")) {
+	StormWork work(params.getIntValue(YSTRING("handlers"),10,1,1000));
+	checks.check(work.once(0),"dispatched message was not handled");
+    }
+    else if (workload == YSTRING("route")) {
+	RouteWork work(params);
+	unsigned int thres = NamedList::indexThreshold();
+	String linear;
+	String indexed;
+	NamedList::indexThreshold(0);
+	bool ok = work.route(0,linear);
+	NamedList::indexThreshold(thres ? thres : 16);
+	ok = work.route(0,indexed) && ok;
+	NamedList::indexThreshold(thres);
+	if (checks.check(ok,"call was not routed"))
+	    checks.check(linear == indexed,"route '%s' with linear lookups, '%s' with indexed",
+		linear.c_str(),indexed.c_str());
+    }
+}
+
+// loadbench workload [param=value...]
+bool LoadBench::run(const String& args, String& error)
+{
+    NamedList params(name());
+    ObjList* words = splitArgs(args,params);
+    String workload = words->get() ? words->get()->toString() : String::empty();
+    TelEngine::destruct(words);
+    if (workload.null()) {
+	error << "no workload, use one of " << s_workloads;
+	return false;
+    }
+    if (runWorkload(workload,params))
+	return true;
+    error << "workload '" << workload << "' failed";
+    return false;
+}
+
+// Run a workload, report results on a single machine readable line
+bool LoadBench::runWorkload(const String& workload, const NamedList& params)
+{
+    String line("workload=");
+    line << workload;
+    if (workload == YSTRING("calls")) {
+	if (!runCalls(params,line))
+	    return false;
+	report(line,params);
+	return true;
+    }
+    unsigned int ops = params.getIntValue(YSTRING("count"),100000,1);
+    unsigned int threads = params.getIntValue(YSTRING("threads"),1,1,64);
+    if (threads > ops)
+	threads = ops;
+    Workload* work = 0;
+    if (workload == YSTRING("dispatch"))
+	work = new StormWork(params.getIntValue(YSTRING("handlers"),10,1,1000));
+    else if (workload == YSTRING("route"))
+	work = new RouteWork(params);
+    else {
+	Debug(this,DebugWarn,"Unknown workload '%s', known: %s",workload.c_str(),s_workloads);
+	return false;
+    }
+    BenchRun* run = new BenchRun(*work,ops,threads);
+    u_int64_t cpu = cpuTime();
+    u_int64_t start = Time::now();
+    for (unsigned int i = 1; i < threads; i++) {
+	BenchWorker* w = new BenchWorker(run,i);
+	if (!w->startup()) {
+	    // its share of operations is done by nobody, count them as failed
+	    delete w;
+	    run->lock();
+	    run->m_failed += (ops - i + threads - 1) / threads;
+	    run->m_running--;
+	    run->unlock();
+	}
+    }
+    run->work(0);
+    run->wait();
+    u_int64_t elapsed = Time::now() - start;
+    cpu = cpuTime() - cpu;
+    line << " ops=" << ops << " threads=" << threads;
+    work->describe(line);
+    line << " ok=" << (ops - run->m_failed) << " failed=" << run->m_failed;
+    line << " elapsed_usec=" << elapsed;
+    String tmp;
+    tmp.printf(" rate=%.1f cpu_usec_per_op=%.2f",perSecond(ops,elapsed),(double)cpu / ops);
+    line << tmp;
+    percentiles(line,"",run->m_samples,run->collect());
+    TelEngine::destruct(run);
+    TelEngine::destruct(work);
+    report(line,params);
+    return true;
+}
+
+// Set up calls at a target rate, hold them with media flowing, then tear them down
+bool LoadBench::runCalls(const NamedList& params, String& line)
+{
+    unsigned int count = params.getIntValue(YSTRING("count"),100,1);
+    unsigned int caps = params.getIntValue(YSTRING("caps"),10,1,100000);
+    unsigned int duration = params.getIntValue(YSTRING("duration"),1000,0);
+    const String& callto = params[YSTRING("callto")].null() ? String("dumb/") : params[YSTRING("callto")];
+    String source = params.getValue(YSTRING("media"),"tone/dial");
+    if (source == YSTRING("none"))
+	source.clear();
+    u_int64_t* setup = new u_int64_t[count];
+    u_int64_t* teardown = new u_int64_t[count];
+    unsigned int started = 0;
+    unsigned int ok = 0;
+    unsigned int dropped = 0;
+    unsigned int peak = 0;
+    ObjList active;
+    s_mediaMutex.lock();
+    s_mediaBytes = 0;
+    s_mediaMutex.unlock();
+    u_int64_t cpu = cpuTime();
+    u_int64_t start = Time::now();
+    u_int64_t lastStart = start;
+    while (((started < count) || active.skipNull()) && !Engine::exiting()) {
+	u_int64_t now = Time::now();
+	while ((started < count) && (now >= start + ((u_int64_t)started * 1000000) / caps)) {
+	    BenchCall* call = new BenchCall(++started);
+	    lastStart = Time::now();
+	    Message m("call.execute");
+	    m.addParam("module","loadbench");
+	    m.addParam("id",call->id());
+	    m.addParam("callto",callto);
+	    m.addParam("caller",params.getValue(YSTRING("caller"),"loadbench"));
+	    m.addParam("called",params.getValue(YSTRING("called"),"bench"));
+	    m.userData(call);
+	    if (!Engine::dispatch(m)) {
+		TelEngine::destruct(call);
+		now = Time::now();
+		continue;
+	    }
+	    setup[ok++] = Time::now() - lastStart;
+	    if (source) {
+		RefPointer<CallEndpoint> peer = call->getPeer();
+		if (peer) {
+		    Message a("chan.attach");
+		    a.addParam("source",source);
+		    a.addParam("single",String::boolText(true));
+		    a.userData(peer);
+		    Engine::dispatch(a);
+		}
+		CountConsumer* cons = new CountConsumer;
+		call->setConsumer(cons);
+		cons->deref();
+	    }
+	    call->m_finish = Time::now() + (u_int64_t)duration * 1000;
+	    active.append(call);
+	    if (active.count() > peak)
+		peak = active.count();
+	    now = Time::now();
+	}
+	for (ObjList* l = active.skipNull(); l; ) {
+	    BenchCall* call = static_cast<BenchCall*>(l->get());
+	    if (call->m_finish > now) {
+		l = l->skipNext();
+		continue;
+	    }
+	    u_int64_t t = Time::now();
+	    call->disconnect("bench");
+	    l->remove();
+	    teardown[dropped++] = Time::now() - t;
+	    l = l->skipNull();
+	}
+	Thread::msleep(1);
+    }
+    // engine exiting, drop what is left
+    while (BenchCall* call = static_cast<BenchCall*>(active.remove(false))) {
+	call->disconnect("exiting");
+	TelEngine::destruct(call);
+    }
+    u_int64_t elapsed = Time::now() - start;
+    cpu = cpuTime() - cpu;
+    s_mediaMutex.lock();
+    u_int64_t media = s_mediaBytes;
+    s_mediaMutex.unlock();
+    line << " calls=" << count << " callto=" << callto << " target_caps=" << caps;
+    line << " duration_msec=" << duration << " ok=" << ok << " failed=" << (started - ok);
+    line << " peak=" << peak << " elapsed_usec=" << elapsed;
+    String tmp;
+    tmp.printf(" caps=%.1f cpu_usec_per_call=%.1f media_bytes=" FMT64U,
+	perSecond(started > 1 ? started - 1 : 0,lastStart - start),
+	ok ? (double)cpu / ok : 0.0,media);
+    line << tmp;
+    percentiles(line,"setup_",setup,ok);
+    percentiles(line,"teardown_",teardown,dropped);
+    delete[] setup;
+    delete[] teardown;
+    return true;
+}
+
+}; // anonymous namespace
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,182 @@
+/**
+ * parambench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Message parameters access benchmark
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "benchmark.h"
+
+namespace { // anonymous
+
+class ParamBench : public BenchPlugin
+{
+public:
+    ParamBench();
+protected:
+    virtual void check(const String& args, BenchChecks& checks);
+    virtual bool run(const String& args, String& error);
+private:
+    u_int64_t runOnce(unsigned int params, unsigned int loops, String* result = 0);
+    void runSizes(unsigned int params, unsigned int loops);
+};
+
+INIT_PLUGIN(ParamBench);
+
+// Names usually found in a call.route or call.execute
+static const char* s_names[] = {
+    "id", "module", "status", "address", "billid", "answered", "direction",
+    "callid", "caller", "called", "callername", "format", "formats", "handlers",
+    "rtp_addr", "rtp_port", "rtp_forward", "sdp_raw", "media", "transport",
+    "ip_host", "ip_port", "ip_transport", "connection_id", "connection_reliable",
+    "sip_uri", "sip_from", "sip_to", "sip_callid", "sip_contact", "sip_user-agent",
+    "sip_allow", "sip_supported", "sip_content-type", "device", "antiloop",
+    "domain", "xsip_dlgasked", "newcall", "line", "username", "reason", 0
+};
+
+static const char* s_lookups[] = {
+    "called", "caller", "billid", "callername", "format", "formats", "line",
+    "rtp_forward", "sip_user-agent", "domain", "antiloop", "osip_X-Missing",
+    "copyparams", "reason", "x_missing", "callto", 0
+};
+
+// Build a message similar to what a SIP channel emits
+static void fillMessage(Message& msg, unsigned int params)
+{
+    unsigned int n = 0;
+    for (const char** p = s_names; *p && (n < params); p++, n++)
+	msg.addParam(*p,String(*p) + "-value");
+    for (; n < params; n++)
+	msg.addParam("osip_X-Header-" + String(n),"some header value");
+}
+
+
+ParamBench::ParamBench()
+    : BenchPlugin("parambench","ParamBench")
+{
+}
+
+// Run typical routing access patterns, return elapsed time in usec
+// Append what the router sees to result if one is given
+u_int64_t ParamBench::runOnce(unsigned int params, unsigned int loops, String* result)
+{
+    u_int64_t start = Time::now();
+    for (unsigned int i = 0; i < loops; i++) {
+	// channel builds call.route, routing module reads it
+	Message route("call.route");
+	fillMessage(route,params);
+	for (const char** p = s_lookups; *p; p++)
+	    route.getValue(*p);
+	route.setParam("callto","sip/sip:1234@example.com");
+	route.setParam("line","trunk1");
+	// router copies the received parameters to call.execute
+	Message exec("call.execute");
+	exec.copyParams(route);
+	exec.copyParams(route,"caller,called,billid,callername,rtp_forward,missing");
+	exec.copySubParams(route,"osip_",false,true);
+	for (const char** p = s_lookups; *p; p++) {
+	    const char* val = exec.getValue(*p);
+	    if (result)
+		*result << *p << "=" << TelEngine::c_safe(val) << ";";
+	}
+	exec.clearParam("handlers");
+	exec.clearParam("osip_X-Missing");
+	String query = "SELECT route FROM routes WHERE called='${called}' AND line='${line}'";
+	exec.replaceParams(query,true);
+	if (result) {
+	    *result << query;
+	    for (const ObjList* l = exec.paramList()->skipNull(); l; l = l->skipNext()) {
+		const NamedString* ns = static_cast<const NamedString*>(l->get());
+		*result << ";" << ns->name() << "=" << *ns;
+	    }
+	}
+    }
+    return Time::now() - start;
+}
+
+// parambench [params] [loops], return false if no size was given
+static bool parseArgs(const String& args, int& params, int& loops)
+{
+    String line(args);
+    if (line.trimBlanks().null())
+	return false;
+    line >> params >> " " >> loops;
+    if (params < 1)
+	params = 1;
+    if (loops < 1)
+	loops = 1;
+    return true;
+}
+
+// The indexed lookups must see exactly what the linear search sees
+void ParamBench::check(const String& args, BenchChecks& checks)
+{
+    static const int s_sizes[] = { 1, 15, 16, 17, 80, 120, 0 };
+    int params = 0;
+    int loops = 1;
+    if (!parseArgs(args,params,loops))
+	params = 0;
+    unsigned int thres = NamedList::indexThreshold();
+    for (const int* n = s_sizes; ; n++) {
+	int size = *n ? *n : params;
+	if (!size)
+	    break;
+	NamedList::indexThreshold(0);
+	String linear;
+	runOnce(size,1,&linear);
+	NamedList::indexThreshold(thres ? thres : 16);
+	String indexed;
+	runOnce(size,1,&indexed);
+	checks.check(linear == indexed,"%d params: linear and indexed lookups differ",size);
+	if (!*n)
+	    break;
+    }
+    NamedList::indexThreshold(thres);
+}
+
+void ParamBench::runSizes(unsigned int params, unsigned int loops)
+{
+    unsigned int thres = NamedList::indexThreshold();
+    NamedList::indexThreshold(0);
+    u_int64_t linear = runOnce(params,loops);
+    NamedList::indexThreshold(thres ? thres : 16);
+    u_int64_t indexed = runOnce(params,loops);
+    NamedList::indexThreshold(thres);
+    Output("ParamBench: %u params x %u loops: linear " FMT64U " usec, indexed (threshold %u) "
+	FMT64U " usec, %.2f usec/message pair saved",
+	params,loops,linear,(thres ? thres : 16),indexed,
+	((double)linear - (double)indexed) / loops);
+}
+
+// Run all typical sizes if none was given
+bool ParamBench::run(const String& args, String& error)
+{
+    int params = 80;
+    int loops = 20000;
+    if (parseArgs(args,params,loops)) {
+	runSizes(params,loops);
+	return true;
+    }
+    runSizes(20,loops);
+    runSizes(80,loops);
+    runSizes(120,loops);
+    return true;
+}
+
+}; // anonymous namespace
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
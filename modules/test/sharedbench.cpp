@@ -0,0 +1,223 @@
+/**
+ * sharedbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * Shared variables counters benchmark
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "benchmark.h"
+
+namespace { // anonymous
+
+class SharedBench : public BenchPlugin
+{
+public:
+    SharedBench();
+protected:
+    virtual void check(const String& args, BenchChecks& checks);
+    virtual bool run(const String& args, String& error);
+private:
+    u_int64_t runOnce(unsigned int threads, unsigned int loops, bool legacy, BenchChecks* checks = 0);
+    void runThreads(unsigned int threads, unsigned int loops);
+};
+
+// Single list behind one mutex, same as the original shared variables
+class LegacyVars : public Mutex
+{
+public:
+    inline LegacyVars()
+	: Mutex(false,"LegacyVars"), m_vars("")
+	{ }
+    inline unsigned int inc(const String& name)
+	{
+	    Lock mylock(this);
+	    unsigned int val = m_vars.getIntValue(name);
+	    m_vars.setParam(name,String(val + 1));
+	    return val;
+	}
+    inline unsigned int dec(const String& name)
+	{
+	    Lock mylock(this);
+	    unsigned int val = m_vars.getIntValue(name);
+	    val = val ? (val - 1) : 0;
+	    m_vars.setParam(name,String(val));
+	    return val;
+	}
+    inline unsigned int count(const String& name)
+	{
+	    Lock mylock(this);
+	    return m_vars.getIntValue(name);
+	}
+private:
+    NamedList m_vars;
+};
+
+// Worker counting calls on trunks like a routing script does
+class BenchThread : public Thread
+{
+public:
+    inline BenchThread(unsigned int loops, SharedVars* vars, LegacyVars* legacy)
+	: Thread("SharedBench"),
+	  m_loops(loops), m_vars(vars), m_legacy(legacy)
+	{ }
+    virtual void run();
+private:
+    unsigned int m_loops;
+    SharedVars* m_vars;
+    LegacyVars* m_legacy;
+};
+
+// Number of trunks counters are kept for
+#define TRUNKS 64
+
+// Maximum number of worker threads
+#define THREADS 64
+
+static String s_trunks[TRUNKS];
+// Static so finishing workers never touch a destroyed semaphore
+static Semaphore s_start(THREADS,"SharedBenchStart",0);
+static Semaphore s_done(THREADS,"SharedBenchDone",0);
+
+INIT_PLUGIN(SharedBench);
+
+void BenchThread::run()
+{
+    s_start.lock();
+    for (unsigned int i = 0; i < m_loops; i++) {
+	const String& trunk = s_trunks[i % TRUNKS];
+	if (m_vars) {
+	    m_vars->inc(trunk);
+	    m_vars->dec(trunk);
+	}
+	else {
+	    m_legacy->inc(trunk);
+	    m_legacy->dec(trunk);
+	}
+    }
+    s_done.unlock();
+}
+
+
+SharedBench::SharedBench()
+    : BenchPlugin("sharedbench","SharedBench")
+{
+    for (unsigned int i = 0; i < TRUNKS; i++)
+	s_trunks[i] << "calls_trunk" << i;
+}
+
+// Run an increment / decrement pair per loop in each thread, return elapsed usec
+u_int64_t SharedBench::runOnce(unsigned int threads, unsigned int loops, bool legacy, BenchChecks* checks)
+{
+    // reference counted, must not live on the stack
+    SharedVars* vars = new SharedVars;
+    LegacyVars old;
+    // some unrelated variables so lookups are not trivial
+    for (unsigned int i = 0; i < 200; i++) {
+	String name("route_cache_");
+	name << i;
+	vars->set(name,"value");
+	old.inc(name);
+    }
+    unsigned int started = 0;
+    for (unsigned int i = 0; i < threads; i++) {
+	BenchThread* t = new BenchThread(loops,(legacy ? 0 : vars),&old);
+	if (t->startup())
+	    started++;
+    }
+    u_int64_t begin = Time::now();
+    for (unsigned int i = 0; i < started; i++)
+	s_start.unlock();
+    for (unsigned int i = 0; i < started; i++)
+	s_done.lock();
+    u_int64_t elapsed = Time::now() - begin;
+    // all increments were matched by decrements
+    for (unsigned int i = 0; checks && i < TRUNKS; i++) {
+	unsigned int left = 0;
+	if (legacy)
+	    left = old.count(s_trunks[i]);
+	else {
+	    String val;
+	    vars->get(s_trunks[i],val);
+	    left = val.toInteger();
+	}
+	checks->check(!left,"%s with %u threads: counter %s left at %u",
+	    (legacy ? "single list" : "sharded"),threads,s_trunks[i].c_str(),left);
+    }
+    TelEngine::destruct(vars);
+    return elapsed ? elapsed : 1;
+}
+
+// Both implementations must count the same way and not lose updates under contention
+void SharedBench::check(const String& args, BenchChecks& checks)
+{
+    SharedVars* vars = new SharedVars;
+    LegacyVars old;
+    bool same = true;
+    for (unsigned int i = 0; same && i < 1000; i++) {
+	const String& trunk = s_trunks[(i * 7) % TRUNKS];
+	if ((i % 3) == 2)
+	    same = (vars->dec(trunk) == old.dec(trunk));
+	else
+	    same = (vars->inc(trunk) == old.inc(trunk));
+    }
+    for (unsigned int i = 0; same && i < TRUNKS; i++) {
+	String val;
+	vars->get(s_trunks[i],val);
+	same = ((unsigned int)val.toInteger() == old.count(s_trunks[i]));
+    }
+    TelEngine::destruct(vars);
+    checks.check(same,"sharded and single list counters differ");
+    runOnce(THREADS / 2,2000,true,&checks);
+    runOnce(THREADS / 2,2000,false,&checks);
+}
+
+void SharedBench::runThreads(unsigned int threads, unsigned int loops)
+{
+    u_int64_t legacy = runOnce(threads,loops,true);
+    u_int64_t sharded = runOnce(threads,loops,false);
+    double ops = 2.0 * threads * loops;
+    Output("SharedBench: %u threads x %u loops: single list " FMT64U " usec (%.0f ns/op), "
+	"sharded " FMT64U " usec (%.0f ns/op), speedup %.2f",
+	threads,loops,legacy,1000.0 * legacy / ops,sharded,1000.0 * sharded / ops,
+	(double)legacy / (double)sharded);
+}
+
+// sharedbench [threads] [loops], one and four threads if none given
+bool SharedBench::run(const String& args, String& error)
+{
+    String line(args);
+    if (line.trimBlanks().null()) {
+	runThreads(1,200000);
+	runThreads(4,100000);
+	return true;
+    }
+    int threads = 4;
+    int loops = 100000;
+    line >> threads >> " " >> loops;
+    if (threads < 1)
+	threads = 1;
+    else if (threads > THREADS)
+	threads = THREADS;
+    if (loops < 1)
+	loops = 1;
+    runThreads(threads,loops);
+    return true;
+}
+
+}; // anonymous namespace
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -0,0 +1,282 @@
+/**
+ * srtpbench.cpp
+ * This file is part of the YATE Project http://YATE.null.ro
+ *
+ * SRTP protect/unprotect benchmark
+ *
+ * Yet Another Telephony Engine - a fully featured software PBX and IVR
+ * Copyright (C) 2004-2014 Null Team
+ *
+ * This software is distributed under multiple licenses;
+ * see the COPYING file in the main directory for licensing
+ * information for this specific distribution.
+ *
+ * This use of this software may be subject to additional restrictions.
+ * See the LEGAL file in the main directory for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "benchmark.h"
+#include <yatertp.h>
+
+#include <string.h>
+
+namespace { // anonymous
+
+class SrtpBench : public BenchPlugin
+{
+public:
+    SrtpBench();
+protected:
+    virtual void check(const String& args, BenchChecks& checks);
+    virtual bool run(const String& args, String& error);
+private:
+    bool checkOnce(const char* suite, const char* key, const char* plain, const char* secured);
+    bool runOnce(const char* suite, unsigned int packets, unsigned int size,
+	u_int64_t& protect, u_int64_t& unprotect);
+};
+
+class CipherHolder : public RefObject
+{
+public:
+    inline CipherHolder()
+	: m_cipher(0)
+	{ }
+    virtual ~CipherHolder()
+	{ TelEngine::destruct(m_cipher); }
+    virtual void* getObject(const String& name) const
+	{ return (name == YATOM("Cipher*")) ? (void*)&m_cipher : RefObject::getObject(name); }
+    inline Cipher* cipher()
+	{ Cipher* tmp = m_cipher; m_cipher = 0; return tmp; }
+private:
+    Cipher* m_cipher;
+};
+
+// Session without transport, only used to build ciphers
+class BenchSession : public RTPSession
+{
+public:
+    virtual Cipher* createCipher(const String& name, Cipher::Direction dir);
+    virtual bool checkCipher(const String& name);
+};
+
+// Expose the packet transforms that RTPSender and RTPReceiver normally call
+class BenchSecure : public RTPSecure
+{
+public:
+    inline BenchSecure()
+	{ }
+    inline BenchSecure(const String& suite)
+	: RTPSecure(suite)
+	{ }
+    inline void protect(unsigned char* pkt, int len)
+	{ rtpEncipher(pkt + 12,len - 12); rtpAddIntegrity(pkt,len,pkt + len); }
+    inline bool unprotect(unsigned char* pkt, int len, u_int32_t ssrc, u_int64_t seq)
+	{ return rtpCheckIntegrity(pkt,len,pkt + len,ssrc,seq) &&
+	    rtpDecipher(pkt + 12,len - 12,pkt + len,ssrc,seq); }
+};
+
+INIT_PLUGIN(SrtpBench);
+
+static const char* s_suites[] = {
+    "AES_CM_128_HMAC_SHA1_80",
+    "AES_CM_128_HMAC_SHA1_32",
+    "AEAD_AES_128_GCM",
+    "AEAD_AES_256_GCM",
+    0
+};
+
+struct KnownAnswer {
+    const char* suite;
+    const char* key;
+    const char* plain;
+    const char* secured;
+};
+
+// Master key and salt, plain and protected packet with SSRC cafebabe and sequence 1234
+static const KnownAnswer s_vectors[] = {
+    { "AES_CM_128_HMAC_SHA1_80",
+	"e1f97a0d3e018be0d64fa32c06de41390ec675ad498afeebb6960b3aabe6",
+	"800f1234decafbadcafebabeabababababababababababababababab",
+	"800f1234decafbadcafebabe4e55dc4ce79978d88ca4d215949d2402b78d6acc99ea179b8dbb" },
+    { "AEAD_AES_128_GCM",
+	"000102030405060708090a0b0c0d0e0fa0a1a2a3a4a5a6a7a8a9aaab",
+	"800f1234decafbadcafebabeabababababababababababababababab",
+	"800f1234decafbadcafebabec5002ede04cfdd2eb91159e0880aa06ed2976826f796b201df3131a127e8a392" },
+    { 0, 0, 0, 0 }
+};
+
+Cipher* BenchSession::createCipher(const String& name, Cipher::Direction dir)
+{
+    Message msg("engine.cipher");
+    msg.addParam("cipher",name);
+    msg.addParam("direction",lookup(dir,Cipher::directions(),"unknown"));
+    CipherHolder* cHold = new CipherHolder;
+    msg.userData(cHold);
+    cHold->deref();
+    return Engine::dispatch(msg) ? cHold->cipher() : 0;
+}
+
+bool BenchSession::checkCipher(const String& name)
+{
+    Message msg("engine.cipher");
+    msg.addParam("cipher",name);
+    return Engine::dispatch(msg);
+}
+
+
+SrtpBench::SrtpBench()
+    : BenchPlugin("srtpbench","SrtpBench")
+{
+}
+
+// Protect and unprotect packets with one suite, return times in usec
+bool SrtpBench::runOnce(const char* suite, unsigned int packets, unsigned int size,
+    u_int64_t& protect, u_int64_t& unprotect)
+{
+    BenchSession session;
+    if (!session.checkCipher("aes_ctr"))
+	return false;
+    RTPSender sender(&session);
+    RTPReceiver receiver(&session);
+    BenchSecure* tx = new BenchSecure(suite);
+    String cryptoSuite;
+    String key;
+    if (!(tx->supported(&session) && tx->create(cryptoSuite,key,true))) {
+	TelEngine::destruct(tx);
+	return false;
+    }
+    sender.security(tx);
+    BenchSecure* rx = new BenchSecure;
+    if (!rx->setup(cryptoSuite,key)) {
+	TelEngine::destruct(rx);
+	return false;
+    }
+    receiver.security(rx);
+    if (!(tx->rtpCipher() && rx->rtpCipher()))
+	return false;
+
+    unsigned int len = size + 12;
+    DataBlock plain(0,len + 16);
+    unsigned char* p = (unsigned char*)plain.data();
+    p[0] = 0x80;
+    p[1] = 8;
+    for (unsigned int i = 12; i < len; i++)
+	p[i] = (unsigned char)(i * 7);
+    DataBlock work(0,len + 16);
+    unsigned char* w = (unsigned char*)work.data();
+
+    u_int64_t start = Time::now();
+    for (unsigned int i = 0; i < packets; i++) {
+	::memcpy(w,p,len);
+	tx->protect(w,len);
+    }
+    protect = Time::now() - start;
+
+    DataBlock secured(work);
+    const unsigned char* s = (const unsigned char*)secured.data();
+    unsigned int fails = 0;
+    start = Time::now();
+    for (unsigned int i = 0; i < packets; i++) {
+	::memcpy(w,s,len + 16);
+	if (!rx->unprotect(w,len,sender.ssrc(),sender.fullSeq()))
+	    fails++;
+    }
+    unprotect = Time::now() - start;
+    if (fails || ::memcmp(w,p,len)) {
+	Debug("srtpbench",DebugWarn,"Suite %s failed to unprotect %u of %u packets",
+	    suite,fails,packets);
+	return false;
+    }
+    return true;
+}
+
+// Unprotect a known packet, compare with the expected plain one
+bool SrtpBench::checkOnce(const char* suite, const char* key, const char* plain, const char* secured)
+{
+    BenchSession session;
+    RTPReceiver receiver(&session);
+    DataBlock master;
+    DataBlock ref;
+    DataBlock pkt;
+    if (!(master.unHexify(key) && ref.unHexify(plain) && pkt.unHexify(secured)))
+	return false;
+    Base64 b64(master.data(),master.length());
+    String keyParams;
+    b64.encode(keyParams,0,false);
+    BenchSecure* rx = new BenchSecure;
+    if (!(rx->supported(&session) && rx->setup(suite,"inline:" + keyParams))) {
+	TelEngine::destruct(rx);
+	return false;
+    }
+    receiver.security(rx);
+    unsigned char* p = (unsigned char*)pkt.data();
+    return rx->rtpCipher() && rx->unprotect(p,ref.length(),0xcafebabe,0x1234) &&
+	!::memcmp(p,ref.data(),ref.length());
+}
+
+// Check if the ciphers needed by a suite are provided by some module
+static bool available(const char* suite)
+{
+    BenchSession session;
+    BenchSecure* sec = new BenchSecure(suite);
+    bool ok = sec->supported(&session);
+    TelEngine::destruct(sec);
+    if (!ok)
+	Debug("srtpbench",DebugNote,"Suite %s is not available",suite);
+    return ok;
+}
+
+// Unprotect the known answer packets, protect and unprotect with each suite
+void SrtpBench::check(const String& args, BenchChecks& checks)
+{
+    for (const KnownAnswer* v = s_vectors; v->suite; v++) {
+	if (available(v->suite))
+	    checks.check(checkOnce(v->suite,v->key,v->plain,v->secured),
+		"suite %s failed the known answer test",v->suite);
+    }
+    for (const char** s = s_suites; *s; s++) {
+	if (!available(*s))
+	    continue;
+	u_int64_t protect = 0;
+	u_int64_t unprotect = 0;
+	checks.check(runOnce(*s,16,1400,protect,unprotect),"suite %s failed the round trip",*s);
+    }
+}
+
+// srtpbench [packets] [size]
+bool SrtpBench::run(const String& args, String& error)
+{
+    int packets = 100000;
+    int size = 160;
+    String line(args);
+    line >> packets >> " " >> size;
+    if (packets < 1)
+	packets = 1;
+    if (size < 1)
+	size = 1;
+    else if (size > 1400)
+	size = 1400;
+    for (const char** s = s_suites; *s; s++) {
+	if (!available(*s))
+	    continue;
+	u_int64_t protect = 0;
+	u_int64_t unprotect = 0;
+	if (!runOnce(*s,packets,size,protect,unprotect)) {
+	    error << "suite " << *s << " failed";
+	    return false;
+	}
+	Output("SrtpBench: %s %u bytes x %u packets: protect " FMT64U " usec (%.0f ns/packet), "
+	    "unprotect " FMT64U " usec (%.0f ns/packet)",
+	    *s,size,packets,protect,1000.0 * protect / packets,
+	    unprotect,1000.0 * unprotect / packets);
+    }
+    return true;
+}
+
+}; // anonymous namespace
+
+/* vi: set ts=8 sw=4 sts=4 noet: */
@@ -211,6 +211,8 @@ public:
 	const void* data, int len);
     virtual bool rtpRecvEvent(int event, char key, int duration,
 	int volume, unsigned int timestamp);
+    virtual bool rtpConcealData(unsigned int timestamp, const void* data, int len,
+	unsigned int count);
     virtual void rtpNewPayload(int payload, unsigned int timestamp);
     virtual void rtpNewSSRC(u_int32_t newSsrc, int newPayload, bool marker);
     virtual Cipher* createCipher(const String& name, Cipher::Direction dir);
@@ -222,7 +224,9 @@ public:
 protected:
     virtual void timeout(bool initial);
 private:
+    bool forward(DataBlock& block, unsigned int timestamp, unsigned long flags);
     YRTPWrapper* m_wrap;
+    DataBlock m_conceal;
     u_int32_t m_lastLost;
     int m_newPayload;
     bool m_resync;
@@ -974,6 +978,38 @@ YRTPSession::~YRTPSession()
 }
 
 bool YRTPSession::rtpRecvData(bool marker, unsigned int timestamp, const void* data, int len)
+{
+    unsigned long flags = (marker ? DataNode::DataMark : 0);
+    u_int32_t lost = ioPacketsLost();
+    if (lost != m_lastLost) {
+	if (lost > m_lastLost)
+	    flags |= DataNode::DataMissed;
+	m_lastLost = lost;
+    }
+    DataBlock block;
+    block.assign((void*)data, len, false);
+    bool ok = forward(block,timestamp,flags);
+    block.clear(false);
+    return ok;
+}
+
+bool YRTPSession::rtpConcealData(unsigned int timestamp, const void* data, int len,
+    unsigned int count)
+{
+    // only signed linear can be repeated and faded without a codec
+    if (!(m_wrap && (len >= 2) && count && (count < 4) && m_wrap->m_format.startsWith("slin")))
+	return false;
+    if (m_conceal.length() != (unsigned int)len)
+	m_conceal.assign(0,len);
+    const int16_t* src = (const int16_t*)data;
+    int16_t* dst = (int16_t*)m_conceal.data();
+    for (int i = len / 2; i > 0; i--)
+	*dst++ = (int16_t)(((int)*src++) * (int)(4 - count) / 4);
+    return forward(m_conceal,timestamp,0);
+}
+
+// Send a received or synthesized data block to the source, if any
+bool YRTPSession::forward(DataBlock& block, unsigned int timestamp, unsigned long flags)
 {
     s_srcMutex.lock();
     YRTPSource* source = m_wrap ? m_wrap->m_source : 0;
@@ -988,18 +1024,8 @@ bool YRTPSession::rtpRecvData(bool marker, unsigned int timestamp, const void* d
     s_srcMutex.unlock();
     if (!source)
 	return false;
-    unsigned long flags = (marker ? DataNode::DataMark : 0);
-    u_int32_t lost = ioPacketsLost();
-    if (lost != m_lastLost) {
-	if (lost > m_lastLost)
-	    flags |= DataNode::DataMissed;
-	m_lastLost = lost;
-    }
     // the source will not be destroyed until we reset the busy flag
-    DataBlock block;
-    block.assign((void*)data, len, false);
     source->Forward(block,timestamp,flags);
-    block.clear(false);
     source->busy(false);
     return true;
 }
@@ -1861,7 +1887,7 @@ void YRTPPlugin::initialize()
     s_minport = cfg.getIntValue("general","minport",MIN_PORT);
     s_maxport = cfg.getIntValue("general","maxport",MAX_PORT);
     s_bufsize = cfg.getIntValue("general","buffer",BUF_SIZE);
-    s_minJitter = cfg.getIntValue("general","minjitter",50);
+    s_minJitter = cfg.getIntValue("general","minjitter",20);
     s_maxJitter = cfg.getIntValue("general","maxjitter",Engine::clientMode() ? 120 : 0);
     s_tos = cfg.getIntValue("general","tos",Socket::tosValues());
     s_udpbuf = cfg.getIntValue("general","udpbuf",0);
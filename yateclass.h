@@ -633,6 +633,17 @@ public:
      */
     static void enableOutput(bool enable = true, bool colorize = false);
 
+    /**
+     * Switch between synchronous and asynchronous output of debug messages.
+     * In asynchronous mode each thread formats lines into its own ring buffer
+     *  and a dedicated thread writes them out in batches. Lines that do not
+     *  fit in a full buffer are dropped and their number is reported.
+     * @param bufSize Size of the per thread buffer in bytes, zero to flush
+     *  pending lines and revert to synchronous output
+     * @return True if asynchronous output is active
+     */
+    static bool setAsyncOutput(unsigned int bufSize = 0);
+
     /**
      * Retrieve the start timestamp
      * @return Start timestamp value in seconds
@@ -3511,6 +3522,122 @@ private:
     unsigned int m_current;
 };
 
+/**
+ * Scheduling state of an object kept in a TimerWheel.
+ * It is meant to be a member of the scheduled object.
+ * @short An entry of a timer wheel
+ */
+class YATE_API TimerWheelEntry : public GenObject
+{
+    friend class TimerWheel;
+    YNOCOPY(TimerWheelEntry); // no automatic copies please
+public:
+    /**
+     * Constructor
+     * @param object Pointer to the object returned when the entry is due
+     */
+    inline explicit TimerWheelEntry(GenObject* object)
+	: m_object(object), m_slot(-1), m_tick(0), m_ready(false), m_done(false)
+	{ }
+
+    /**
+     * Get the object this entry schedules
+     * @return Pointer to the scheduled object
+     */
+    inline GenObject* object() const
+	{ return m_object; }
+
+    /**
+     * Check if the entry is waiting in the wheel or in the ready list
+     * @return True if the entry is scheduled
+     */
+    inline bool scheduled() const
+	{ return m_ready || (m_slot >= 0); }
+
+    /**
+     * Check if the entry was cancelled for good
+     * @return True if the entry can't be scheduled anymore
+     */
+    inline bool done() const
+	{ return m_done; }
+
+private:
+    GenObject* m_object;
+    int m_slot;
+    u_int64_t m_tick;
+    bool m_ready;
+    bool m_done;
+};
+
+/**
+ * A hashed timer wheel holding objects that need to be checked at a given time
+ *  or as soon as possible. Due objects are collected in a ready list in the
+ *  order they expired and retrieved one by one.
+ * Times beyond the span of the wheel are clamped to its last slot so
+ *  objects must be prepared to be returned early and schedule themselves again.
+ * The wheel is not thread safe, the owner must serialize access to it.
+ * @short A timer wheel with a ready list
+ */
+class YATE_API TimerWheel
+{
+    YNOCOPY(TimerWheel); // no automatic copies please
+public:
+    /**
+     * Constructor
+     * @param slots Number of slots in the wheel
+     * @param tick Duration of a slot, in the time unit used by the owner
+     * @param now Current time in the time unit used by the owner
+     */
+    TimerWheel(unsigned int slots, u_int64_t tick, u_int64_t now);
+
+    /**
+     * Destructor, does not delete the entries
+     */
+    ~TimerWheel();
+
+    /**
+     * Get the duration of a slot
+     * @return Duration of a slot, in the time unit used by the owner
+     */
+    inline u_int64_t tick() const
+	{ return m_tick; }
+
+    /**
+     * Schedule an entry. An entry already in the wheel is moved only to an earlier time
+     * @param entry Entry to schedule
+     * @param when Time when the entry is due, zero to make it ready now
+     * @return True if the entry is scheduled, false if it was cancelled for good
+     */
+    bool schedule(TimerWheelEntry& entry, u_int64_t when = 0);
+
+    /**
+     * Remove an entry from the wheel and the ready list
+     * @param entry Entry to remove
+     * @param done True to prevent the entry from being scheduled again
+     */
+    void cancel(TimerWheelEntry& entry, bool done = false);
+
+    /**
+     * Move entries from all elapsed slots to the ready list
+     * @param now Current time in the time unit used by the owner
+     */
+    void advance(u_int64_t now);
+
+    /**
+     * Remove the first entry from the ready list
+     * @return Pointer to the object of the entry, NULL if no entry is ready
+     */
+    GenObject* get();
+
+private:
+    unsigned int m_slots;
+    u_int64_t m_tick;
+    u_int64_t m_current;
+    ObjList* m_wheel;
+    ObjList m_ready;
+    ObjList* m_readyLast;
+};
+
 /**
  * The Time class holds a time moment with microsecond accuracy
  * @short A time holding class
@@ -3920,6 +4047,20 @@ public:
      */
     void cut(int len);
 
+    /**
+     * Enable or disable allocating small data blocks (like media frames) from
+     *  pools of reusable buffers kept per thread
+     * @param enable True to use the buffer pools, false to allocate with malloc
+     */
+    static void setFramePool(bool enable);
+
+    /**
+     * Replace the current thread's counter of data block allocations
+     * @param value New value of the counter
+     * @return Previous value of the counter, always zero if not supported
+     */
+    static unsigned int allocCounter(unsigned int value);
+
     /**
      * Byte indexing operator with signed parameter
      * @param index Index of the byte to retrieve
@@ -4005,10 +4146,12 @@ public:
 
 private:
     unsigned int allocLen(unsigned int len) const;
+    void replace(void* data, unsigned int len, unsigned int allocated, void* buffer);
     void* m_data;
     unsigned int m_length;
     unsigned int m_allocated;
     unsigned int m_overAlloc;
+    void* m_buffer;
 };
 
 /**
@@ -4168,6 +4311,29 @@ public:
      */
     virtual unsigned int hmacBlockSize() const;
 
+    /**
+     * CPU specific features the hash implementations can take advantage of
+     */
+    enum Acceleration {
+	// x86 SHA extensions, used by SHA1 and SHA256
+	AccelShaExt = 0x01,
+	// AVX2 integer vectors, used by multi-buffer MD5
+	AccelAvx2   = 0x02,
+    };
+
+    /**
+     * Retrieve the CPU specific features currently used for hashing
+     * @return Mask of Acceleration flags, zero if only portable code is used
+     */
+    static unsigned int accelerated();
+
+    /**
+     * Enable or disable the CPU specific hash implementations.
+     * They are enabled by default when the processor supports them
+     * @param enable True to use accelerated code when available, false to use portable code
+     */
+    static void setAccelerated(bool enable);
+
 protected:
     /**
      * Default constructor
@@ -4267,6 +4433,18 @@ public:
     virtual unsigned int hashLength() const
 	{ return 16; }
 
+    /**
+     * Compute the MD5 digests of many independent messages interleaved in vector
+     *  registers when the CPU allows it
+     * @param out Buffer to fill with count * rawLength() octets of raw digests
+     * @param bufs Pointers to the messages
+     * @param lens Lengths of the messages in octets
+     * @param count Number of messages
+     * @return True on success, false if a message has no data
+     */
+    static bool digestMany(unsigned char* out, const void* const* bufs,
+	const unsigned int* lens, unsigned int count);
+
 protected:
     bool updateInternal(const void* buf, unsigned int len);
 
@@ -4354,6 +4532,18 @@ public:
     virtual unsigned int hashLength() const
 	{ return 20; }
 
+    /**
+     * Compute the SHA1 digests of many independent messages without allocating
+     *  a context for each of them
+     * @param out Buffer to fill with count * rawLength() octets of raw digests
+     * @param bufs Pointers to the messages
+     * @param lens Lengths of the messages in octets
+     * @param count Number of messages
+     * @return True on success, false if a message has no data
+     */
+    static bool digestMany(unsigned char* out, const void* const* bufs,
+	const unsigned int* lens, unsigned int count);
+
     /**
      * NIST FIPS 186-2 change notice 1 Pseudo Random Function.
      * Uses a b=160 bits SHA1 based G(t,c) function with no XSEEDj
@@ -4451,6 +4641,18 @@ public:
     virtual unsigned int hashLength() const
 	{ return 32; }
 
+    /**
+     * Compute the SHA256 digests of many independent messages without allocating
+     *  a context for each of them
+     * @param out Buffer to fill with count * rawLength() octets of raw digests
+     * @param bufs Pointers to the messages
+     * @param lens Lengths of the messages in octets
+     * @param count Number of messages
+     * @return True on success, false if a message has no data
+     */
+    static bool digestMany(unsigned char* out, const void* const* bufs,
+	const unsigned int* lens, unsigned int count);
+
 protected:
     bool updateInternal(const void* buf, unsigned int len);
 
@@ -4527,9 +4729,12 @@ public:
 };
 
 class NamedIterator;
+class NamedListIndex;
 
 /**
- * This class holds a named list of named strings
+ * This class holds a named list of named strings.
+ * Lists holding more than a (configurable) number of parameters build a hash
+ *  index on parameter names so lookups don't need to scan the entire list
  * @short A named string container class
  */
 class YATE_API NamedList : public String
@@ -4556,6 +4761,11 @@ public:
      */
     NamedList(const char* name, const NamedList& original, const String& prefix);
 
+    /**
+     * Destructor
+     */
+    virtual ~NamedList();
+
     /**
      * Assignment operator
      * @param value New name and parameters to assign
@@ -4588,7 +4798,7 @@ public:
      * Clear all parameters
      */
     inline void clearParams()
-	{ m_params.clear(); }
+	{ dropIndex(); m_params.clear(); }
 
     /**
      * Add a named string to the parameter list.
@@ -4611,12 +4821,7 @@ public:
      * @param param Parameter to set or add
      * @return Reference to this NamedList
      */
-    inline NamedList& setParam(NamedString* param)
-    {
-	if (param)
-	    m_params.setUnique(param);
-	return *this;
-    }
+    NamedList& setParam(NamedString* param);
 
     /**
      * Set a named string in the parameter list.
@@ -4820,11 +5025,12 @@ public:
     static const NamedList& empty();
 
     /**
-     * Get the parameters list
+     * Get the parameters list.
+     * The name index is discarded as the caller may alter the list directly
      * @return Pointer to the parameters list
      */
     inline ObjList* paramList()
-	{ return &m_params; }
+	{ dropIndex(); return &m_params; }
 
     /**
      * Get the parameters list
@@ -4833,9 +5039,31 @@ public:
     inline const ObjList* paramList() const
 	{ return &m_params; }
 
+    /**
+     * Discard the parameter name index, it will be rebuilt when the list grows.
+     * Must be called after renaming parameters already held in the list
+     */
+    void dropIndex();
+
+    /**
+     * Retrieve the number of parameters above which lists are indexed
+     * @return Parameter count that triggers indexing, zero if disabled
+     */
+    static unsigned int indexThreshold();
+
+    /**
+     * Set the number of parameters above which lists are indexed.
+     * Lists already indexed are not affected
+     * @param count Parameter count that triggers indexing, zero to disable
+     */
+    static void indexThreshold(unsigned int count);
+
 private:
     NamedList(); // no default constructor please
+    void appendParam(NamedString* param);
+    void removeParam(ObjList* item, bool delParam);
     ObjList m_params;
+    NamedListIndex* m_index;
 };
 
 /**
@@ -5195,6 +5423,34 @@ public:
      */
     static bool efficientTimedLock();
 
+    /**
+     * Start or stop collecting lock wait and hold times of mutexes.
+     * Statistics are kept per mutex name so all mutexes sharing a name are
+     *  accounted together. Profiling adds a small overhead to each lock.
+     * @param enable True to start profiling, false to stop it
+     * @return True if profiling is active, false if stopped or not supported
+     */
+    static bool profiling(bool enable);
+
+    /**
+     * Check if mutex profiling is currently active
+     * @return True if lock times are being collected
+     */
+    static bool profiling();
+
+    /**
+     * Clear the collected mutex profiling statistics
+     */
+    static void profileReset();
+
+    /**
+     * Build a text report of mutex profiling statistics, most waited first
+     * @param dest String to append one line per mutex name to
+     * @param max Maximum number of lines to append, zero for all
+     * @return Number of mutex names having statistics
+     */
+    static unsigned int profileReport(String& dest, unsigned int max = 0);
+
 private:
     MutexPrivate* privDataCopy() const;
     MutexPrivate* m_private;
@@ -7875,6 +8131,12 @@ public:
      */
     virtual unsigned int initVectorSize() const;
 
+    /**
+     * Get the authentication tag size of an authenticated encryption (AEAD) cipher
+     * @return Authentication tag size in bytes, 0 if not applicable
+     */
+    virtual unsigned int tagSize() const;
+
     /**
      * Round up a buffer length to a multiple of block size
      * @param len Length of data to encrypt or decrypt in bytes
@@ -7959,6 +8221,32 @@ public:
     inline bool decrypt(DataBlock& data)
 	{ return decrypt(data.data(),data.length()); }
 
+    /**
+     * Encrypt data in place and compute its authentication tag, AEAD ciphers only.
+     * The Initialization Vector must be set before each call
+     * @param data Pointer to data to encrypt in place
+     * @param len Length of data in bytes
+     * @param aad Pointer to additional data that is authenticated but not encrypted
+     * @param aadLen Length of additional authenticated data in bytes
+     * @param tag Buffer to store the authentication tag in, tagSize() bytes long
+     * @return True if data was successfully encrypted
+     */
+    virtual bool encryptAuth(void* data, unsigned int len,
+	const void* aad, unsigned int aadLen, void* tag);
+
+    /**
+     * Decrypt data in place and verify its authentication tag, AEAD ciphers only.
+     * The Initialization Vector must be set before each call
+     * @param data Pointer to data to decrypt in place
+     * @param len Length of data in bytes
+     * @param aad Pointer to additional data that is authenticated but not encrypted
+     * @param aadLen Length of additional authenticated data in bytes
+     * @param tag Pointer to the received authentication tag, tagSize() bytes long
+     * @return True if data was decrypted and the tag matched
+     */
+    virtual bool decryptAuth(void* data, unsigned int len,
+	const void* aad, unsigned int aadLen, const void* tag);
+
 private:
     static const TokenDict s_directions[];
 };
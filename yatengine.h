@@ -231,19 +231,36 @@ private:
     ObjList m_sections;
 };
 
+class SharedVarsShard;
+
 /**
- * Class that implements atomic / locked access and operations to its shared variables
+ * Class that implements atomic / locked access and operations to its shared variables.
+ * Variables are spread over a set of independently locked shards. Lookups and
+ *  numeric increment / decrement are lock free when atomic operations are available.
+ * Cleared variables are unlinked and freed as soon as no lock free reader can
+ *  still be walking the shard that held them.
  * @short Atomic access and operations to shared variables
  */
-class YATE_API SharedVars : public Mutex
+class YATE_API SharedVars : public Mutex, public RefObject
 {
+    YNOCOPY(SharedVars); // no automatic copies please
 public:
     /**
      * Constructor
+     * @param name Name of the variables space, empty for the engine's global one
      */
-    inline SharedVars()
-	: Mutex(false,"SharedVars"), m_vars("")
-	{ }
+    explicit SharedVars(const char* name = 0);
+
+    /**
+     * Destructor, releases all variables
+     */
+    virtual ~SharedVars();
+
+    /**
+     * Get the name of the variables space
+     * @return Name of the variables space
+     */
+    virtual const String& toString() const;
 
     /**
      * Get the string value of a variable
@@ -273,6 +290,11 @@ public:
      */
     void clear(const String& name);
 
+    /**
+     * Clear all variables
+     */
+    void clearAll();
+
     /**
      * Check if a variable exists
      * @param name Name of the variable
@@ -296,11 +318,31 @@ public:
      */
     unsigned int dec(const String& name, unsigned int wrap = 0);
 
+    /**
+     * Count the variables currently set, also frees cleared variables no longer in use
+     * @return Number of variables that exist
+     */
+    unsigned int count();
+
+    /**
+     * Copy a snapshot of the variables to a list of parameters.
+     * Each shard is copied atomically but not the space as a whole
+     * @param dest Destination list
+     * @param prefix Copy only variables whose name start with this prefix
+     * @param skipPrefix Strip the prefix from the name of copied parameters
+     * @return Number of variables copied
+     */
+    unsigned int copy(NamedList& dest, const String& prefix = String::empty(),
+	bool skipPrefix = true);
+
 private:
-    NamedList m_vars;
+    SharedVarsShard* shard(const String& name) const;
+    SharedVarsShard* m_shards;
+    String m_name;
 };
 
 class MessageDispatcher;
+class MessageHandler;
 class MessageRelay;
 class Engine;
 
@@ -401,6 +443,23 @@ public:
     inline bool broadcast() const
 	{ return m_broadcast; }
 
+    /**
+     * Suspend dispatching this message from inside a handler's received().
+     * Only messages dispatched from the engine queue can be suspended. When
+     *  this returns true the handler must return false and later call
+     *  @ref resume() exactly once, the message must not be used after that.
+     * @return True if the message was suspended, false if it must be handled synchronously
+     */
+    bool suspend();
+
+    /**
+     * Continue dispatching a suspended message to the remaining handlers.
+     * Dispatching is completed by an engine worker thread
+     * @param handled True if the handler that suspended the message accepted it
+     * @return True if the message was resumed, false if it was not suspended
+     */
+    bool resume(bool handled);
+
     /**
      * Retrieve a reference to the creation time of the message.
      * @return A reference to the @ref Time when the message was created
@@ -467,11 +526,24 @@ protected:
     virtual void dispatched(bool accepted);
 
 private:
+    enum DispatchState {
+	Sync = 0,
+	Async,
+	Suspending,
+	Resumed,
+	Suspended,
+	Resuming
+    };
     Message(); // no default constructor please
     Message& operator=(const Message& value); // no assignment please
     String m_return;
     Time m_time;
     RefObject* m_data;
+    MessageDispatcher* m_dispatcher;
+    const MessageHandler* m_suspender;
+    unsigned int m_priority;
+    int m_state;
+    bool m_handled;
     bool m_notify;
     bool m_broadcast;
     void commonEncode(String& str) const;
@@ -692,6 +764,7 @@ class YATE_API MessagePostHook : public RefObject, public MessageNotifier
 class YATE_API MessageDispatcher : public GenObject, public Mutex
 {
     friend class Engine;
+    friend class Message;
     YNOCOPY(MessageDispatcher); // no automatic copies please
 public:
     /**
@@ -798,6 +871,13 @@ public:
      */
     void setHook(MessagePostHook* hook, bool remove = false);
 
+    /**
+     * Get the number of messages suspended by handlers
+     * @return Count of messages waiting to be resumed
+     */
+    inline unsigned int suspendedCount() const
+	{ return m_suspended; }
+
 protected:
     /**
      * Set the tracked parameter name
@@ -807,6 +887,8 @@ protected:
 	{ m_trackParam = paramName; }
 
 private:
+    bool dispatchInternal(Message& msg, bool& suspended);
+    ObjList* resumePoint(const MessageHandler* handler, unsigned int priority);
     ObjList m_handlers;
     ObjList m_messages;
     ObjList m_hooks;
@@ -817,6 +899,7 @@ private:
     unsigned int m_changes;
     u_int64_t m_warnTime;
     int m_hookCount;
+    unsigned int m_suspended;
     bool m_hookHole;
 };
 
@@ -1018,9 +1101,27 @@ public:
     bool earlyInit() const
 	{ return m_early; }
 
+    /**
+     * Get the plugins that must complete initialization before this one
+     *  when plugins are initialized in parallel
+     * @return Comma separated list of plugin names
+     */
+    inline const String& initAfter() const
+	{ return m_initAfter; }
+
+protected:
+    /**
+     * Declare the plugins that must complete initialization before this one
+     *  when the engine initializes plugins in parallel
+     * @param names Comma separated list of plugin names
+     */
+    inline void initAfter(const char* names)
+	{ m_initAfter = names; }
+
 private:
     Plugin(); // no default constructor please
     String m_name;
+    String m_initAfter;
     NamedCounter* m_counter;
     bool m_early;
 };
@@ -1459,6 +1560,13 @@ public:
     inline unsigned int messageCount()
 	{ return m_dispatcher.messageCount(); }
 
+    /**
+     * Get the number of messages suspended by handlers
+     * @return Count of messages waiting to be resumed
+     */
+    inline unsigned int suspendedCount()
+	{ return m_dispatcher.suspendedCount(); }
+
     /**
      * Get the number of handlers in the dispatcher
      * @return Count of handlers
@@ -1505,6 +1613,15 @@ public:
      */
     static SharedVars& sharedVars();
 
+    /**
+     * Access a named space of shared variables, create it if missing.
+     * Named spaces are released by the engine once empty and no longer referenced
+     * @param vars Pointer to be set to the referenced variables space
+     * @param name Name of the variables space, empty for the global one
+     * @return True if the pointer was set
+     */
+    static bool sharedVars(RefPointer<SharedVars>& vars, const String& name);
+
     /**
      * Append command line arguments form current config.
      * The following parameters are added: -Dads, -v, -q, Debugger timestamp.
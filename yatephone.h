@@ -644,6 +644,7 @@ private:
 class YATE_API DataTranslator : public DataConsumer
 {
     friend class TranslatorFactory;
+    friend class DataConsumer;
 public:
     /**
      * Construct a data translator.
@@ -686,6 +687,14 @@ public:
     virtual DataSource* getTransSource() const
 	{ return m_tsource; }
 
+    /**
+     * Get the number of data blocks allocated while converting data.
+     * Blocks allocated by translators further down the chain are not included
+     * @return Number of allocations made by this translator
+     */
+    inline unsigned int allocations() const
+	{ return m_allocs; }
+
     /**
      * Get the first translator from a chain
      * @return Pointer to the first translator in a chain
@@ -811,6 +820,7 @@ private:
     static void compose(TranslatorFactory* factory);
     static bool canConvert(const FormatInfo* fmt1, const FormatInfo* fmt2);
     DataSource* m_tsource;
+    unsigned int m_allocs;
     static Mutex s_mutex;
     static ObjList s_factories;
     static unsigned int s_maxChain;
@@ -1650,6 +1660,8 @@ private:
     u_int64_t m_timeout;
     u_int64_t m_maxcall;
     u_int64_t m_maxPDD;          // Timeout while waiting for some progress on outgoing calls
+    u_int64_t m_timerTime;       // Time of the check scheduled in driver's timer wheel
+    TimerWheelEntry m_timer;     // Driver's timer wheel scheduling state
     u_int64_t m_dtmfTime;
     unsigned int m_toutAns;
     unsigned int m_dtmfSeq;
@@ -1803,7 +1815,9 @@ public:
     virtual bool msgControl(Message& msg);
 
     /**
-     * Timer check method, by default handles channel timeouts
+     * Timer check method, by default handles channel timeouts.
+     * It is called from the engine timer only after the time of a check
+     *  scheduled by setting a timeout or by @ref scheduleTimers() has passed
      * @param msg Timer message
      * @param tmr Current time against which timers are compared
      */
@@ -1911,7 +1925,7 @@ public:
      * @param tout New timeout time or zero to disable
      */
     inline void timeout(u_int64_t tout)
-	{ m_timeout = tout; }
+	{ m_timeout = tout; scheduleTimers(tout); }
 
     /**
      * Get the time this channel will time out on outgoing calls
@@ -1925,7 +1939,7 @@ public:
      * @param tout New timeout time or zero to disable
      */
     inline void maxcall(u_int64_t tout)
-	{ m_maxcall = tout; }
+	{ m_maxcall = tout; scheduleTimers(tout); }
 
     /**
      * Set the time this channel will time out on outgoing calls
@@ -1956,7 +1970,7 @@ public:
      * @param tout New timeout time or zero to disable
      */
     inline void maxPDD(u_int64_t tout)
-	{ m_maxPDD = tout; }
+	{ m_maxPDD = tout; scheduleTimers(tout); }
 
     /**
      * Set the time this channel will time out while waiting for some progress
@@ -2145,8 +2159,17 @@ protected:
     inline NamedList& parameters()
 	{ return m_parameters; }
 
+    /**
+     * Request a call of @ref checkTimers() at or shortly after a given time.
+     * Only channels already in the driver's list are scheduled, an earlier
+     *  check that is already scheduled is kept
+     * @param when Time of the check in microseconds, zero to do nothing
+     */
+    void scheduleTimers(u_int64_t when);
+
 private:
     void init();
+    void updateTimers();
     Channel(); // no default constructor please
 };
 
@@ -2164,6 +2187,8 @@ private:
     bool m_varchan;
     String m_prefix;
     ObjList m_chans;
+    HashList m_chanIndex;
+    TimerWheel* m_timerWheel;
     int m_routing;
     int m_routed;
     int m_total;
@@ -2204,7 +2229,8 @@ public:
 	{ return m_chans; }
 
     /**
-     * Find a channel by id
+     * Find a channel by id in the hashed channel index.
+     * The driver should be locked while calling this method
      * @param id Unique identifier of the channel to find
      * @return Pointer to the channel or NULL if not found
      */
@@ -2298,6 +2324,11 @@ protected:
      */
     Driver(const char* name, const char* type = 0);
 
+    /**
+     * Destructor
+     */
+    virtual ~Driver();
+
     /**
      * This method is called to initialize the loaded module
      */
@@ -2424,6 +2455,8 @@ protected:
 
 private:
     Driver(); // no default constructor please
+    void timerSchedule(Channel* chan, u_int64_t when);
+    void timerCancel(Channel* chan);
 };
 
 /**